@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "dedup.h"
+#include "metrics.h"
+
+static dedup_table *table = NULL;
+static int table_fd = -1;
+
+/* fnv-1a */
+static uint32_t dedup_hash(char *key) {
+  uint32_t h = 2166136261u;
+
+  for (; *key; key++)
+    h = (h ^ (unsigned char) *key) * 16777619u;
+  return h;
+}
+
+/* find, or claim, the slot for a stream */
+static dedup_slot *dedup_find(char *key) {
+  dedup_slot *s;
+  int i, n;
+
+  for (i = dedup_hash(key) & (DEDUP_SLOTS - 1), n = 0; n < DEDUP_SLOTS; i = (i + 1) & (DEDUP_SLOTS - 1), n++) {
+    s = &table->slot[i];
+    if (s->key[0] == '\0') {
+      (void) snprintf(s->key, sizeof(s->key), "%s", key);
+      s->seq = -1; s->start = 0.0; s->next = 0.0;
+      table->used++;
+      return s;
+    }
+    if (strcmp(s->key, key) == 0)
+      return s;
+  }
+
+  return NULL;
+}
+
+/* returns 0 for a record to pass on, 1 for an exact duplicate, 2 for one already covered */
+int dedup_record (tminiseed_call *data) {
+  int archival = (data->miniseed_action != MSA_512);
+  unsigned char *p = (unsigned char *) data->data_address;
+  char key[sizeof(((dedup_slot *) 0)->key)];
+  double period, next;
+  dedup_slot *s;
+  int32_t seq;
+  int samples, i;
+
+  /* only data records follow on from each other */
+  if ((table == NULL) || (data->packet_class != PKC_DATA) || (data->rate == 0) || (data->data_size < 48))
+    return 0;
+
+  /* archival records follow on from each other separately from the 512 byte ones */
+  (void) snprintf(key, sizeof(key), "%s.%s.%s%s", data->station_name, data->location, data->channel, (archival) ? DEDUP_ARCHIVAL : "");
+  if ((s = dedup_find(key)) == NULL)
+    return 0;
+
+  /* sequence number and sample count straight from the fixed header */
+  for (seq = 0, i = 0; i < 6; i++)
+    seq = seq * 10 + (((p[i] >= '0') && (p[i] <= '9')) ? p[i] - '0' : 0);
+  samples = (p[30] << 8) | p[31];
+
+  period = (data->rate > 0) ? 1.0 / (double) data->rate : -(double) data->rate;
+  next = data->timestamp + samples * period;
+
+  /* an update carries on the record last let through, any other belongs to one dropped */
+  if ((data->miniseed_action == MSA_INC) || (data->miniseed_action == MSA_FINAL)) {
+    if ((s->seq >= 0) && ((seq != s->seq) || (fabs(data->timestamp - s->start) >= (period / 2.0)))) {
+      metrics_dedup(data->data_size, 1);
+      return 2;
+    }
+    s->seq = seq;
+    s->start = data->timestamp;
+    s->next = next;
+    return 0;
+  }
+
+  if ((s->seq >= 0) && (data->timestamp > (s->start - DEDUP_REWIND))) {
+    if ((seq == s->seq) && (fabs(data->timestamp - s->start) < (period / 2.0))) {
+      metrics_dedup(data->data_size, 0);
+      return 1;
+    }
+    if (next <= (s->next + period / 2.0)) {
+      metrics_dedup(data->data_size, 1);
+      return 2;
+    }
+  }
+
+  s->seq = seq;
+  s->start = data->timestamp;
+  s->next = next;
+
+  return 0;
+}
+
+int dedup_open (char *path) {
+  struct stat st;
+  int fresh;
+
+  if ((table_fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+    ms_log(2, "can't open dedup index %s [%s]\n", path, strerror(errno)); return -1;
+  }
+  if (fstat(table_fd, &st) < 0) {
+    ms_log(2, "can't stat dedup index %s [%s]\n", path, strerror(errno)); close(table_fd); table_fd = -1; return -1;
+  }
+
+  /* anything not quite right is started afresh */
+  fresh = (st.st_size != sizeof(dedup_table));
+  if ((fresh) && (ftruncate(table_fd, 0) < 0 || ftruncate(table_fd, sizeof(dedup_table)) < 0)) {
+    ms_log(2, "can't size dedup index %s [%s]\n", path, strerror(errno)); close(table_fd); table_fd = -1; return -1;
+  }
+
+  if ((table = (dedup_table *) mmap(NULL, sizeof(dedup_table), PROT_READ | PROT_WRITE, MAP_SHARED, table_fd, 0)) == MAP_FAILED) {
+    ms_log(2, "can't map dedup index %s [%s]\n", path, strerror(errno)); close(table_fd); table_fd = -1; table = NULL; return -1;
+  }
+
+  if ((!fresh) && ((memcmp(table->magic, DEDUP_MAGIC, 4) != 0) || (table->version != DEDUP_VERSION) || (table->slots != DEDUP_SLOTS)))
+    fresh = 1;
+  if (fresh) {
+    memset(table, 0, sizeof(dedup_table));
+    memcpy(table->magic, DEDUP_MAGIC, 4);
+    table->version = DEDUP_VERSION;
+    table->slots = DEDUP_SLOTS;
+  }
+
+  return 0;
+}
+
+void dedup_close (void) {
+  if (table == NULL)
+    return;
+
+  (void) msync(table, sizeof(dedup_table), MS_SYNC);
+  (void) munmap(table, sizeof(dedup_table));
+  close(table_fd);
+
+  table = NULL;
+  table_fd = -1;
+}
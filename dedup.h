@@ -0,0 +1,49 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/*
+ * dedup: drop the miniseed records lib330 regenerates after a registration
+ * loss or continuity reset, before they reach the archive or the datalink
+ * server.
+ *
+ * A small open addressed table holds, for each station, location and
+ * channel, the start time and sequence number of the last record let
+ * through and the time the next one is expected. A data record that ends
+ * before that is dropped, one carrying any new samples is kept. The table
+ * lives in a memory mapped file so it carries over a restart.
+ *
+ * Archival records are tracked as separate streams, their keys marked with
+ * DEDUP_ARCHIVAL. An update to an archival record is let through only if it
+ * carries on the record last let through, so the updates to a dropped
+ * record are dropped with it.
+ *
+ * Only called from the lib330 station thread.
+ */
+
+#define DEDUP_MAGIC "QDDX"
+#define DEDUP_VERSION 1
+#define DEDUP_SLOTS 1024 /* a power of two, well above the channels of one station */
+#define DEDUP_ARCHIVAL "/A" /* appended to the keys of archival streams */
+#define DEDUP_REWIND 86400.0 /* anything further back than this is a clock reset, not a resend */
+
+typedef struct dedup_slot {
+  char key[20]; /* NN-SSSSS.LL.CCC, then DEDUP_ARCHIVAL for archival records */
+  int32_t seq; /* sequence number of the last record */
+  double start; /* its start time, seconds since 2000 */
+  double next; /* when the following record should start */
+} dedup_slot;
+
+typedef struct dedup_table {
+  char magic[4];
+  int32_t version;
+  int32_t slots;
+  int32_t used;
+  dedup_slot slot[DEDUP_SLOTS];
+} dedup_table;
+
+extern int dedup_open (char *path);
+extern void dedup_close (void);
+
+extern int dedup_record (tminiseed_call *data);
+
+#endif /* DEDUP_H */
@@ -14,6 +14,7 @@
  *
  * modified: 2010.052
  * modified: 2011.046 - add month/mday
+ * modified: 2026.292 - add archival records updated in place
  ***************************************************************************/
 
 #include <stdio.h>
@@ -28,6 +29,7 @@
 #include <time.h>
 
 #include <libmseed.h>
+#include <libtime.h>
 
 #include "dsarchive.h"
 
@@ -35,6 +37,27 @@
 int ds_maxopenfiles = 0;
 int ds_openfilecount = 0;
 
+/* Length of generated file names and definition keys */
+#define DS_PATHLEN 400
+
+/* Stream files are appended to, record files are written at known offsets */
+#define DS_APPENDFLAGS (O_RDWR | O_CREAT | O_APPEND)
+#define DS_RECORDFLAGS (O_RDWR | O_CREAT)
+
+/* Records are matched on the station, location, channel and network codes */
+#define DS_KEYOFFSET 8
+#define DS_KEYLEN 12
+
+/* Start times from 2000 on are split up by the cached lib330 calendar */
+#define DS_EPOCH2000 ((hptime_t) 946684800 * HPTMODULUS)
+#define DS_EPOCHEND (DS_EPOCH2000 + (hptime_t) CAL_MAXDAY * 86400 * HPTMODULUS)
+
+/* How far back to look for a record being updated */
+#define DS_SEARCHRECORDS 64
+
+/* Enough of a record to find its length from blockette 1000 */
+#define DS_HEADERLEN 128
+
 /* For a linked list of strings, as filled by strparse() */
 typedef struct strlist_s {
   char             *element;
@@ -42,9 +65,12 @@ typedef struct strlist_s {
 } strlist;
 
 /* Functions internal to this source file */
+static int ds_pathname (DataStream *datastream, MSRecord *msr, long suffix,
+			char *filename, char *definition);
 static DataStreamGroup *ds_getstream (DataStream *datastream, MSRecord *msr,
-				      const char *defkey, const char *filename);
-static int ds_openfile (DataStream *datastream, const char *filename);
+				      const char *defkey, const char *filename, int flags);
+static int ds_openfile (DataStream *datastream, const char *filename, int flags);
+static off_t ds_findrecord (int filed, off_t filesize, const char *record, int reclen);
 static int ds_closeidle (DataStream *datastream, int idletimeout);
 static void ds_shutdown (DataStream *datastream);
 static int strparse (const char *string, const char *delim, strlist **list);
@@ -69,15 +95,8 @@ extern int
 ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 {
   DataStreamGroup *foundgroup = NULL;
-  BTime stime;
-  int month, mday;
-  strlist *fnlist, *fnptr;
-  char net[3], sta[6], loc[3], chan[4];
-  char filename[400];
-  char definition[400];
-  char pathformat[600];
-  char tstr[20];
-  int fnlen = 0;
+  char filename[DS_PATHLEN];
+  char definition[DS_PATHLEN];
   
   /* Set Verbosity for ds_ functions */
   dsverbose = verbose;
@@ -98,6 +117,277 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
       return -1;
     }
   
+  if ( ds_pathname (datastream, msr, suffix, filename, definition) < 0 )
+    return -1;
+
+  /* Check for previously used stream entry, otherwise create it */
+  foundgroup = ds_getstream (datastream, msr, definition, filename, DS_APPENDFLAGS);
+
+  if (foundgroup != NULL)
+    {
+      /* Write binary data samples to approriate file */
+      if ( msr->datasamples && msr->numsamples )
+	{
+	  if ( dsverbose >= 3 )
+	    ms_log (0, "Writing binary data samples to data stream file %s\n", filename);
+	  
+	  if ( !write (foundgroup->filed, msr->datasamples, msr->numsamples * ms_samplesize(msr->sampletype)) )
+	    {
+	      ms_log (2, "ds_streamproc: failed to write binary data samples\n");
+	      return -1;
+	    }
+	  else
+	    {
+	      foundgroup->modtime = time (NULL);	  
+	    }
+	}
+      /* Write the data record to the appropriate file */ 
+      else
+	{
+	  if ( dsverbose >= 3 )
+	    ms_log (0, "Writing data record to data stream file %s\n", filename);
+	  
+	  if ( !write (foundgroup->filed, msr->record, msr->reclen) )
+	    {
+	      ms_log (2, "ds_streamproc: failed to write data record\n");
+	      return -1;
+	    }
+	  else
+	    {
+	      foundgroup->modtime = time (NULL);	  
+	    }
+	}
+
+      return 0;
+    }
+  
+  return -1;
+}  /* End of ds_streamproc() */
+
+
+/***************************************************************************
+ * ds_recordproc:
+ *
+ * Save an archival MiniSEED record into the same directory/file
+ * structure as ds_streamproc().  A new record is added to the end of
+ * the file, while an update rewrites the latest record for the same
+ * channel in place, so a record can be grown incrementally until it
+ * is full.  The offset of the record last written is kept with the
+ * stream, the file is only searched if that record was for another
+ * channel or the stream had been closed.
+ *
+ * Returns 0 on success, -1 on error.
+ ***************************************************************************/
+extern int
+ds_recordproc (DataStream *datastream, MSRecord *msr, int update,
+	       long suffix, int verbose)
+{
+  DataStreamGroup *foundgroup = NULL;
+  char filename[DS_PATHLEN];
+  char definition[DS_PATHLEN];
+  off_t offset = -1;
+
+  /* Set Verbosity for ds_ functions */
+  dsverbose = verbose;
+
+  if ( ! msr->fsdh || ! msr->record )
+    {
+      ms_log (2, "ds_recordproc(): msr->fsdh and msr->record must be available\n");
+      return -1;
+    }
+
+  if ( ds_pathname (datastream, msr, suffix, filename, definition) < 0 )
+    return -1;
+
+  if ( (foundgroup = ds_getstream (datastream, msr, definition, filename, DS_RECORDFLAGS)) == NULL )
+    return -1;
+
+  if ( update )
+    {
+      if ( foundgroup->recoffset >= 0 &&
+	   ! memcmp (foundgroup->reckey, msr->record + DS_KEYOFFSET, DS_KEYLEN) )
+	offset = foundgroup->recoffset;
+      else
+	offset = ds_findrecord (foundgroup->filed, foundgroup->filesize, msr->record, msr->reclen);
+
+      if ( offset < 0 && dsverbose >= 1 )
+	ms_log (0, "No record to update in %s, adding a new one\n", filename);
+    }
+
+  if ( offset < 0 )
+    offset = foundgroup->filesize;
+
+  if ( dsverbose >= 3 )
+    ms_log (0, "Writing data record to %s at offset %lld\n", filename, (long long int) offset);
+
+  if ( pwrite (foundgroup->filed, msr->record, msr->reclen, offset) != msr->reclen )
+    {
+      ms_log (2, "ds_recordproc: failed to write data record, %s\n", strerror (errno));
+      return -1;
+    }
+
+  foundgroup->recoffset = offset;
+  memcpy (foundgroup->reckey, msr->record + DS_KEYOFFSET, DS_KEYLEN);
+  if ( (offset + msr->reclen) > foundgroup->filesize )
+    foundgroup->filesize = offset + msr->reclen;
+  foundgroup->modtime = time (NULL);
+
+  return 0;
+}  /* End of ds_recordproc() */
+
+
+/***************************************************************************
+ * ds_lastrecord:
+ *
+ * Read back the latest record for a channel from the file it would be
+ * archived into, as named by the header and start time in 'msr', so
+ * that an incomplete record can be carried on after a restart.  If
+ * that file has no record for the channel, the file for the day
+ * before is tried, the record may have been started before midnight.
+ * Files are not created if they do not already exist.
+ *
+ * Returns 0 if a record was copied into 'record', -1 otherwise.
+ ***************************************************************************/
+extern int
+ds_lastrecord (DataStream *datastream, MSRecord *msr, char *record,
+	       int reclen, long suffix, int verbose)
+{
+  char filename[DS_PATHLEN];
+  char definition[DS_PATHLEN];
+  char key[DS_KEYOFFSET + DS_KEYLEN];
+  struct stat st;
+  hptime_t starttime;
+  off_t offset = -1;
+  int filed, day;
+
+  /* Set Verbosity for ds_ functions */
+  dsverbose = verbose;
+
+  if ( ! msr->fsdh )
+    {
+      ms_log (2, "ds_lastrecord(): msr->fsdh must be available\n");
+      return -1;
+    }
+
+  memset (key, 0, sizeof(key));
+  memcpy (key + DS_KEYOFFSET, msr->fsdh->station, 5);
+  memcpy (key + DS_KEYOFFSET + 5, msr->fsdh->location, 2);
+  memcpy (key + DS_KEYOFFSET + 7, msr->fsdh->channel, 3);
+  memcpy (key + DS_KEYOFFSET + 10, msr->fsdh->network, 2);
+
+  /* Today's file first, then yesterday's */
+  starttime = msr->starttime;
+  for ( day = 0; day < 2 && offset < 0; day++ )
+    {
+      msr->starttime = starttime - (hptime_t) day * 86400 * HPTMODULUS;
+      if ( ds_pathname (datastream, msr, suffix, filename, definition) < 0 )
+	break;
+
+      if ( (filed = open (filename, O_RDONLY)) < 0 )
+	continue;
+
+      if ( fstat (filed, &st) == 0 )
+	offset = ds_findrecord (filed, st.st_size, key, reclen);
+
+      if ( offset >= 0 && pread (filed, record, reclen, offset) != reclen )
+	offset = -1;
+
+      close (filed);
+    }
+  msr->starttime = starttime;
+
+  if ( offset >= 0 && dsverbose >= 1 )
+    ms_log (0, "Resuming record at offset %lld of %s\n", (long long int) offset, filename);
+
+  return ( offset >= 0 ) ? 0 : -1;
+}  /* End of ds_lastrecord() */
+
+
+/***************************************************************************
+ * ds_findrecord:
+ *
+ * Search for the latest record 'reclen' long with the same station,
+ * location, channel and network codes as 'record'.  Where the file
+ * is a whole number of records of that length, it is searched
+ * backwards from the end one record at a time, checking the length
+ * each record gives itself in blockette 1000.  If the file is not
+ * laid out that way, it is scanned forwards from the start following
+ * each record's own length instead.
+ *
+ * Returns the file offset of the record, or -1 if none was found.
+ ***************************************************************************/
+static off_t
+ds_findrecord (int filed, off_t filesize, const char *record, int reclen)
+{
+  char header[DS_HEADERLEN];
+  off_t offset, found = -1;
+  int count, length;
+
+  if ( reclen < DS_HEADERLEN )
+    return -1;
+
+  if ( (filesize % reclen) == 0 )
+    {
+      offset = filesize - reclen;
+      for ( count = 0; count < DS_SEARCHRECORDS && offset >= 0; count++, offset -= reclen )
+	{
+	  if ( pread (filed, header, sizeof(header), offset) != sizeof(header) )
+	    return -1;
+
+	  /* Not on a record boundary after all */
+	  if ( ms_detect (header, sizeof(header)) != reclen )
+	    break;
+
+	  if ( ! memcmp (header + DS_KEYOFFSET, record + DS_KEYOFFSET, DS_KEYLEN) )
+	    return offset;
+	}
+
+      if ( offset < 0 || count == DS_SEARCHRECORDS )
+	return -1;
+    }
+
+  if ( dsverbose >= 2 )
+    ms_log (0, "Records are not %d bytes apart, scanning forwards\n", reclen);
+
+  for ( offset = 0; offset + DS_HEADERLEN <= filesize; offset += length )
+    {
+      if ( pread (filed, header, sizeof(header), offset) != sizeof(header) )
+	break;
+
+      if ( (length = ms_detect (header, sizeof(header))) <= 0 )
+	break;
+
+      if ( length == reclen && offset + reclen <= filesize &&
+	   ! memcmp (header + DS_KEYOFFSET, record + DS_KEYOFFSET, DS_KEYLEN) )
+	found = offset;
+    }
+
+  return found;
+}  /* End of ds_findrecord() */
+
+
+/***************************************************************************
+ * ds_pathname:
+ *
+ * Build the file name and the group definition key for a record from
+ * the DataStream path format, creating any directories needed along
+ * the way.  Both buffers must be DS_PATHLEN long.
+ *
+ * Returns 0 on success, -1 on error.
+ ***************************************************************************/
+static int
+ds_pathname (DataStream *datastream, MSRecord *msr, long suffix,
+	     char *filename, char *definition)
+{
+  BTime stime;
+  tcalendar cal;
+  int month, mday;
+  strlist *fnlist, *fnptr;
+  char net[3], sta[6], loc[3], chan[4];
+  char pathformat[600];
+  char tstr[20];
+  int fnlen = 0;
+
   /* Build file path and name from datastream->path */
   filename[0] = '\0';
   definition[0] = '\0';
@@ -105,7 +395,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
   
   if ( strparse (pathformat, "/", &fnlist) < 0 )
     {
-      ms_log (2, "ds_streamproc(): error parsing path format: '%s'\n", pathformat);
+      ms_log (2, "ds_pathname(): error parsing path format: '%s'\n", pathformat);
       return -1;
     }
   
@@ -116,32 +406,47 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
     {
       if ( fnptr->next != 0 )
 	{
-	  strncat (filename, "/", sizeof(filename));
+	  strncat (filename, "/", DS_PATHLEN);
 	  fnptr = fnptr->next;
 	}
       else
 	{
-	  ms_log (2, "ds_streamproc(): empty path format\n");
+	  ms_log (2, "ds_pathname(): empty path format\n");
 	  strparse (NULL, NULL, &fnlist);
 	  return -1;
 	}
     }
   
-  /* Convert normalized starttime to BTime structure */
-  if ( ms_hptime2btime (msr->starttime, &stime) )
+  /* Successive records nearly always fall on the same day, which the calendar keeps */
+  if ( msr->starttime >= DS_EPOCH2000 && msr->starttime < DS_EPOCHEND )
     {
-      ms_log (2, "ds_streamproc(): cannot convert start time to separate fields\n");
-      strparse (NULL, NULL, &fnlist);
-      return -1;
+      lib330_calendar ((longint) ((msr->starttime - DS_EPOCH2000) / HPTMODULUS), &cal);
+      stime.year = cal.year;
+      stime.day = cal.jday;
+      stime.hour = cal.hour;
+      stime.min = cal.minute;
+      stime.sec = cal.second;
+      stime.fract = (uint16_t) (((msr->starttime - DS_EPOCH2000) % HPTMODULUS) / (HPTMODULUS / 10000));
+      month = cal.month;
+      mday = cal.mday;
     }
-
-
-  /* Add support for months etc */
-	if ( ms_doy2md(stime.year, stime.day, &month, &mday) )
+  else
     {
-      ms_log (2, "ds_streamproc(): cannot convert start time month and mday fields\n");
-      strparse (NULL, NULL, &fnlist);
-      return -1;
+      /* Convert normalized starttime to BTime structure */
+      if ( ms_hptime2btime (msr->starttime, &stime) )
+	{
+	  ms_log (2, "ds_pathname(): cannot convert start time to separate fields\n");
+	  strparse (NULL, NULL, &fnlist);
+	  return -1;
+	}
+
+      /* Add support for months etc */
+      if ( ms_doy2md(stime.year, stime.day, &month, &mday) )
+	{
+	  ms_log (2, "ds_pathname(): cannot convert start time month and mday fields\n");
+	  strparse (NULL, NULL, &fnlist);
+	  return -1;
+	}
     }
 
   
@@ -155,7 +460,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
       /* Special case of no file given */
       if ( *p == '\0' && fnptr->next == 0 )
 	{
-	  ms_log (2, "ds_streamproc(): no file name specified, only %s\n",
+	  ms_log (2, "ds_pathname(): no file name specified, only %s\n",
 		   filename);
 	  strparse (NULL, NULL, &fnlist);
 	  return -1;
@@ -165,7 +470,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 	{
 	  def = ( *w == '%' );
 	  *w = '\0';
-	  strncat (filename, p, (sizeof(filename) - fnlen));
+	  strncat (filename, p, (DS_PATHLEN - fnlen));
 	  fnlen = strlen (filename);
 
 	  w += 1;
@@ -174,36 +479,36 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 	    {
 	    case 'n' :
 	      ms_strncpclean (net, msr->fsdh->network, 2);
-	      strncat (filename, net, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, net, (sizeof(definition) - fnlen));
+	      strncat (filename, net, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, net, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 's' :
 	      ms_strncpclean (sta, msr->fsdh->station, 5);
-	      strncat (filename, sta, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, sta, (sizeof(definition) - fnlen));
+	      strncat (filename, sta, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, sta, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'l' :
 	      ms_strncpclean (loc, msr->fsdh->location, 2);
-	      strncat (filename, loc, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, loc, (sizeof(definition) - fnlen));
+	      strncat (filename, loc, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, loc, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'c' :
 	      ms_strncpclean (chan, msr->fsdh->channel, 3);
-	      strncat (filename, chan, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, chan, (sizeof(definition) - fnlen));
+	      strncat (filename, chan, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, chan, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'Y' :
 	      snprintf (tstr, sizeof(tstr), "%04d", (int) stime.year);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
@@ -214,95 +519,95 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 		  tdy -= 100;
 		}
 	      snprintf (tstr, sizeof(tstr), "%02d", tdy);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'j' :
 	      snprintf (tstr, sizeof(tstr), "%03d", (int) stime.day);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'm' :
 	      snprintf (tstr, sizeof(tstr), "%02d", (int) month);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'd' :
 	      snprintf (tstr, sizeof(tstr), "%02d", (int) mday);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'H' :
 	      snprintf (tstr, sizeof(tstr), "%02d", (int) stime.hour);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'M' :
 	      snprintf (tstr, sizeof(tstr), "%02d", (int) stime.min);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'S' :
 	      snprintf (tstr, sizeof(tstr), "%02d", (int) stime.sec);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'F' :
 	      snprintf (tstr, sizeof(tstr), "%04d", (int) stime.fract);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'q' :
 	      snprintf (tstr, sizeof(tstr), "%c", msr->dataquality);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'L' :
 	      snprintf (tstr, sizeof(tstr), "%d", msr->reclen);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'r' :
 	      snprintf (tstr, sizeof(tstr), "%ld", (long int) (msr->samprate+0.5));
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case 'R' :
 	      snprintf (tstr, sizeof(tstr), "%.6f", msr->samprate);
-	      strncat (filename, tstr, (sizeof(filename) - fnlen));
-	      if ( def ) strncat (definition, tstr, (sizeof(definition) - fnlen));
+	      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+	      if ( def ) strncat (definition, tstr, (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case '%' :
-	      strncat (filename, "%", (sizeof(filename) - fnlen));
+	      strncat (filename, "%", (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
 	    case '#' :
-	      strncat (filename, "#", (sizeof(filename) - fnlen));
+	      strncat (filename, "#", (DS_PATHLEN - fnlen));
 	      fnlen = strlen (filename);
 	      p = w + 1;
 	      break;
@@ -313,7 +618,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 	    }
 	}
       
-      strncat (filename, p, (sizeof(filename) - fnlen));
+      strncat (filename, p, (DS_PATHLEN - fnlen));
       fnlen = strlen (filename);
 
       /* If not the last entry then it should be a directory */
@@ -329,7 +634,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 		  if (mkdir
 		      (filename, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH))
 		    {
-		      ms_log (2, "ds_streamproc: mkdir(%s) %s\n", filename, strerror (errno));
+		      ms_log (2, "ds_pathname: mkdir(%s) %s\n", filename, strerror (errno));
 		      strparse (NULL, NULL, &fnlist);
 		      return -1;
 		    }
@@ -342,7 +647,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
 		}
 	    }
 
-	  strncat (filename, "/", (sizeof(filename) - fnlen));
+	  strncat (filename, "/", (DS_PATHLEN - fnlen));
 	  fnlen++;
 	}
 
@@ -355,58 +660,17 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
   if ( suffix )
     {
       snprintf (tstr, sizeof(tstr), ".%ld", suffix);
-      strncat (filename, tstr, (sizeof(filename) - fnlen));
-      strncat (definition, tstr, (sizeof(definition) - fnlen));
+      strncat (filename, tstr, (DS_PATHLEN - fnlen));
+      strncat (definition, tstr, (DS_PATHLEN - fnlen));
       fnlen = strlen (filename);
     }
 
   /* Make sure the filename and definition are NULL terminated */
-  *(filename + sizeof(filename) - 1) = '\0';
-  *(definition + sizeof(definition) -1) = '\0';
+  *(filename + DS_PATHLEN - 1) = '\0';
+  *(definition + DS_PATHLEN -1) = '\0';
 
-  /* Check for previously used stream entry, otherwise create it */
-  foundgroup = ds_getstream (datastream, msr, definition, filename);
-
-  if (foundgroup != NULL)
-    {
-      /* Write binary data samples to approriate file */
-      if ( msr->datasamples && msr->numsamples )
-	{
-	  if ( dsverbose >= 3 )
-	    ms_log (0, "Writing binary data samples to data stream file %s\n", filename);
-	  
-	  if ( !write (foundgroup->filed, msr->datasamples, msr->numsamples * ms_samplesize(msr->sampletype)) )
-	    {
-	      ms_log (2, "ds_streamproc: failed to write binary data samples\n");
-	      return -1;
-	    }
-	  else
-	    {
-	      foundgroup->modtime = time (NULL);	  
-	    }
-	}
-      /* Write the data record to the appropriate file */ 
-      else
-	{
-	  if ( dsverbose >= 3 )
-	    ms_log (0, "Writing data record to data stream file %s\n", filename);
-	  
-	  if ( !write (foundgroup->filed, msr->record, msr->reclen) )
-	    {
-	      ms_log (2, "ds_streamproc: failed to write data record\n");
-	      return -1;
-	    }
-	  else
-	    {
-	      foundgroup->modtime = time (NULL);	  
-	    }
-	}
-
-      return 0;
-    }
-  
-  return -1;
-}  /* End of ds_streamproc() */
+  return 0;
+}  /* End of ds_pathname() */
 
 
 /***************************************************************************
@@ -425,7 +689,7 @@ ds_streamproc (DataStream *datastream, MSRecord *msr, long suffix, int verbose)
  ***************************************************************************/
 static DataStreamGroup *
 ds_getstream (DataStream *datastream, MSRecord *msr,
-	      const char *defkey, const char *filename)
+	      const char *defkey, const char *filename, int flags)
 {
   DataStreamGroup *foundgroup  = NULL;
   DataStreamGroup *searchgroup = NULL;
@@ -478,6 +742,8 @@ ds_getstream (DataStream *datastream, MSRecord *msr,
       foundgroup->defkey = strdup (defkey);
       foundgroup->filed = 0;
       foundgroup->modtime = curtime;
+      foundgroup->filesize = 0;
+      foundgroup->recoffset = -1;
       foundgroup->next = NULL;
 
       /* Set the stream root if this is the first entry */
@@ -503,22 +769,24 @@ ds_getstream (DataStream *datastream, MSRecord *msr,
   /* If no file is open, well, open it */
   if ( foundgroup->filed == 0 )
     {
-      int filepos;
+      off_t filepos;
       
       if ( dsverbose >= 1 )
 	ms_log (0, "Opening data stream file %s\n", filename);
       
-      if ( (foundgroup->filed = ds_openfile (datastream, filename)) == -1 )
+      if ( (foundgroup->filed = ds_openfile (datastream, filename, flags)) == -1 )
 	{
 	  ms_log (2, "cannot open data stream file, %s\n", strerror (errno));
 	  return NULL;
 	}
       
-      if ( (filepos = (int) lseek (foundgroup->filed, (off_t) 0, SEEK_END)) < 0 )
+      if ( (filepos = lseek (foundgroup->filed, (off_t) 0, SEEK_END)) < 0 )
 	{
 	  ms_log (2, "cannot seek in data stream file, %s\n", strerror (errno));
 	  return NULL;
 	}      
+
+      foundgroup->filesize = filepos;
     }
   
   return foundgroup;
@@ -528,7 +796,7 @@ ds_getstream (DataStream *datastream, MSRecord *msr,
 /***************************************************************************
  * ds_openfile:
  *
- * Open a specified file, if the open file limit has been reached try
+ * Open a specified file with the given flags, if the open file limit has been reached try
  * once to increase the limit, if that fails or has already been done
  * start closing idle files with decreasing idle timeouts until a file
  * can be opened.
@@ -537,13 +805,12 @@ ds_getstream (DataStream *datastream, MSRecord *msr,
  * on success and -1 on error.
  ***************************************************************************/
 static int
-ds_openfile (DataStream *datastream, const char *filename)
+ds_openfile (DataStream *datastream, const char *filename, int flags)
 {
   static char rlimit = 0;
   struct rlimit rlim;
   int idletimeout = datastream->idletimeout;
   int oret = 0;
-  int flags = (O_RDWR | O_CREAT | O_APPEND);
   mode_t mode = (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH); /* Mode 0644 */
   
   /* Lookup process open file limit and change ds_maxopenfiles if needed */
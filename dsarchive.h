@@ -3,6 +3,7 @@
 #define DSARCHIVE_H
 
 #include <time.h>
+#include <sys/types.h>
 
 /* Define pre-formatted archive layouts */
 #define CHANLAYOUT  "%n.%s.%l.%c"
@@ -17,6 +18,9 @@ typedef struct DataStreamGroup_s
   char   *defkey;
   int     filed;
   time_t  modtime;
+  off_t   filesize;
+  off_t   recoffset;
+  char    reckey[12];
   struct  DataStreamGroup_s *next;
 }
 DataStreamGroup;
@@ -34,5 +38,9 @@ extern int ds_maxopenfiles;
 
 extern int ds_streamproc (DataStream *datastream, MSRecord *msr,
                           long suffix, int verbose);
+extern int ds_recordproc (DataStream *datastream, MSRecord *msr, int update,
+                          long suffix, int verbose);
+extern int ds_lastrecord (DataStream *datastream, MSRecord *msr, char *record,
+                          int reclen, long suffix, int verbose);
 
 #endif /* DSARCHIVE_H */
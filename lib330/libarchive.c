@@ -35,6 +35,9 @@ Edit History:
                      last data record. If not set by continuity it's OK to start over since
                      SEED sequence numbers are informational only.
     5 2009-06-25 rdr Increment blockette count when appending timing blockettes.
+    6 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
+    7 2026-10-19 gns flush_archive holds the output lock, miniseed_call is shared with the
+                     LCQ worker threads.
 */
 #ifndef OMIT_SEED
 #ifndef libarchive_h
@@ -55,6 +58,9 @@ Edit History:
 #ifndef libctrldet_h
 #include "libctrldet.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 #ifndef libcompress_h
 #include "libcompress.h"
 #endif
@@ -87,7 +93,7 @@ begin
   memset(addr(parc->hdr_buf), 0, sizeof(seed_header)) ;
 end
 
-void flush_archive (paqstruc paqs, plcq q)
+static void write_archive (paqstruc paqs, plcq q)
 begin
 #define JAN_1_2006 189388800 /* first possible valid data */
 #define MAX_DATE 0x7FFF0000 /* above this just has to be nonsense */
@@ -96,7 +102,7 @@ begin
   tarc *parc ;
 
   q330 = paqs->owner ;
-  parc = addr(q->arc) ;
+  parc = addr(q->cold->arc) ;
   p = (pointer)parc->pcfr ; /* start of record */
   q330->miniseed_call.timestamp = parc->hdr_buf.starting_time.seed_fpt ;
   if ((q330->miniseed_call.timestamp < JAN_1_2006) lor (q330->miniseed_call.timestamp > MAX_DATE))
@@ -165,6 +171,14 @@ begin
   parc->appended = FALSE ; /* client is up to date */
 end
 
+void flush_archive (paqstruc paqs, plcq q)
+begin
+
+  outlock (paqs->owner) ;
+  write_archive (paqs, q) ;
+  outunlock (paqs->owner) ;
+end
+
 void archive_512_record (paqstruc paqs, plcq q, pcompressed_buffer_ring pbuf)
 begin
   pq330 q330 ;
@@ -175,7 +189,7 @@ begin
   tarc *parc ;
 
   q330 = paqs->owner ;
-  parc = addr(q->arc) ;
+  parc = addr(q->cold->arc) ;
   switch (q->pack_class) begin
     case PKC_DATA :
       if (q->rate > 0)
@@ -442,10 +456,10 @@ begin
       q = paqs->dplcqs ;
   while (q)
     begin
-      if (q->arc.amini_filter)
+      if (q->cold->arc.amini_filter)
         then
           begin
-            parc = addr(q->arc) ;
+            parc = addr(q->cold->arc) ;
             q330->miniseed_call.context = q330 ;
             memcpy(addr(q330->miniseed_call.station_name), addr(q330->station_ident), sizeof(string9)) ;
             strcpy(addr(q330->miniseed_call.location), addr(q->slocation)) ;
@@ -35,6 +35,10 @@ Edit History:
     9 2009-02-09 rdr Add EP Support.
    10 2010-01-04 rdr Add version for libdss.
    11 2010-03-27 rdr Add Q335 support.
+   12 2026-10-19 gns Add lib_capture and lib_replay.
+   13 2026-10-19 gns Add lib_msg_event.
+   14 2026-10-19 gns Add lib_record_hold, lib_record_addref, lib_record_release, and
+                     lib_get_recpoolstat.
 */
 #ifndef q330types_h
 #include "q330types.h"
@@ -812,6 +816,151 @@ begin
   return LIBERR_NOERR ;
 end
 
+enum tliberr lib_capture (tcontext ct, pchar fname)
+begin
+  pq330 q330 ;
+
+  q330 = ct ;
+  if (q330 == NIL)
+    then
+      return LIBERR_INVCTX ;
+  lock (q330) ;
+  if (fname)
+    then
+      strncpy (q330->share.capture_name, fname, 250) ;
+    else
+      q330->share.capture_name[0] = 0 ;
+  q330->share.capture_requested = TRUE ;
+  unlock (q330) ;
+  return LIBERR_NOERR ;
+end
+
+enum tliberr lib_replay (tcontext ct, pchar fname, boolean paced)
+begin
+  pq330 q330 ;
+  enum tliberr err ;
+
+  q330 = ct ;
+  if (q330 == NIL)
+    then
+      return LIBERR_INVCTX ;
+  if ((fname == NIL) lor (fname[0] == 0))
+    then
+      return LIBERR_PAR ;
+  lock (q330) ;
+  if ((q330->libstate != LIBSTATE_IDLE) lor (q330->share.target_state != LIBSTATE_IDLE))
+    then
+      err = LIBERR_INVREG ; /* replay takes the place of registering */
+    else
+      begin
+        strncpy (q330->share.replay_name, fname, 250) ;
+        q330->share.replay_paced = paced ;
+        q330->share.replay_requested = TRUE ;
+        q330->share.liberr = LIBERR_NOERR ;
+        err = LIBERR_NOERR ;
+      end
+  unlock (q330) ;
+  return err ;
+end
+
+/* No lock needed, the event ring can be read while lib330 is writing to it */
+boolean lib_msg_event (tcontext ct, longword *next, tmsgevent *event)
+begin
+  pq330 q330 ;
+
+  q330 = ct ;
+  if (q330 == NIL)
+    then
+      return FALSE ;
+  return read_msgring (q330, next, event) ;
+end
+
+#ifndef OMIT_SEED
+/* Only from within the miniseed data callback, the record is copied so it remains
+   valid after the callback returns */
+precord_ref lib_record_hold (pminiseed_call call)
+begin
+  pq330 q330 ;
+  precord_ref ref ;
+
+  q330 = call->context ;
+  if ((q330 == NIL) lor (call->data_size > RECPOOL_RECSIZE))
+    then
+      return NIL ;
+  poollock (q330) ;
+  ref = q330->recpool.free ;
+  if (ref)
+    then
+      begin
+        q330->recpool.free = ref->link ;
+        ref->link = NIL ;
+        ref->refs = 1 ;
+        inc(q330->recpool.in_use) ;
+        if (q330->recpool.in_use > q330->recpool.high_water)
+          then
+            q330->recpool.high_water = q330->recpool.in_use ;
+        inc(q330->recpool.holds) ;
+      end
+  else if (q330->recpool.size > 0)
+    then
+      inc(q330->recpool.refused) ;
+  poolunlock (q330) ;
+  if (ref)
+    then
+      begin
+        memcpy (addr(ref->call), call, sizeof(tminiseed_call)) ;
+        memcpy (addr(ref->rec), call->data_address, call->data_size) ;
+        ref->call.data_address = addr(ref->rec) ;
+      end
+  return ref ;
+end
+
+void lib_record_addref (precord_ref ref)
+begin
+  pq330 q330 ;
+
+  q330 = ref->call.context ;
+  poollock (q330) ;
+  inc(ref->refs) ;
+  poolunlock (q330) ;
+end
+
+void lib_record_release (precord_ref ref)
+begin
+  pq330 q330 ;
+
+  q330 = ref->call.context ;
+  poollock (q330) ;
+  dec(ref->refs) ;
+  if (ref->refs <= 0)
+    then
+      begin
+        ref->link = q330->recpool.free ;
+        q330->recpool.free = ref ;
+        dec(q330->recpool.in_use) ;
+      end
+  poolunlock (q330) ;
+end
+
+enum tliberr lib_get_recpoolstat (tcontext ct, trecpoolstat *recpoolstat)
+begin
+  pq330 q330 ;
+
+  q330 = ct ;
+  if (q330 == NIL)
+    then
+      return LIBERR_INVCTX ;
+  poollock (q330) ;
+  recpoolstat->size = q330->recpool.size ;
+  recpoolstat->in_use = q330->recpool.in_use ;
+  recpoolstat->high_water = q330->recpool.high_water ;
+  recpoolstat->holds = q330->recpool.holds ;
+  recpoolstat->refused = q330->recpool.refused ;
+  poolunlock (q330) ;
+  return LIBERR_NOERR ;
+end
+#endif
+
 #ifndef OMIT_SERIAL
 enum tliberr lib_inject_packet (tcontext ct, pbyte payload, byte protocol, longword srcaddr,
                         longword destaddr, word srcport, word destport, word datalength,
@@ -30,12 +30,18 @@ Edit History:
     7 2008-08-20 rdr Add tcp support.
     8 2009-08-02 rdr Add opt_dss_memory.
     9 2010-03-27 rdr Add Q335 State subtype definitions.
+   10 2026-10-19 gns Add packet trace events and lib_msg_event.
+   11 2026-10-19 gns Add opt_recpool and the pooled record handles.
+   12 2026-10-19 gns Add opt_workers.
+   13 2026-10-19 gns Add ST_REGDATA.
+   14 2026-10-19 gns Add opt_hugepages.
+   15 2026-10-19 gns Add lost to tmsgevent.
 }
 */
 #ifndef libclient_h
 /* Flag this file as included */
 #define libclient_h
-#define VER_LIBCLIENT 15
+#define VER_LIBCLIENT 22
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -54,6 +60,10 @@ Edit History:
 #define OMF_TIM 8 /* pass timing records */
 #define OMF_MSG 16 /* pass message records */
 #define MAX_LCQ 128 /* maximum number of lcqs that can be reported */
+/* memory arena backing for opt_hugepages */
+#define OHP_NONE 0 /* malloc */
+#define OHP_TRANSPARENT 1 /* aligned for transparent huge pages */
+#define OHP_EXPLICIT 2 /* reserved huge pages, falling back to transparent */
 
 #ifndef OMIT_SEED
 #define FILTER_NAME_LENGTH 31 /* Maximum number of characters in an IIR filter name */
@@ -110,6 +120,8 @@ typedef struct { /* parameters for lib_create call */
   word opt_zoneadjust ; /* calculate host's timezone automatically */
   word opt_secfilter ; /* OSF_xxx bits */
   word opt_client_msgs ; /* Number of client message buffers */
+  word opt_workers ; /* threads processing main digitizer LCQs, zero for the lib330 thread */
+  word opt_hugepages ; /* OHP_xxx, how memory for LCQs and buffers is backed */
 #ifndef OMIT_SEED
   word opt_compat ; /* Compatibility Mode */
   word opt_minifilter ; /* OMF_xxx bits */
@@ -118,6 +130,7 @@ typedef struct { /* parameters for lib_create call */
   integer amini_512highest ; /* rates up to this value are updated every 512 bytes */
   word mini_embed ; /* 1 = embed calibration and event blockettes into data */
   word mini_separate ; /* 1 = generate separate calibration and event records */
+  word opt_recpool ; /* records pooled for lib_record_hold, zero for none */
   pfilter mini_firchain ; /* FIR filter chain for decimation */
   tcallback call_minidata ; /* address of miniseed data callback procedure */
   tcallback call_aminidata ; /* address of archival miniseed data callback procedure */
@@ -130,6 +143,12 @@ typedef struct { /* parameters for lib_create call */
   tcallback call_baler ; /* Baler related callbacks */
   pfile_owner file_owner ; /* For continuity file handling */
 } tpar_create ;
+/*
+  With opt_workers the data callbacks for main digitizer channels come from the
+  worker threads, one callback at a time. Each channel's records stay in order but
+  different channels may interleave differently than without workers.
+*/
+#define MAX_WORKERS 16 /* largest opt_workers */
 typedef struct { /* parameters for lib_register call */
   t64 q330id_auth ; /* authentication code */
   string250 q330id_address ; /* domain name or IP address in dotted decimal */
@@ -276,6 +295,28 @@ typedef struct { /* format for miniseed and archival miniseed */
   pointer data_address ; /* pointer to miniseed record */
 } tminiseed_call ;
 typedef tminiseed_call *pminiseed_call ;
+/*
+  A record held with lib_record_hold from within the miniseed data callback. The
+  record is copied once into a buffer from a pool of opt_recpool, after that it
+  can be passed to other threads and stays valid until the last reference is
+  given back with lib_record_release.
+*/
+#define RECPOOL_MAX 8192 /* largest opt_recpool */
+#define RECPOOL_RECSIZE 512 /* only 512 byte records are pooled */
+typedef struct trecord_ref {
+  tminiseed_call call ; /* copy of the callback, data_address points at rec */
+  byte rec[RECPOOL_RECSIZE] ;
+  struct trecord_ref *link ; /* next free, for lib330 use */
+  integer refs ; /* references, for lib330 use */
+} trecord_ref ;
+typedef trecord_ref *precord_ref ;
+typedef struct { /* record pool statistics */
+  integer size ; /* records in the pool, zero if not enabled */
+  integer in_use ; /* currently held */
+  integer high_water ; /* most ever held at once */
+  longword holds ; /* records handed out */
+  longword refused ; /* holds refused because every record was in use */
+} trecpoolstat ;
 #endif
 enum tstate_type {ST_STATE, /* new operational state */
                  ST_STATUS, /* new status available */
@@ -284,7 +325,8 @@ enum tstate_type {ST_STATE, /* new operational state */
                  ST_PING, /* subtype has ping type */
                  ST_TICK, /* info has seconds, subtype has usecs */
                  ST_OPSTAT, /* new operational status minute */
-                 ST_TUNNEL} ; /* tunnel response available */
+                 ST_TUNNEL, /* tunnel response available */
+                 ST_REGDATA} ; /* first data since registering, info has milliseconds taken */
 enum tbaler_type {BT_Q330TIME, /* number of seconds since 2000 from Q330 */
                   BT_UDPRECV, /* UDP packet received that might be for baler */
                   BT_TCPRECV, /* TCP packet received that might be for baler */
@@ -321,6 +363,23 @@ typedef struct { /* format for messages callback */
   longword timestamp, datatime ;
   string95 suffix ;
 } tmsg_call ;
+#define MSGRING_SIZE 256 /* packet trace events kept, must be a power of two */
+#define PEV_ACKS 1 /* acks holds the data acknowledge map */
+#define PEV_DSN 2 /* dsn holds the data sequence number */
+#define PEV_INSIDE 4 /* data packet was inside the window */
+typedef struct { /* packet trace event, formatted with lib_event_string */
+  longword number ; /* event number, starting at 1 */
+  word code ; /* LIBMSG_PKTIN or LIBMSG_PKTOUT */
+  byte command ; /* QDP command */
+  byte flags ; /* PEV_xxx */
+  double timestamp ; /* when sent or received */
+  word datalength ;
+  word sequence ;
+  word acknowledge ;
+  longword dsn ;
+  longword acks[4] ;
+  longword lost ; /* set by lib_msg_event, events overwritten before this one could be read */
+} tmsgevent ;
 
 typedef struct { /* format for baler callback */
   tcontext context ;
@@ -455,6 +514,15 @@ extern enum tliberr lib_md5_operation (tcontext ct, tmd5op *md5op) ;
 extern enum tliberr lib_set_access_timer (tcontext ct, word seconds) ;
 extern enum tliberr lib_set_freeze_timer (tcontext ct, integer seconds) ;
 extern enum tliberr lib_flush_data (tcontext ct) ;
+extern enum tliberr lib_capture (tcontext ct, pchar fname) ; /* NIL or empty name stops capture */
+extern enum tliberr lib_replay (tcontext ct, pchar fname, boolean paced) ; /* Only from LIBSTATE_IDLE */
+extern boolean lib_msg_event (tcontext ct, longword *next, tmsgevent *event) ; /* start with *next zero */
+#ifndef OMIT_SEED
+extern precord_ref lib_record_hold (pminiseed_call call) ; /* NIL if none available */
+extern void lib_record_addref (precord_ref ref) ;
+extern void lib_record_release (precord_ref ref) ; /* from any thread, before lib_destroy_context */
+extern enum tliberr lib_get_recpoolstat (tcontext ct, trecpoolstat *recpoolstat) ;
+#endif
 #ifndef OMIT_SERIAL
 extern enum tliberr lib_inject_packet (tcontext ct, pbyte payload, byte protocol, longword srcaddr,
                         longword destaddr, word srcport, word destport, word datalength,
@@ -55,6 +55,20 @@ Edit History:
    21 2010-04-20 rdr Add processing for LPSF_PWROFF request.
    22 2010-05-07 rdr If opt_connwait is zero then use a value of ten minutes.
    23 2010-05-17 rdr Add sending Q335 Aware flag in C1_RQFGLS.
+   24 2026-10-19 gns Add packet capture and replay handling to lib_timer.
+   25 2026-10-19 gns Record packet level debug with libpktmsg, lib_timer passes it to the
+                     message log only with VERB_PKTMSG.
+   26 2026-10-19 gns Keep up to CMDWINDOW read requests outstanding at once, each with its
+                     own sequence and retry timing, responses are matched on the acknowledge.
+                     Tokens are read once both fixed values and status have arrived. Report
+                     the time from registration to the first data packet.
+   27 2026-10-19 gns Pass token segments to read_q330_cfg while verifying cached tokens, if
+                     they turn out to differ handle it as a token change once running.
+   28 2026-10-19 gns Memory requests carry their own memory type, responses are passed on
+                     with where they were asked for. A token segment refused for a bad
+                     parameter is asked for again.
+   29 2026-10-19 gns Don't open the data port while cached tokens are still being verified,
+                     if they turn out to differ deallocate and read them again.
 */
 #ifndef libcmds_h
 #include "libcmds.h"
@@ -122,7 +136,6 @@ Edit History:
 void purge_cmdq (pq330 q330)
 begin
 
-  q330->commands.cphase = CP_IDLE ;
   q330->commands.cmdin = 0 ;
   q330->commands.cmdout = 0 ;
   if (q330->stalled_link)
@@ -140,7 +153,7 @@ begin
   tcmdq *pcmd ;
 
   pc = addr(q330->commands) ;
-  pcmd = addr(pc->cmdq[pc->cmdout]) ;
+  pcmd = addr(pc->cmdq[pc->cmdcur]) ;
   pcmd->retsz = pcmd->retsz + IP_HDR_LTH + UDP_HDR_LTH + QDP_HDR_LTH + q330->recvhdr.datalength ;
   nw = now () ;
   if (nw == pcmd->sent)
@@ -152,11 +165,9 @@ begin
   if (pc->history_count < MAX_HISTORY)
     then
       inc(pc->history_count) ;
-  pc->cphase = CP_IDLE ;
-  pc->ctrl_retries = 0 ;
-  if (pc->cmdin != pc->cmdout)
-    then
-      pc->cmdout = (pc->cmdout + 1) mod CMDQSZ ;
+  pcmd->cphase = CP_DONE ;
+  while ((pc->cmdin != pc->cmdout) land (pc->cmdq[pc->cmdout].cphase == CP_DONE))
+    pc->cmdout = (pc->cmdout + 1) mod CMDQSZ ; /* answered out of order, drop those done */
   if ((pc->cmdin == pc->cmdout) land (q330->stalled_link))
     then
       begin
@@ -171,7 +182,35 @@ begin
   storeqdphdr (p, cmd, 0, q330->commands.ctrlseq, 0) ;
 end
 
-static void lib_send_next_cmd (pq330 q330)
+/* read requests that don't depend on each other and can be outstanding together */
+static boolean pipelined (tcmdq *pcmd)
+begin
+
+  if (pcmd->tunneled)
+    then
+      return FALSE ;
+  switch (pcmd->cmd) begin
+    case C1_RQFGLS :
+    case C1_RQGID :
+    case C1_RQSTAT :
+    case C1_RQLOG :
+    case C1_RQMEM :
+    case C1_RQRT :
+    case C1_RQDEV :
+    case C1_RQMAN :
+    case C1_RQDCP :
+    case C2_RQGPS :
+    case C2_RQEPD :
+    case C2_RQEPCFG :
+      return TRUE ;
+    default :
+      return FALSE ;
+  end
+end
+
+/* ahead is the traffic still owed for commands sent before this one, returns FALSE if
+   the send failed badly enough to purge the command queue */
+static boolean send_cmd (pq330 q330, tcmdq *pcmd, integer ahead)
 begin
   pbyte p ;
   pbyte pref ;
@@ -188,285 +227,306 @@ begin
 #else
 #endif
 #endif
-  string95 s, s1 ;
+  string95 s1 ;
   tcommands *pc ;
-  tcmdq *pcmd ;
 
   pc = addr(q330->commands) ;
-  if ((pc->cphase == CP_IDLE) land (pc->cmdin != pc->cmdout))
+  p = addr(pc->cmsgout.qdp) ;
+  initcmdhdr (q330, addr(p), pcmd->cmd) ;
+  pref = p ; /* pointer after header for length calculation */
+  if (pcmd->tunneled)
     then
-      pc->cphase = CP_NEED ;
-  if (pc->cphase == CP_NEED)
+      memcpy (p, addr(q330->share.tunnel.payload), q330->share.tunnel.paysize) ;
+    else
+      switch (pcmd->cmd) begin
+        case C1_RQSRV :
+          storerqsrv (addr(p), addr(q330->par_create.q330id_serial)) ;
+          break ;
+        case C1_SRVRSP :
+          storesrvrsp (addr(p), addr(q330->srvresp)) ;
+          break ;
+        case C1_DSRV :
+          storerqsrv (addr(p), addr(q330->par_create.q330id_serial)) ;
+          break ;
+        case C1_RQSTAT :
+          storerqstat (addr(p), q330->stat_request) ;
+          break ;
+        case C1_RQLOG :
+          storeword (addr(p), q330->par_create.q330id_dataport) ;
+          break ;
+        case C1_RQFGLS :
+          storeword (addr(p), q330->par_create.q330id_dataport) ;
+          storeword (addr(p), 1) ;
+          break ;
+        case C1_POLLSN :
+          storepollsn (addr(p), addr(q330->newpoll)) ;
+          break ;
+        case C1_PING :
+          lock (q330) ;
+          q330->pinghdr.ping_type = q330->share.pingreq.pingtype ;
+          switch (q330->pinghdr.ping_type) begin
+            case 0 :
+            case 4 : /* normal ping or format request */
+              q330->pinghdr.ping_opt = q330->pingid ;
+              inc(q330->pingid) ;
+              storepinghdr (addr(p), addr(q330->pinghdr)) ;
+              break ;
+            case 2 : /* status request */
+              q330->pinghdr.ping_opt = q330->share.pingreq.pingopt ;
+              storepinghdr (addr(p), addr(q330->pinghdr)) ;
+              storepingstatreq (addr(p), q330->share.pingreq.pingreqmap) ;
+              break ;
+          end
+          unlock (q330) ;
+          q330->ping_send = now () ;
+          break ;
+        case C1_RQMEM :
+          q330->mem_req.start = pcmd->memstart ;
+          q330->mem_req.memtype = pcmd->memtype ;
+          storememhdr (addr(p), addr(q330->mem_req)) ;
+          break ;
+        case C1_SLOG :
+          lock (q330) ;
+          storeslog (addr(p), addr(q330->share.newlog)) ;
+          unlock (q330) ;
+          break ;
+        case C1_UMSG :
+          lock (q330) ;
+          storeumsg (addr(p), addr(q330->share.newuser)) ;
+          unlock (q330) ;
+          break ;
+        case C1_WEB :
+          lock (q330) ;
+          if (q330->share.fixed.flags and FF_NWEB)
+            then
+              storenewweb (addr(p), addr(q330->share.new_webadv)) ;
+            else
+              storeoldweb (addr(p), addr(q330->share.old_webadv)) ;
+          unlock (q330) ;
+          break ;
+        case C2_BRDY :
+          memset(addr(q330->brdy), 0, sizeof(tbrdy)) ;
+          memcpy(addr(q330->brdy.sernum), addr(q330->par_create.q330id_serial), sizeof(t64)) ;
+          (q330->brdy.stn)[5] = BR_RQCFG ; /* Request it if it is there */
+          storebrdy (addr(p), addr(q330->brdy)) ;
+          break ;
+        case C2_BOFF :
+          storeword (addr(p), 1) ;
+          break ;
+        case C2_REGCHK :
+          lock (q330) ;
+          storelongword (addr(p), q330->share.check_ip) ;
+          unlock (q330) ;
+          break ;
+        case C2_SEPCFG :
+          lock (q330) ;
+          storeepcfg (addr(p), addr(q330->share.newepcfg)) ;
+          unlock (q330) ;
+          break ;
+      end
+  lth = (longint)p - (longint)pref ; /* length of data */
+  p = addr(pc->cmsgout.qdp) ;
+  plth = p ;
+  incn(plth, 6) ; /* point at length */
+  storeword (addr(plth), lth) ;
+  pcmd->cphase = CP_WAIT ;
+  pcmd->lastctrlseq = pc->ctrlseq ;
+  inc(pc->ctrlseq) ;
+  pcmd->sent = now() ;
+  pcmd->sendsz = lth + IP_HDR_LTH + UDP_HDR_LTH + QDP_HDR_LTH ;
+  if (q330->usesock)
     then
-      begin
-        p = addr(pc->cmsgout.qdp) ;
-        pcmd = addr(pc->cmdq[pc->cmdout]) ;
-        initcmdhdr (q330, addr(p), pcmd->cmd) ;
-        pref = p ; /* pointer after header for length calculation */
-        if (pcmd->tunneled)
-          then
-            memcpy (p, addr(q330->share.tunnel.payload), q330->share.tunnel.paysize) ;
-          else
-            switch (pcmd->cmd) begin
-              case C1_RQSRV :
-                storerqsrv (addr(p), addr(q330->par_create.q330id_serial)) ;
-                break ;
-              case C1_SRVRSP :
-                storesrvrsp (addr(p), addr(q330->srvresp)) ;
-                break ;
-              case C1_DSRV :
-                storerqsrv (addr(p), addr(q330->par_create.q330id_serial)) ;
-                break ;
-              case C1_RQSTAT :
-                storerqstat (addr(p), q330->stat_request) ;
-                break ;
-              case C1_RQLOG :
-                storeword (addr(p), q330->par_create.q330id_dataport) ;
-                break ;
-              case C1_RQFGLS :
-                storeword (addr(p), q330->par_create.q330id_dataport) ;
-                storeword (addr(p), 1) ;
-                break ;
-              case C1_POLLSN :
-                storepollsn (addr(p), addr(q330->newpoll)) ;
-                break ;
-              case C1_PING :
-                lock (q330) ;
-                q330->pinghdr.ping_type = q330->share.pingreq.pingtype ;
-                switch (q330->pinghdr.ping_type) begin
-                  case 0 :
-                  case 4 : /* normal ping or format request */
-                    q330->pinghdr.ping_opt = q330->pingid ;
-                    inc(q330->pingid) ;
-                    storepinghdr (addr(p), addr(q330->pinghdr)) ;
-                    break ;
-                  case 2 : /* status request */
-                    q330->pinghdr.ping_opt = q330->share.pingreq.pingopt ;
-                    storepinghdr (addr(p), addr(q330->pinghdr)) ;
-                    storepingstatreq (addr(p), q330->share.pingreq.pingreqmap) ;
-                    break ;
-                end
-                unlock (q330) ;
-                q330->ping_send = now () ;
-                break ;
-              case C1_RQMEM :
-                storememhdr (addr(p), addr(q330->mem_req)) ;
-                break ;
-              case C1_SLOG :
-                lock (q330) ;
-                storeslog (addr(p), addr(q330->share.newlog)) ;
-                unlock (q330) ;
-                break ;
-              case C1_UMSG :
-                lock (q330) ;
-                storeumsg (addr(p), addr(q330->share.newuser)) ;
-                unlock (q330) ;
-                break ;
-              case C1_WEB :
-                lock (q330) ;
-                if (q330->share.fixed.flags and FF_NWEB)
-                  then
-                    storenewweb (addr(p), addr(q330->share.new_webadv)) ;
-                  else
-                    storeoldweb (addr(p), addr(q330->share.old_webadv)) ;
-                unlock (q330) ;
-                break ;
-              case C2_BRDY :
-                memset(addr(q330->brdy), 0, sizeof(tbrdy)) ;
-                memcpy(addr(q330->brdy.sernum), addr(q330->par_create.q330id_serial), sizeof(t64)) ;
-                (q330->brdy.stn)[5] = BR_RQCFG ; /* Request it if it is there */
-                storebrdy (addr(p), addr(q330->brdy)) ;
-                break ;
-              case C2_BOFF :
-                storeword (addr(p), 1) ;
-                break ;
-              case C2_REGCHK :
-                lock (q330) ;
-                storelongword (addr(p), q330->share.check_ip) ;
-                unlock (q330) ;
-                break ;
-              case C2_SEPCFG :
-                lock (q330) ;
-                storeepcfg (addr(p), addr(q330->share.newepcfg)) ;
-                unlock (q330) ;
-                break ;
-            end
-        lth = (longint)p - (longint)pref ; /* length of data */
-        p = addr(pc->cmsgout.qdp) ;
-        plth = p ;
-        incn(plth, 6) ; /* point at length */
-        storeword (addr(plth), lth) ;
-        pc->cphase = CP_WAIT ;
-        pc->lastctrlseq = pc->ctrlseq ;
-        inc(pc->ctrlseq) ;
-        pcmd->sent = now() ;
-        pcmd->sendsz = lth + IP_HDR_LTH + UDP_HDR_LTH + QDP_HDR_LTH ;
-        if (q330->usesock)
-          then
-            sersz = 576 ;
+      sersz = 576 ;
 #ifndef OMIT_SERIAL
 #ifdef X86_WIN32
-          else
-            begin
-              ClearCommError(q330->comid, addr(errs), addr(comstat)) ;
-              sersz = comstat.cbOutQue + 600 ;
-            end
+    else
+      begin
+        ClearCommError(q330->comid, addr(errs), addr(comstat)) ;
+        sersz = comstat.cbOutQue + 600 ;
+      end
 #else
 #endif
 #endif
-        if (pc->history_count < 3)
+  if (pc->history_count < 3)
+    then
+      begin
+        if (q330->usesock)
           then
-            begin
-              if (q330->usesock)
-                then
-                  pc->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
+            pcmd->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
 #ifndef OMIT_SERIAL
-                else
-                  begin
-                    pc->ctrlrecnt = ((pcmd->sendsz + pcmd->estsz + sersz) div (q330->par_register.serial_baud div 10)) * 2 + 1 ;
-                    if (pc->ctrlrecnt < ((q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2))
-                      then
-                        pc->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
-                  end
-#endif
-            end
           else
             begin
-              r = 0 ;
-              for (i = 0 ; i <= pc->history_count - 1 ; i++)
-                r = r + pc->histories[i] ;
-              r = r / pc->history_count ;
-              if (r == 0.0)
+              pcmd->ctrlrecnt = ((pcmd->sendsz + pcmd->estsz + ahead + sersz) div (q330->par_register.serial_baud div 10)) * 2 + 1 ;
+              if (pcmd->ctrlrecnt < ((q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2))
                 then
-                  pc->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
-                else
-                  pc->ctrlrecnt = ((pcmd->sendsz + pcmd->estsz + sersz) / r) * 2 + 1.5 ;
-              pc->ctrlrecnt = pc->ctrlrecnt * (pc->ctrl_retries + 1) ; /* backoff */
+                  pcmd->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
             end
-        if (pc->ctrlrecnt < q330->par_register.host_mincmdretry)
-          then
-            pc->ctrlrecnt = q330->par_register.host_mincmdretry ;
-        if (pc->ctrlrecnt > q330->par_register.host_maxcmdretry)
+#endif
+      end
+    else
+      begin
+        r = 0 ;
+        for (i = 0 ; i <= pc->history_count - 1 ; i++)
+          r = r + pc->histories[i] ;
+        r = r / pc->history_count ;
+        if (r == 0.0)
           then
-            pc->ctrlrecnt = q330->par_register.host_maxcmdretry ;
-        switch (pcmd->cmd) begin
-          case C1_POLLSN :
-            pc->ctrlrecnt = 3 ; /* 300ms, special timeout */
-            break ;
-          case C1_PING :
-            pc->ctrlrecnt = 5 ; /* 5 seconds */
-            break ;
-        end
-        msglth = QDP_HDR_LTH + lth ;
+            pcmd->ctrlrecnt = (q330->par_register.host_maxcmdretry + q330->par_register.host_mincmdretry) div 2 ;
+          else
+            pcmd->ctrlrecnt = ((pcmd->sendsz + pcmd->estsz + ahead + sersz) / r) * 2 + 1.5 ;
+        pcmd->ctrlrecnt = pcmd->ctrlrecnt * (pcmd->ctrl_retries + 1) ; /* backoff */
+      end
+  if (pcmd->ctrlrecnt < q330->par_register.host_mincmdretry)
+    then
+      pcmd->ctrlrecnt = q330->par_register.host_mincmdretry ;
+  if (pcmd->ctrlrecnt > q330->par_register.host_maxcmdretry)
+    then
+      pcmd->ctrlrecnt = q330->par_register.host_maxcmdretry ;
+  switch (pcmd->cmd) begin
+    case C1_POLLSN :
+      pcmd->ctrlrecnt = 3 ; /* 300ms, special timeout */
+      break ;
+    case C1_PING :
+      pcmd->ctrlrecnt = 5 ; /* 5 seconds */
+      break ;
+  end
+  msglth = QDP_HDR_LTH + lth ;
+  p = addr(pc->cmsgout.qdp) ;
+  storelongint (addr(p), gcrccalc (addr(q330->crc_table), (pointer)((integer)p + 4), msglth - 4)) ;
+  if (q330->cur_verbosity and VERB_PACKET)
+    then
+      begin /* log the message sent */
         p = addr(pc->cmsgout.qdp) ;
-        storelongint (addr(p), gcrccalc (addr(q330->crc_table), (pointer)((integer)p + 4), msglth - 4)) ;
-        if (q330->cur_verbosity and VERB_PACKET)
+        loadqdphdr (addr(p), addr(q330->recvhdr)) ; /* for display purposes */
+        libpktmsg (q330, LIBMSG_PKTOUT, 0, 0, NIL) ;
+      end
+#ifndef OMIT_NETWORK
+  if (q330->usesock)
+    then
+      begin
+        if (q330->cpath == INVALID_SOCKET)
+          then
+            return TRUE ;
+        if (q330->tcp)
           then
-            begin /* log the message sent */
-              p = addr(pc->cmsgout.qdp) ;
-              loadqdphdr (addr(p), addr(q330->recvhdr)) ; /* for display purposes */
-              packet_time (now(), addr(s)) ;
-              command_name (q330->recvhdr.command, addr(s1)) ;
-              strcat (s, s1) ;
-              sprintf(s1, ", Lth=%d Seq=%d Ack=%d", q330->recvhdr.datalength, q330->recvhdr.sequence,
-                      q330->recvhdr.acknowledge) ;
-              strcat(s, s1) ;
-              libmsgadd(q330, LIBMSG_PKTOUT, addr(s)) ;
+            begin
+              p = (pointer)((integer)addr(pc->cmsgout.qdp) - 4) ;
+              pref = p ; /* save start of tcp packet */
+              storeword (addr(p), 0) ; /* control port */
+              storeword (addr(p), msglth) ; /* qdp length */
+              err = send(q330->cpath, (pchar) pref, msglth + 4, 0) ;
             end
-#ifndef OMIT_NETWORK
-        if (q330->usesock)
+          else
+            err = sendto(q330->cpath, addr(pc->cmsgout.qdp), msglth, 0, addr(q330->csockout), sizeof(struct sockaddr)) ;
+        if (err == SOCKET_ERROR)
           then
             begin
-              if (q330->cpath == INVALID_SOCKET)
-                then
-                  return ;
-              if (q330->tcp)
-                then
-                  begin
-                    p = (pointer)((integer)addr(pc->cmsgout.qdp) - 4) ;
-                    pref = p ; /* save start of tcp packet */
-                    storeword (addr(p), 0) ; /* control port */
-                    storeword (addr(p), msglth) ; /* qdp length */
-                    err = send(q330->cpath, (pchar) pref, msglth + 4, 0) ;
-                  end
-                else
-                  err = sendto(q330->cpath, addr(pc->cmsgout.qdp), msglth, 0, addr(q330->csockout), sizeof(struct sockaddr)) ;
-              if (err == SOCKET_ERROR)
-                then
-                  begin
-                    err =
+              err =
 #ifdef X86_WIN32
-                           WSAGetLastError() ;
+                     WSAGetLastError() ;
 #else
-                           errno ;
+                     errno ;
 #endif
-                    if (err == ENOBUFS)
-                      then
-                        begin
-                          purge_cmdq (q330) ;
-                          lib_change_state (q330, LIBSTATE_WAIT, LIBERR_NOTR) ;
-                          close_sockets (q330) ;
-                          q330->reg_wait_timer = 60 * 10 ;
-                          q330->registered = FALSE ;
-                          libmsgadd (q330, LIBMSG_ROUTEFAULT, "Waiting 10 minutes") ;
-                        end
-                    else if (err != EWOULDBLOCK)
-                      then
-                        if (q330->tcp)
-                          then
-                            begin
-                              purge_cmdq (q330) ;
-                              sprintf(s1, "%d, Waiting 10 minutes", err) ;
-                              tcp_error (q330, addr(s1)) ;
-                            end
-                          else
-                            begin
-                              sprintf(s1, "%d", err) ;
-                              libmsgadd(q330, LIBMSG_CANTSEND, addr(s1)) ;
-                              add_status (q330, AC_IOERR, 1) ; /* add one I/O error */
-                              pc->ctrl_retries = 10 ;
-                            end
+              if (err == ENOBUFS)
+                then
+                  begin
+                    purge_cmdq (q330) ;
+                    lib_change_state (q330, LIBSTATE_WAIT, LIBERR_NOTR) ;
+                    close_sockets (q330) ;
+                    q330->reg_wait_timer = 60 * 10 ;
+                    q330->registered = FALSE ;
+                    libmsgadd (q330, LIBMSG_ROUTEFAULT, "Waiting 10 minutes") ;
+                    return FALSE ;
                   end
-                else
-                  add_status (q330, AC_WRITE, msglth + IP_HDR_LTH + UDP_HDR_LTH) ;
+              else if (err != EWOULDBLOCK)
+                then
+                  if (q330->tcp)
+                    then
+                      begin
+                        purge_cmdq (q330) ;
+                        sprintf(s1, "%d, Waiting 10 minutes", err) ;
+                        tcp_error (q330, addr(s1)) ;
+                        return FALSE ;
+                      end
+                    else
+                      begin
+                        sprintf(s1, "%d", err) ;
+                        libmsgadd(q330, LIBMSG_CANTSEND, addr(s1)) ;
+                        add_status (q330, AC_IOERR, 1) ; /* add one I/O error */
+                        pcmd->ctrl_retries = 10 ;
+                      end
             end
+          else
+            add_status (q330, AC_WRITE, msglth + IP_HDR_LTH + UDP_HDR_LTH) ;
+      end
 #endif
 #ifndef OMIT_SERIAL
-        if (q330->usesock == 0)
-          then
-            send_packet (q330, msglth, q330->q330cport, q330->ctrlport) ;
+  if (q330->usesock == 0)
+    then
+      send_packet (q330, msglth, q330->q330cport, q330->ctrlport) ;
 #endif
-      end
+  return TRUE ;
+end
+
+static void lib_send_next_cmd (pq330 q330)
+begin
+  integer i, count, ahead ;
+  tcommands *pc ;
+  tcmdq *pcmd ;
+
+  pc = addr(q330->commands) ;
+  count = 0 ;
+  ahead = 0 ;
+  i = pc->cmdout ;
+  while (i != pc->cmdin)
+    begin
+      pcmd = addr(pc->cmdq[i]) ;
+      if (pcmd->cphase != CP_DONE)
+        then
+          begin
+            if ((count > 0) land ((count >= CMDWINDOW) lor (lnot pipelined (pcmd))))
+              then
+                return ; /* has to wait for those ahead of it */
+            if (pcmd->cphase == CP_NEED)
+              then
+                if (lnot send_cmd (q330, pcmd, ahead))
+                  then
+                    return ;
+            if (lnot pipelined (pcmd))
+              then
+                return ; /* nothing goes past it */
+            inc(count) ;
+            ahead = ahead + pcmd->sendsz + pcmd->estsz ;
+          end
+      i = (i + 1) mod CMDQSZ ;
+    end
 end
 
 static void abort_cmsg (pq330 q330)
 begin
 
-  if ((q330->commands.cphase == CP_WAIT) land (q330->commands.cmdin != q330->commands.cmdout))
+  if ((q330->commands.cmdin != q330->commands.cmdout) land
+      (q330->commands.cmdq[q330->commands.cmdout].cphase == CP_WAIT))
     then
       begin
+        q330->commands.cmdcur = q330->commands.cmdout ;
         libmsgadd (q330, LIBMSG_CMDABT, "") ;
         clear_cmsg (q330) ;
         q330->stat_request = 0 ;
       end
 end
 
-void new_cmd (pq330 q330, byte ncmd, word sz)
+static tcmdq *add_cmd (pq330 q330, byte ncmd, word sz)
 begin
-  integer i ;
   tcommands *pc ;
   tcmdq *pcmd ;
 
   pc = addr(q330->commands) ;
-  i = pc->cmdout ;
-  while (i != pc->cmdin)
-    if (pc->cmdq[i].cmd == ncmd)
-      then
-        return ; /* already one there */
-      else
-        i = (i + 1) mod CMDQSZ ;
   pcmd = addr(pc->cmdq[pc->cmdin]) ;
   pcmd->cmd = ncmd ;
+  pcmd->cphase = CP_NEED ;
+  pcmd->ctrl_retries = 0 ;
+  pcmd->memstart = 0 ;
   if (sz == TUNCMDFLAG)
     then
       begin
@@ -480,9 +540,37 @@ begin
       end
   pcmd->retsz = 0 ;
   pc->cmdin = (pc->cmdin + 1) mod CMDQSZ ;
+  return pcmd ;
+end
+
+void new_cmd (pq330 q330, byte ncmd, word sz)
+begin
+  integer i ;
+  tcommands *pc ;
+
+  pc = addr(q330->commands) ;
+  i = pc->cmdout ;
+  while (i != pc->cmdin)
+    if ((pc->cmdq[i].cmd == ncmd) land (pc->cmdq[i].cphase != CP_DONE))
+      then
+        return ; /* already one there */
+      else
+        i = (i + 1) mod CMDQSZ ;
+  add_cmd (q330, ncmd, sz) ;
   lib_send_next_cmd (q330) ; /* in case are free to send */
 end
 
+/* each memory request keeps what it asked for, so there can be several */
+void new_mem_cmd (pq330 q330, word memtype, longword start)
+begin
+  tcmdq *pcmd ;
+
+  pcmd = add_cmd (q330, C1_RQMEM, MAXSEG) ;
+  pcmd->memstart = start ;
+  pcmd->memtype = memtype ;
+  lib_send_next_cmd (q330) ;
+end
+
 static word stat_estimate (longword stat_rqst)
 begin
   word w ;
@@ -556,6 +644,8 @@ static void reboot (pq330 q330, boolean keep_link)
 begin
 
   q330->reboot_done = FALSE ;
+  q330->fgls_read = FALSE ;
+  q330->cfgcheck = CC_NONE ;
   q330->share.opstat.runtime = 0 ;
   new_state (q330, LIBSTATE_READCFG) ;
   q330->link_recv = keep_link ;
@@ -571,6 +661,19 @@ begin
   new_cmd (q330, C1_RQSTAT, stat_estimate(q330->stat_request)) ;
 end
 
+/* the reboot requests may be answered in any order, start on the tokens once
+   the fixed values and all the requested status have arrived */
+static void check_reboot_done (pq330 q330)
+begin
+
+  if ((lnot q330->reboot_done) land (q330->fgls_read) land (q330->stat_request == 0))
+    then
+      begin
+        q330->reboot_done = TRUE ;
+        cfg_start (q330) ;
+      end
+end
+
 static void start_deregistration (pq330 q330)
 begin
   boolean have_msg ;
@@ -651,6 +754,7 @@ begin
     else
       new_cmd (q330, C1_RQSRV, sizeof(t64)) ;
   q330->reg_timer = 0 ;
+  q330->reg_started = now () ;
 end
 
 void lib_start_registration (pq330 q330)
@@ -737,6 +841,28 @@ begin
   q330->reg_timer = 0 ;
 end
 
+/* find the outstanding command a response acknowledges */
+static boolean match_cmd (pq330 q330, tcmdq **pcmd)
+begin
+  integer i ;
+  tcommands *pc ;
+
+  pc = addr(q330->commands) ;
+  i = pc->cmdout ;
+  while (i != pc->cmdin)
+    begin
+      if ((pc->cmdq[i].cphase == CP_WAIT) land (pc->cmdq[i].lastctrlseq == q330->recvhdr.acknowledge))
+        then
+          begin
+            pc->cmdcur = i ;
+            *pcmd = addr(pc->cmdq[i]) ;
+            return TRUE ;
+          end
+      i = (i + 1) mod CMDQSZ ;
+    end
+  return FALSE ;
+end
+
 /* pb has pointer to packet buffer */
 void lib_command_response (pq330 q330, pbyte pb)
 begin
@@ -749,6 +875,8 @@ begin
   string63 s3 ;
   longword req_mask, mask ;
   longword bitnum, check_resp ;
+  longword memstart ;
+  word memtype ;
   byte errcmd ;
   double t ;
   single perc ;
@@ -764,26 +892,19 @@ begin
   add_status (q330, AC_PACKETS, 1) ;
   if (q330->cur_verbosity and VERB_PACKET)
     then
-      begin /* log the message received */
-        packet_time (now(), addr(s)) ;
-        command_name (q330->recvhdr.command, addr(s2)) ;
-        strcat (s, s2) ;
-        sprintf(s2, ", Lth=%d Seq=%d Ack=%d", q330->recvhdr.datalength, q330->recvhdr.sequence,
-                q330->recvhdr.acknowledge) ;
-        strcat(s, s2) ;
-        libmsgadd(q330, LIBMSG_PKTIN, s) ;
-      end
+      libpktmsg (q330, LIBMSG_PKTIN, 0, 0, NIL) ; /* log the message received */
 /*  with *q330, recvhdr, commands */
-  pcmd = addr(pc->cmdq[pc->cmdout]) ;
-  if (pc->cphase == CP_WAIT)
+  if (pc->cmdin != pc->cmdout)
     then
-      if (q330->recvhdr.acknowledge == pc->lastctrlseq)
+      if (match_cmd (q330, addr(pcmd)))
         then
           if (q330->recvhdr.command == C1_CERR)
             then
               begin
                 errcode = loadcerr (addr(p)) ;
                 errcmd = pcmd->cmd ;
+                memstart = pcmd->memstart ;
+                memtype = pcmd->memtype ;
                 q330->share.tunnel_state = TS_IDLE ; /* just in case */
                 if (errcmd != C1_RQMEM)
                   then
@@ -813,15 +934,21 @@ begin
                     break ;
                   case CERR_PAR :
                     libmsgadd(q330, LIBMSG_PARERR, "") ;
+                    if ((errcmd == C1_RQMEM) land
+                        ((q330->libstate == LIBSTATE_READTOK) lor (q330->cfgcheck == CC_VERIFY)) land
+                        (memtype == q330->par_create.q330id_dataport + MT_CFG1))
+                      then
+                        cfg_segment_error (q330, memstart) ;
                     break ;
                   case CERR_SNV :
                     libmsgadd(q330, LIBMSG_SNV, "") ;
                     switch (errcmd) begin
                       case C1_RQMEM :
-                        if ((q330->libstate == LIBSTATE_READTOK) land
-                           (q330->mem_req.memtype == q330->par_create.q330id_dataport + MT_CFG1))
+                        if (((q330->libstate == LIBSTATE_READTOK) lor (q330->cfgcheck == CC_VERIFY)) land
+                           (memtype == q330->par_create.q330id_dataport + MT_CFG1))
                           then
                             begin
+                              q330->cfgcheck = CC_NONE ;
                               lib_change_state (q330, LIBSTATE_WAIT, LIBERR_INVAL_TOKENS) ;
                               sprintf(s, ", will retry in %d seconds", NR_TIME) ;
                               libmsgadd (q330, LIBMSG_INVTOK, addr(s)) ;
@@ -1012,6 +1139,8 @@ begin
                         if (q330->q335)
                           then
                             libmsgadd(q330, LIBMSG_Q335, "") ;
+                        q330->fgls_read = TRUE ;
+                        check_reboot_done (q330) ;
                       end
                   break ;
                 case C1_SLOG :
@@ -1260,12 +1389,7 @@ begin
                             begin
                               q330->status_timer = 0 ;
                               q330->last_status_received = now () ;
-                              if (lnot q330->reboot_done)
-                                then
-                                  begin
-                                    q330->reboot_done = TRUE ;
-                                    cfg_start (q330) ;
-                                  end
+                              check_reboot_done (q330) ;
                             end
                           else
                             new_cmd (q330, C1_RQSTAT, stat_estimate(q330->stat_request)) ;
@@ -1381,12 +1505,14 @@ begin
                   if (q330->recvhdr.command == C1_MEM)
                     then
                       begin
+                        memstart = pcmd->memstart ;
+                        memtype = pcmd->memtype ;
                         clear_cmsg (q330) ;
                         loadmemhdr (addr(p), addr(q330->mem_hdr)) ;
-                        if ((q330->libstate == LIBSTATE_READTOK) land
-                           (q330->mem_hdr.memtype == (MT_CFG1 + q330->par_create.q330id_dataport)))
+                        if (((q330->libstate == LIBSTATE_READTOK) lor (q330->cfgcheck == CC_VERIFY)) land
+                           (memtype == (MT_CFG1 + q330->par_create.q330id_dataport)))
                           then
-                            read_q330_cfg (q330, p) ;
+                            read_q330_cfg (q330, p, memstart) ;
                       end
                   break ;
                 case C1_WEB :
@@ -1494,7 +1620,9 @@ begin
   word piggy_threshold ;
   longword cfgnum ;
   longword bitmap ;
+  integer i ;
   tcommands *pc ;
+  tcmdq *pcmd ;
   string95 s ;
 #ifndef OMIT_SEED
   paqstruc paqs ;
@@ -1515,6 +1643,24 @@ begin
         libmsgadd (q330, LIBMSG_CONTIN, addr(q330->contmsg)) ;
         q330->contmsg[0] = 0 ;
       end
+  if (q330->cur_verbosity and VERB_PKTMSG)
+    then
+      flush_msgring (q330) ;
+  if (q330->share.capture_requested)
+    then
+      capture_request (q330) ;
+  if (q330->capturing)
+    then
+      capture_flush (q330) ;
+  if (q330->share.replay_requested)
+    then
+      replay_request (q330) ;
+  if (q330->replay)
+    then
+      begin
+        replay_timer (q330) ;
+        return ;
+      end
   if (q330->libstate != LIBSTATE_RUN)
     then
       begin
@@ -1565,6 +1711,7 @@ begin
           case LIBSTATE_RUNWAIT :
             switch (q330->libstate) begin
               case LIBSTATE_DECTOK :
+                capture_config (q330) ;
                 decode_cfg (q330) ;
                 strcpy(s, q330->station_ident) ;
                 strcat(s, ", ") ;
@@ -1590,6 +1737,18 @@ begin
           case LIBSTATE_RUN :
             switch (q330->libstate) begin
               case LIBSTATE_RUNWAIT :
+                if (q330->cfgcheck == CC_CHANGED)
+                  then
+                    begin /* the tokens read back don't match the cached ones decoded */
+                      q330->cfgcheck = CC_NONE ;
+                      libmsgadd (q330, LIBMSG_TOKCHG, "") ;
+                      lib_change_state (q330, LIBSTATE_RUNWAIT, LIBERR_TOKENS_CHANGE) ;
+                      start_deallocation (q330) ;
+                      break ;
+                    end
+                if (q330->cfgcheck == CC_VERIFY)
+                  then
+                    break ; /* no data until every segment has matched the cache */
                 send_dopen (q330) ;
                 add_status (q330, AC_COMSUC, 1) ; /* complete cycle */
                 new_state (q330, LIBSTATE_RUN) ;
@@ -1621,6 +1780,7 @@ begin
 #endif
                         save_thread_continuity (q330) ;
                       end
+                  capture_close (q330) ;
                   q330->terminate = TRUE ; /* shutdown thread */
 #ifdef CMEX32
                   new_state (q330, LIBSTATE_TERM) ;
@@ -1703,52 +1863,59 @@ begin
             flush_dplcqs (q330) ;
       end
 #endif
-  if ((pc->cphase == CP_WAIT) land (pc->ctrlrecnt == 0))
-    then
-      begin
-        if (pc->cmdq[pc->cmdout].cmd == C1_PING)
-          then
-            begin
-              clear_cmsg (q330) ;
-              if (q330->share.client_ping == CLP_SENT)
-                then
-                  begin
-                    q330->share.client_ping = CLP_IDLE ;
-                    if (q330->par_create.call_state)
-                      then
-                        begin
-                          q330->state_call.context = q330 ;
-                          q330->state_call.state_type = ST_PING ;
-                          q330->state_call.subtype = 1 ;
-                          memcpy(addr(q330->state_call.station_name), addr(q330->station_ident), sizeof(string9)) ;
-                          q330->state_call.info = 0xFFFFFFFF ; /* no response */
-                          q330->pingbuffer.ping_type = 1 ; /* fake a response */
-                          q330->pingbuffer.ping_id = q330->pinghdr.ping_opt ;
-                          q330->par_create.call_state (addr(q330->state_call)) ;
-                          if (q330->libstate == LIBSTATE_PING)
-                            then
-                              q330->share.target_state = LIBSTATE_IDLE ;
-                        end
-                  end
-            end
-          else
-            begin
-              pc->cphase = CP_NEED ;
-              if (pc->ctrl_retries < 10)
-                then
-                  inc(pc->ctrl_retries) ;
-              add_status (q330, AC_CMDTO, 1) ;
-              if (lnot q330->stalled_link)
-                then
-                  begin
-                    q330->stalled_link = TRUE ;
-                    state_callback (q330, ST_STALL, 1) ;
-                  end
-              if (q330->cur_verbosity and VERB_RETRY)
-                then
-                  libmsgadd (q330, LIBMSG_RETRY, command_name (pc->cmdq[pc->cmdout].cmd, addr(s))) ;
-            end
-      end
+  i = pc->cmdout ;
+  while (i != pc->cmdin)
+    begin
+      pcmd = addr(pc->cmdq[i]) ;
+      if ((pcmd->cphase == CP_WAIT) land (pcmd->ctrlrecnt == 0))
+        then
+          begin
+            if (pcmd->cmd == C1_PING)
+              then
+                begin
+                  pc->cmdcur = i ;
+                  clear_cmsg (q330) ;
+                  if (q330->share.client_ping == CLP_SENT)
+                    then
+                      begin
+                        q330->share.client_ping = CLP_IDLE ;
+                        if (q330->par_create.call_state)
+                          then
+                            begin
+                              q330->state_call.context = q330 ;
+                              q330->state_call.state_type = ST_PING ;
+                              q330->state_call.subtype = 1 ;
+                              memcpy(addr(q330->state_call.station_name), addr(q330->station_ident), sizeof(string9)) ;
+                              q330->state_call.info = 0xFFFFFFFF ; /* no response */
+                              q330->pingbuffer.ping_type = 1 ; /* fake a response */
+                              q330->pingbuffer.ping_id = q330->pinghdr.ping_opt ;
+                              q330->par_create.call_state (addr(q330->state_call)) ;
+                              if (q330->libstate == LIBSTATE_PING)
+                                then
+                                  q330->share.target_state = LIBSTATE_IDLE ;
+                            end
+                      end
+                end
+              else
+                begin
+                  pcmd->cphase = CP_NEED ;
+                  if (pcmd->ctrl_retries < 10)
+                    then
+                      inc(pcmd->ctrl_retries) ;
+                  add_status (q330, AC_CMDTO, 1) ;
+                  if (lnot q330->stalled_link)
+                    then
+                      begin
+                        q330->stalled_link = TRUE ;
+                        state_callback (q330, ST_STALL, 1) ;
+                      end
+                  if (q330->cur_verbosity and VERB_RETRY)
+                    then
+                      libmsgadd (q330, LIBMSG_RETRY, command_name (pcmd->cmd, addr(s))) ;
+                end
+          end
+      i = (i + 1) mod CMDQSZ ;
+    end
   if (q330->share.log_changed)
     then
       begin
@@ -1800,9 +1967,14 @@ begin
     then
       begin /* about 1 second */
         q330->timercnt = 0 ;
-        if (pc->ctrlrecnt)
-          then
-            dec(pc->ctrlrecnt) ;
+        i = pc->cmdout ;
+        while (i != pc->cmdin)
+          begin
+            if ((pc->cmdq[i].cphase == CP_WAIT) land (pc->cmdq[i].ctrlrecnt))
+              then
+                dec(pc->cmdq[i].ctrlrecnt) ;
+            i = (i + 1) mod CMDQSZ ;
+          end
         inc(q330->share.interval_counter) ;
         if (q330->share.freeze_timer > 0)
           then
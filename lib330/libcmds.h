@@ -25,7 +25,7 @@ Edit History:
 #ifndef libcmds_h
 /* Flag this file as included */
 #define libcmds_h
-#define VER_LIBCMDS 23
+#define VER_LIBCMDS 29
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -43,5 +43,6 @@ extern void purge_cmdq (pq330 q330) ;
 extern void lib_command_response (pq330 q330, pbyte pb) ;
 extern void start_deallocation (pq330 q330) ;
 extern void new_cmd (pq330 q330, byte ncmd, word sz) ;
+extern void new_mem_cmd (pq330 q330, word memtype, longword start) ;
 
 #endif
@@ -36,6 +36,8 @@ Edit History:
                      instead of using getmem.
     9 2010-07-21 rdr Add high frequency to connection continuity.
    10 2010-07-22 rdr Add updating of thread memory required. 
+   11 2026-10-19 gns DP LCQs come from new_lcq. Archival and session statistics are now in
+                     the LCQ cold part.
 */
 #ifndef libcont_h
 #include "libcont.h"
@@ -355,7 +357,7 @@ begin
   pq330 q330 ;
 
   q330 = paqs->owner ;
-  getthrbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+  cur_lcq = new_lcq (paqs, TRUE) ;
   if (paqs->dplcqs == NIL)
     then
       paqs->dplcqs = cur_lcq ;
@@ -373,7 +375,7 @@ begin
   cur_lcq->com->frame = 1 ;
   cur_lcq->com->next_compressed_sample = 1 ;
   cur_lcq->com->maxframes = 255 ;
-  cur_lcq->arc.records_written = 0 ;
+  cur_lcq->cold->arc.records_written = 0 ;
 #endif
   paqs->msg_lcq = cur_lcq ;
   if (done)
@@ -497,7 +499,7 @@ begin
                     build_fake_log_lcq (paqs, TRUE) ;
                 return ;
               end
-          getthrbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+          cur_lcq = new_lcq (paqs, TRUE) ;
           if (paqs->dplcqs == NIL)
             then
               paqs->dplcqs = cur_lcq ;
@@ -537,7 +539,7 @@ begin
           cur_lcq->com->last_sample = pdlsrc->last_sample ;
           cur_lcq->backup_tag = pdlsrc->nextrec_tag ;
           cur_lcq->last_timetag = 0 ; /* Expecting a gap, don't report */
-          cur_lcq->arc.records_written = pdlsrc->arec_written ;
+          cur_lcq->cold->arc.records_written = pdlsrc->arec_written ;
 #endif
           lib_file_seek (q330->par_create.file_owner, cf, next) ;
           inc(loops) ;
@@ -660,7 +662,7 @@ begin
 #ifndef OMIT_SEED
             pdldest->frame_limit = q->com->maxframes ;
             pdldest->rec_written = q->com->records_written ;
-            pdldest->arec_written = q->arc.records_written ;
+            pdldest->arec_written = q->cold->arc.records_written ;
             pdldest->last_sample = q->com->last_sample ;
             pdldest->nextrec_tag = q->backup_tag ;
             pdldest->lastrec_tag = q->last_timetag ;
@@ -961,7 +963,7 @@ begin
                   q->calstat = plsrc->cstat ;
                   q->calinc = plsrc->cinc ;
                   q->com->records_written = plsrc->rec_written ;
-                  q->arc.records_written = plsrc->arec_written ;
+                  q->cold->arc.records_written = plsrc->arec_written ;
                   q->gen_next = plsrc->gnext ;
                   q->com->last_sample = plsrc->last_sample ;
                   q->backup_tag = plsrc->nextrec_tag ;
@@ -1225,7 +1227,7 @@ begin
       pldest->cinc = q->calinc ;
       pldest->qpad = 0 ;
       pldest->rec_written = q->com->records_written ;
-      pldest->arec_written = q->arc.records_written ;
+      pldest->arec_written = q->cold->arc.records_written ;
       pldest->gnext = q->gen_next ;
       pldest->last_sample = q->com->last_sample ;
       pldest->nextrec_tag =q-> backup_tag ;
@@ -22,11 +22,12 @@ Edit History:
    -- ---------- --- ---------------------------------------------------
     0 2006-09-28 rdr Created
     1 2007-01-08 hjs Prefaced some functions with lib330_ to avoid collisions
+    2 2026-10-19 gns Add fixed layout field codecs.
 */
 #ifndef libcvrt_h
 /* Flag this file as included */
 #define libcvrt_h
-#define VER_LIBCVRT 2
+#define VER_LIBCVRT 3
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -52,4 +53,87 @@ extern void loadstring (pbyte *p, integer fieldwidth, string *) ;
 extern void loadmac (pbyte *p, tsix *mac) ;
 extern void loadblock (pbyte *p, integer size, pointer pdest) ;
 
+/* Fixed layout codecs. A wire structure with a fixed layout is described once
+  as a list of F(kind, offset, width, field) entries, from which CVRT_STORE and
+  CVRT_LOAD expand to straight line code with constant offsets, using "wire"
+  as the buffer and "rec" as the structure pointer. Width is only used by the
+  array kinds (element count) and by BLOCK and STRING (byte count). Nothing is
+  advanced, the caller moves its pointer on by the size of the layout. */
+#define CVRT_STORE(kind, offset, width, field) cvrt_put_##kind (wire, offset, width, rec->field) ;
+#define CVRT_LOAD(kind, offset, width, field) cvrt_get_##kind (wire, offset, width, rec->field) ;
+
+#define cvrt_put_BYTE(b, o, n, v) (b)[o] = (byte)(v)
+#define cvrt_put_CHAR(b, o, n, v) (b)[o] = (byte)(v)
+#define cvrt_put_WORD(b, o, n, v) cvrt_put16 ((b) + (o), (word)(v))
+#define cvrt_put_INT16(b, o, n, v) cvrt_put16 ((b) + (o), (word)(v))
+#define cvrt_put_LONGWORD(b, o, n, v) cvrt_put32 ((b) + (o), (longword)(v))
+#define cvrt_put_LONGINT(b, o, n, v) cvrt_put32 ((b) + (o), (longword)(v))
+#define cvrt_put_BLOCK(b, o, n, v) memcpy((b) + (o), addr(v), n)
+
+#define cvrt_get_BYTE(b, o, n, v) (v) = (b)[o]
+#define cvrt_get_CHAR(b, o, n, v) (v) = (char)(b)[o]
+#define cvrt_get_WORD(b, o, n, v) (v) = cvrt_get16 ((b) + (o))
+#define cvrt_get_INT16(b, o, n, v) (v) = (int16)cvrt_get16 ((b) + (o))
+#define cvrt_get_LONGWORD(b, o, n, v) (v) = cvrt_get32 ((b) + (o))
+#define cvrt_get_LONGINT(b, o, n, v) (v) = (longint)cvrt_get32 ((b) + (o))
+#define cvrt_get_BLOCK(b, o, n, v) memcpy(addr(v), (b) + (o), n)
+#define cvrt_get_WORDS(b, o, n, v) cvrt_getn16 ((b) + (o), n, (pword)(v))
+#define cvrt_get_INT16S(b, o, n, v) cvrt_getn16 ((b) + (o), n, (pword)(v))
+#define cvrt_get_LONGWORDS(b, o, n, v) cvrt_getn32 ((b) + (o), n, (longword *)(v))
+#define cvrt_get_LONGINTS(b, o, n, v) cvrt_getn32 ((b) + (o), n, (longword *)(v))
+/* same word order as loadlongword into a t64 has always used */
+#ifdef ENDIAN_LITTLE
+#define cvrt_get_T64(b, o, n, v) (v)[1] = cvrt_get32 ((b) + (o)), (v)[0] = cvrt_get32 ((b) + (o) + 4)
+#else
+#define cvrt_get_T64(b, o, n, v) (v)[0] = cvrt_get32 ((b) + (o)), (v)[1] = cvrt_get32 ((b) + (o) + 4)
+#endif
+#define cvrt_get_STRING(b, o, n, v) memcpy(v, (b) + (o), n), lib330_strpcopy ((pchar)(v), (pchar)(v))
+
+/* Network order at any alignment, compilers turn these into a single load or
+  store and a byte swap */
+static __inline void cvrt_put16 (pbyte b, word w)
+begin
+
+  b[0] = (byte)(w shr 8) ;
+  b[1] = (byte)w ;
+end
+
+static __inline void cvrt_put32 (pbyte b, longword lw)
+begin
+
+  b[0] = (byte)(lw shr 24) ;
+  b[1] = (byte)(lw shr 16) ;
+  b[2] = (byte)(lw shr 8) ;
+  b[3] = (byte)lw ;
+end
+
+static __inline word cvrt_get16 (pbyte b)
+begin
+
+  return (word)((b[0] shl 8) or b[1]) ;
+end
+
+static __inline longword cvrt_get32 (pbyte b)
+begin
+
+  return ((longword)b[0] shl 24) or ((longword)b[1] shl 16) or
+         ((longword)b[2] shl 8) or (longword)b[3] ;
+end
+
+static __inline void cvrt_getn16 (pbyte b, integer count, pword dest)
+begin
+  integer i ;
+
+  for (i = 0 ; i < count ; i++)
+    dest[i] = cvrt_get16 (b + 2 * i) ;
+end
+
+static __inline void cvrt_getn32 (pbyte b, integer count, longword *dest)
+begin
+  integer i ;
+
+  for (i = 0 ; i < count ; i++)
+    dest[i] = cvrt_get32 (b + 4 * i) ;
+end
+
 #endif
@@ -28,6 +28,12 @@ Edit History:
     4 2009-09-17 jms fix timeout msg. add BALER44 condx for ARM double storage.
                      report secs since Q330 reboot, not dss server.
     5 2010-01-04 rdr Use fcntl instead of ioctl to set socket non-blocking.
+    6 2026-10-19 gns Replace best-fit free list with segregated size classes, report
+                     fragmentation statistics.
+    7 2026-10-19 gns Never leave a free block too small for its header, fix report formats.
+    8 2026-10-19 gns Merge adjacent free blocks when the arena is exhausted. Keep the
+                     client list links valid when the head client is removed, and the
+                     report list head when a new first report is refused.
 */
 #ifndef OMIT_SEED /* Can't use without seed generation */
 #ifndef OMIT_NETWORK /* or without network */
@@ -59,7 +65,10 @@ Edit History:
 #define RPT_ALLOC 3 /* show memory allocations */
 #define RPT_ALLMEM 4 /* all memory allocations */
 #define DEF_CHUNKSIZE 16384 /* how much to get using getmem */
-#define MIN_FRAG 32 /* minimum size of left memory segment to create a new segment */
+#define DSS_GRAIN 16 /* size class granularity, must be a power of two */
+#define DSS_CLASSES 32 /* number of size classes */
+#define DSS_MAXBLOCK ((DSS_CLASSES - 1) * DSS_GRAIN) /* largest block that can be requested */
+#define DSS_MINBLOCK ((sizeof(tmemory) + DSS_GRAIN - 1) and (not (DSS_GRAIN - 1))) /* smallest block that holds a free list header */
 #define BYTE_INTERVAL 10 /* interval over which to measure bytes transmitted */
 #define FLAG_INT 1 /* just get data at the interval */
 #define FLAG_CON 2 /* continuously get new data from server */
@@ -236,8 +245,15 @@ typedef struct {
 #else
   struct sockaddr dsockin, sock ; /* dss address descriptors */
 #endif
-  pmemory free ;       /* head of free memory list */
+  pmemory classes[DSS_CLASSES] ; /* free lists by size class */
+  integer class_count[DSS_CLASSES] ; /* number of blocks in each free list */
+  pbyte chunk ;        /* unallocated tail of current chunk */
+  integer chunk_left ; /* bytes left in current chunk */
   integer total ;      /* total memory obtained from system */
+  integer in_use ;     /* memory currently allocated */
+  integer peak ;       /* highest value of in_use */
+  integer failures ;   /* requests that could not be satisfied */
+  boolean merged ;     /* free blocks merged and none freed since */
   integer mem_allowed ; /* memory allowed to be used */
   longint client_timeout ;  /* number of seconds without DSS_TOR */
   longint maxbps ;     /* maximum bytes per second */
@@ -264,172 +280,289 @@ typedef struct {
 } tdssstr ;
 typedef tdssstr *pdssstr ;
 
-/* try to find smallest free segment that is big enough and
-   return, else return NIL */
-static pmemory scan (pdssstr dssstr, integer sz, integer *smallest)
+/* Pop a free block off a size class list */
+static pmemory class_pop (pdssstr dssstr, integer cls)
 begin
-  pmemory mscan, smaller ;
+  pmemory pt ;
 
-  *smallest = 0 ;
-  smaller = NIL ;
-  mscan = dssstr->free ;
-  while (mscan)
+  pt = dssstr->classes[cls] ;
+  if (pt)
+    then
+      begin
+        dssstr->classes[cls] = pt->next ;
+        dec(dssstr->class_count[cls]) ;
+      end
+  return pt ;
+end
+
+/* Push a block onto the free list for its size class, the block must be at least
+  DSS_MINBLOCK long. Free blocks are not merged back together until the arena
+  is exhausted, see merge_free, until then a block keeps the size it was first
+  carved or split at. DSS only ever asks for a handful of structure sizes, so
+  the classes settle on those and are reused rather than fragmenting further */
+static void class_push (pdssstr dssstr, pmemory pt, integer sz)
+begin
+  integer cls ;
+
+  cls = sz div DSS_GRAIN ;
+  pt->size = sz ;
+  pt->prev = NIL ;
+  pt->next = dssstr->classes[cls] ;
+  dssstr->classes[cls] = pt ;
+  inc(dssstr->class_count[cls]) ;
+end
+
+/* Hand a run of free memory to the class lists in the largest blocks
+  allowed, a tail too small to hold a header is abandoned */
+static void carve_free (pdssstr dssstr, pbyte p, integer lth)
+begin
+  integer sz ;
+
+  while (lth >= (integer)DSS_MINBLOCK)
     begin
-      if ((mscan->size >= sz) land ((smaller == NIL) lor (mscan->size < *smallest)))
+      sz = lth ;
+      if (sz > DSS_MAXBLOCK)
         then
-          begin
-            *smallest = mscan->size ;
-            smaller = mscan ;
-          end
-      mscan = mscan->next ;
+          sz = DSS_MAXBLOCK ;
+      if (((lth - sz) > 0) land ((lth - sz) < (integer)DSS_MINBLOCK))
+        then
+          decn(sz, DSS_MINBLOCK) ; /* leave enough for one more block */
+      class_push (dssstr, (pmemory)p, sz) ;
+      incn(p, sz) ;
+      decn(lth, sz) ;
+    end
+end
+
+/* Hand whatever is left of the current chunk to the class lists */
+static void retire_chunk (pdssstr dssstr)
+begin
+
+  carve_free (dssstr, dssstr->chunk, dssstr->chunk_left) ;
+  dssstr->chunk_left = 0 ;
+end
+
+/* Sort a list of free blocks into address order */
+static pmemory sort_free (pmemory list)
+begin
+  pmemory a, b, pt, tail ;
+  tmemory head ;
+
+  if ((list == NIL) lor (list->next == NIL))
+    then
+      return list ;
+  a = NIL ;
+  b = NIL ;
+  while (list)
+    begin /* deal alternately onto two lists */
+      pt = list ;
+      list = list->next ;
+      pt->next = a ;
+      a = b ;
+      b = pt ;
     end
-  return smaller ;
+  a = sort_free (a) ;
+  b = sort_free (b) ;
+  tail = addr(head) ;
+  while (a land b)
+    if ((pbyte)a < (pbyte)b)
+      then
+        begin
+          tail->next = a ;
+          tail = a ;
+          a = a->next ;
+        end
+      else
+        begin
+          tail->next = b ;
+          tail = b ;
+          b = b->next ;
+        end
+  if (a)
+    then
+      tail->next = a ;
+    else
+      tail->next = b ;
+  return head.next ;
+end
+
+/* The arena is exhausted, put free blocks that lie next to each other back
+  together so that a larger class can be served again. Without this a burst
+  of small reports can leave the arena in pieces too small for a client.
+  Returns TRUE if any blocks were merged */
+static boolean merge_free (pdssstr dssstr)
+begin
+  pmemory list, run ;
+  integer c, before, after, lth ;
+
+  if (dssstr->merged)
+    then
+      return FALSE ; /* nothing freed since the last time */
+  dssstr->merged = TRUE ;
+  list = NIL ;
+  before = 0 ;
+  for (c = 0 ; c < DSS_CLASSES ; c++)
+    while (dssstr->classes[c])
+      begin
+        run = class_pop (dssstr, c) ;
+        run->next = list ;
+        list = run ;
+        inc(before) ;
+      end
+  list = sort_free (list) ;
+  while (list)
+    begin
+      run = list ;
+      lth = 0 ;
+      repeat
+        incn(lth, list->size) ;
+        list = list->next ;
+      until ((list == NIL) lor ((pbyte)list != ((pbyte)run + lth)))) ;
+      carve_free (dssstr, (pbyte)run, lth) ;
+    end
+  after = 0 ;
+  for (c = 0 ; c < DSS_CLASSES ; c++)
+    incn(after, dssstr->class_count[c]) ;
+  return (after < before) ;
 end
 
 /* Return pointer to memory segment at least sz bytes long, or NIL
-  if not available */
+  if not available. Requests are rounded to a size class and served
+  from that class's free list, the tail of the current chunk, or by
+  splitting the smallest larger free block, in that order */
 static pmemory memreq (pdssstr dssstr, integer sz)
 begin
-  pmemory mscan, oldnext, oldprev, mend ;
-  integer oldsize ;
-  pmemory smallpt, mpt, ret ;
-  integer smallest, msize;
+  pmemory ret ;
+  integer cls, c, msize ;
+  pbyte mpt ;
   string63 s ;
 
-  sz = (sz + 3) and 0xFFFFFFFC ;
+  sz = (sz + DSS_GRAIN - 1) and (not (DSS_GRAIN - 1)) ;
+  if (sz < (integer)DSS_MINBLOCK)
+    then
+      sz = DSS_MINBLOCK ;
   if (dssstr->verbosity >= RPT_ALLMEM)
     then
       begin
         sprintf(s, "DSS Memory Request for %d  Bytes", sz) ;
         lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
       end
-  smallpt = scan (dssstr, sz, addr(smallest)) ; /* check for memory in free list */
-  if (smallpt == NIL)
+  if (sz > DSS_MAXBLOCK)
     then
-      begin /* nothing found there */
-        msize = DEF_CHUNKSIZE ;
-        if (msize > (dssstr->mem_allowed - dssstr->total))
-          then
-            msize = dssstr->mem_allowed - dssstr->total ;
-        if (msize < 1024)
-          then
-            return NIL ; /* can't allocate a usable amount */
-        getbuf (dssstr->q330, addr(mpt), msize) ;
-        incn(dssstr->total, msize) ;
-        if (dssstr->verbosity >= RPT_ALLOC)
+      begin
+        inc(dssstr->failures) ;
+        return NIL ;
+      end
+  cls = sz div DSS_GRAIN ;
+  ret = class_pop (dssstr, cls) ;
+  if ((ret == NIL) land (dssstr->chunk_left < sz))
+    then
+      begin /* split the smallest larger free block */
+        for (c = cls + 1 ; c < DSS_CLASSES ; c++)
+          if (dssstr->classes[c])
+            then
+              begin
+                ret = class_pop (dssstr, c) ;
+                if (((c - cls) * DSS_GRAIN) >= (integer)DSS_MINBLOCK)
+                  then
+                    class_push (dssstr, (pmemory)((pbyte)ret + sz), (c - cls) * DSS_GRAIN) ;
+                  else
+                    sz = c * DSS_GRAIN ; /* remainder stays with the block */
+                break ;
+              end
+        if (ret == NIL)
           then
-            begin
-              sprintf(s, "Total DSS Memory=%d", dssstr->total) ;
-              lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
-            end
-        mscan = dssstr->free ;
-        while (mscan) /* check for contiguous with other free memory */
-          begin
-            mend = (pointer)((uninteger)mscan + mscan->size) ;
-            if (mend == mpt)
-              then
-                begin /* mpt follows mscan */
-                  mscan->size = mscan->size + msize ;
-                  mpt = NIL ; /* used up */
-                  break ;
-                end
-            else if ((pointer)((uninteger)mpt + msize) == mscan)
-              then
-                begin /* mpt preceeds mscan */
-                  if (mscan->prev)
-                    then
-                      mscan->prev->next = mpt ;
-                  if (mscan->next)
-                    then
-                      mscan->next->prev = mpt ;
-                  mpt->size = msize + mscan->size ;
-                  mpt->next = mscan->next ;
-                  mpt->prev = mscan->prev ;
-                  mpt = NIL ;
-                  break ;
-                end
-            mscan = mscan->next ;
-          end
-        if (mpt)
-          then /* not contiguous, add to beginning of free list */
-            begin
-              if (dssstr->free == NIL)
+            begin /* nothing free, get a new chunk */
+              msize = DEF_CHUNKSIZE ;
+              if (msize > (dssstr->mem_allowed - dssstr->total))
+                then
+                  msize = dssstr->mem_allowed - dssstr->total ;
+              if (msize < 1024)
                 then
-                  mpt->next = NIL ;
-                else
                   begin
-                    dssstr->free->prev = mpt ;
-                    mpt->next = dssstr->free ;
+                    if (merge_free (dssstr))
+                      then
+                        return memreq (dssstr, sz) ; /* try again */
+                    inc(dssstr->failures) ;
+                    return NIL ; /* can't allocate a usable amount */
+                  end
+              retire_chunk (dssstr) ;
+              getbuf (dssstr->q330, addr(mpt), msize) ;
+              incn(dssstr->total, msize) ;
+              dssstr->chunk = mpt ;
+              dssstr->chunk_left = msize ;
+              if (dssstr->verbosity >= RPT_ALLOC)
+                then
+                  begin
+                    sprintf(s, "Total DSS Memory=%d", (int)dssstr->total) ;
+                    lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
                   end
-              dssstr->free = mpt ;
-              mpt->size = msize ;
-              mpt->prev = NIL ;
             end
-        smallpt = scan (dssstr, sz, addr(smallest)) ; /* now check, should be enough now */
-      end
-  if (smallpt == NIL)
-    then
-      return NIL ; /* guess not */
-  ret = smallpt ; /* before we skip what we just allocated */
-  oldnext = smallpt->next ;
-  oldprev = smallpt->prev ;
-  oldsize = smallpt->size ;
-  memset (smallpt, 0, sz) ; /* clear header and block */
-  if ((smallest - sz) >= MIN_FRAG)
-    then
-      begin /* keep leftover fragment */
-        smallpt->size = sz ; /* new size of this segment */
-        smallpt = (pointer)((uninteger)smallpt + sz) ; /* memory left over */
-        smallpt->size = oldsize - sz ;
-        smallpt->next = oldnext ;
-        smallpt->prev = oldprev ;
-        if (oldprev)
-          then
-            oldprev->next = smallpt ;
-          else
-            dssstr->free = smallpt ;
-        if (oldnext)
-          then
-            oldnext->prev = smallpt ;
       end
-    else
-      begin /* use all of memory fragment */
-        smallpt->size = oldsize ; /* restore size after clearing block */
-        if (oldprev)
-          then
-            oldprev->next = oldnext ;
-          else
-            dssstr->free = oldnext ;
-        if (oldnext)
+  if (ret == NIL)
+    then
+      begin /* carve from the current chunk */
+        ret = (pmemory)dssstr->chunk ;
+        if (((dssstr->chunk_left - sz) < (integer)DSS_MINBLOCK) land ((dssstr->chunk_left - sz) > 0) land
+            (dssstr->chunk_left <= DSS_MAXBLOCK))
           then
-            oldnext->prev = oldprev ;
+            sz = dssstr->chunk_left ; /* remainder stays with the block */
+        incn(dssstr->chunk, sz) ;
+        decn(dssstr->chunk_left, sz) ;
       end
+  memset (ret, 0, sz) ; /* clear header and block */
+  ret->size = sz ;
+  incn(dssstr->in_use, sz) ;
+  if (dssstr->in_use > dssstr->peak)
+    then
+      dssstr->peak = dssstr->in_use ;
   return ret ;
 end
 
+/* report memory usage and fragmentation of the free lists */
 static void count_blocks (pdssstr dssstr)
 begin
-  pmemory mscan ;
-  integer count, total ;
+  integer c, count, total, frag ;
   string95 s ;
+  string15 s1 ;
 
   count = 0 ;
   total = 0 ;
-  mscan = dssstr->free ;
-  while (mscan)
+  for (c = 1 ; c < DSS_CLASSES ; c++)
     begin
-      inc(count) ;
-      total = total + mscan->size ;
-      mscan = mscan->next ;
+      incn(count, dssstr->class_count[c]) ;
+      incn(total, dssstr->class_count[c] * c * DSS_GRAIN) ;
     end
-  sprintf(s, "%d DSS Free Blocks with size of %d", count, total) ;
+  if ((dssstr->total - dssstr->chunk_left) > 0)
+    then
+      frag = (total * 100) div (dssstr->total - dssstr->chunk_left) ;
+    else
+      frag = 0 ;
+  sprintf(s, "DSS Memory=%d Used=%d Peak=%d Unused=%d Failed=%d", (int)dssstr->total,
+          (int)dssstr->in_use, (int)dssstr->peak, (int)dssstr->chunk_left, (int)dssstr->failures) ;
   lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
+  sprintf(s, "%d DSS Free Blocks with size of %d, %d%% Fragmented", (int)count, (int)total, (int)frag) ;
+  lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
+  if ((count) land (dssstr->verbosity >= RPT_ALLMEM))
+    then
+      begin /* free blocks by size class */
+        strcpy (s, "DSS Free Classes:") ;
+        for (c = 1 ; c < DSS_CLASSES ; c++)
+          if (dssstr->class_count[c])
+            then
+              begin
+                sprintf(s1, " %d*%d", (int)(c * DSS_GRAIN), (int)dssstr->class_count[c]) ;
+                if ((strlen(s) + strlen(s1)) > 95)
+                  then
+                    break ;
+                strcat(s, s1) ;
+              end
+        lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s)) ;
+      end
 end
 
-/* return memory segment to free list, merging if possible */
+/* return memory segment to the free list for its size class */
 static void mem_free (pdssstr dssstr, pmemory pt)
 begin
-  pmemory mscan, mend, previous ;
   string63 s ;
 
   if (dssstr->verbosity >= RPT_ALLMEM)
@@ -445,87 +578,9 @@ begin
   if (pt->next)
     then
       pt->next->prev = pt->prev ;
-  previous = NIL ;
- /* see if adjoins existing segment */
-  mend = (pointer)((uninteger)pt + pt->size) ; /* end of this segment */
-  mscan = dssstr->free ;
-  while (mscan)
-    begin
-      if (mscan == mend)
-        then
-          begin /* returned segment just before scanned segment */
-            if (mscan->prev)
-              then
-                mscan->prev->next = pt ;
-              else
-                dssstr->free = pt ;
-            if (mscan->next)
-              then
-                mscan->next->prev = pt ;
-            pt->size = pt->size + mscan->size ;
-            pt->next = mscan->next ;
-            pt->prev = mscan->prev ;
-            return ;
-          end
-      else if ((pointer)((uninteger)mscan + mscan->size) == pt)
-        then
-          begin /* returned segment follows scanned segment */
-            mscan->size = mscan->size + pt->size ;
-            return ;
-          end
-      else if ((uninteger)mscan < (uninteger)pt)
-        then
-          previous = mscan ;
-      mscan = mscan->next ;
-    end
-  /* if it gets here, it is not contiguous with another segment,
-    add it to the free list */
-  if (previous)
-    then
-      begin
-        pt->next = previous->next ;
-        if (previous->next)
-          then
-            previous->next->prev = pt ;
-        previous->next = pt ;
-        pt->prev = previous ;
-      end
-    else
-      begin /* beginning of list */
-        if (dssstr->free == NIL)
-          then
-            pt->next = NIL ;
-          else
-            begin
-              dssstr->free->prev = pt ;
-              pt->next = dssstr->free ;
-            end
-        dssstr->free = pt ;
-        pt->prev = NIL ;
-      end
-  if (dssstr->verbosity >= RPT_ALLMEM)
-    then
-      count_blocks (dssstr) ;
-end
-
-static void compact_memory (pdssstr dssstr)
-begin
-  pmemory mscan, mend, mnext ;
-
-  mscan = dssstr->free ;
-  while ((mscan) land (mscan->next))
-    begin
-      mend = (pointer)((uninteger)mscan + mscan->size) ;
-      mnext = mscan->next ;
-      if (mend == mnext)
-        then
-          begin /* merge them */
-            mscan->next = mnext->next ;
-            mscan->size = mscan->size + mnext->size ;
-          end
-        else
-          mscan = mnext ; /* try next pair */
-    end
+  decn(dssstr->in_use, pt->size) ;
+  class_push (dssstr, pt, pt->size) ;
+  dssstr->merged = FALSE ;
   if (dssstr->verbosity >= RPT_ALLMEM)
     then
       count_blocks (dssstr) ;
@@ -657,12 +712,19 @@ begin
     if (dssstr->clients[cp] == pcli)
       then
         begin
-          dssstr->clients[cp] = (pdss_client)((dssstr->clients[cp])->memory.next) ;
+          dssstr->clients[cp] = (pdss_client)(pcli->memory.next) ;
+          if (dssstr->clients[cp])
+            then
+              dssstr->clients[cp]->memory.prev = (pmemory)(dssstr->clients[cp]) ; /* head points to itself */
+          pcli->memory.next = NIL ; /* already unlinked */
+          pcli->memory.prev = NIL ;
           break ;
         end
   /* remove memory */
   mem_free (dssstr, addr(pcli->memory)) ;
-  compact_memory (dssstr) ; /* good time to clean up free list */
+  if (dssstr->verbosity >= RPT_ALLOC)
+    then
+      count_blocks (dssstr) ; /* good time to show fragmentation */
 end
 
 static void storedsshdr (pbyte *p, tqdp *hdr)
@@ -1400,6 +1462,7 @@ begin
         lib_msg_add(dssstr->q330, AUXMSG_DSS, 0, addr(s2)) ;
       end
   /* try to reconnect now */
+  lastpt = (pdss_report)(newreq->memory.next) ; /* in case it is removed */
   switch (newreq->reqcode) begin
     case REQ_BOOT :
     case REQ_GPS :
@@ -1422,8 +1485,14 @@ begin
       recon_sqr (dssstr, newreq) ;
       break ;
   end
-  if (lnot dssstr->refused)
+  if (dssstr->refused)
     then
+      begin /* report was removed */
+        if (pcli->head == newreq)
+          then
+            pcli->head = lastpt ;
+      end
+    else
       ack (dssstr) ; /* if it got here, it must have been ok */
 end
 
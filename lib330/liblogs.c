@@ -24,6 +24,9 @@ Edit History:
     1 2008-01-03 rdr Add log_timer handling.
     2 2008-03-13 rdr Don't reset records_written at 999999.
     3 2010-08-08 rdr In spad protect against negative length difference.
+    4 2026-10-19 gns Seed times filled straight from the cached calendar with
+                     convert_seed_time.
+    5 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
 */
 #ifndef liblogs_h
 #include "liblogs.h"
@@ -112,17 +115,14 @@ end
 
 static void fix_time (tseed_time *st)
 begin
-  tsystemtime greg ;
   longint usec ;
 
-  convert_time (st->seed_fpt, addr(greg), addr(usec)) ;
-  lib330_seed_time (st, addr(greg), usec) ;
+  convert_seed_time (st->seed_fpt, st, addr(usec)) ;
 end
 
 void log_clock (pq330 q330, enum tclock_exception clock_exception, string95 *jump_amount)
 begin
   string s ;
-  tsystemtime newtime ;
   longint newusec ;
   integer i ;
   paqstruc paqs ;
@@ -170,8 +170,7 @@ begin
   ptim->blockette_type = 500 ;
   ptim->next_blockette = 0 ;
   ptim->vco_correction = q330->share.stat_global.cur_vco / 40.96 ;
-  convert_time (paqs->data_timetag, addr(newtime), addr(newusec)) ;
-  lib330_seed_time (addr(ptim->time_of_exception), addr(newtime), newusec) ;
+  convert_seed_time (paqs->data_timetag, addr(ptim->time_of_exception), addr(newusec)) ;
   ptim->usec99 = newusec mod 100 ;
   ptim->reception_quality = paqs->data_qual ;
   ptim->exception_count = paqs->except_count ;
@@ -208,8 +207,8 @@ begin
         p = addr(pcom->ring->rec) ;
         storeseedhdr (addr(p), phdr, FALSE) ;
         storetiming (addr(p), ptim) ;
-        inc(q->records_generated_session) ;
-        q->last_record_generated = secsince () ;
+        inc(q->cold->records_generated_session) ;
+        q->cold->last_record_generated = secsince () ;
         send_to_client (paqs, q, pcom->ring, SCD_BOTH) ;
       end
     else
@@ -260,8 +259,8 @@ begin
   p = addr(pcom->ring->rec) ;
   storeseedhdr (addr(p), addr(pcom->ring->hdr_buf), FALSE) ;
   storetiming (addr(p), ptim) ;
-  inc(q->records_generated_session) ;
-  q->last_record_generated = secsince () ;
+  inc(q->cold->records_generated_session) ;
+  q->cold->last_record_generated = secsince () ;
   send_to_client (paqs, paqs->tim_lcq, pcom->ring, SCD_BOTH) ;
 end
 
@@ -273,7 +272,7 @@ begin
   if ((q == NIL) lor (q->com->ring == NIL))
     then
       return ;
-  if ((q->arc.amini_filter) land (q->arc.total_frames > 0))
+  if ((q->cold->arc.amini_filter) land (q->cold->arc.total_frames > 0))
     then
       flush_archive (paqs, q) ;
 end
@@ -538,7 +537,7 @@ begin
             q = paqs->mdispatch[idx][sub] ;
             while (q)
               begin
-                inc(q->calibrations_session) ;
+                inc(q->cold->calibrations_session) ;
                 if (q->lcq_opt and LO_CALP)
                   then
                     begin
@@ -582,8 +581,8 @@ begin
         q330->nested_log = TRUE ;
         p = addr(pcom->ring->rec) ;
         storeseedhdr (addr(p), phdr, FALSE) ;
-        inc(q->records_generated_session) ;
-        q->last_record_generated = secsince () ;
+        inc(q->cold->records_generated_session) ;
+        q->cold->last_record_generated = secsince () ;
         send_to_client (paqs, q, pcom->ring, SCD_BOTH) ;
         q330->nested_log = FALSE ;
         pcom->frame = 0 ;
@@ -645,13 +644,13 @@ begin
         q330->nested_log = TRUE ;
         p = addr(pcom->ring->rec) ;
         storeseedhdr (addr(p), phdr, FALSE) ;
-        inc(q->records_generated_session) ;
-        q->last_record_generated = secsince () ;
+        inc(q->cold->records_generated_session) ;
+        q->cold->last_record_generated = secsince () ;
         send_to_client (paqs, q, pcom->ring, SCD_BOTH) ;
         q330->nested_log = FALSE ;
         pcom->frame = 0 ;
       end
-  if ((q->arc.amini_filter) land (q->arc.hdr_buf.samples_in_record))
+  if ((q->cold->arc.amini_filter) land (q->cold->arc.hdr_buf.samples_in_record))
     then
       flush_archive (paqs, q) ;
   paqs->log_timer = 0 ;
@@ -27,7 +27,7 @@ Edit History:
 #ifndef liblogs_h
 /* Flag this file as included */
 #define liblogs_h
-#define VER_LIBLOGS 3
+#define VER_LIBLOGS 5
 
 #ifndef OMIT_SEED
 /* Make sure libtypes.h is included */
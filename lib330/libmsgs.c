@@ -31,6 +31,14 @@ Edit History:
     8 2009-09-28 rdr Add AUXMSG_DSS.
     9 2010-03-27 rdr Add messages for Q335.
    10 2010-08-21 rdr Change order of evaluation in msgadd and dump_msgqueue. 
+   11 2026-10-19 gns Add packet capture and replay messages.
+   12 2026-10-19 gns Add libpktmsg, recording packet level debug as binary events in a
+                     ring without locking or formatting, lib_event_string to format them
+                     for a reader and flush_msgring to pass them to the message log.
+   13 2026-10-19 gns Add cached token messages.
+   14 2026-10-19 gns Add LIBMSG_TOKSEG.
+   15 2026-10-19 gns Count the events read_msgring skips when the ring has lapped the
+                     reader, and report them from flush_msgring.
 */
 #ifndef libmsgs_h
 #include "libmsgs.h"
@@ -59,6 +67,7 @@ begin
         case LIBMSG_GENDBG : strcpy(s, "") ; /* generic, all info in suffix */ break ;
         case LIBMSG_PKTIN : strcpy(s, "Recv") ; break ;
         case LIBMSG_PKTOUT : strcpy(s, "Sent") ; break ;
+        case LIBMSG_PKTLOST : strcpy(s, "Packet trace events lost=") ; break ;
       end
       break ;
     case 1 : /* informational */
@@ -112,6 +121,11 @@ begin
         case LIBMSG_BACK : strcpy(s, "Baler Acknowledged by Q330") ; break ;
         case LIBMSG_CONN : strcpy(s, "Connected to TCP Tunnel") ; break ;
         case LIBMSG_Q335 : strcpy(s, "Q335 Architecture Detected") ; break ;
+        case LIBMSG_CAPTURE : strcpy(s, "Capturing packets to ") ; break ;
+        case LIBMSG_REPLAY : strcpy(s, "Replaying packets from ") ; break ;
+        case LIBMSG_REPLAYEND : strcpy(s, "Replay complete, records=") ; break ;
+        case LIBMSG_TOKCACHE : strcpy(s, "DP Tokens taken from cache, size=") ; break ;
+        case LIBMSG_TOKVER : strcpy(s, "Cached DP Tokens match the Q330") ; break ;
       end
       break ;
     case 3 : /* converted Q330 blockettes */
@@ -178,6 +192,8 @@ begin
         case LIBMSG_SEGOVER : strcpy(s, "Segment buffer overflow on ") ; break ;
         case LIBMSG_TCPTUN : strcpy(s, "TCP Tunnelling error: ") ; break ;
         case LIBMSG_HFRATE : strcpy(s, "Sampling Rate mis-match ") ; break ;
+        case LIBMSG_CAPERR : strcpy(s, "Packet capture error: ") ; break ;
+        case LIBMSG_TOKSEG : strcpy(s, "Bad DP Token segment") ; break ;
       end
       break ;
     case 6 :
@@ -306,6 +322,162 @@ begin
   msgadd (q330, msgcode, dt, msgsuf, FALSE) ;
 end
 
+/* Packet level debug. Only the lib330 thread writes events, readers copy them
+  out and check the event number again afterwards to spot one overwritten
+  while it was being copied. */
+void libpktmsg (pq330 q330, word msgcode, byte flags, longword dsn, longword *acks)
+begin
+  tmsgring *ring ;
+  tmsgevent *ev ;
+  longword number ;
+
+  ring = addr(q330->msgring) ;
+  number = ring->head + 1 ;
+  ev = addr(ring->events[number and (MSGRING_SIZE - 1)]) ;
+  ev->number = 0 ; /* not valid while being filled in */
+  MEMBARRIER() ;
+  ev->code = msgcode ;
+  ev->command = q330->recvhdr.command ;
+  ev->flags = flags ;
+  ev->timestamp = now () ;
+  ev->datalength = q330->recvhdr.datalength ;
+  ev->sequence = q330->recvhdr.sequence ;
+  ev->acknowledge = q330->recvhdr.acknowledge ;
+  ev->dsn = dsn ;
+  if (acks)
+    then
+      memcpy(addr(ev->acks), acks, sizeof(ev->acks)) ;
+  MEMBARRIER() ;
+  ev->number = number ;
+  ring->head = number ;
+end
+
+/* Copy out event number *next, or the oldest one still held if that has been
+  overwritten, and move *next on past it. The copy's lost says how many events
+  were overwritten before they could be read. Returns FALSE if there is nothing newer */
+boolean read_msgring (pq330 q330, longword *next, tmsgevent *event)
+begin
+  tmsgring *ring ;
+  tmsgevent *ev ;
+  longword head, number, wanted ;
+
+  ring = addr(q330->msgring) ;
+  wanted = *next ;
+  if (wanted == 0)
+    then
+      wanted = 1 ;
+  repeat
+    head = ring->head ;
+    MEMBARRIER() ;
+    number = wanted ;
+    if ((head >= MSGRING_SIZE) land (number <= head - MSGRING_SIZE))
+      then
+        number = head - MSGRING_SIZE + 1 ;
+    if (number > head)
+      then
+        return FALSE ;
+    ev = addr(ring->events[number and (MSGRING_SIZE - 1)]) ;
+    memcpy(event, ev, sizeof(tmsgevent)) ;
+    MEMBARRIER() ;
+  until (event->number == number) land (ev->number == number)) ;
+  event->lost = number - wanted ;
+  *next = number + 1 ;
+  return TRUE ;
+end
+
+/* Format the suffix text for an event, the same as was once built for each
+  packet. An acknowledge map can need several lines, *part starts at zero and
+  is set to -1 after the last. Returns NIL if there is no line to show */
+char *lib_event_string (tmsgevent *event, integer *part, pchar result)
+begin
+  string95 s1 ;
+  integer j ;
+  boolean added ;
+
+  packet_time ((longint)event->timestamp, result) ;
+  strcat (result, command_name (event->command, addr(s1))) ;
+  if (lnot (event->flags and PEV_ACKS))
+    then
+      begin
+        *part = -1 ;
+        if (event->flags and PEV_DSN)
+          then
+            begin
+              sprintf(s1, ", Lth=%d Seq=%d DSN=%d", event->datalength, event->sequence,
+                      event->dsn) ;
+              strcat(result, s1) ;
+              if (event->flags and PEV_INSIDE)
+                then
+                  strcat(result, " Inside the Window") ;
+                else
+                  strcat(result, " Outside the Window") ;
+            end
+          else
+            begin
+              sprintf(s1, ", Lth=%d Seq=%d Ack=%d", event->datalength, event->sequence,
+                      event->acknowledge) ;
+              strcat(result, s1) ;
+            end
+        return result ;
+      end
+  if (*part == 0)
+    then
+      begin
+        sprintf(s1, ", Lth=%d Seq=%d Ack=%d", event->datalength, event->sequence,
+                event->acknowledge) ;
+        strcat(result, s1) ;
+      end
+  strcat(result, ", Acking ") ;
+  added = FALSE ;
+  j = *part ;
+  while (j <= 127)
+    begin
+      if (event->acks[(j shr 5) and 3] and (1 shl (longword)(j and 31)))
+        then
+          begin
+            added = TRUE ;
+            sprintf(s1, "%d,", (int)(event->acknowledge + j)) ;
+            strcat(result, s1) ;
+          end
+      inc(j) ;
+      if (strlen(result) >= 88)
+        then
+          begin
+            *part = j ;
+            return result ;
+          end
+    end
+  *part = -1 ;
+  if (added)
+    then
+      return result ;
+    else
+      return NIL ;
+end
+
+/* Called from lib_timer when packet level debug should also reach the message log */
+void flush_msgring (pq330 q330)
+begin
+  tmsgevent ev ;
+  integer part ;
+  string95 s ;
+
+  while (read_msgring (q330, addr(q330->msgring_out), addr(ev)))
+    begin
+      if (ev.lost)
+        then
+          begin
+            sprintf(s, "%u", (unsigned int)ev.lost) ;
+            libmsgadd (q330, LIBMSG_PKTLOST, addr(s)) ;
+          end
+      part = 0 ;
+      while (part >= 0)
+        if (lib_event_string (addr(ev), addr(part), s))
+          then
+            libmsgadd (q330, ev.code, addr(s)) ;
+    end
+end
+
 char *lib_get_errstr (enum tliberr err, string63 *result)
 begin
   string63 s ;
@@ -25,11 +25,16 @@ Edit History:
     2 2007-03-05 rdr Add LIBMSG_CONPURGE.
     3 2008-01-09 rdr Add dump_msgqueue and AUXMSG_RECV.
     4 2008-08-19 rdr Add TCP support.
+    5 2026-10-19 gns Add packet capture and replay messages.
+    6 2026-10-19 gns Add packet trace events, recorded in binary and formatted when read.
+    7 2026-10-19 gns Add LIBMSG_TOKCACHE and LIBMSG_TOKVER.
+    8 2026-10-19 gns Add LIBMSG_TOKSEG.
+    9 2026-10-19 gns Add LIBMSG_PKTLOST.
 */
 #ifndef libmsgs_h
 /* Flag this file as included */
 #define libmsgs_h
-#define VER_LIBMSGS 10
+#define VER_LIBMSGS 15
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -50,11 +55,13 @@ Edit History:
 #define VERB_REGMSG 4 /* Registration messages */
 #define VERB_LOGEXTRA 8 /* stuff like filter delays */
 #define VERB_AUXMSG 16 /* webserver & netserver messages to seed message log */
-#define VERB_PACKET 32 /* packet level debug */
+#define VERB_PACKET 32 /* packet level debug, recorded as events for lib_msg_event */
+#define VERB_PKTMSG 64 /* also pass packet level debug to the message log and callback */
 /* message codes */
 #define LIBMSG_GENDBG 0
 #define LIBMSG_PKTIN 1
 #define LIBMSG_PKTOUT 2
+#define LIBMSG_PKTLOST 3
 
 #define LIBMSG_WINDOW 100
 #define LIBMSG_USER 101
@@ -102,6 +109,11 @@ Edit History:
 #define LIBMSG_BACK 214
 #define LIBMSG_CONN 215
 #define LIBMSG_Q335 216
+#define LIBMSG_CAPTURE 217
+#define LIBMSG_REPLAY 218
+#define LIBMSG_REPLAYEND 219
+#define LIBMSG_TOKCACHE 220
+#define LIBMSG_TOKVER 221
 
 #define LIBMSG_GPSSTATUS 300
 #define LIBMSG_DIGPHASE 301
@@ -159,6 +171,8 @@ Edit History:
 #define LIBMSG_SEGOVER 522
 #define LIBMSG_TCPTUN 523
 #define LIBMSG_HFRATE 524
+#define LIBMSG_CAPERR 525
+#define LIBMSG_TOKSEG 526
 
 #define LIBMSG_FIXED 600
 #define LIBMSG_GPSIDS 601
@@ -205,5 +219,9 @@ extern char *lib_gps_state (enum tgps_stat gs, string63 *result) ;
 extern char *lib_gps_fix (enum tgps_fix gf, string63 *result) ;
 extern char *lib_pll_state (enum tpll_stat ps, string31 *result) ;
 extern char *lib_acc_types (enum tacctype acctype, string31 *result) ;
+extern void libpktmsg (pq330 q330, word msgcode, byte flags, longword dsn, longword *acks) ;
+extern boolean read_msgring (pq330 q330, longword *next, tmsgevent *event) ;
+extern void flush_msgring (pq330 q330) ;
+extern char *lib_event_string (tmsgevent *event, integer *part, pchar result) ;
 
 #endif
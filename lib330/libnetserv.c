@@ -32,6 +32,10 @@ Edit History:
     5 2008-04-20 rdr Fix missing assignment to err in read_from_client.
     6 2010-01-04 rdr Use fcntl instead of ioctl to set socket non-blocking. Fix setting non-blocking
                      on accepted socket.
+    7 2026-10-19 gns Serve multiple clients from the shared ring with a cursor per client,
+                     batch sends over contiguous ring spans, use epoll on linux.
+    8 2026-10-19 gns Drop a client on any socket error, release the epoll descriptor and
+                     wake pipe if the thread can't be started.
 */
 #ifndef OMIT_SEED /* Can't use without seed generation */
 #ifndef OMIT_NETWORK /* or without network */
@@ -52,6 +56,34 @@ Edit History:
 #include "libstrucs.h"
 #endif
 
+#if defined(linux)
+#include <sys/epoll.h>
+#endif
+#ifndef X86_WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define NS_BATCH 32 /* maximum records handed to one send call */
+#define NS_TIMEOUT 1000 /* ms to wait for events when idle */
+
+typedef struct { /* one connected netserver client */
+#ifdef X86_WIN32
+  SOCKET sockpath ;
+#else
+  integer sockpath ;
+#endif
+  struct sockaddr client ;
+  boolean sockfull ; /* last send failed */
+  boolean holding ; /* sending from hold rather than the ring */
+  integer nsq_out ; /* next record in ring to send */
+  integer partial ; /* bytes of current record already sent */
+  longword dropped ; /* records overwritten before they could be sent */
+  double last_sent ;
+  completed_record hold ; /* record being sent that is no longer in the ring */
+} tns_client ;
+typedef tns_client *pns_client ;
+
 typedef struct {
 #ifdef X86_WIN32
   HANDLE mutex ;
@@ -62,24 +94,25 @@ typedef struct {
   pthread_t threadid ;
 #endif
   boolean running ;
-  boolean haveclient ; /* accepted a client */
   boolean sockopen ;
-  boolean sockfull ; /* last send failed */
   boolean terminate ;
+  boolean wakeup ; /* wakeup already signalled to thread */
   tns_par ns_par ; /* creation parameters */
 #ifdef X86_WIN32
   SOCKET npath ; /* netserv socket */
   struct sockaddr nsockin, nsockout ; /* netserv address descriptors */
-  SOCKET sockpath ;
-  struct sockaddr client ;
 #else
   integer npath ; /* commands socket */
   struct sockaddr nsockin, nsockout ; /* netserv address descriptors */
-  integer sockpath ;
-  struct sockaddr client ;
 #endif
-  integer nsq_in, nsq_out ;
-  double last_sent ;
+#if defined(linux)
+  int epfd ; /* epoll descriptor */
+  int wake[2] ; /* pipe to wake thread when new data arrives */
+#endif
+  integer clientcount ;
+  tns_client clients[MAX_NS_CLIENTS] ;
+  integer nsq_in ; /* next record in ring to fill, shared by all clients */
+  integer nsq_resume ; /* where the next client starts when none are connected */
   completed_record sync_record ;
 } tnsstr ;
 typedef tnsstr *pnsstr ;
@@ -137,8 +170,36 @@ end
 
 #endif
 
+/* Must be called with the mutex held */
+static void close_client (pnsstr nsstr, pns_client pcli)
+begin
+  string63 s ;
+
+#if defined(linux)
+  epoll_ctl (nsstr->epfd, EPOLL_CTL_DEL, pcli->sockpath, NIL) ;
+#endif
+#ifdef X86_WIN32
+  closesocket (pcli->sockpath) ;
+#else
+  close (pcli->sockpath) ;
+#endif
+  pcli->sockpath = INVALID_SOCKET ;
+  pcli->sockfull = FALSE ;
+  dec(nsstr->clientcount) ;
+  if (nsstr->clientcount == 0)
+    then
+      nsstr->nsq_resume = pcli->nsq_out ; /* next client picks up from here */
+  if (pcli->dropped)
+    then
+      sprintf(s, "netserv[%d] port, %u records dropped", nsstr->ns_par.server_number, (unsigned int)pcli->dropped) ;
+    else
+      sprintf(s, "netserv[%d] port", nsstr->ns_par.server_number) ;
+  lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_DISCON, 0, addr(s)) ;
+end
+
 static void close_socket (pnsstr nsstr)
 begin
+  integer i ;
 
   nsstr->sockopen = FALSE ;
   if (nsstr->npath != INVALID_SOCKET)
@@ -151,16 +212,18 @@ begin
 #endif
         nsstr->npath = INVALID_SOCKET ;
       end
-  if (nsstr->sockpath != INVALID_SOCKET)
-    then
-      begin
+  for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+    if (nsstr->clients[i].sockpath != INVALID_SOCKET)
+      then
+        begin
 #ifdef X86_WIN32
-        closesocket (nsstr->sockpath) ;
+          closesocket (nsstr->clients[i].sockpath) ;
 #else
-        close (nsstr->sockpath) ;
+          close (nsstr->clients[i].sockpath) ;
 #endif
-        nsstr->sockpath = INVALID_SOCKET ;
-      end
+          nsstr->clients[i].sockpath = INVALID_SOCKET ;
+        end
+  nsstr->clientcount = 0 ;
 end
 
 static void open_socket (pnsstr nsstr)
@@ -254,11 +317,11 @@ begin
   flag = 1 ;
 #ifdef X86_WIN32
   ioctlsocket (nsstr->npath, FIONBIO, addr(flag)) ;
-  err = listen (nsstr->npath, 1) ;
+  err = listen (nsstr->npath, MAX_NS_CLIENTS) ;
 #else
   flag = fcntl (nsstr->npath, F_GETFL, 0) ;
   fcntl (nsstr->npath, F_SETFL, flag or O_NONBLOCK) ;  
-  err = listen (nsstr->npath, 1) ;
+  err = listen (nsstr->npath, MAX_NS_CLIENTS) ;
 #endif
   if (err)
     then
@@ -295,125 +358,162 @@ begin
   boolean found ;
   string15 hostname ;
   string63 s ;
+  struct sockaddr client ;
   struct sockaddr_in *psock ;
   twhitelist *pwhite ;
-
-  lth = sizeof(struct sockaddr) ;
-  if (nsstr->npath == INVALID_SOCKET)
-    then
-      return ;
+  pns_client pcli ;
 #ifdef X86_WIN32
-  nsstr->sockpath = accept (nsstr->npath, addr(nsstr->client), addr(lth)) ;
+  SOCKET path ;
 #else
-  nsstr->sockpath = accept (nsstr->npath, addr(nsstr->client), addr(lth)) ;
+  integer path ;
 #endif
-  if (nsstr->sockpath == INVALID_SOCKET)
-    then
-      begin
-        err =
+#if defined(linux)
+  struct epoll_event ev ;
+#endif
+
+  repeat /* accept all pending connections */
+    if (nsstr->npath == INVALID_SOCKET)
+      then
+        return ;
+    lth = sizeof(struct sockaddr) ;
+    path = accept (nsstr->npath, addr(client), addr(lth)) ;
+    if (path == INVALID_SOCKET)
+      then
+        begin
+          err =
 #ifdef X86_WIN32
-               WSAGetLastError() ;
+                 WSAGetLastError() ;
 #else
-               errno ;
+                 errno ;
 #endif
-        if ((err != EWOULDBLOCK) land (err != EINPROGRESS))
-          then
-            begin
+          if ((err != EWOULDBLOCK) land (err != EINPROGRESS))
+            then
+              begin
 #ifdef X86_WIN32
-              err2 = closesocket (nsstr->npath) ;
+                err2 = closesocket (nsstr->npath) ;
 #else
-              err2 = close (nsstr->npath) ;
+                err2 = close (nsstr->npath) ;
 #endif
-              nsstr->npath = INVALID_SOCKET ;
-              sprintf(s, "%d on netserv[%d] port", err2, nsstr->ns_par.server_number) ;
-              lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_ACCERR, 0, addr(s)) ;
-            end
-      end
-    else
-      begin
+                nsstr->npath = INVALID_SOCKET ;
+                sprintf(s, "%d on netserv[%d] port", err2, nsstr->ns_par.server_number) ;
+                lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_ACCERR, 0, addr(s)) ;
+              end
+          return ;
+        end
 #ifdef X86_WIN32
-        flag = 1 ;
-        ioctlsocket (nsstr->sockpath, FIONBIO, addr(flag)) ;
+    flag = 1 ;
+    ioctlsocket (path, FIONBIO, addr(flag)) ;
 #else
-        flag = fcntl (nsstr->sockpath, F_GETFL, 0) ;
-        fcntl (nsstr->sockpath, F_SETFL, flag or O_NONBLOCK) ;  
-#endif
-        psock = (pointer) addr(nsstr->client) ;
-        showdot (ntohl(psock->sin_addr.s_addr), addr(hostname)) ;
-        client_ip = ntohl(psock->sin_addr.s_addr) ;
-        client_port = ntohs(psock->sin_port) ;
-        if (nsstr->ns_par.whitecount > 0)
-          then
+    flag = fcntl (path, F_GETFL, 0) ;
+    fcntl (path, F_SETFL, flag or O_NONBLOCK) ;
+#endif
+    psock = (pointer) addr(client) ;
+    showdot (ntohl(psock->sin_addr.s_addr), addr(hostname)) ;
+    client_ip = ntohl(psock->sin_addr.s_addr) ;
+    client_port = ntohs(psock->sin_port) ;
+    if (nsstr->ns_par.whitecount > 0)
+      then
+        begin
+          found = FALSE ;
+          for (i = 1 ; i <= nsstr->ns_par.whitecount ; i++)
             begin
-              found = FALSE ;
-              for (i = 1 ; i <= nsstr->ns_par.whitecount ; i++)
-                begin
-                  pwhite = addr(nsstr->ns_par.whitelist[i]) ;
-                  if ((client_ip >= pwhite->lowip) land (client_ip <= pwhite->highip))
-                    then
-                      begin
-                        found = TRUE ;
-                        break ;
-                      end
-                end
-              if (lnot found)
+              pwhite = addr(nsstr->ns_par.whitelist[i]) ;
+              if ((client_ip >= pwhite->lowip) land (client_ip <= pwhite->highip))
                 then
                   begin
-#ifdef X86_WIN32
-                    closesocket (nsstr->npath) ;
-#else
-                    close (nsstr->npath) ;
-#endif
-                    nsstr->sockpath = INVALID_SOCKET ;
-                    return ;
+                    found = TRUE ;
+                    break ;
                   end
             end
-        sprintf(s, "\"%s:%d\" to netserv[%d] port", addr(hostname), client_port, nsstr->ns_par.server_number) ;
-        lib_msg_add (nsstr->ns_par.stnctx, AUXMSG_CONN, 0, addr(s)) ;
-        lth = sizeof(integer) ;
+          if (lnot found)
+            then
+              begin
 #ifdef X86_WIN32
-        err = getsockopt (nsstr->sockpath, SOL_SOCKET, SO_SNDBUF, addr(bufsize), addr(lth)) ;
+                closesocket (path) ;
 #else
-        err = getsockopt (nsstr->sockpath, SOL_SOCKET, SO_SNDBUF, addr(bufsize), addr(lth)) ;
+                close (path) ;
 #endif
-        if ((err == 0) land (bufsize < 30000))
-          then
-            begin
-              bufsize = 30000 ;
+                continue ;
+              end
+        end
+    pcli = NIL ;
+    for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+      if (nsstr->clients[i].sockpath == INVALID_SOCKET)
+        then
+          begin
+            pcli = addr(nsstr->clients[i]) ;
+            break ;
+          end
+    if (pcli == NIL)
+      then
+        begin
 #ifdef X86_WIN32
-              setsockopt (nsstr->sockpath, SOL_SOCKET, SO_SNDBUF, addr(bufsize), lth) ;
+          closesocket (path) ;
 #else
-              setsockopt (nsstr->sockpath, SOL_SOCKET, SO_SNDBUF, addr(bufsize), lth) ;
+          close (path) ;
 #endif
-            end
+          sprintf(s, "\"%s:%d\", too many clients on netserv[%d] port", hostname, client_port,
+                  (int)nsstr->ns_par.server_number) ;
+          lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_ACCERR, 0, addr(s)) ;
+          continue ;
+        end
+    sprintf(s, "\"%s:%d\" to netserv[%d] port", hostname, client_port, (int)nsstr->ns_par.server_number) ;
+    lib_msg_add (nsstr->ns_par.stnctx, AUXMSG_CONN, 0, addr(s)) ;
+    lth = sizeof(integer) ;
+    err = getsockopt (path, SOL_SOCKET, SO_SNDBUF, addr(bufsize), addr(lth)) ;
+    if ((err == 0) land (bufsize < 30000))
+      then
+        begin
+          bufsize = 30000 ;
+          setsockopt (path, SOL_SOCKET, SO_SNDBUF, addr(bufsize), lth) ;
+        end
 #ifndef X86_WIN32
-        flag = 1 ;
-        lth = sizeof(integer) ;
+    flag = 1 ;
+    lth = sizeof(integer) ;
 #if defined(linux) || defined(solaris)
-        signal (SIGPIPE, SIG_IGN) ;
+    signal (SIGPIPE, SIG_IGN) ;
 #else
-        setsockopt (nsstr->sockpath, SOL_SOCKET, SO_NOSIGPIPE, addr(flag), lth) ;
+    setsockopt (path, SOL_SOCKET, SO_NOSIGPIPE, addr(flag), lth) ;
 #endif
 #endif
-        nsstr->haveclient = TRUE ;
-        nsstr->last_sent = now () ;
-        nsstr->sockfull = FALSE ;
-      end
+    qlock (nsstr) ;
+    memset (pcli, 0, sizeof(tns_client)) ;
+    memcpy (addr(pcli->client), addr(client), sizeof(struct sockaddr)) ;
+    pcli->sockpath = path ;
+    pcli->last_sent = now () ;
+    if (nsstr->clientcount == 0)
+      then
+        pcli->nsq_out = nsstr->nsq_resume ; /* gets what was buffered while nobody was connected */
+      else
+        pcli->nsq_out = nsstr->nsq_in ;
+    inc(nsstr->clientcount) ;
+    qunlock (nsstr) ;
+#if defined(linux)
+    memset (addr(ev), 0, sizeof(struct epoll_event)) ;
+    ev.events = EPOLLIN ;
+    ev.data.ptr = pcli ;
+    epoll_ctl (nsstr->epfd, EPOLL_CTL_ADD, path, addr(ev)) ;
+#endif
+  until FALSE) ;
 end
 
-static void read_from_client (pnsstr nsstr)
+static void read_from_client (pnsstr nsstr, pns_client pcli)
 begin
 #define RBUFSIZE 100
   integer err ;
   byte buf[RBUFSIZE] ;
-  string63 s ;
 
   repeat
-    if (lnot nsstr->haveclient)
+    err = recv(pcli->sockpath, addr(buf), RBUFSIZE, 0) ;
+    if (err == 0)
       then
-        return ;
-    err = recv(nsstr->sockpath, addr(buf), RBUFSIZE, 0) ;
-    if (err == SOCKET_ERROR)
+        begin /* orderly shutdown by client */
+          qlock (nsstr) ;
+          close_client (nsstr, pcli) ;
+          qunlock (nsstr) ;
+          return ;
+        end
+    else if (err == SOCKET_ERROR)
       then
         begin
           err =
@@ -425,19 +525,13 @@ begin
           if ((err == ECONNRESET) lor (err == ECONNABORTED))
             then
               begin
-#ifdef X86_WIN32
-                closesocket (nsstr->sockpath) ;
-#else
-                close (nsstr->sockpath) ;
-#endif
-                sprintf(s, "netserv[%d] port", nsstr->ns_par.server_number) ;
-                lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_DISCON, 0, addr(s)) ;
-                nsstr->haveclient = FALSE ;
-                nsstr->sockfull = FALSE ;
-                return ;
+                qlock (nsstr) ;
+                close_client (nsstr, pcli) ;
+                qunlock (nsstr) ;
               end
+          return ;
         end
-  until (err == 0)) ; /* nothing left in buffer */
+  until FALSE) ; /* until nothing left in buffer */
 end
 
 static integer wrap_buffer (integer max, integer i)
@@ -451,170 +545,356 @@ begin
   return j ;
 end
 
-/* returns TRUE if error */
-static boolean send_netserv_packet (pnsstr nsstr, pointer buf)
+/* Enable or disable write readiness notification for a client */
+static void want_write (pnsstr nsstr, pns_client pcli, boolean full)
 begin
-  integer err ;
-  string63 s ;
+#if defined(linux)
+  struct epoll_event ev ;
+#endif
 
-  if (lnot nsstr->haveclient)
+  if (pcli->sockfull == full)
     then
-      return TRUE ;
+      return ;
+  pcli->sockfull = full ;
 #if defined(linux)
-  err = send(nsstr->sockpath, buf, LIB_REC_SIZE, MSG_NOSIGNAL) ;
-#else
-  err = send(nsstr->sockpath, buf, LIB_REC_SIZE, 0) ;
-#endif
-  if (err == SOCKET_ERROR)
+  memset (addr(ev), 0, sizeof(struct epoll_event)) ;
+  ev.events = EPOLLIN ;
+  if (full)
     then
-      begin
-        err =
+      ev.events = ev.events or EPOLLOUT ;
+  ev.data.ptr = pcli ;
+  epoll_ctl (nsstr->epfd, EPOLL_CTL_MOD, pcli->sockpath, addr(ev)) ;
+#endif
+end
+
+/* Send as much as the socket will take of the held record followed by
+   the contiguous spans of the ring between the client's cursor and the
+   shared input pointer. Must be called with the mutex held, returns
+   TRUE if the client was disconnected */
+static boolean send_to_client (pnsstr nsstr, pns_client pcli)
+begin
+  integer err, cnt, records, sofar, lth ;
+  integer nsq_out ;
 #ifdef X86_WIN32
-               WSAGetLastError() ;
+  byte *buf ;
 #else
-               errno ;
+  struct iovec iov[3] ;
+  struct msghdr msg ;
 #endif
-        if (err == EWOULDBLOCK)
-          then
-            begin
-              nsstr->sockfull = TRUE ;
-              return TRUE ;
-            end
+
+  repeat
+    cnt = 0 ;
+    records = 0 ;
+    sofar = pcli->partial ;
 #ifdef X86_WIN32
-        else if ((err == ECONNRESET) lor (err == ECONNABORTED))
+    if (pcli->holding)
+      then
+        begin
+          buf = addr(pcli->hold[sofar]) ;
+          lth = LIB_REC_SIZE - sofar ;
+        end
+    else if (pcli->nsq_out != nsstr->nsq_in)
+      then
+        begin
+          buf = addr((*(nsstr->ns_par.nsbuf))[pcli->nsq_out][sofar]) ;
+          if (nsstr->nsq_in > pcli->nsq_out)
+            then
+              records = nsstr->nsq_in - pcli->nsq_out ;
+            else
+              records = nsstr->ns_par.record_count - pcli->nsq_out ;
+          if (records > NS_BATCH)
+            then
+              records = NS_BATCH ;
+          lth = records * LIB_REC_SIZE - sofar ;
+        end
+      else
+        return FALSE ; /* nothing to send */
+    err = send(pcli->sockpath, buf, lth, 0) ;
 #else
-        else if (err = EPIPE)
-#endif
+    lth = 0 ;
+    if (pcli->holding)
+      then
+        begin
+          iov[cnt].iov_base = addr(pcli->hold[sofar]) ;
+          iov[cnt].iov_len = LIB_REC_SIZE - sofar ;
+          incn(lth, iov[cnt].iov_len) ;
+          inc(cnt) ;
+          sofar = 0 ;
+        end
+    nsq_out = pcli->nsq_out ;
+    while ((nsq_out != nsstr->nsq_in) land (records < NS_BATCH))
+      begin /* one iovec per contiguous span of the ring */
+        if (nsstr->nsq_in > nsq_out)
           then
-            begin
+            err = nsstr->nsq_in - nsq_out ;
+          else
+            err = nsstr->ns_par.record_count - nsq_out ;
+        if (err > (NS_BATCH - records))
+          then
+            err = NS_BATCH - records ;
+        iov[cnt].iov_base = addr((*(nsstr->ns_par.nsbuf))[nsq_out][sofar]) ;
+        iov[cnt].iov_len = err * LIB_REC_SIZE - sofar ;
+        incn(lth, iov[cnt].iov_len) ;
+        inc(cnt) ;
+        sofar = 0 ;
+        incn(records, err) ;
+        incn(nsq_out, err) ;
+        if (nsq_out >= nsstr->ns_par.record_count)
+          then
+            nsq_out = 0 ;
+      end
+    if (cnt == 0)
+      then
+        return FALSE ; /* nothing to send */
+    memset (addr(msg), 0, sizeof(struct msghdr)) ;
+    msg.msg_iov = iov ;
+    msg.msg_iovlen = cnt ;
+#if defined(linux)
+    err = sendmsg(pcli->sockpath, addr(msg), MSG_NOSIGNAL) ;
+#else
+    err = sendmsg(pcli->sockpath, addr(msg), 0) ;
+#endif
+#endif
+    if (err == SOCKET_ERROR)
+      then
+        begin
+          err =
 #ifdef X86_WIN32
-              closesocket (nsstr->sockpath) ;
+                 WSAGetLastError() ;
 #else
-              close (nsstr->sockpath) ;
+                 errno ;
 #endif
-              sprintf(s, "netserv[%d] port", nsstr->ns_par.server_number) ;
-              lib_msg_add(nsstr->ns_par.stnctx, AUXMSG_DISCON, 0, addr(s)) ;
-              nsstr->haveclient = FALSE ;
-              nsstr->sockfull = FALSE ;
-              return TRUE ;
-            end
+          if (err == EWOULDBLOCK)
+            then
+              begin
+                want_write (nsstr, pcli, TRUE) ;
+                return FALSE ;
+              end
+          close_client (nsstr, pcli) ;
+          return TRUE ;
+        end
+    /* advance past what the socket accepted */
+    pcli->last_sent = now () ;
+    incn(err, pcli->partial) ;
+    if (pcli->holding)
+      then
+        begin
+          if (err < LIB_REC_SIZE)
+            then
+              begin
+                pcli->partial = err ;
+                want_write (nsstr, pcli, TRUE) ;
+                return FALSE ;
+              end
+          pcli->holding = FALSE ;
+          decn(err, LIB_REC_SIZE) ;
+        end
+    while (err >= LIB_REC_SIZE)
+      begin
+        pcli->nsq_out = wrap_buffer(nsstr->ns_par.record_count, pcli->nsq_out) ;
+        decn(err, LIB_REC_SIZE) ;
       end
-    else
-      nsstr->sockfull = FALSE ;
-  nsstr->last_sent = now () ;
-  return FALSE ;
+    pcli->partial = err ;
+    if (err)
+      then
+        begin /* socket buffer filled part way through a record */
+          want_write (nsstr, pcli, TRUE) ;
+          return FALSE ;
+        end
+    want_write (nsstr, pcli, FALSE) ;
+  until FALSE) ;
 end
 
-static void send_next_buffer (pnsstr nsstr)
+/* Send pending data to every client that can accept it, and a sync record
+   to any that have been idle for longer than sync_time */
+static void service_clients (pnsstr nsstr)
 begin
-  boolean failed ;
+  integer i ;
+  pns_client pcli ;
 
-  if (lnot nsstr->haveclient)
-    then
-      return ;
-  failed = send_netserv_packet (nsstr, addr((*(nsstr->ns_par.nsbuf))[nsstr->nsq_out])) ;
-  if (lnot failed)
-    then
-      nsstr->nsq_out = wrap_buffer(nsstr->ns_par.record_count, nsstr->nsq_out) ; /* sucessful */
+  qlock (nsstr) ;
+  nsstr->wakeup = FALSE ;
+  for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+    begin
+      pcli = addr(nsstr->clients[i]) ;
+      if ((pcli->sockpath == INVALID_SOCKET) lor (pcli->sockfull))
+        then
+          continue ;
+      if ((lnot pcli->holding) land (pcli->nsq_out == nsstr->nsq_in) land
+          (nsstr->ns_par.sync_time) land ((now () - pcli->last_sent) >= nsstr->ns_par.sync_time))
+        then
+          begin
+            memcpy (addr(pcli->hold), addr(nsstr->sync_record), LIB_REC_SIZE) ;
+            pcli->holding = TRUE ;
+            pcli->partial = 0 ;
+          end
+      send_to_client (nsstr, pcli) ;
+    end
+  qunlock (nsstr) ;
 end
 
 void lib_ns_send (pointer ct, pcompleted_record pbuf)
 begin
   pnsstr nsstr ;
-  integer nq ;
-  boolean wasempty ;
+  integer i, nq ;
+  pns_client pcli ;
+  boolean wake ;
 
   nsstr = ct ;
   qlock (nsstr) ;
-  wasempty = (nsstr->nsq_in == nsstr->nsq_out) ;
   nq = wrap_buffer (nsstr->ns_par.record_count, nsstr->nsq_in) ; /* next pointer after we insert new record */
-  if (nq == nsstr->nsq_out)
+  if (nsstr->nsq_resume == nq)
     then
-      nsstr->nsq_out = wrap_buffer(nsstr->ns_par.record_count, nsstr->nsq_out) ; /* throw away oldest */
+      nsstr->nsq_resume = wrap_buffer(nsstr->ns_par.record_count, nq) ; /* throw away oldest */
+  for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+    begin
+      pcli = addr(nsstr->clients[i]) ;
+      if ((pcli->sockpath != INVALID_SOCKET) land (pcli->nsq_out == nq))
+        then
+          begin /* throw away oldest for this client */
+            if ((pcli->partial) land (lnot pcli->holding))
+              then
+                begin /* keep the rest of the record it is part way through */
+                  memcpy (addr(pcli->hold), addr((*(nsstr->ns_par.nsbuf))[nq]), LIB_REC_SIZE) ;
+                  pcli->holding = TRUE ;
+                end
+              else
+                inc(pcli->dropped) ;
+            pcli->nsq_out = wrap_buffer(nsstr->ns_par.record_count, nq) ;
+          end
+    end
   memcpy(addr((*(nsstr->ns_par.nsbuf))[nsstr->nsq_in]), pbuf, LIB_REC_SIZE) ;
   nsstr->nsq_in = nq ;
-  if (wasempty)
+  wake = (nsstr->clientcount > 0) land (lnot nsstr->wakeup) ;
+  if (wake)
     then
-      send_next_buffer (nsstr) ;
+      nsstr->wakeup = TRUE ;
   qunlock (nsstr) ;
+#if defined(linux)
+  if (wake)
+    then
+      write (nsstr->wake[1], "", 1) ;
+#endif
 end
 
-#ifdef X86_WIN32
-unsigned long  __stdcall nsthread (pointer p)
+#if defined(linux)
+/* wait for events on the listening socket, clients, and wakeup pipe */
+static void ns_poll (pnsstr nsstr)
 begin
-  pnsstr nsstr ;
-  fd_set readfds, writefds, exceptfds ;
-  struct timeval timeout ;
-  integer res ;
-  boolean sent ;
+#define NS_EVENTS 16
+  struct epoll_event events[NS_EVENTS] ;
+  integer i, n, timeout ;
+  byte buf[64] ;
+  pns_client pcli ;
 
-  nsstr = p ;
-  repeat
-    if (nsstr->sockopen)
+  if (nsstr->ns_par.sync_time)
+    then
+      timeout = NS_TIMEOUT ;
+    else
+      timeout = -1 ; /* nothing to do until woken */
+  n = epoll_wait (nsstr->epfd, events, NS_EVENTS, timeout) ;
+  for (i = 0 ; i < n ; i++)
+    if (events[i].data.ptr == NIL)
       then
-        begin /* wait for socket input or timeout */
-          FD_ZERO (addr(readfds)) ;
-          FD_ZERO (addr(writefds)) ;
-          FD_ZERO (addr(exceptfds)) ;
-          if (lnot nsstr->haveclient)
+        accept_ns_socket (nsstr) ;
+    else if (events[i].data.ptr == addr(nsstr->wake))
+      then
+        while (read (nsstr->wake[0], addr(buf), sizeof(buf)) > 0) ;
+      else
+        begin
+          pcli = events[i].data.ptr ;
+          if (pcli->sockpath == INVALID_SOCKET)
             then
-              FD_SET (nsstr->npath, addr(readfds)) ; /* waiting for accept */
-            else
-              begin
-                FD_SET (nsstr->sockpath, addr(readfds)) ; /* client might try to send me something */
-                if (nsstr->sockfull)
-                  then
-                    FD_SET (nsstr->sockpath, addr(writefds)) ; /* buffer was full */
-              end
-          timeout.tv_sec = 0 ;
-          timeout.tv_usec = 25000 ; /* 25ms timeout */
-          res = select (0, addr(readfds), addr(writefds), addr(exceptfds), addr(timeout)) ;
-          if (res > 0)
+              continue ;
+          if (events[i].events and EPOLLERR)
             then
-              begin
-                if (FD_ISSET (nsstr->npath, addr(readfds)))
-                  then
-                    accept_ns_socket (nsstr) ;
-                else if (nsstr->haveclient)
-                  then
-                    begin
-                      if (FD_ISSET (nsstr->sockpath, addr(readfds)))
-                        then
-                          read_from_client (nsstr) ;
-                      if ((nsstr->sockfull) land (FD_ISSET (nsstr->sockpath, addr(writefds))))
-                        then
-                          nsstr->sockfull = FALSE ;
-                    end
+              begin /* whatever the error, the connection is no use */
+                qlock (nsstr) ;
+                close_client (nsstr, pcli) ;
+                qunlock (nsstr) ;
+                continue ;
               end
-          if (nsstr->haveclient)
+          if (events[i].events and (EPOLLIN or EPOLLHUP))
+            then
+              read_from_client (nsstr, pcli) ;
+          if ((pcli->sockpath != INVALID_SOCKET) land (events[i].events and EPOLLOUT))
             then
               begin
-                sent = FALSE ;
-                if (nsstr->sockfull)
-                  then
-                    sleepms (25) ;
-                  else
-                    begin
-                      qlock (nsstr) ;
-                      if (nsstr->nsq_in != nsstr->nsq_out)
-                        then
-                          begin
-                            sent = TRUE ;
-                            send_next_buffer (nsstr) ;
-                          end
-                      qunlock (nsstr) ;
-                      if (lnot sent)
-                        then
-                          begin
-                            if ((nsstr->ns_par.sync_time) land ((now () - nsstr->last_sent) >= nsstr->ns_par.sync_time))
-                              then
-                                send_netserv_packet (nsstr, addr(nsstr->sync_record)) ;
-                              else
-                                sleepms (25) ;
-                          end
-                    end
+                qlock (nsstr) ;
+                want_write (nsstr, pcli, FALSE) ;
+                qunlock (nsstr) ;
               end
         end
+  service_clients (nsstr) ;
+end
+#else
+/* wait for socket input or timeout */
+static void ns_poll (pnsstr nsstr)
+begin
+  fd_set readfds, writefds, exceptfds ;
+  struct timeval timeout ;
+  integer i, res ;
+  pns_client pcli ;
+
+  FD_ZERO (addr(readfds)) ;
+  FD_ZERO (addr(writefds)) ;
+  FD_ZERO (addr(exceptfds)) ;
+  if (nsstr->npath != INVALID_SOCKET)
+    then
+      FD_SET (nsstr->npath, addr(readfds)) ; /* waiting for accept */
+  for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+    begin
+      pcli = addr(nsstr->clients[i]) ;
+      if (pcli->sockpath == INVALID_SOCKET)
+        then
+          continue ;
+      FD_SET (pcli->sockpath, addr(readfds)) ; /* client might try to send me something */
+      if (pcli->sockfull)
+        then
+          FD_SET (pcli->sockpath, addr(writefds)) ; /* buffer was full */
+    end
+  timeout.tv_sec = 0 ;
+  timeout.tv_usec = 25000 ; /* 25ms timeout */
+#ifdef X86_WIN32
+  res = select (0, addr(readfds), addr(writefds), addr(exceptfds), addr(timeout)) ;
+#else
+  res = select (getdtablesize(), addr(readfds), addr(writefds), addr(exceptfds), addr(timeout)) ;
+#endif
+  if (res > 0)
+    then
+      begin
+        if ((nsstr->npath != INVALID_SOCKET) land (FD_ISSET (nsstr->npath, addr(readfds))))
+          then
+            accept_ns_socket (nsstr) ;
+        for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+          begin
+            pcli = addr(nsstr->clients[i]) ;
+            if (pcli->sockpath == INVALID_SOCKET)
+              then
+                continue ;
+            if (FD_ISSET (pcli->sockpath, addr(readfds)))
+              then
+                read_from_client (nsstr, pcli) ;
+            if ((pcli->sockpath != INVALID_SOCKET) land (pcli->sockfull) land
+                (FD_ISSET (pcli->sockpath, addr(writefds))))
+              then
+                pcli->sockfull = FALSE ;
+          end
+      end
+  service_clients (nsstr) ;
+end
+#endif
+
+#ifdef X86_WIN32
+unsigned long  __stdcall nsthread (pointer p)
+begin
+  pnsstr nsstr ;
+
+  nsstr = p ;
+  repeat
+    if (nsstr->sockopen)
+      then
+        ns_poll (nsstr) ;
       else
         sleepms (25) ;
   until nsstr->terminate) ;
@@ -626,78 +906,12 @@ end
 void *nsthread (pointer p)
 begin
   pnsstr nsstr ;
-  fd_set readfds, writefds, exceptfds ;
-  struct timeval timeout ;
-  integer res ;
-  boolean sent ;
 
   nsstr = p ;
   repeat
     if (nsstr->sockopen)
       then
-        begin /* wait for socket input or timeout */
-          FD_ZERO (addr(readfds)) ;
-          FD_ZERO (addr(writefds)) ;
-          FD_ZERO (addr(exceptfds)) ;
-          if (lnot nsstr->haveclient)
-            then
-              FD_SET (nsstr->npath, addr(readfds)) ; /* waiting for accept */
-            else
-              begin
-                FD_SET (nsstr->sockpath, addr(readfds)) ; /* client might try to send me something */
-                if (nsstr->sockfull)
-                  then
-                    FD_SET (nsstr->sockpath, addr(writefds)) ; /* buffer was full */
-              end
-          timeout.tv_sec = 0 ;
-          timeout.tv_usec = 25000 ; /* 25ms timeout */
-          res = select (getdtablesize(), addr(readfds), addr(writefds), addr(exceptfds), addr(timeout)) ;
-          if (res > 0)
-            then
-              begin
-                if (FD_ISSET (nsstr->npath, addr(readfds)))
-                  then
-                    accept_ns_socket (nsstr) ;
-                else if (nsstr->haveclient)
-                  then
-                    begin
-                      if (FD_ISSET (nsstr->sockpath, addr(readfds)))
-                        then
-                          read_from_client (nsstr) ;
-                      if ((nsstr->sockfull) land (FD_ISSET (nsstr->sockpath, addr(writefds))))
-                        then
-                          nsstr->sockfull = FALSE ;
-                    end
-              end
-          if (nsstr->haveclient)
-            then
-              begin
-                sent = FALSE ;
-                if (nsstr->sockfull)
-                  then
-                    sleepms (25) ;
-                  else
-                    begin
-                      qlock (nsstr) ;
-                      if (nsstr->nsq_in != nsstr->nsq_out)
-                        then
-                          begin
-                            sent = TRUE ;
-                            send_next_buffer (nsstr) ;
-                          end
-                      qunlock (nsstr) ;
-                      if (lnot sent)
-                        then
-                          begin
-                            if ((nsstr->ns_par.sync_time) land ((now () - nsstr->last_sent) >= nsstr->ns_par.sync_time))
-                              then
-                                send_netserv_packet (nsstr, addr(nsstr->sync_record)) ;
-                              else
-                                sleepms (25) ;
-                          end
-                    end
-              end
-        end
+        ns_poll (nsstr) ;
       else
         sleepms (25) ;
   until nsstr->terminate) ;
@@ -714,6 +928,9 @@ begin
 #ifndef X86_WIN32
   integer err ;
 #endif
+#if defined(linux)
+  struct epoll_event ev ;
+#endif
 
   nsstr = malloc (sizeof(tnsstr)) ;
   memset (nsstr, 0, sizeof(tnsstr)) ;
@@ -727,7 +944,8 @@ begin
     end
   create_mutex (nsstr) ;
   nsstr->npath = INVALID_SOCKET ;
-  nsstr->sockpath = INVALID_SOCKET ;
+  for (i = 0 ; i < MAX_NS_CLIENTS ; i++)
+    nsstr->clients[i].sockpath = INVALID_SOCKET ;
   open_socket (nsstr) ;
   if (lnot nsstr->sockopen)
     then
@@ -735,6 +953,28 @@ begin
         free (nsstr) ;
         return NIL ;
       end
+#if defined(linux)
+  nsstr->epfd = epoll_create (MAX_NS_CLIENTS + 2) ;
+  if ((nsstr->epfd < 0) lor (pipe (nsstr->wake)))
+    then
+      begin
+        if (nsstr->epfd >= 0)
+          then
+            close (nsstr->epfd) ;
+        close_socket (nsstr) ;
+        destroy_mutex (nsstr) ;
+        free (nsstr) ;
+        return NIL ;
+      end
+  for (i = 0 ; i <= 1 ; i++)
+    fcntl (nsstr->wake[i], F_SETFL, fcntl (nsstr->wake[i], F_GETFL, 0) or O_NONBLOCK) ;
+  memset (addr(ev), 0, sizeof(struct epoll_event)) ;
+  ev.events = EPOLLIN ;
+  ev.data.ptr = NIL ; /* listening socket */
+  epoll_ctl (nsstr->epfd, EPOLL_CTL_ADD, nsstr->npath, addr(ev)) ;
+  ev.data.ptr = addr(nsstr->wake) ;
+  epoll_ctl (nsstr->epfd, EPOLL_CTL_ADD, nsstr->wake[0], addr(ev)) ;
+#endif
 #ifdef X86_WIN32
   nsstr->threadhandle = CreateThread (NIL, 0, nsthread, nsstr, 0, addr(nsstr->threadid)) ;
   if (nsstr->threadhandle == NIL)
@@ -744,6 +984,13 @@ begin
 #endif
     then
       begin
+        close_socket (nsstr) ;
+#if defined(linux)
+        close (nsstr->epfd) ;
+        close (nsstr->wake[0]) ;
+        close (nsstr->wake[1]) ;
+#endif
+        destroy_mutex (nsstr) ;
         free (nsstr) ;
         return NIL ;
       end
@@ -757,10 +1004,18 @@ begin
 
   nsstr = ct ;
   nsstr->terminate = TRUE ;
+#if defined(linux)
+  write (nsstr->wake[1], "", 1) ;
+#endif
   repeat
     sleepms (25) ;
   until (lnot nsstr->running)) ;
   close_socket (nsstr) ;
+#if defined(linux)
+  close (nsstr->epfd) ;
+  close (nsstr->wake[0]) ;
+  close (nsstr->wake[1]) ;
+#endif
   destroy_mutex (nsstr) ;
 end
 
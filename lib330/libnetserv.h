@@ -26,7 +26,7 @@ Edit History:
 #ifndef libnetserv_h
 /* Flag this file as included */
 #define libnetserv_h
-#define VER_LIBNETSERV 6
+#define VER_LIBNETSERV 8
 
 #ifndef OMIT_SEED
 /* Make sure libtypes.h is included */
@@ -40,6 +40,7 @@ Edit History:
 
 #define MAX_NETWHITE 10
 #define MAX_NS_BUFFERS 9800 /* 5.0MB as shown in station manager */
+#define MAX_NS_CLIENTS 64 /* maximum concurrent clients per netserver */
 
 typedef completed_record tnsbuf[MAX_NS_BUFFERS] ;
 typedef struct {
@@ -27,6 +27,7 @@ Edit History:
     3 2008-01-16 rdr Fix record length for CNP blockette data.
     4 2008-02-27 rdr cfg_lastwritten set to data time, not host time.
     5 2008-03-13 rdr Don't reset records_written at 999999.
+    6 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
 */
 #ifndef OMIT_SEED
 #ifndef libopaque_h
@@ -72,8 +73,8 @@ begin
       begin
         p = addr(pcom->ring->rec) ;
         storeseedhdr (addr(p), addr(pcom->ring->hdr_buf), FALSE) ;
-        inc(q->records_generated_session) ;
-        q->last_record_generated = secsince () ;
+        inc(q->cold->records_generated_session) ;
+        q->cold->last_record_generated = secsince () ;
         send_to_client (paqs, q, pcom->ring, SCD_BOTH) ;
       end
   memset (addr(pcom->ring->rec), 0, LIB_REC_SIZE) ;
@@ -85,7 +86,7 @@ begin
     then
       begin
         paqs->cfg_timer = 0 ;
-        if ((q->arc.amini_filter) land (q->arc.total_frames > 1))
+        if ((q->cold->arc.amini_filter) land (q->cold->arc.total_frames > 1))
           then
             flush_archive (paqs, q) ;
       end
@@ -217,8 +218,8 @@ begin
       begin
         p = addr(pcom->ring->rec) ;
         storeseedhdr (addr(p), addr(pcom->ring->hdr_buf), FALSE) ;
-        inc(q->records_generated_session) ;
-        q->last_record_generated = secsince () ;
+        inc(q->cold->records_generated_session) ;
+        q->cold->last_record_generated = secsince () ;
         send_to_client (paqs, q, pcom->ring, SCD_BOTH) ;
       end
   memset (addr(pcom->ring->rec), 0, LIB_REC_SIZE) ;
@@ -226,7 +227,7 @@ begin
   pcom->blockette_index = 56 ;
   pcom->last_blockette = 48 ;
   pcom->blockette_count = 0 ;
-  if ((q->arc.amini_filter) land (q->arc.total_frames > 1))
+  if ((q->cold->arc.amini_filter) land (q->cold->arc.total_frames > 1))
     then
       flush_archive (paqs, q) ;
 end
@@ -51,6 +51,10 @@ Edit History:
    14 2009-09-07 rdr Fix recursive mutex locking in verify_mapping.
    15 2010-03-27 rdr Q335 support added.
    16 2011-03-17 rdr Setup new gain_bits in LCQ init for deb_flags usage.
+   17 2026-10-19 gns Flag data LCQs for the low latency callback.
+   18 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
+   19 2026-10-19 gns Add build_plans, flattening the dispatch chains into dispatch plans.
+   20 2026-10-19 gns Wait for the LCQ worker threads before deallocating or clearing calstat.
 */
 #ifndef libsampcfg_h
 #include "libsampcfg.h"
@@ -90,6 +94,9 @@ Edit History:
 #ifndef libsample_h
 #include "libsample.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 #ifndef libverbose_h
 #include "libverbose.h"
 #endif
@@ -100,6 +107,8 @@ Edit History:
 
 #define EP_UPDATE_TIME 120 /* 2 minutes */
 
+static tplanstep no_steps ; /* plan for a blockette channel nothing uses */
+
 longword secsince (void)
 begin
 
@@ -108,6 +117,7 @@ end
 
 void clear_sg (paqstruc paqs)
 begin
+  integer i, j ;
 
   memset (addr(paqs->first_sg), 0, (longint)addr(paqs->last_sg) - (longint)addr(paqs->first_sg)) ;
   string2fixed (addr(paqs->log_tim.tim_location), "  ") ;
@@ -118,6 +128,11 @@ begin
   memset (addr(paqs->dispatch), 0, sizeof(tdispatch)) ;
   memset (addr(paqs->mdispatch), 0, sizeof(tmdispatch)) ;
   memset (addr(paqs->epdispatch), 0, sizeof(tepdispatch)) ;
+  for (i = 0 ; i <= 95 ; i++)
+    paqs->dplan[i] = addr(no_steps) ;
+  for (i = 0 ; i <= CHANNELS - 1 ; i++)
+    for (j = 0 ; j <= FREQUENCIES - 1 ; j++)
+      paqs->mplan[i][j] = addr(no_steps) ;
 end
 
 pointer allocate_aqstruc (tcontext ownedby)
@@ -418,6 +433,7 @@ begin
               then
                 pl->onesec_filter = pl->onesec_filter or OSF_EP ;
           end
+      pl->lowlat = (q330->par_create.call_lowlatency != NIL) ;
 #ifndef OMIT_SEED
       if (q330->par_create.call_minidata)
         then
@@ -430,8 +446,8 @@ begin
       if ((paqs->arc_size > 0) land (q330->par_create.call_aminidata))
         then
           begin
-            pl->arc.amini_filter = q330->par_create.opt_aminifilter and OMF_ALL ;
-            pl->arc.incremental = (pl->rate <= q330->par_create.amini_512highest) ;
+            pl->cold->arc.amini_filter = q330->par_create.opt_aminifilter and OMF_ALL ;
+            pl->cold->arc.incremental = (pl->rate <= q330->par_create.amini_512highest) ;
           end
 #endif
       pl->dholdq = NIL ;
@@ -621,9 +637,9 @@ begin
       if (pr)
         then
           pr->link = pl->com->ring ;
-      if (pl->arc.amini_filter)
+      if (pl->cold->arc.amini_filter)
         then
-          getbuf (q330, addr(pl->arc.pcfr), paqs->arc_size) ;
+          getbuf (q330, addr(pl->cold->arc.pcfr), paqs->arc_size) ;
       if (pl->lcq_opt and LO_EVENT)
         then
           begin
@@ -665,6 +681,192 @@ begin
       end
 end
 
+/* How an LCQ on the dispatch chain for blockette channel "idx" takes its sample,
+   must match the non-main data handling in proc_insequence */
+static byte plan_handler (integer idx, plcq q, byte *shift)
+begin
+  byte sub, field ;
+
+  sub = idx and not DCM ;
+  field = q->raw_data_field ;
+  *shift = 0 ;
+  switch ((idx or 0x80) and DCM) begin
+    case DC_MN816 :
+    case DC_AG816 :
+      return DH_WORD ;
+    case DC_MN38 :
+      switch (sub) begin
+        case 0 :
+          switch (field) begin
+            case 0 :
+              return DH_SUBCHAN ;
+            case 1 :
+              return DH_BHIGH ;
+          end
+          break ;
+        case 1 :
+          switch (field) begin
+            case 0 :
+              return DH_SUBCHAN ;
+            case 1 :
+              return DH_HIGH ;
+            case 2 :
+              return DH_LOW ;
+          end
+          break ;
+        case 2 :
+          if (field == 0)
+            then
+              return DH_SUBCHAN ;
+          *shift = field - 1 ;
+          return DH_BIT ;
+        case 3 :
+          if ((field <= 7) land (field != 5))
+            then
+              begin
+                *shift = field ;
+                return DH_BIT ;
+              end
+          break ;
+        case 4 :
+          switch (field) begin
+            case 0 :
+              return DH_SUBCHAN ;
+            case 1 :
+              return DH_HIGH ;
+          end
+          break ;
+      end
+      break ;
+    case DC_MN32 :
+      return DH_VARIABLE ;
+    case DC_MN232 :
+      switch (field) begin
+        case 1 :
+          return DH_CLKPHASE ;
+        case 2 :
+          return DH_CLKQUAL ;
+        case 3 :
+          return DH_WORD ;
+      end
+      break ;
+    case DC_AG38 :
+      if (sub > 2)
+        then
+          break ;
+      switch (field) begin
+        case 0 :
+          return DH_BSUBCHAN ;
+        case 1 :
+          return DH_BHIGH ;
+        case 2 :
+          if (sub < 2)
+            then
+              return DH_BLOW ;
+          break ;
+      end
+      break ;
+    case DC_AG32 :
+      if (sub > 1)
+        then
+          break ;
+      switch (field) begin
+        case 0 :
+          return DH_SUBCHAN ;
+        case 1 :
+          return DH_SWORD ;
+        case 2 :
+          return DH_LONG ;
+      end
+      break ;
+    case DC_CNP38 :
+      switch (field) begin
+        case 0 :
+          return DH_BSUBCHAN ;
+        case 1 :
+          return DH_HIGH ;
+        case 2 :
+          return DH_LOW ;
+      end
+      break ;
+    case DC_CNP316 :
+      if (sub == 0)
+        then
+          switch (field) begin
+            case 0 :
+              return DH_WORD ;
+            case 1 :
+              return DH_WORD2 ;
+            case 2 :
+              return DH_SWORD3 ;
+            case 3 :
+              return DH_SUBCHAN ;
+          end
+      else if ((sub <= 3) land (field <= 2))
+        then
+          begin
+            *shift = field * 2 ;
+            return DH_CNPSEL ;
+          end
+      break ;
+  end
+  return DH_NONE ;
+end
+
+/* Flatten one dispatch chain, idx < 0 for main data */
+static pplanstep build_plan (paqstruc paqs, plcq first, integer idx)
+begin
+  plcq q ;
+  pplanstep plan, ps ;
+  integer count ;
+  byte handler, shift ;
+
+  count = 0 ;
+  q = first ;
+  while (q)
+    begin
+      inc(count) ;
+      q = q->dispatch_link ;
+    end
+  if (count == 0)
+    then
+      return addr(no_steps) ;
+  getbuf (paqs->owner, (pointer *)addr(plan), (count + 1) * sizeof(tplanstep)) ; /* zeroed, so ends with NIL */
+  ps = plan ;
+  q = first ;
+  while (q)
+    begin
+      shift = 0 ;
+      if (idx < 0)
+        then
+          handler = DH_MAIN ;
+        else
+          handler = plan_handler (idx, q, addr(shift)) ;
+      if (handler != DH_NONE)
+        then
+          begin
+            ps->lcq = q ;
+            ps->handler = handler ;
+            ps->shift = shift ;
+            inc(ps) ;
+          end
+      q = q->dispatch_link ;
+    end
+  return plan ;
+end
+
+/* Called once the dispatch chains are setup by init_lcq */
+void build_plans (paqstruc paqs)
+begin
+  integer i, j ;
+
+  for (i = 0 ; i <= 95 ; i++)
+    paqs->dplan[i] = build_plan (paqs, paqs->dispatch[i], i) ;
+  for (i = 0 ; i <= CHANNELS - 1 ; i++)
+    for (j = 0 ; j <= FREQUENCIES - 1 ; j++)
+      paqs->mplan[i][j] = build_plan (paqs, paqs->mdispatch[i][j], -1) ;
+end
+
 void init_dplcq (paqstruc paqs, plcq pl, boolean newone)
 begin
 #ifndef OMIT_SEED
@@ -707,8 +909,8 @@ begin
   if ((paqs->arc_size > 0) land (q330->par_create.call_aminidata))
     then
       begin
-        pl->arc.amini_filter = q330->par_create.opt_aminifilter and OMF_ALL ;
-        pl->arc.incremental = (pl->rate <= q330->par_create.amini_512highest) ;
+        pl->cold->arc.amini_filter = q330->par_create.opt_aminifilter and OMF_ALL ;
+        pl->cold->arc.incremental = (pl->rate <= q330->par_create.amini_512highest) ;
       end
 #endif
   pl->dholdq = NIL ;
@@ -729,9 +931,9 @@ begin
   pr->full = FALSE ;
   pl->com->ring = pr ;
   pr->link = pl->com->ring ; /* just keeps going back to itself */
-  if (pl->arc.amini_filter)
+  if (pl->cold->arc.amini_filter)
     then
-      getthrbuf (q330, addr(pl->arc.pcfr), paqs->arc_size) ;
+      getthrbuf (q330, addr(pl->cold->arc.pcfr), paqs->arc_size) ;
 #endif
 end
 
@@ -763,6 +965,7 @@ begin
   string s ;
 
   q330 = paqs->owner ;
+  drain_workers (q330) ;
 #ifndef OMIT_SEED
   if (q330->need_sats)
     then
@@ -862,23 +1065,23 @@ begin
           strcpy(addr(pone->location), addr(q->slocation)) ;
           strcpy(addr(pone->channel), addr(q->sseedname)) ;
           pone->chan_number = q->lcq_num ;
-          pone->rec_cnt = q->records_generated_session ;
+          pone->rec_cnt = q->cold->records_generated_session ;
           pone->rec_seq = q->com->records_written ;
-          if (q->last_record_generated == 0)
+          if (q->cold->last_record_generated == 0)
             then
               pone->rec_age = -1 ; /* not written */
             else
-              pone->rec_age = cur - q->last_record_generated ;
-          pone->det_count = q->detections_session ;
-          pone->cal_count = q->calibrations_session ;
-          pone->arec_cnt = q->arc.records_written_session ;
-          pone->arec_over = q->arc.records_overwritten_session ;
-          if (q->arc.last_updated == 0)
+              pone->rec_age = cur - q->cold->last_record_generated ;
+          pone->det_count = q->cold->detections_session ;
+          pone->cal_count = q->cold->calibrations_session ;
+          pone->arec_cnt = q->cold->arc.records_written_session ;
+          pone->arec_over = q->cold->arc.records_overwritten_session ;
+          if (q->cold->arc.last_updated == 0)
             then
               pone->arec_age = -1 ;
             else
-              pone->arec_age = cur - q->arc.last_updated ;
-          pone->arec_seq = q->arc.records_written ;
+              pone->arec_age = cur - q->cold->arc.last_updated ;
+          pone->arec_seq = q->cold->arc.records_written ;
           inc(lcqstat->count) ;
           q = q->link ;
         end
@@ -908,6 +1111,7 @@ begin
   if (q330->libstate != LIBSTATE_RUN)
     then
       return ;
+  drain_workers (q330) ;
   pl = paqs->lcqs ;
   while (pl)
     begin
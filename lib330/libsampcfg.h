@@ -21,11 +21,12 @@ Edit History:
    Ed Date       By  Changes
    -- ---------- --- ---------------------------------------------------
     0 2006-09-30 rdr Created
+    1 2026-10-19 gns Add build_plans.
 */
 #ifndef libsampcfg_h
 /* Flag this file as included */
 #define libsampcfg_h
-#define VER_LIBSAMPCFG 16
+#define VER_LIBSAMPCFG 20
 
 #ifndef libtypes_h
 #include "libtypes.h"
@@ -46,6 +47,7 @@ extern pointer allocate_aqstruc (tcontext ownedby) ;
 extern void clear_calstat (pq330 q330) ;
 extern void set_gaps (plcq q) ;
 extern void init_lcq (paqstruc paqs) ;
+extern void build_plans (paqstruc paqs) ;
 extern void init_dplcq (paqstruc paqs, plcq pl, boolean newone) ;
 extern void init_dplcqs (paqstruc paqs) ;
 extern void verify_mapping (pq330 q330) ;
@@ -30,11 +30,17 @@ Edit History:
                      Add gap_offset.
     6 2010-03-27 rdr Add Q335 definitions.
     7 2011-03-17 rdr Add gain_bits to tlcq.
+    8 2026-10-19 gns Add lowlat to tlcq.
+    9 2026-10-19 gns Reorder tlcq with the fields used for every packet first, move archival
+                     and session statistics out to tlcq_cold, remove the unused
+                     control_detector_name. Add LCQ slab allocation fields.
+   10 2026-10-19 gns Add precompiled dispatch plans.
+   11 2026-10-19 gns Add worker to tlcq and tsampctx for processing on worker threads.
 */
 #ifndef libsampglob_h
 /* Flag this file as included */
 #define libsampglob_h
-#define VER_LIBSAMPGLOB 8
+#define VER_LIBSAMPGLOB 12
 
 #ifndef libtypes_h
 #include "libtypes.h"
@@ -373,26 +379,48 @@ typedef struct {
 /*
   tlcq define one "Logical Channel Queue", corresponding to one SEED channel.
 */
+#define LCQ_SLAB 16 /* LCQs allocated together */
+#ifndef OMIT_SEED
+typedef struct { /* LCQ fields only used when records are archived or statistics reported */
+  tarc arc ; /* archival miniseed structure */
+  longint records_generated_session ; /* count of buffers generated this connection */
+  longword last_record_generated ; /* seconds since 2000 */
+  longint detections_session ; /* number of detections during session */
+  longint calibrations_session ; /* number of calibrations during session */
+} tlcq_cold ;
+typedef tlcq_cold *plcq_cold ;
+#endif
+/*
+  Fields used for every packet or sample come first so they share as few cache
+  lines as possible, configuration follows, statistics are out of line in cold.
+*/
 typedef struct tlcq {
-  struct tlcq *link ; /* forward link */
+  struct tlcq *link ; /* forward link, first for extend_link */
   struct tlcq *dispatch_link ; /* to next lcq that gets similar input data */
-  tlocation location ; /* Seed Location */
-  tseed_name seedname ; /* Seed Channel Name */
-  byte lcq_num ; /* reference number for this LCQ */
   byte raw_data_source ; /* from Q330 channel */
   byte raw_data_field ; /* adds more information */
   byte gain_bits ; /* for DEB flags */
-  longword lcq_opt ; /* LCQ options */
-  string2 slocation ; /* dynamic length version */
-  string3 sseedname ;
-  word caldly ; /* number of seconds after cal over to turn off detection */
-  word calinc ; /* count up timer for turning off detect flag*/
+  byte lcq_num ; /* reference number for this LCQ */
+  byte worker ; /* zero if processed by the lib330 thread, else worker number + 1 */
   integer rate ; /* + => samp per sec; - => sec per samp */
+  longword lcq_opt ; /* LCQ options */
+  word timequal ; /* quality from 0 to 100% */
+  word backup_qual ; /* in case >1hz data gets flushed between seconds */
+  double timetag ; /* seconds since 2000 */
+  double backup_tag ; /* in case >1hz data gets flushed between seconds */
+  double last_timetag ; /* if not zero, timetag of last second of data */
+  tprecomp precomp ; /* precompressed data fields */
+  pidxarray idxbuf ; /* for converting frames into samples */
+  pdataarray databuf ; /* raw input data */
+  word datasize ; /* size of above structure */
+  word onesec_filter ; /* OSF_xxx bits */
   boolean timemark_occurred ; /* set at the first sample */
   boolean cal_on ; /* calibration on */
   boolean calstat ; /* unfiltered calibration status */
-  boolean variable_rate_set ; /* if any new data has been added to variable rate LCQ */
-  boolean validated ; /* DP LCQ is still in tokens */
+  boolean lowlat ; /* also pass each second to the low latency callback */
+  single gap_threshold ; /* number of samples that constitutes a gap */
+  tfloat gap_secs ; /* number of seconds constituting a gap */
+  tfloat gap_offset ; /* expected number of seconds between new incoming samples */
   enum tpacket_class pack_class ; /* for sending to client */
   longword dtsequence ; /* data record sequence number currently being processed */
   tfloat delay ; /* total FIR delay including digitizer delay */
@@ -403,52 +431,45 @@ typedef struct tlcq {
   word segsize ; /* size of segment buffer */
   word seg_count ; /* number of segments so far */
   word seg_high ; /* highest segment, zero if not yet known */
+  word caldly ; /* number of seconds after cal over to turn off detection */
+  word calinc ; /* count up timer for turning off detect flag*/
   pmergedbuf mergedbuf ; /* continguous version of data from segments, same size as segbuf */
-  word onesec_filter ; /* OSF_xxx bits */
-  pidxarray idxbuf ; /* for converting frames into samples */
-  pdataarray databuf ; /* raw input data */
-  word datasize ; /* size of above structure */
   tdhqp dholdq ; /* data holding queue for DC_MULT pkts */
-  double timetag ; /* seconds since 2000 */
-  double backup_tag ; /* in case >1hz data gets flushed between seconds */
-  double last_timetag ; /* if not zero, timetag of last second of data */
-  word timequal ; /* quality from 0 to 100% */
-  word backup_qual ; /* in case >1hz data gets flushed between seconds */
-  single gap_threshold ; /* number of samples that constitutes a gap */
-  tfloat gap_secs ; /* number of seconds constituting a gap */
-  tfloat gap_offset ; /* expected number of seconds between new incoming samples */
-  tprecomp precomp ; /* precompressed data fields */
 #ifndef OMIT_SEED
-  boolean slipping ; /* is derived stream, waiting for sync */
-  longint slip_modulus ;
-  tfloat input_sample_rate ; /* sample rate of input to decimation filter */
-  pdownstream_packet downstream_link ; /* "stream_avail"'s for derived lcq's */
-  struct tlcq *prev_link ; /* back link for checking fir-derived queue order */
-  longword avg_length ; /* interval in samples between reports */
-  single firfixing_gain ; /* normally 1.0, typically <1.0 for goes */
   pcom_packet com ; /* this stream's compression packet(s) */
-  pcontrol_detector ctrl ; /* pointer to general detector stack */
-  pointer det ; /* head of this channel's detector chain */
-  pfilter source_fir ; /* pointer to where "fir" came from */
   pfir_packet fir ; /* this stream's fir filter */
-  piirdef avg_source ; /* where the average filter came from */
+  piirfilter stream_iir ; /* head of this channel's IIR filter chain */
+  pdownstream_packet downstream_link ; /* "stream_avail"'s for derived lcq's */
+  pointer det ; /* head of this channel's detector chain */
+  pcontrol_detector ctrl ; /* pointer to general detector stack */
+  pavg_packet avg ; /* structure for doing averaging */
   piirfilter avg_filt ; /* prefilter for averaging, if any */
+  tfloat processed_stream ; /* output of this stream's FIR filter */
+  tfloat input_sample_rate ; /* sample rate of input to decimation filter */
+  longint slip_modulus ;
+  single firfixing_gain ; /* normally 1.0, typically <1.0 for goes */
+  word mini_filter ; /* OMF_xxx bits */
+  boolean slipping ; /* is derived stream, waiting for sync */
   boolean gen_on ; /* general detector on */
   boolean gen_last_on ;
   boolean data_written ;
   byte scd_evt, scd_cont ; /* SCD_xxx flags for event and continuous */
-  word pre_event_buffers ; /* number of pre-event buffers */
-  tfloat processed_stream ; /* output of this stream's FIR filter */
-  longint records_generated_session ; /* count of buffers generated this connection */
-  longword last_record_generated ; /* seconds since 2000 */
-  longint detections_session ; /* number of detections during session */
-  longint calibrations_session ; /* number of calibrations during session */
   longword gen_next ; /* general next to send */
-  piirfilter stream_iir ; /* head of this channel's IIR filter chain */
-  pavg_packet avg ; /* structure for doing averaging */
-  word mini_filter ; /* OMF_xxx bits */
-  tarc arc ; /* archival miniseed structure */
-  char control_detector_name[79] ; /* for later conversion to pointer */
+  plcq_cold cold ; /* archival and statistics */
+#endif
+  /* configuration */
+  tlocation location ; /* Seed Location */
+  tseed_name seedname ; /* Seed Channel Name */
+  string2 slocation ; /* dynamic length version */
+  string3 sseedname ;
+  boolean variable_rate_set ; /* if any new data has been added to variable rate LCQ */
+  boolean validated ; /* DP LCQ is still in tokens */
+#ifndef OMIT_SEED
+  struct tlcq *prev_link ; /* back link for checking fir-derived queue order */
+  pfilter source_fir ; /* pointer to where "fir" came from */
+  piirdef avg_source ; /* where the average filter came from */
+  longword avg_length ; /* interval in samples between reports */
+  word pre_event_buffers ; /* number of pre-event buffers */
 #endif
 } tlcq ;
 typedef tlcq *plcq ;
@@ -497,6 +518,45 @@ typedef struct {
 typedef plcq tdispatch[96] ; /* handlers for non-main data */
 typedef plcq tmdispatch[CHANNELS][FREQUENCIES] ; /* for main data */
 typedef plcq tepdispatch[256] ; /* for Environmental Processor */
+/*
+  A dispatch plan is the dispatch chain for one blockette channel flattened into
+  an array, with the way each LCQ takes its sample from the blockette already
+  worked out from the channel and raw_data_field. Ends with a NIL lcq.
+*/
+#define DH_NONE 0 /* LCQ gets nothing from this blockette, not included in plans */
+#define DH_WORD 1 /* 16 bit value */
+#define DH_SWORD 2 /* 16 bit value sign extended */
+#define DH_SUBCHAN 3 /* first 8 bit value */
+#define DH_BSUBCHAN 4 /* same sign extended */
+#define DH_HIGH 5 /* second 8 bit value */
+#define DH_BHIGH 6 /* same sign extended */
+#define DH_LOW 7 /* third 8 bit value */
+#define DH_BLOW 8 /* same sign extended */
+#define DH_BIT 9 /* bit "shift" of the first 8 bit value */
+#define DH_LONG 10 /* first 32 bit value */
+#define DH_VARIABLE 11 /* variable rate serial sensor value */
+#define DH_CLKPHASE 12 /* clock phase from the timing update */
+#define DH_CLKQUAL 13 /* current data quality */
+#define DH_WORD2 14 /* second 16 bit value */
+#define DH_SWORD3 15 /* third 16 bit value sign extended */
+#define DH_CNPSEL 16 /* 16 bit value "shift" / 2, if selected by the first 8 bit value */
+#define DH_MAIN 17 /* main digitizer data, handled by blockette type */
+typedef struct {
+  plcq lcq ;
+  byte handler ; /* DH_xxx */
+  byte shift ; /* argument for DH_BIT and DH_CNPSEL */
+} tplanstep ;
+typedef tplanstep *pplanstep ;
+typedef pplanstep tdispatchplan[96] ; /* same index as tdispatch */
+typedef pplanstep tmdispatchplan[CHANNELS][FREQUENCIES] ; /* same as tmdispatch */
+
+typedef struct { /* the data packet state process_lcq works from, a copy for each worker */
+  double timetag ; /* data_timetag when the blockette was sequenced */
+  word qual ; /* data_qual */
+  longword sequence ; /* dt_data_sequence */
+  tonesec_call *onesec ; /* where one second callbacks are built */
+} tsampctx ;
+typedef tsampctx *psampctx ;
 
 typedef struct tmsgqueue {
   struct tmsgqueue *link ;
@@ -546,6 +606,8 @@ typedef struct {
   timing timing_buf ; /* need a place to keep this between log_clock and finish_log_clock */
   tcompressed_buffer_ring detcal_buf ; /* used for building event and calibration only records */
 #endif
+  plcq lcq_slab ; /* next free LCQ in the current slab */
+  integer lcq_slab_left ; /* LCQs left in it */
   word last_sg ;
   plcq dplcqs ; /* For statistics */
   plcq msg_lcq ;
@@ -554,6 +616,8 @@ typedef struct {
   tdispatch dispatch ;
   tmdispatch mdispatch ;
   tepdispatch epdispatch ;
+  tdispatchplan dplan ; /* plans built from dispatch and mdispatch */
+  tmdispatchplan mplan ;
 #ifndef OMIT_SEED
   pmsgqueue msgqueue, msgq_in, msgq_out ;
   pfilter firchain ; /* start of fir filter chain */
@@ -37,6 +37,12 @@ Edit History:
    10 2011-03-17 rdr For Q335 new usage of deb_flags.
    11 2011-09-22 rdr In process_mult make sure have first segment, if not then don't
                      call process_lcq.
+   12 2026-10-19 gns Pass each second of data to the low latency callback, dropping
+                     seconds older than opt_latencytarget.
+   13 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
+   14 2026-10-19 gns Take the LCQ and packet state as arguments instead of from paqs so
+                     LCQs can be processed on worker threads, client callbacks are
+                     made under outlock.
 */
 #ifndef libsample_h
 #include "libsample.h"
@@ -56,11 +62,14 @@ Edit History:
 #ifndef libcvrt_h
 #include "libcvrt.h"
 #endif
-
-#ifndef OMIT_SEED
 #ifndef libsupport_h
 #include "libsupport.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
+
+#ifndef OMIT_SEED
 #ifndef libfilters_h
 #include "libfilters.h"
 #endif
@@ -180,7 +189,7 @@ begin
               result = TRUE ;
               inc(pcc->total_detections) ;
               onset_save.signal_onset_time.seed_fpt = onset_save.signal_onset_time.seed_fpt - q->delay ;
-              inc(q->detections_session) ;
+              inc(q->cold->detections_session) ;
               if (det->det_options and DO_LOG)
                 then
                   logevent (paqs, det, addr(onset_save)) ;
@@ -241,6 +250,7 @@ begin
   pq330 q330 ;
 
   q330 = paqs->owner ;
+  outlock (q330) ;
   q330->miniseed_call.context = q330 ;
   memcpy(addr(q330->miniseed_call.station_name), addr(q330->station_ident), sizeof(string9)) ;
   strcpy(addr(q330->miniseed_call.location), addr(q->slocation)) ;
@@ -252,7 +262,10 @@ begin
   q330->miniseed_call.timestamp = pbuf->hdr_buf.starting_time.seed_fpt ;
   if ((q330->miniseed_call.timestamp < JAN_1_2006) lor (q330->miniseed_call.timestamp > MAX_DATE))
     then
-      return ; /* not possible */
+      begin
+        outunlock (q330) ;
+        return ; /* not possible */
+      end
   q330->miniseed_call.filter_bits = q->mini_filter ;
   q330->miniseed_call.packet_class = q->pack_class ;
   q330->miniseed_call.miniseed_action = MSA_512 ;
@@ -261,10 +274,11 @@ begin
   if ((dest and SCD_512) land (q->mini_filter) land (q330->par_create.call_minidata))
     then
       q330->par_create.call_minidata (addr(q330->miniseed_call)) ;
-  if ((dest and SCD_ARCH) land (q->arc.amini_filter) land (q->pack_class != PKC_EVENT) land
+  if ((dest and SCD_ARCH) land (q->cold->arc.amini_filter) land (q->pack_class != PKC_EVENT) land
       (q->pack_class != PKC_CALIBRATE) land (q330->par_create.call_aminidata))
     then
       archive_512_record (paqs, q, pbuf) ;
+  outunlock (q330) ;
 end
 
 void install_header (paqstruc paqs, plcq q, pcom_packet pcom)
@@ -391,8 +405,8 @@ begin
                 if (q->scd_evt and SCD_ARCH)
                   then
                     begin /* archival output only */
-                      inc(q->records_generated_session) ;
-                      q->last_record_generated = secsince () ;
+                      inc(q->cold->records_generated_session) ;
+                      q->cold->last_record_generated = secsince () ;
                     end
                 send_to_client (paqs, q, lring, q->scd_evt) ;
                 lring->hdr_buf.activity_flags = sohsave ;
@@ -402,7 +416,7 @@ begin
   if (lnot (*now_on))
     then
       begin
-        if ((q->scd_evt and SCD_ARCH) land (*was_on) land (q->arc.amini_filter))
+        if ((q->scd_evt and SCD_ARCH) land (*was_on) land (q->cold->arc.amini_filter))
           then
             flush_archive (paqs, q) ;
         *was_on = FALSE ; /* contiguity broken */
@@ -448,8 +462,8 @@ begin
         if (q->scd_cont and SCD_ARCH)
           then
             begin /* archival output only */
-              inc(q->records_generated_session) ;
-              q->last_record_generated = secsince () ;
+              inc(q->cold->records_generated_session) ;
+              q->cold->last_record_generated = secsince () ;
             end
         send_to_client (paqs, q, pcom->ring, q->scd_cont) ;
         phdr->activity_flags = sohsave ;
@@ -511,7 +525,7 @@ begin
             end
         finish_record (paqs, q, pcom) ;
       end
-  if ((q->arc.amini_filter) land (q->arc.total_frames > 1))
+  if ((q->cold->arc.amini_filter) land (q->cold->arc.total_frames > 1))
     then
       flush_archive (paqs, q) ;
 end
@@ -558,6 +572,7 @@ begin
   seed_header *phdr ;
 
   q330 = paqs->owner ;
+  outlock (q330) ; /* detcal_buf is shared */
   memset (addr(paqs->detcal_buf), 0, sizeof(tcompressed_buffer_ring)) ;
   phdr = addr(paqs->detcal_buf.hdr_buf) ;
   phdr->starting_time.seed_fpt = time ;
@@ -587,6 +602,7 @@ begin
   q->pack_class = pclass ; /* override normal data class */
   send_to_client (paqs, q, addr(paqs->detcal_buf), SCD_BOTH) ;
   q->pack_class = PKC_DATA ; /* restore to normal */
+  outunlock (q330) ;
 end
 
 void set_slip (paqstruc paqs, plcq q)
@@ -617,7 +633,33 @@ begin
 end
 #endif
 
-void process_lcq (paqstruc paqs, plcq q, integer src_samp, tfloat dv)
+/* a second of data for the low latency callback, unless it is already
+  too old to meet the latency target, as when catching up a backlog */
+static void send_lowlatency (pq330 q330, tonesec_call *pcall)
+begin
+
+  if ((q330->par_register.opt_latencytarget) land
+      ((now () - pcall->timestamp) > q330->par_register.opt_latencytarget))
+    then
+      return ;
+  q330->par_create.call_lowlatency (pcall) ;
+end
+
+/* the one second callbacks for an LCQ, one client callback at a time */
+static void send_onesec (pq330 q330, plcq q, tonesec_call *pcall)
+begin
+
+  outlock (q330) ;
+  if (q->onesec_filter)
+    then
+      q330->par_create.call_secdata (pcall) ;
+  if (q->lowlat)
+    then
+      send_lowlatency (q330, pcall) ;
+  outunlock (q330) ;
+end
+
+void process_lcq (paqstruc paqs, plcq q, psampctx ctx, integer src_samp, tfloat dv)
 begin
   string95 s ;
   string31 s1, s2 ;
@@ -645,14 +687,14 @@ begin
   if (q->slipping)
     then
       begin /* for derived, see if reached modulus */
-        int_time = lib_round((src_samp - 1) * q->input_sample_rate + paqs->data_timetag) ;
+        int_time = lib_round((src_samp - 1) * q->input_sample_rate + ctx->timetag) ;
         if ((int_time mod q->slip_modulus) == (q->slip_modulus - 1))
           then
             q->slipping = FALSE ;
           else
             return ;
       end
-  if (paqs->data_timetag < 1)
+  if (ctx->timetag < 1)
     then
       q->com->charging = TRUE ;
 #endif
@@ -660,14 +702,14 @@ begin
     then
       begin
         q->timemark_occurred = TRUE ; /* fist sample */
-        if ((q->last_timetag > 1) land (fabs(paqs->data_timetag - q->last_timetag - q->gap_offset) > q->gap_secs))
+        if ((q->last_timetag > 1) land (fabs(ctx->timetag - q->last_timetag - q->gap_offset) > q->gap_secs))
           then
             begin
               if (q330->cur_verbosity and VERB_LOGEXTRA)
                 then
                   begin
                     sprintf(s, "%s %s", seed2string(q->location, q->seedname, addr(s1)),
-                            realtostr(paqs->data_timetag - q->last_timetag - q->gap_offset, 6, addr(s2))) ;
+                            realtostr(ctx->timetag - q->last_timetag - q->gap_offset, 6, addr(s2))) ;
                     libdatamsg (q330, LIBMSG_TIMEDISC, addr(s)) ;
                   end
 #ifndef OMIT_SEED
@@ -675,8 +717,8 @@ begin
               set_slip (paqs, q) ;
 #endif
             end
-        q->last_timetag = paqs->data_timetag ;
-        q->dtsequence = paqs->dt_data_sequence ;
+        q->last_timetag = ctx->timetag ;
+        q->dtsequence = ctx->sequence ;
       end
   dsamp = 0 ;
   sf = 0.0 ;
@@ -754,7 +796,7 @@ begin
 #endif
       end
 #ifndef OMIT_SEED
-  run_detector_chain (paqs, q, paqs->data_timetag) ;
+  run_detector_chain (paqs, q, ctx->timetag) ;
 #endif
   if (q->calstat)
     then
@@ -791,7 +833,7 @@ begin
             down = q->downstream_link ;
             while (down)
               begin
-                process_lcq (paqs, down->derived_q, i, sf) ;
+                process_lcq (paqs, down->derived_q, ctx, i, sf) ;
                 down = down->link ;
               end
             if (q->avg_filt)
@@ -811,56 +853,56 @@ begin
     then
       begin
         q->timemark_occurred = FALSE ;
-        if ((paqs->data_qual > q->timequal) lor (q->timetag == 0))
+        if ((ctx->qual > q->timequal) lor (q->timetag == 0))
           then
             begin
-              q->timetag = paqs->data_timetag ;
-              q->timequal = paqs->data_qual ;
+              q->timetag = ctx->timetag ;
+              q->timequal = ctx->qual ;
 #ifndef OMIT_SEED
               q->com->time_mark_sample = q->com->peek_total + q->com->next_compressed_sample ;
 #endif
             end
       end
   p1 = (pointer)q->databuf ;
-  if (q->onesec_filter)
+  if ((q->onesec_filter) lor (q->lowlat))
     then
       begin
-        q330->onesec_call.total_size = sizeof(tonesec_call) - ((MAX_RATE - samples) * sizeof(longint)) ;
-        q330->onesec_call.context = q330 ;
-        memcpy(addr(q330->onesec_call.station_name), addr(q330->station_ident), sizeof(string9)) ;
-        strcpy(addr(q330->onesec_call.location), addr(q->slocation)) ;
-        strcpy(addr(q330->onesec_call.channel), addr(q->sseedname)) ;
-        q330->onesec_call.chan_number = q->lcq_num ;
-        q330->onesec_call.cl_session = 0 ;
-        q330->onesec_call.cl_offset = 0 ;
-        q330->onesec_call.timestamp = paqs->data_timetag - q->delay ;
-        q330->onesec_call.qual_perc = paqs->data_qual ;
-        q330->onesec_call.filter_bits = q->onesec_filter ;
-        q330->onesec_call.rate = q->rate ;
-        q330->onesec_call.activity_flags = 0 ;
+        ctx->onesec->total_size = sizeof(tonesec_call) - ((MAX_RATE - samples) * sizeof(longint)) ;
+        ctx->onesec->context = q330 ;
+        memcpy(addr(ctx->onesec->station_name), addr(q330->station_ident), sizeof(string9)) ;
+        strcpy(addr(ctx->onesec->location), addr(q->slocation)) ;
+        strcpy(addr(ctx->onesec->channel), addr(q->sseedname)) ;
+        ctx->onesec->chan_number = q->lcq_num ;
+        ctx->onesec->cl_session = 0 ;
+        ctx->onesec->cl_offset = 0 ;
+        ctx->onesec->timestamp = ctx->timetag - q->delay ;
+        ctx->onesec->qual_perc = ctx->qual ;
+        ctx->onesec->filter_bits = q->onesec_filter ;
+        ctx->onesec->rate = q->rate ;
+        ctx->onesec->activity_flags = 0 ;
 #ifndef OMIT_SEED
         if (q->gen_on)
           then
-            q330->onesec_call.activity_flags = q330->onesec_call.activity_flags or SAF_EVENT_IN_PROGRESS ;
+            ctx->onesec->activity_flags = ctx->onesec->activity_flags or SAF_EVENT_IN_PROGRESS ;
 #endif
         if (q->cal_on)
           then
-            q330->onesec_call.activity_flags = q330->onesec_call.activity_flags or SAF_CAL_IN_PROGRESS ;
-        if (paqs->data_qual >= q330->qclock.q_off)
+            ctx->onesec->activity_flags = ctx->onesec->activity_flags or SAF_CAL_IN_PROGRESS ;
+        if (ctx->qual >= q330->qclock.q_off)
          then
-           q330->onesec_call.io_flags = SIF_LOCKED ;
+           ctx->onesec->io_flags = SIF_LOCKED ;
          else
-           q330->onesec_call.io_flags = 0 ;
-        if (paqs->data_qual < q330->qclock.q_low)
+           ctx->onesec->io_flags = 0 ;
+        if (ctx->qual < q330->qclock.q_low)
           then
-            q330->onesec_call.data_quality_flags = SQF_QUESTIONABLE_TIMETAG ;
+            ctx->onesec->data_quality_flags = SQF_QUESTIONABLE_TIMETAG ;
           else
-            q330->onesec_call.data_quality_flags = 0 ;
-        q330->onesec_call.src_channel = q->raw_data_source ;
-        q330->onesec_call.src_subchan = q->raw_data_field ;
+            ctx->onesec->data_quality_flags = 0 ;
+        ctx->onesec->src_channel = q->raw_data_source ;
+        ctx->onesec->src_subchan = q->raw_data_field ;
         if ((samples > 1) land (src_samp < 0))
           then
-            memcpy (addr(q330->onesec_call.samples), q->databuf, samples * sizeof(longint)) ;
+            memcpy (addr(ctx->onesec->samples), q->databuf, samples * sizeof(longint)) ;
       end
   if (src_samp >= 0)
     then
@@ -871,19 +913,19 @@ begin
             q->com->peeks[q->com->next_in] = dsamp ;
           else
             q->com->peeks[q->com->next_in] = *p1 ;
-        q330->onesec_call.samples[0] = q->com->peeks[q->com->next_in] ;
+        ctx->onesec->samples[0] = q->com->peeks[q->com->next_in] ;
         q->com->next_in = (q->com->next_in + 1) and (PEEKELEMS - 1) ;
         inc(q->com->peek_total) ;
 #else
         if (src_samp)
           then
-            q330->onesec_call.samples[0] = dsamp ;
+            ctx->onesec->samples[0] = dsamp ;
           else
-            q330->onesec_call.samples[0] = *p1 ;
+            ctx->onesec->samples[0] = *p1 ;
 #endif
-        if (q->onesec_filter)
+        if ((q->onesec_filter) lor (q->lowlat))
           then
-            q330->par_create.call_secdata (addr(q330->onesec_call)) ;
+            send_onesec (q330, q, ctx->onesec) ;
 #ifndef OMIT_SEED
         if (q->com->peek_total < MAXSAMPPERWORD)
           then
@@ -920,9 +962,9 @@ begin
 #else
         samples = 0 ;
 #endif
-        if (q->onesec_filter)
+        if ((q->onesec_filter) lor (q->lowlat))
           then
-            q330->par_create.call_secdata (addr(q330->onesec_call)) ;
+            send_onesec (q330, q, ctx->onesec) ;
       end
 end
 
@@ -931,6 +973,7 @@ void flush_lcqs (paqstruc paqs)
 begin
   plcq q ;
 
+  drain_workers (paqs->owner) ;
   q = paqs->lcqs ;
   while (q)
     begin
@@ -960,6 +1003,7 @@ begin
   plcq q ;
   paqstruc paqs ;
 
+  drain_workers (q330) ;
   paqs = q330->aqstruc ;
   q = paqs->dplcqs ;
   while (q)
@@ -977,58 +1021,54 @@ begin
 end
 #endif
 
-void process_one (pq330 q330, longint data)
+void process_one (pq330 q330, plcq q, psampctx ctx, longint data)
 begin
   paqstruc paqs ;
-  plcq q ;
   string15 s ;
 
   paqs = q330->aqstruc ;
-  q = paqs->proc_lcq ;
-  if (paqs->data_timetag < 1)
+  if (ctx->timetag < 1)
     then
       begin
         libdatamsg (q330, LIBMSG_DISCARD, seed2string(q->location, q->seedname, addr(s))) ;
         return ; /* don't know what time it is yet */
       end
-  if (seqspread (paqs->dt_data_sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
+  if (seqspread (ctx->sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
     then
       begin
-        if (abs(seqspread(paqs->dt_data_sequence, q->dtsequence)) > MAXSPREAD)
+        if (abs(seqspread(ctx->sequence, q->dtsequence)) > MAXSPREAD)
           then
-            q->dtsequence = paqs->dt_data_sequence ; /* if we're not within continuity distance, forget it */
+            q->dtsequence = ctx->sequence ; /* if we're not within continuity distance, forget it */
         return ;
       end
   (*(q->databuf))[0] = data ; /* just one data point */
-  process_lcq (paqs, q, 0, 0.0) ;
+  process_lcq (paqs, q, ctx, 0, 0.0) ;
 end
 
-void process_comp (pq330 q330, pbyte p, integer size)
+void process_comp (pq330 q330, plcq q, psampctx ctx, pbyte p, integer size)
 begin
   paqstruc paqs ;
   pbyte psave ;
   word offset ;
-  plcq q ;
   tprecomp *pcmp ;
   string15 s ;
 
   psave = p ;
   decn(psave, 4) ; /* we have already read the first four bytes */
   paqs = q330->aqstruc ;
-  q = paqs->proc_lcq ;
   pcmp = addr(q->precomp) ;
-  if (paqs->data_timetag < 1)
+  if (ctx->timetag < 1)
     then
       begin
         libdatamsg (q330, LIBMSG_DISCARD, seed2string(q->location, q->seedname, addr(s))) ;
         return ; /* don't know what time it is yet */
       end
-  if (seqspread (paqs->dt_data_sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
+  if (seqspread (ctx->sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
     then
       begin
-        if (abs(seqspread(paqs->dt_data_sequence, q->dtsequence)) > MAXSPREAD)
+        if (abs(seqspread(ctx->sequence, q->dtsequence)) > MAXSPREAD)
           then
-            q->dtsequence = paqs->dt_data_sequence ; /* if we're not within continuity distance, forget it */
+            q->dtsequence = ctx->sequence ; /* if we're not within continuity distance, forget it */
         return ;
       end
   pcmp->prev_sample = loadlongint (addr(p)) ;
@@ -1038,10 +1078,10 @@ begin
   pcmp->pdata = psave ; /* data starts here */
   pcmp->blocks = (size - offset) shr 2 ; /* number of 32 bit blocks */
   pcmp->mapidx = 0 ;
-  process_lcq (paqs, q, -1, 0.0) ;
+  process_lcq (paqs, q, ctx, -1, 0.0) ;
 end
 
-void process_mult (pq330 q330, pbyte psave, longword seq)
+void process_mult (pq330 q330, plcq q, psampctx ctx, pbyte psave, longword seq)
 begin
   paqstruc paqs ;
   word offset ;
@@ -1050,7 +1090,6 @@ begin
   boolean have_first ;
   word size ;
   pbyte p ;
-  plcq q ;
   tprecomp *pcmp ;
   string15 s ;
 
@@ -1059,21 +1098,20 @@ begin
   loadbyte (addr(p)) ;
   seg_freq = loadbyte (addr(p)) ;
   size = loadword (addr(p)) ;
-  q = paqs->proc_lcq ;
   pcmp = addr(q->precomp) ;
   seed2string(q->location, q->seedname, addr(s)) ;
-  if (paqs->data_timetag < 1)
+  if (ctx->timetag < 1)
     then
       begin
         libdatamsg (q330, LIBMSG_DISCARD, addr(s)) ;
         return ; /* don't know what time it is yet */
       end
-  if (seqspread (paqs->dt_data_sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
+  if (seqspread (ctx->sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
     then
       begin
-        if (abs(seqspread(paqs->dt_data_sequence, q->dtsequence)) > MAXSPREAD)
+        if (abs(seqspread(ctx->sequence, q->dtsequence)) > MAXSPREAD)
           then
-            q->dtsequence = paqs->dt_data_sequence ; /* if we're not within continuity distance, forget it */
+            q->dtsequence = ctx->sequence ; /* if we're not within continuity distance, forget it */
         return ;
       end
   if (seq != q->seg_seq)
@@ -1183,14 +1221,14 @@ begin
         q->seg_seq = 0xFFFFFFFF ; /* flag as all used up */
         if (have_first)
           then
-            process_lcq (paqs, q, -1, 0.0) ;
+            process_lcq (paqs, q, ctx, -1, 0.0) ;
       end
   if (q->dholdq)
     then
       q->dholdq->ppkt = NIL ;
 end
 
-void process_variable (pq330 q330, integer sps, integer dly5ms, longint data)
+void process_variable (pq330 q330, plcq q, psampctx ctx, integer sps, integer dly5ms, longint data)
 begin
 #ifndef OMIT_SEED
   pdownstream_packet down ;
@@ -1198,24 +1236,22 @@ begin
   single r ;
 #endif
   paqstruc paqs ;
-  plcq q ;
   string15 s ;
   integer adjrate ;
 
   paqs = q330->aqstruc ;
-  q = paqs->proc_lcq ;
-  if (paqs->data_timetag < 1)
+  if (ctx->timetag < 1)
     then
       begin
         libdatamsg (q330, LIBMSG_DISCARD, seed2string(q->location, q->seedname, addr(s))) ;
         return ; /* don't know what time it is yet */
       end
-  if (seqspread (paqs->dt_data_sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
+  if (seqspread (ctx->sequence, q->dtsequence) <= 0) /* has this second of data already been processed? */
     then
       begin
-        if (abs(seqspread(paqs->dt_data_sequence, q->dtsequence)) > MAXSPREAD)
+        if (abs(seqspread(ctx->sequence, q->dtsequence)) > MAXSPREAD)
           then
-            q->dtsequence = paqs->dt_data_sequence ; /* if we're not within continuity distance, forget it */
+            q->dtsequence = ctx->sequence ; /* if we're not within continuity distance, forget it */
         return ;
       end
   if (sps == 1)
@@ -1266,5 +1302,5 @@ begin
 #endif
       end
   (*(q->databuf))[0] = data ;
-  process_lcq (paqs, q, 0, 0.0) ;
+  process_lcq (paqs, q, ctx, 0, 0.0) ;
 end
@@ -21,11 +21,12 @@ Edit History:
    Ed Date       By  Changes
    -- ---------- --- ---------------------------------------------------
     0 2006-10-01 rdr Created
+    1 2026-10-19 gns process_xxx take the LCQ and a tsampctx.
 */
 #ifndef libsample_h
 /* Flag this file as included */
 #define libsample_h
-#define VER_LIBSAMPLE 11
+#define VER_LIBSAMPLE 14
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -37,10 +38,10 @@ Edit History:
 
 extern longint sex (longint l) ;
 extern longint bsex (longint l) ;
-extern void process_one (pq330 q330, longint data) ;
-extern void process_comp (pq330 q330, pbyte p, integer size) ;
-extern void process_mult (pq330 q330, pbyte psave, longword seq) ;
-extern void process_variable (pq330 q330, integer sps, integer dly5ms, longint data) ;
+extern void process_one (pq330 q330, plcq q, psampctx ctx, longint data) ;
+extern void process_comp (pq330 q330, plcq q, psampctx ctx, pbyte p, integer size) ;
+extern void process_mult (pq330 q330, plcq q, psampctx ctx, pbyte psave, longword seq) ;
+extern void process_variable (pq330 q330, plcq q, psampctx ctx, integer sps, integer dly5ms, longint data) ;
 extern longint seqspread (longword new_, longword last) ;
 extern word translate_clock (tclock *qclock, word qual, word loss) ;
 
@@ -22,6 +22,10 @@ Edit History:
    -- ---------- --- ---------------------------------------------------
     0 2006-09-10 rdr Created
     1 2008-03-13 rdr Use modulus to restrict SEED record number to between 1 and 999999.
+    2 2026-10-19 gns Add convert_seed_time, filling the seed time straight from the cached
+                     calendar in libtime, and use it in storeseedhdr.
+    3 2026-10-19 gns storeseedhdr and loadseedhdr generated from a single fixed layout
+                     description of the header and its blockettes.
 */
 #ifndef libseed_h
 #include "libseed.h"
@@ -34,6 +38,9 @@ Edit History:
 #ifndef libcvrt_h
 #include "libcvrt.h"
 #endif
+#ifndef libtime_h
+#include "libtime.h"
+#endif
 #endif
 /* convert seedname and location into string */
 char *seed2string(tlocation *loc, tseed_name *sn, pchar result)
@@ -79,23 +86,29 @@ begin
   st->seed_jday = day_julian (greg->wyear, greg->wmonth, greg->wday) ;
 end
 
-void fix_seed_header (seed_header *hdr, tsystemtime *greg,
-                           longint usec, boolean setdeb)
+static void fix_seed_sequence (seed_header *hdr, longint usec, boolean setdeb)
 begin
   string7 s ;
   longword recnum ;
 
   recnum = ((hdr->sequence.seed_num - 1) mod 999999) + 1 ; /* restrict to 1 .. 999999 */
-  sprintf(s, "%d", recnum) ;
-  zpad(addr(s), 6) ;
+  sprintf(s, "%06d", recnum) ;
   memcpy(addr(hdr->sequence.seed_num), addr(s), 6) ;
-  lib330_seed_time (addr(hdr->starting_time), greg, usec) ;
   if (setdeb)
     then
       hdr->deb.usec99 = usec mod 100 ;
 end
 
-void convert_time (double fp, tsystemtime *greg, longint *usec)
+void fix_seed_header (seed_header *hdr, tsystemtime *greg,
+                           longint usec, boolean setdeb)
+begin
+
+  lib330_seed_time (addr(hdr->starting_time), greg, usec) ;
+  fix_seed_sequence (hdr, usec, setdeb) ;
+end
+
+/* whole seconds, with the microseconds left over */
+static longint split_time (double fp, longint *usec)
 begin
   longint jul ;
   double fjul, fusec ;
@@ -116,7 +129,28 @@ begin
         jul = jul + 1 ;
         *usec = *usec - 1000000 ;
       end
-  lib330_gregorian (jul, greg) ;
+  return jul ;
+end
+
+void convert_time (double fp, tsystemtime *greg, longint *usec)
+begin
+
+  lib330_gregorian (split_time (fp, usec), greg) ;
+end
+
+/* same as convert_time followed by lib330_seed_time, without going through months */
+void convert_seed_time (double fp, tseed_time *st, longint *usec)
+begin
+  tcalendar cal ;
+
+  lib330_calendar (split_time (fp, usec), addr(cal)) ;
+  st->seed_yr = cal.year ;
+  st->seed_jday = cal.jday ;
+  st->seed_hr = (byte)cal.hour ;
+  st->seed_minute = (byte)cal.minute ;
+  st->seed_seconds = (byte)cal.second ;
+  st->seed_unused = 0 ;
+  st->seed_tenth_millisec = *usec div 100 ;
 end
 
 double extract_time (tseed_time *st, byte usec)
@@ -159,52 +193,70 @@ begin
   storeword (p, seedtime->seed_tenth_millisec) ;
 end
 
+/* Wire layout of the fixed header and data only blockette, common to all records */
+#define SEED_FIXED_SIZE 56
+#define SEED_FIXED_LAYOUT(F) \
+  F(BLOCK, 0, 6, sequence.seed_ch) \
+  F(CHAR, 6, 0, seed_record_type) \
+  F(CHAR, 7, 0, continuation_record) \
+  F(BLOCK, 8, 5, station_id_call_letters) \
+  F(BLOCK, 13, 2, location_id) \
+  F(BLOCK, 15, 3, channel_id) \
+  F(BLOCK, 18, 2, seednet) \
+  F(WORD, 20, 0, starting_time.seed_yr) \
+  F(WORD, 22, 0, starting_time.seed_jday) \
+  F(BYTE, 24, 0, starting_time.seed_hr) \
+  F(BYTE, 25, 0, starting_time.seed_minute) \
+  F(BYTE, 26, 0, starting_time.seed_seconds) \
+  F(BYTE, 27, 0, starting_time.seed_unused) \
+  F(WORD, 28, 0, starting_time.seed_tenth_millisec) \
+  F(WORD, 30, 0, samples_in_record) \
+  F(INT16, 32, 0, sample_rate_factor) \
+  F(INT16, 34, 0, sample_rate_multiplier) \
+  F(BYTE, 36, 0, activity_flags) \
+  F(BYTE, 37, 0, io_flags) \
+  F(BYTE, 38, 0, data_quality_flags) \
+  F(BYTE, 39, 0, number_of_following_blockettes) \
+  F(LONGINT, 40, 0, tenth_msec_correction) \
+  F(WORD, 44, 0, first_data_byte) \
+  F(WORD, 46, 0, first_blockette_byte) \
+  F(WORD, 48, 0, dob.blockette_type) \
+  F(WORD, 50, 0, dob.next_blockette) \
+  F(BYTE, 52, 0, dob.encoding_format) \
+  F(BYTE, 53, 0, dob.word_order) \
+  F(BYTE, 54, 0, dob.rec_length) \
+  F(BYTE, 55, 0, dob.dob_reserved)
+/* Data extension blockette, only in data records */
+#define SEED_DEB_SIZE 8
+#define SEED_DEB_LAYOUT(F) \
+  F(WORD, 56, 0, deb.blockette_type) \
+  F(WORD, 58, 0, deb.next_blockette) \
+  F(BYTE, 60, 0, deb.qual) \
+  F(BYTE, 61, 0, deb.usec99) \
+  F(BYTE, 62, 0, deb.deb_flags) \
+  F(BYTE, 63, 0, deb.frame_count)
+
 void storeseedhdr (pbyte *pdest, seed_header *hdr, boolean hasdeb)
 begin
-  tsystemtime newtime ;
   longint newusec ;
   double time_save ;
   longword seq_save ;
+  pbyte wire ;
+  seed_header *rec ;
 
   time_save = hdr->starting_time.seed_fpt ;
   seq_save = hdr->sequence.seed_num ;
-  convert_time (hdr->starting_time.seed_fpt, addr(newtime), addr(newusec)) ;
-  fix_seed_header (hdr, addr(newtime), newusec, hasdeb) ;
-  storeblock (pdest, 6, addr(hdr->sequence.seed_ch)) ;
-  storebyte (pdest, (byte)hdr->seed_record_type) ;
-  storebyte (pdest, (byte)hdr->continuation_record) ;
-  storeblock (pdest, 5, addr(hdr->station_id_call_letters)) ;
-  storeblock (pdest, 2, addr(hdr->location_id)) ;
-  storeblock (pdest, 3, addr(hdr->channel_id)) ;
-  storeblock (pdest, 2, addr(hdr->seednet)) ;
-  storetime (pdest, addr(hdr->starting_time)) ;
-  storeword (pdest, hdr->samples_in_record) ;
-  storeint16 (pdest, hdr->sample_rate_factor) ;
-  storeint16 (pdest, hdr->sample_rate_multiplier) ;
-  storebyte (pdest, hdr->activity_flags) ;
-  storebyte (pdest, hdr->io_flags) ;
-  storebyte (pdest, hdr->data_quality_flags) ;
-  storebyte (pdest, hdr->number_of_following_blockettes) ;
-  storelongint (pdest, hdr->tenth_msec_correction) ;
-  storeword (pdest, hdr->first_data_byte) ;
-  storeword (pdest, hdr->first_blockette_byte) ;
-  /* all seed records have this one */
-  storeword (pdest, hdr->dob.blockette_type) ;
-  storeword (pdest, hdr->dob.next_blockette) ;
-  storebyte (pdest, hdr->dob.encoding_format) ;
-  storebyte (pdest, hdr->dob.word_order) ;
-  storebyte (pdest, hdr->dob.rec_length) ;
-  storebyte (pdest, hdr->dob.dob_reserved) ;
-  /* only data records have this one */
+  convert_seed_time (hdr->starting_time.seed_fpt, addr(hdr->starting_time), addr(newusec)) ;
+  fix_seed_sequence (hdr, newusec, hasdeb) ;
+  wire = *pdest ;
+  rec = hdr ;
+  SEED_FIXED_LAYOUT(CVRT_STORE)
+  incn(*pdest, SEED_FIXED_SIZE) ;
   if (hasdeb)
     then
       begin
-        storeword (pdest, hdr->deb.blockette_type) ;
-        storeword (pdest, hdr->deb.next_blockette) ;
-        storebyte (pdest, hdr->deb.qual) ;
-        storebyte (pdest, hdr->deb.usec99) ;
-        storebyte (pdest, hdr->deb.deb_flags) ;
-        storebyte (pdest, hdr->deb.frame_count) ;
+        SEED_DEB_LAYOUT(CVRT_STORE)
+        incn(*pdest, SEED_DEB_SIZE) ;
       end
   hdr->starting_time.seed_fpt = time_save ;
   hdr->sequence.seed_num = seq_save ;
@@ -369,40 +421,18 @@ end
 
 void loadseedhdr (pbyte *psrc, seed_header *hdr, boolean hasdeb)
 begin
+  pbyte wire ;
+  seed_header *rec ;
 
-  loadblock (psrc, 6, addr(hdr->sequence.seed_ch)) ;
-  hdr->seed_record_type = (char)loadbyte (psrc) ;
-  hdr->continuation_record = (char)loadbyte (psrc) ;
-  loadblock (psrc, 5, addr(hdr->station_id_call_letters)) ;
-  loadblock (psrc, 2, addr(hdr->location_id)) ;
-  loadblock (psrc, 3, addr(hdr->channel_id)) ;
-  loadblock (psrc, 2, addr(hdr->seednet)) ;
-  loadtime (psrc, addr(hdr->starting_time)) ;
-  hdr->samples_in_record = loadword (psrc) ;
-  hdr->sample_rate_factor = loadint16 (psrc) ;
-  hdr->sample_rate_multiplier = loadint16 (psrc) ;
-  hdr->activity_flags = loadbyte (psrc) ;
-  hdr->io_flags = loadbyte (psrc) ;
-  hdr->data_quality_flags = loadbyte (psrc) ;
-  hdr->number_of_following_blockettes = loadbyte (psrc) ;
-  hdr->tenth_msec_correction = loadlongint (psrc) ;
-  hdr->first_data_byte = loadword (psrc) ;
-  hdr->first_blockette_byte = loadword (psrc) ;
-  hdr->dob.blockette_type = loadword (psrc) ;
-  hdr->dob.next_blockette = loadword (psrc) ;
-  hdr->dob.encoding_format = loadbyte (psrc) ;
-  hdr->dob.word_order = loadbyte (psrc) ;
-  hdr->dob.rec_length = loadbyte (psrc) ;
-  hdr->dob.dob_reserved = loadbyte (psrc) ;
+  wire = *psrc ;
+  rec = hdr ;
+  SEED_FIXED_LAYOUT(CVRT_LOAD)
+  incn(*psrc, SEED_FIXED_SIZE) ;
   if (hasdeb)
     then
       begin
-        hdr->deb.blockette_type = loadword (psrc) ;
-        hdr->deb.next_blockette = loadword (psrc) ;
-        hdr->deb.qual = loadbyte (psrc) ;
-        hdr->deb.usec99 = loadbyte (psrc) ;
-        hdr->deb.deb_flags = loadbyte (psrc) ;
-        hdr->deb.frame_count = loadbyte (psrc) ;
+        SEED_DEB_LAYOUT(CVRT_LOAD)
+        incn(*psrc, SEED_DEB_SIZE) ;
       end
 end
 
@@ -23,11 +23,12 @@ Edit History:
     0 2006-09-10 rdr Created
     1 2007-01-08 hjs prefaced some functions with lib330 to avoid collisions
     2 2011-03-17 rdr Add new deb_flags definitions.
+    3 2026-10-19 gns Add convert_seed_time.
 */
 #ifndef libseed_h
 /* Flag this file as included */
 #define libseed_h
-#define VER_LIBSEED 3
+#define VER_LIBSEED 5
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -294,6 +295,7 @@ extern void loadblkhdr (pbyte *p, blk_min *blk) ;
 extern void loadtime (pbyte *p, tseed_time *seedtime) ;
 extern void loadseedhdr (pbyte *psrc, seed_header *hdr, boolean hasdeb) ;
 extern void convert_time (double fp, tsystemtime *greg, longint *usec) ;
+extern void convert_seed_time (double fp, tseed_time *st, longint *usec) ;
 extern double extract_time (tseed_time *st, byte usec) ;
 extern void loadtiming (pbyte *psrc, timing *tim) ;
 extern void loadmurdock (pbyte *psrc, murdock_detect *mdet) ;
@@ -42,6 +42,13 @@ Edit History:
    13 2009-09-13 rdr Fix error message for ST32_DRIFT.
    14 2010-12-22 rdr Add Sensor control blockette handling.
    15 2011-02-18 rdr Add handling of FE PLL blockettes.
+   16 2026-10-19 gns Don't send data acks while replaying captured packets.
+   17 2026-10-19 gns Record packet level debug with libpktmsg.
+   18 2026-10-19 gns Process non-main and main data blockettes from the dispatch plans.
+   19 2026-10-19 gns Pass main digitizer blockettes to process_main, which may queue them
+                     for an LCQ worker thread. Wait for the workers before changing calibration
+                     state they look at.
+   20 2026-10-19 gns Report the time from registration to the first data packet.
 */
 #ifndef libtypes_h
 #include "libtypes.h"
@@ -96,6 +103,9 @@ Edit History:
 #ifndef libdss_h
 #include "libdss.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 #endif
 
 void allocate_packetbuffers (pq330 q330)
@@ -161,7 +171,7 @@ void send_dopen (pq330 q330)
 begin
   pbyte p, pref, psave ;
   integer lth, msglth, err ;
-  string95 s, s1 ;
+  string95 s1 ;
 
   q330->ack_timeout = 0 ;
   q330->ack_counter = 0 ;
@@ -185,13 +195,7 @@ begin
       begin /* log the message sent */
         p = addr(q330->dataout.qdp) ;
         loadqdphdr (addr(p), addr(q330->recvhdr)) ; /* for display purposes */
-        packet_time (now(), addr(s)) ;
-        command_name (q330->recvhdr.command, addr(s1)) ;
-        strcat (s, s1) ;
-        sprintf(s1, ", Lth=%d Seq=%d Ack=%d", q330->recvhdr.datalength, q330->recvhdr.sequence,
-                q330->recvhdr.acknowledge) ;
-        strcat(s, s1) ;
-        libmsgadd(q330, LIBMSG_PKTOUT, addr(s)) ;
+        libpktmsg (q330, LIBMSG_PKTOUT, 0, 0, NIL) ;
       end
 #ifndef OMIT_NETWORK
   if (q330->usesock)
@@ -270,6 +274,105 @@ const tpwrph pwrph = {"Not Charging", "Bulk", "Absorption", "Float", "Equalizati
 const tgpscold gpscold = {"Command Received", "Reception Timeout",
                       "GPS & RTC out of phase ", "Large time jump"} ;
 
+/* Snapshot of the packet state for process_lcq, callbacks are built in the context */
+static void set_sampctx (pq330 q330, psampctx ctx)
+begin
+  paqstruc paqs ;
+
+  paqs = q330->aqstruc ;
+  ctx->timetag = paqs->data_timetag ;
+  ctx->qual = paqs->data_qual ;
+  ctx->sequence = paqs->dt_data_sequence ;
+  ctx->onesec = addr(q330->onesec_call) ;
+end
+
+/* Pass the values from a non-main data blockette to each LCQ in its plan */
+static void run_plan (pq330 q330, pplanstep ps, byte subchan, word wordval, word wordval2,
+                      word wordval3, longint lval1, longint lval2)
+begin
+  tsampctx ctx ;
+  word w ;
+  integer diff ;
+
+  set_sampctx (q330, addr(ctx)) ;
+  while (ps->lcq)
+    begin
+      switch (ps->handler) begin
+        case DH_WORD :
+          process_one (q330, ps->lcq, addr(ctx), wordval) ;
+          break ;
+        case DH_SWORD :
+          process_one (q330, ps->lcq, addr(ctx), sex(wordval)) ;
+          break ;
+        case DH_SUBCHAN :
+          process_one (q330, ps->lcq, addr(ctx), subchan) ;
+          break ;
+        case DH_BSUBCHAN :
+          process_one (q330, ps->lcq, addr(ctx), bsex(subchan)) ;
+          break ;
+        case DH_HIGH :
+          process_one (q330, ps->lcq, addr(ctx), wordval shr 8) ;
+          break ;
+        case DH_BHIGH :
+          process_one (q330, ps->lcq, addr(ctx), bsex(wordval shr 8)) ;
+          break ;
+        case DH_LOW :
+          process_one (q330, ps->lcq, addr(ctx), wordval and 255) ;
+          break ;
+        case DH_BLOW :
+          process_one (q330, ps->lcq, addr(ctx), bsex(wordval and 255)) ;
+          break ;
+        case DH_BIT :
+          process_one (q330, ps->lcq, addr(ctx), (subchan shr ps->shift) and 1) ;
+          break ;
+        case DH_LONG :
+          process_one (q330, ps->lcq, addr(ctx), lval1) ;
+          break ;
+        case DH_VARIABLE :
+          process_variable (q330, ps->lcq, addr(ctx), subchan, wordval, lval1) ;
+          break ;
+        case DH_CLKPHASE :
+          diff = lval2 ;
+          if (diff >= 500000)
+            then
+              diff = diff - 1000000 ;
+          process_one (q330, ps->lcq, addr(ctx), diff) ;
+          break ;
+        case DH_CLKQUAL :
+          process_one (q330, ps->lcq, addr(ctx), ctx.qual) ;
+          break ;
+        case DH_WORD2 :
+          process_one (q330, ps->lcq, addr(ctx), wordval2) ;
+          break ;
+        case DH_SWORD3 :
+          process_one (q330, ps->lcq, addr(ctx), sex(wordval3)) ;
+          break ;
+        case DH_CNPSEL :
+          switch (ps->shift) begin
+            case 0 :
+              w = wordval ;
+              break ;
+            case 2 :
+              w = wordval2 ;
+              break ;
+            default :
+              w = wordval3 ;
+              break ;
+          end
+          switch ((subchan shr ps->shift) and 3) begin
+            case 1 :
+              process_one (q330, ps->lcq, addr(ctx), w) ;
+              break ;
+            case 2 :
+              process_one (q330, ps->lcq, addr(ctx), sex(w)) ;
+              break ;
+          end
+          break ;
+      end
+      inc(ps) ;
+    end
+end
+
 static void proc_insequence (pq330 q330, integer pktidx)
 begin
   paqstruc paqs ;
@@ -285,6 +388,8 @@ begin
   longint lval1, lval2 ;
   longword tmp_sec, tmp_usec ;
   integer diff ;
+  pplanstep ps ;
+  tsampctx ctx ;
   double r, t ;
   string s ;
 
@@ -319,6 +424,12 @@ begin
       break ;
     case DT_DATA :
       q330->data_timer = 0 ;
+      if (q330->reg_started != 0.0)
+        then
+          begin
+            state_callback (q330, ST_REGDATA, lib_round((now () - q330->reg_started) * 1000.0)) ;
+            q330->reg_started = 0.0 ;
+          end
       dsn = loadlongword (addr(p)) ;
       v1 = paqs->dt_data_sequence ;
       v2 = dsn ;
@@ -434,6 +545,9 @@ begin
                           libdatamsg (q330, LIBMSG_APWROFF, "") ;
                       break ;
                     case ST816_CALERR :
+                      if (paqs->calerr_bitmap != subchan)
+                        then
+                          drain_workers (q330) ;
                       paqs->calerr_bitmap = subchan ;
                       break ;
                   end
@@ -457,98 +571,12 @@ begin
             else
               switch (chan and DCM) begin
                 case DC_MN816 :
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      process_one (q330, wordval) ;
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
-                  break ;
                 case DC_MN38 :
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (sub) begin
-                        case 0 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, bsex(wordval shr 8)) ;
-                              break ;
-                          end
-                          break ;
-                        case 1 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, wordval shr 8) ;
-                              break ;
-                            case 2 :
-                              process_one (q330, wordval and 255) ;
-                              break ;
-                          end
-                          break ;
-                        case 2 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan) ;
-                              break ;
-                            default :
-                              process_one (q330, (subchan shr (paqs->proc_lcq->raw_data_field - 1)) and 1) ;
-                              break ;
-                          end
-                          break ;
-                        case 3 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan and 1) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, (subchan shr 1) and 1) ;
-                              break ;
-                            case 2 :
-                              process_one (q330, (subchan shr 2) and 1) ;
-                              break ;
-                            case 3 :
-                              process_one (q330, (subchan shr 3) and 1) ;
-                              break ;
-                            case 4 :
-                              process_one (q330, (subchan shr 4) and 1) ;
-                              break ;
-                            case 6 :
-                              process_one (q330, (subchan shr 6) and 1) ;
-                              break ;
-                            case 7 :
-                              process_one (q330, (subchan shr 7) and 1) ;
-                              break ;
-                          end
-                          break ;
-                        case 4 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, wordval shr 8) ;
-                              break ;
-                          end
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, 0, 0) ;
                   break ;
                 case DC_MN32 :
                   lval1 = loadlongint (addr(p)) ; /* serial sensor */
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      process_variable (q330, subchan, wordval, lval1) ;
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, lval1, 0) ;
                   break ;
                 case DC_MN232 :
                   lval1 = loadlongint (addr(p)) ;
@@ -559,6 +587,7 @@ begin
                         then
                           begin
                             paqs->first_data = FALSE ;
+                            drain_workers (q330) ;
                             purge_continuity (q330) ;
                           end
                       update_ok = TRUE ;
@@ -683,29 +712,9 @@ begin
 #endif
                       break ;
                   end
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (paqs->proc_lcq->raw_data_field) begin
-                        case 1 :
-                          diff = lval2 ;
-                          if (diff >= 500000)
-                            then
-                              diff = diff - 1000000 ;
-                          process_one (q330, diff) ;
-                          break ;
-                        case 2 :
-                          process_one (q330, paqs->data_qual) ;
-                          break ;
-                        case 3 :
-                          process_one (q330, wordval) ;
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, lval1, lval2) ;
                   break ;
                 case DC_AG816 :
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
                   if (sub == 0)
                     then
                       begin
@@ -715,160 +724,36 @@ begin
                               paqs->proc_lcq = paqs->mdispatch[idx][sub] ;
                               while (paqs->proc_lcq)
                                 begin
+                                  if (paqs->proc_lcq->calstat != (wordval and (3 shl idx)))
+                                    then
+                                      drain_workers (q330) ;
                                   paqs->proc_lcq->calstat = (wordval and (3 shl idx)) ;
                                   paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
                                 end
                             end
                       end
                     else
-                      while (paqs->proc_lcq)
-                        begin
-                          process_one (q330, wordval) ;
-                          paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                        end
+                      run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, 0, 0) ;
                   break ;
                 case DC_AG38 :
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (sub) begin
-                        case 0 :
-                        case 1 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, bsex(subchan)) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, bsex(wordval shr 8)) ;
-                              break ;
-                            case 2 :
-                              process_one (q330, bsex(wordval and 255)) ;
-                              break ;
-                          end
-                          break ;
-                        case 2 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, bsex(subchan)) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, bsex(wordval shr 8)) ;
-                              break ;
-                          end
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, 0, 0) ;
                   break ;
                 case DC_AG32 :
                   lval1 = loadlongint (addr(p)) ;
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (sub) begin
-                        case 0 :
-                        case 1 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, subchan) ; /* Clock quality */
-                              break ;
-                            case 1 :
-                              process_one (q330, sex(wordval)) ; /* VCO Control */
-                              break ;
-                            case 2 :
-                              process_one (q330, lval1) ; /* Clock phase */
-                              break ;
-                          end
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, lval1, 0) ;
                   break ;
                 case DC_AG232 :
                   loadlongint (addr(p)) ;
                   loadlongint (addr(p)) ;
                   break ;
                 case DC_CNP38 :
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (paqs->proc_lcq->raw_data_field) begin
-                        case 0 :
-                          process_one (q330, bsex(subchan)) ;
-                          break ;
-                        case 1 :
-                          process_one (q330, wordval shr 8) ;
-                          break ;
-                        case 2 :
-                          process_one (q330, wordval and 255) ;
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, 0, 0, 0, 0) ;
                   break ;
                 case DC_CNP816 : break ;
                 case DC_CNP316 :
                   wordval2 = loadword (addr(p)) ;
                   wordval3 = loadword (addr(p)) ;
-                  paqs->proc_lcq = paqs->dispatch[idx] ;
-                  while (paqs->proc_lcq)
-                    begin
-                      switch (sub) begin
-                        case 0 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              process_one (q330, wordval) ;
-                              break ;
-                            case 1 :
-                              process_one (q330, wordval2) ;
-                              break ;
-                            case 2 :
-                              process_one (q330, sex(wordval3)) ;
-                              break ;
-                            case 3 :
-                              process_one (q330, subchan) ;
-                              break ;
-                          end
-                          break ;
-                        case 1 :
-                        case 2 :
-                        case 3 :
-                          switch (paqs->proc_lcq->raw_data_field) begin
-                            case 0 :
-                              switch (subchan and 3) begin
-                                case 1 :
-                                  process_one (q330, wordval) ;
-                                  break ;
-                                case 2 :
-                                  process_one (q330, sex(wordval)) ;
-                                  break ;
-                              end
-                              break ;
-                            case 1 :
-                              switch ((subchan shr 2) and 3) begin
-                                case 1 :
-                                  process_one (q330, wordval2) ;
-                                  break ;
-                                case 2 :
-                                  process_one (q330, sex(wordval2)) ;
-                                  break ;
-                              end
-                              break ;
-                            case 2 :
-                              switch ((subchan shr 4) and 3) begin
-                                case 1 :
-                                  process_one (q330, wordval3) ;
-                                  break ;
-                                case 2 :
-                                  process_one (q330, sex(wordval3)) ;
-                                  break ;
-                              end
-                              break ;
-                          end
-                          break ;
-                      end
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  run_plan (q330, paqs->dplan[idx], subchan, wordval, wordval2, wordval3, 0, 0) ;
                   break ;
                 case DC_CNP232 :
                   loadlongint (addr(p)) ;
@@ -876,17 +761,9 @@ begin
                   break ;
                 case DC_D32 : /* 1hz data */
                   lval1 = loadlongint (addr(p)) ;
-                  paqs->proc_lcq = paqs->mdispatch[idx and 7][0] ;
-                  while (paqs->proc_lcq)
-                    begin
-#ifndef OMIT_SEED
-                      if (q330->lastseq == 0)
-                        then
-                          paqs->proc_lcq->com->charging = TRUE ;
-#endif
-                      process_one (q330, lval1) ;
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  set_sampctx (q330, addr(ctx)) ;
+                  for (ps = paqs->mplan[idx and 7][0] ; ps->lcq ; inc(ps))
+                    process_main (q330, ps->lcq, addr(ctx), PJ_ONE, NIL, lval1, subchan) ;
                   break ;
                 case DC_COMP :
                   psave = p ; /* start of blockette + 4 */
@@ -900,18 +777,9 @@ begin
                         libdatamsg (q330, LIBMSG_INVBLKLTH, addr(s)) ;
                         return ;
                       end
-                  paqs->proc_lcq = paqs->mdispatch[idx and 7][subchan and 7] ;
-                  while (paqs->proc_lcq)
-                    begin
-#ifndef OMIT_SEED
-                      if (q330->lastseq == 0)
-                        then
-                          paqs->proc_lcq->com->charging = TRUE ;
-#endif
-                      p = psave ; /* in case multiple users */
-                      process_comp (q330, p, wordval) ;
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  set_sampctx (q330, addr(ctx)) ;
+                  for (ps = paqs->mplan[idx and 7][subchan and 7] ; ps->lcq ; inc(ps))
+                    process_main (q330, ps->lcq, addr(ctx), PJ_COMP, psave - 4, wordval, subchan) ;
                   p = psave ;
                   incn(p, skip) ;
                   break ;
@@ -927,33 +795,9 @@ begin
                         libdatamsg (q330, LIBMSG_INVBLKLTH, addr(s)) ;
                         return ;
                       end
-                  paqs->proc_lcq = paqs->mdispatch[idx and 7][subchan and 7] ;
-                  while (paqs->proc_lcq)
-                    begin
-#ifndef OMIT_SEED
-                      if (q330->lastseq == 0)
-                        then
-                          paqs->proc_lcq->com->charging = TRUE ;
-#endif
-                      if (paqs->proc_lcq->dholdq)
-                        then
-                          if (paqs->proc_lcq->dholdq->ppkt)
-                            then
-                              begin
-                                if (paqs->proc_lcq->dholdq->ppkt->seg_freq == subchan)
-                                  then /* detect duplicate queued pkt */
-                                    paqs->proc_lcq->dholdq->ppkt = NIL ;
-                                  else
-                                    begin
-                                      p2 = (pointer)paqs->proc_lcq->dholdq->ppkt ; /* skip chan/subchan */
-                                      process_mult (q330, p2, q330->lastseq) ;
-                                    end
-                              end
-                      p = psave ;
-                      decn(p, 4) ; /* backup to start */
-                      process_mult (q330, p, q330->lastseq) ;
-                      paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
-                    end
+                  set_sampctx (q330, addr(ctx)) ;
+                  for (ps = paqs->mplan[idx and 7][subchan and 7] ; ps->lcq ; inc(ps))
+                    process_main (q330, ps->lcq, addr(ctx), PJ_MULT, psave - 4, wordval, subchan) ;
                   p = psave ;
                   incn(p, skip) ;
                   break ;
@@ -965,12 +809,14 @@ begin
                     case SP_CALSTART :
                       skip = 24 ;
 #ifndef OMIT_SEED
+                      drain_workers (q330) ;
                       log_cal (q330, p) ;
 #endif
                       break ;
                     case SP_CALABORT :
                       skip = 4 ;
 #ifndef OMIT_SEED
+                      drain_workers (q330) ;
                       log_cal (q330, p) ;
 #endif
                       break ;
@@ -1033,6 +879,7 @@ begin
                           begin /* 1hz data */
                             p = psave ; /* point at 32 bit value */
                             lval1 = loadlongint (addr(p)) ;
+                            set_sampctx (q330, addr(ctx)) ;
                             paqs->proc_lcq = paqs->epdispatch[subchan] ;
                             while (paqs->proc_lcq)
                               begin
@@ -1041,7 +888,7 @@ begin
                                   then
                                     paqs->proc_lcq->com->charging = TRUE ;
 #endif
-                                  process_one (q330, lval1) ;
+                                  process_one (q330, paqs->proc_lcq, addr(ctx), lval1) ;
                                   paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
                                 end
                           end
@@ -1056,6 +903,7 @@ begin
                                   libdatamsg (q330, LIBMSG_INVBLKLTH, addr(s)) ;
                                   return ;
                                 end
+                            set_sampctx (q330, addr(ctx)) ;
                             paqs->proc_lcq = paqs->epdispatch[subchan] ;
                             while (paqs->proc_lcq)
                               begin
@@ -1065,7 +913,7 @@ begin
                                     paqs->proc_lcq->com->charging = TRUE ;
 #endif
                                 p = psave ; /* in case multiple users */
-                                process_comp (q330, p, wordval) ;
+                                process_comp (q330, paqs->proc_lcq, addr(ctx), p, wordval) ;
                                 paqs->proc_lcq = paqs->proc_lcq->dispatch_link ;
                               end
                           end
@@ -1101,12 +949,14 @@ void dack_out (pq330 q330)
 begin
   pbyte p, pref ;
   integer msglth, err, j ;
-  string95 s, s1, s2 ;
+  string95 s1 ;
   longword acks[4] ;
-  boolean added ;
 
   q330->ack_delay = 0 ;
   q330->piggyok = TRUE ;
+  if (q330->replay)
+    then
+      return ; /* nobody to acknowledge */
   p = addr(q330->dataout.qdp) ;
   incn(p, 6) ; /* point at length */
   msglth = loadword (addr(p)) + QDP_HDR_LTH ;
@@ -1119,36 +969,7 @@ begin
         incn(p, 16) ; /* point to ack map */
         for (j = 0 ; j <= 3 ; j++)
           acks[j] = loadlongword(addr(p)) ;
-        packet_time (now(), addr(s)) ;
-        command_name (q330->recvhdr.command, addr(s1)) ;
-        strcat (s, s1) ;
-        sprintf(s1, ", Lth=%d Seq=%d Ack=%d", q330->recvhdr.datalength, q330->recvhdr.sequence,
-                q330->recvhdr.acknowledge) ;
-        strcat(s, s1) ;
-        strcat(s, ", Acking ") ;
-        added = FALSE ;
-        j = 0 ;
-        while (j <= 127)
-          begin
-            if (acks[(j shr 5) and 3] and (1 shl (longword)(j and 31)))
-              then
-                begin
-                  added = TRUE ;
-                  sprintf(s1, "%d,", q330->recvhdr.acknowledge + j) ;
-                  strcat(s, s1) ;
-                end
-            if (strlen(s) >= 88)
-              then
-                begin
-                  libmsgadd(q330, LIBMSG_PKTOUT, addr(s)) ;
-                  added = FALSE ;
-                  sprintf(s, "%s%s, Acking ", packet_time (now(), addr(s2)), command_name (q330->recvhdr.command, addr(s1))) ;
-                end
-            inc(j) ;
-          end
-        if (added)
-          then
-            libmsgadd(q330, LIBMSG_PKTOUT, addr(s)) ;
+        libpktmsg (q330, LIBMSG_PKTOUT, PEV_ACKS, 0, addr(acks[0])) ;
       end
 #ifndef OMIT_NETWORK
   if (q330->usesock)
@@ -1281,7 +1102,6 @@ begin
   word hw ;
   boolean good ;
   integer i, j, k ;
-  string95 s, s1 ;
   ppkt_buf pbuf ;
   pbyte p ;
   longword dsn ;
@@ -1303,20 +1123,13 @@ begin
   if (q330->cur_verbosity and VERB_PACKET)
     then
       begin /* log the message received */
-        packet_time (now(), addr(s)) ;
-        command_name (q330->recvhdr.command, addr(s1)) ;
-        strcat (s, s1) ;
         p = (pointer) ((integer)(addr(q330->datain.qdp)) + QDP_HDR_LTH) ;
         dsn = loadlongword(addr(p)) ;
-        sprintf(s1, ", Lth=%d Seq=%d DSN=%d", q330->recvhdr.datalength, q330->recvhdr.sequence,
-                dsn) ;
-        strcat(s, s1) ;
         if (good)
           then
-            strcat(s, " Inside the Window") ;
+            libpktmsg (q330, LIBMSG_PKTIN, PEV_DSN or PEV_INSIDE, dsn, NIL) ;
           else
-            strcat(s, " Outside the Window") ;
-        libmsgadd(q330, LIBMSG_PKTIN, addr(s)) ;
+            libpktmsg (q330, LIBMSG_PKTIN, PEV_DSN, dsn, NIL) ;
       end
   if (good)
     then
@@ -0,0 +1,221 @@
+/*   Lib330 serial line framing and Base-96 decoding
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+*/
+#ifndef libslip_h
+#include "libslip.h"
+#endif
+
+/* SSE2 is always there on x86-64, elsewhere the byte at a time loops do the work */
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define SLIP_SSE2
+#endif
+
+/* size is the most a frame may hold */
+void slip_init (pslip ps, pbyte base, integer size)
+begin
+
+  ps->base = base ;
+  ps->limit = base + size ;
+  ps->ptr = base ;
+  ps->escpend = FALSE ;
+  ps->needframe = FALSE ;
+end
+
+/* First SLIP_FRM or SLIP_ESC from p, pend if neither */
+pbyte slip_special (pbyte p, pbyte pend)
+begin
+#ifdef SLIP_SSE2
+  __m128i frm, esc, v ;
+  int bits ;
+
+  frm = _mm_set1_epi8 ((char)SLIP_FRM) ;
+  esc = _mm_set1_epi8 ((char)SLIP_ESC) ;
+  while ((pend - p) >= 16)
+    begin
+      v = _mm_loadu_si128 ((pointer)p) ;
+      bits = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8 (v, frm), _mm_cmpeq_epi8 (v, esc))) ;
+      if (bits)
+        then
+          return p + __builtin_ctz (bits) ;
+      incn(p, 16) ;
+    end
+#endif
+  while ((p < pend) land (*p != SLIP_FRM) land (*p != SLIP_ESC))
+    inc(p) ;
+  return p ;
+end
+
+/*
+  Unframe count bytes. Runs of ordinary bytes are copied in one go, only the
+  special characters and whatever follows an escape are looked at one by one.
+  After a frame turns out to be a packet everything up to the next SLIP_FRM is
+  skipped. A byte that would go past the end of the buffer is dropped and the
+  frame started again, returns how many times that happened.
+*/
+integer slip_unframe (pslip ps, pbyte pin, integer count, tslipframe frame, pointer ctx)
+begin
+  pbyte pend, pnext, pout ;
+  integer lth, room, overruns ;
+  byte c ;
+
+  overruns = 0 ;
+  pend = pin + count ;
+  pout = ps->ptr ;
+  while (pin < pend)
+    begin
+      if (ps->needframe)
+        then
+          begin
+            pin = memchr (pin, SLIP_FRM, pend - pin) ;
+            if (pin == NIL)
+              then
+                break ;
+          end
+      else if (lnot ps->escpend)
+        then
+          begin
+            pnext = slip_special (pin, pend) ;
+            lth = pnext - pin ;
+            while (lth > 0)
+              begin
+                room = ps->limit - pout ;
+                if (lth <= room)
+                  then
+                    begin
+                      memcpy (pout, pin, lth) ;
+                      incn(pout, lth) ;
+                      incn(pin, lth) ;
+                      lth = 0 ;
+                    end
+                  else
+                    begin
+                      memcpy (pout, pin, room) ;
+                      incn(pin, room + 1) ;
+                      lth = lth - room - 1 ;
+                      pout = ps->base ;
+                      inc(overruns) ;
+                    end
+              end
+            if (pin >= pend)
+              then
+                break ;
+          end
+      c = *pin ;
+      inc(pin) ;
+      switch (c) begin
+        case SLIP_FRM :
+          ps->escpend = FALSE ;
+          ps->needframe = FALSE ;
+          lth = pout - ps->base ;
+          pout = ps->base ;
+          if (lth)
+            then
+              ps->needframe = frame (ctx, lth) ;
+          break ;
+        case SLIP_ESC :
+          ps->escpend = TRUE ;
+          break ;
+        default :
+          if (ps->escpend)
+            then
+              begin
+                if (c == ESC_FRM)
+                  then
+                    begin
+                      ps->escpend = FALSE ;
+                      c = SLIP_FRM ;
+                    end
+                else if (c == ESC_ESC)
+                  then
+                    begin
+                      ps->escpend = FALSE ;
+                      c = SLIP_ESC ;
+                    end
+              end
+          if (pout < ps->limit)
+            then
+              *pout++ = c ;
+            else
+              begin
+                pout = ps->base ;
+                inc(overruns) ;
+              end
+          break ;
+      end
+    end
+  ps->ptr = pout ;
+  return overruns ;
+end
+
+/*
+  Each group of four characters is three bytes less 0x20, with their top two bits
+  in the fourth, then xor'd with the mask. pdest may be psrc or before it.
+  Returns the number of bytes decoded.
+*/
+integer base96_decode (pbyte pdest, pbyte psrc, integer groups, byte mask)
+begin
+  integer count ;
+  byte m ;
+#ifdef SLIP_SSE2
+  __m128i bias, xmask, hi0, hi1, hi2, v, hi ;
+  byte out[16] ;
+#endif
+
+  count = groups * 3 ;
+#ifdef SLIP_SSE2
+  /* four groups at a time, one to each 32 bit lane */
+  bias = _mm_set1_epi8 (0x20) ;
+  xmask = _mm_set1_epi8 ((char)mask) ;
+  hi0 = _mm_set1_epi32 (0xC0) ;
+  hi1 = _mm_set1_epi32 (0xC000) ;
+  hi2 = _mm_set1_epi32 (0xC00000) ;
+  while (groups >= 4)
+    begin
+      v = _mm_sub_epi8 (_mm_loadu_si128 ((pointer)psrc), bias) ;
+      hi = _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (v, 22), hi0),
+                         _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (v, 12), hi1),
+                                       _mm_and_si128 (_mm_srli_epi32 (v, 2), hi2))) ;
+      v = _mm_xor_si128 (_mm_add_epi8 (v, hi), xmask) ;
+      _mm_storeu_si128 ((pointer)addr(out), v) ;
+      memcpy (pdest, addr(out[0]), 3) ;
+      memcpy (pdest + 3, addr(out[4]), 3) ;
+      memcpy (pdest + 6, addr(out[8]), 3) ;
+      memcpy (pdest + 9, addr(out[12]), 3) ;
+      incn(psrc, 16) ;
+      incn(pdest, 12) ;
+      groups = groups - 4 ;
+    end
+#endif
+  while (groups > 0)
+    begin
+      m = psrc[3] - 0x20 ;
+      *pdest++ = (psrc[0] - 0x20 + ((m and 0x30) shl 2)) xor mask ;
+      *pdest++ = (psrc[1] - 0x20 + ((m and 0xc) shl 4)) xor mask ;
+      *pdest++ = (psrc[2] - 0x20 + ((m and 3) shl 6)) xor mask ;
+      incn(psrc, 4) ;
+      dec(groups) ;
+    end
+  return count ;
+end
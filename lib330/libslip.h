@@ -0,0 +1,58 @@
+/*   Lib330 serial line framing and Base-96 decoding definitions
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+*/
+#ifndef libslip_h
+/* Flag this file as included */
+#define libslip_h
+#define VER_LIBSLIP 0
+
+/* Make sure libtypes.h is included */
+#ifndef libtypes_h
+#include "libtypes.h"
+#endif
+
+  /* SLIP */
+#define SLIP_FRM 0xC0 /* Framing character */
+#define SLIP_ESC 0xDB /* Escape character, special follows */
+#define ESC_FRM 0xDC /* SLIP_ESC|ESC_FRM = 0xC0 */
+#define ESC_ESC 0xDD /* SLIP_ESC|ESC_ESC = 0xDB */
+
+typedef struct { /* SLIP receive state */
+  pbyte base ; /* start of the frame buffer */
+  pbyte limit ; /* first byte past the room for a frame */
+  pbyte ptr ; /* where the next byte goes */
+  boolean escpend ; /* SLIP_ESC seen */
+  boolean needframe ; /* skip everything up to the next SLIP_FRM */
+} tslip ;
+typedef tslip *pslip ;
+
+/* called with each complete frame, returns TRUE if it was a packet */
+typedef boolean (*tslipframe) (pointer ctx, integer lth) ;
+
+extern void slip_init (pslip ps, pbyte base, integer size) ;
+extern pbyte slip_special (pbyte p, pbyte pend) ;
+extern integer slip_unframe (pslip ps, pbyte pin, integer count, tslipframe frame, pointer ctx) ;
+extern integer base96_decode (pbyte pdest, pbyte psrc, integer groups, byte mask) ;
+
+#endif
@@ -23,6 +23,9 @@ Edit History:
     0 2006-09-29 rdr Created
     1 2006-11-23 rdr Communications efficiency status reworked.
     2 2006-11-29 rdr Make sure compiler uses floating point for com. eff. calculations
+    3 2026-10-19 gns Accumulators updated atomically without the station lock, only
+                     rebuild the opstat accumulator statistics once per minute.
+    4 2026-10-19 gns Make the one second callback for dp statistics under the output lock.
 */
 #ifndef libtypes_h
 #include "libtypes.h"
@@ -45,6 +48,9 @@ Edit History:
 #ifndef libsupport_h
 #include "libsupport.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 
 #ifndef OMIT_SEED
 #ifndef libsample_h
@@ -54,6 +60,17 @@ Edit History:
 #include "libcompress.h"
 #endif
 #endif
+
+/* Accumulators are bumped by the I/O threads without taking the station lock,
+   lib_stats_timer collects each total and clears it in one step */
+#ifdef X86_WIN32
+#define acc_add(p, v) InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v))
+#define acc_take(p) InterlockedExchange((LONG volatile *)(p), 0)
+#else
+#define acc_add(p, v) __sync_fetch_and_add((p), (longint)(v))
+#define acc_take(p) __sync_lock_test_and_set((p), 0)
+#endif
+
 static void process_dpstat (pq330 q330, plcq q, longint val)
 begin
 #define DPSTAT_QUALITY 100
@@ -124,7 +141,9 @@ begin
         q330->onesec_call.src_channel = q->raw_data_source ;
         q330->onesec_call.src_subchan = q->raw_data_field ;
         q330->onesec_call.samples[0] = val ;
+        outlock (q330) ;
         q330->par_create.call_secdata (addr(q330->onesec_call)) ;
+        outunlock (q330) ;
       end
 #ifndef OMIT_SEED
   pcom->peeks[pcom->next_in] = val ;
@@ -144,15 +163,15 @@ end
 void add_status (pq330 q330, enum tacctype acctype, longword count)
 begin
 
-  incn(q330->share.accmstats[acctype].accum, count) ;
-  incn(q330->share.accmstats[acctype].accum_ds, count) ;
+  acc_add(addr(q330->share.accmstats[acctype].accum), count) ;
+  acc_add(addr(q330->share.accmstats[acctype].accum_ds), count) ;
 end
 
 void lib_stats_timer (pq330 q330)
 begin
   enum tacctype acctype ;
   integer minute, last_minute, comeff_valids ;
-  longint total, sentdif, resdif, val, duty ;
+  longint total, sentdif, resdif, val, ds ;
   paqstruc paqs ;
   taccmstat *paccm ;
 
@@ -172,33 +191,32 @@ begin
       end
     else
       q330->share.accmstats[AC_COMEFF].accum_ds = 0 ;
-  duty = q330->share.accmstats[AC_DUTY].accum_ds ;
   for (acctype = AC_FIRST ; acctype <= AC_LAST ; acctype++)
     begin
       paccm = addr(q330->share.accmstats[acctype]) ;
+      ds = acc_take(addr(paccm->accum_ds)) ;
       if (paccm->ds_lcq)
         then
           begin
             switch (acctype) begin
               case AC_READ :
               case AC_WRITE :
-                val = paccm->accum_ds div 10 ;
+                val = ds div 10 ;
                 break ;
               case AC_DUTY :
-                val = (paccm->accum_ds * 1000) div 10 ;
+                val = (ds * 1000) div 10 ;
                 break ;
               case AC_THROUGH :
-                val = (paccm->accum_ds * 100) div 10 ;
+                val = (ds * 100) div 10 ;
                 break ;
               default :
-                val = paccm->accum_ds ;
+                val = ds ;
                 break ;
             end
             unlock (q330) ;
             process_dpstat (q330, paccm->ds_lcq, val) ;
             lock (q330) ;
           end
-      paccm->accum_ds = 0 ;
     end
   paqs = q330->aqstruc ;
   unlock (q330) ;
@@ -241,7 +259,7 @@ begin
   for (acctype = AC_FIRST ; acctype <= AC_LAST ; acctype++)
     begin
       paccm = addr(q330->share.accmstats[acctype]) ;
-      paccm->minutes[last_minute] = paccm->accum ;
+      paccm->minutes[last_minute] = acc_take(addr(paccm->accum)) ;
       if (q330->share.stat_minutes == 0)
         then
           if (acctype != AC_COMEFF)
@@ -270,7 +288,6 @@ begin
                     total = INVALID_ENTRY ;
                 paccm->hours[q330->share.stat_hours] = total ;
               end
-      paccm->accum = 0 ; /* start counting the new minute as zero */
     end
   if (q330->share.stat_minutes == 0)
     then
@@ -530,34 +547,16 @@ begin
   q330->share.opstat.gps_stat = gpstat ;
 end
 
-void update_op_stats (pq330 q330)
+/* Only changes when lib_stats_timer moves to a new minute */
+static void update_acc_stats (pq330 q330)
 begin
-  paqstruc paqs ;
   enum tacctype acctype ;
   integer lastminute, minute, hour, valids, comeff_valids ;
   longint total ;
   taccmstat *paccm ;
   topstat *pops ;
 
-  paqs = q330->aqstruc ;
   pops = addr(q330->share.opstat) ;
-  if (q330->saved_data_timetag > 1)
-    then
-      pops->data_latency = now () - q330->saved_data_timetag + 0.5 ;
-    else
-      pops->data_latency = INVALID_LATENCY ;
-  if (q330->last_status_received != 0)
-    then
-      pops->status_latency = now () - q330->last_status_received + 0.5 ;
-    else
-      pops->status_latency = INVALID_LATENCY ;
-  memcpy(addr(pops->station_name), addr(q330->station_ident), sizeof(string9)) ;
-  pops->station_port = q330->par_create.q330id_dataport ;
-  pops->station_tag = q330->share.fixed.property_tag ;
-  memcpy(addr(pops->station_serial), addr(q330->share.fixed.sys_num), sizeof(t64)) ;
-  pops->station_reboot = q330->share.fixed.last_reboot ;
-  pops->timezone_offset = q330->zone_adjust ;
-  pops->calibration_errors = paqs->calerr_bitmap ;
   lastminute = q330->share.stat_minutes - 1 ;
   if (lastminute < 0)
     then
@@ -698,3 +697,35 @@ begin
           end
     end
 end
+
+void update_op_stats (pq330 q330)
+begin
+  paqstruc paqs ;
+  topstat *pops ;
+
+  paqs = q330->aqstruc ;
+  pops = addr(q330->share.opstat) ;
+  if (q330->saved_data_timetag > 1)
+    then
+      pops->data_latency = now () - q330->saved_data_timetag + 0.5 ;
+    else
+      pops->data_latency = INVALID_LATENCY ;
+  if (q330->last_status_received != 0)
+    then
+      pops->status_latency = now () - q330->last_status_received + 0.5 ;
+    else
+      pops->status_latency = INVALID_LATENCY ;
+  memcpy(addr(pops->station_name), addr(q330->station_ident), sizeof(string9)) ;
+  pops->station_port = q330->par_create.q330id_dataport ;
+  pops->station_tag = q330->share.fixed.property_tag ;
+  memcpy(addr(pops->station_serial), addr(q330->share.fixed.sys_num), sizeof(t64)) ;
+  pops->station_reboot = q330->share.fixed.last_reboot ;
+  pops->timezone_offset = q330->zone_adjust ;
+  pops->calibration_errors = paqs->calerr_bitmap ;
+  if (q330->share.acc_built != (q330->share.total_minutes + 1))
+    then
+      begin
+        update_acc_stats (q330) ;
+        q330->share.acc_built = q330->share.total_minutes + 1 ;
+      end
+end
@@ -36,6 +36,13 @@ Edit History:
    10 2009-09-15 rdr Add DSS support for serial connection to Q330.
    11 2010-03-27 rdr Add Q335 support.
    12 2010-08-21 rdr In lib_destroy_330 clear ct before doing any deallocations.
+   13 2026-10-19 gns Replay captured packets from the thread loop.
+   14 2026-10-19 gns Add poolmutex and allocate the record pool for lib_record_hold.
+   15 2026-10-19 gns Start and stop the LCQ worker threads. msgmutex is recursive, it is also
+                     the output lock taken around client callbacks.
+   16 2026-10-19 gns getbuf and getthrbuf share arena_get. Blocks past the first double in
+                     size and are reused after mem_release, opt_hugepages maps them on huge
+                     page boundaries.
 */
 /* Make sure libstrucs.h is included */
 #ifndef libstrucs_h
@@ -65,6 +72,9 @@ Edit History:
 #ifndef libmd5_h
 #include "libmd5.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 
 #ifndef OMIT_SEED
 #ifndef libfilters_h
@@ -83,6 +93,7 @@ begin
 
   q330->mutex = CreateMutex(NIL, FALSE, NIL) ;
   q330->msgmutex = CreateMutex(NIL, FALSE, NIL) ;
+  q330->poolmutex = CreateMutex(NIL, FALSE, NIL) ;
 end
 
 static void destroy_mutex (pq330 q330)
@@ -90,6 +101,7 @@ begin
 
   CloseHandle (q330->mutex) ;
   CloseHandle (q330->msgmutex) ;
+  CloseHandle (q330->poolmutex) ;
 end
 
 void lock (pq330 q330)
@@ -116,6 +128,18 @@ begin
   ReleaseMutex (q330->msgmutex) ;
 end
 
+void poollock (pq330 q330)
+begin
+
+  WaitForSingleObject (q330->poolmutex, INFINITE) ;
+end
+
+void poolunlock (pq330 q330)
+begin
+
+  ReleaseMutex (q330->poolmutex) ;
+end
+
 void sleepms (integer ms)
 begin
 
@@ -130,14 +154,21 @@ void lock (pq330 q330) begin end
 void unlock (pq330 q330) begin end
 void msglock (pq330 q330) begin end
 void msgunlock (pq330 q330) begin end
+void poollock (pq330 q330) begin end
+void poolunlock (pq330 q330) begin end
 void sleepms (integer ms) begin end
 
 #else
 static void create_mutex (pq330 q330)
 begin
+  pthread_mutexattr_t attr ;
 
   pthread_mutex_init (addr(q330->mutex), NULL) ;
-  pthread_mutex_init (addr(q330->msgmutex), NULL) ;
+  pthread_mutexattr_init (addr(attr)) ;
+  pthread_mutexattr_settype (addr(attr), PTHREAD_MUTEX_RECURSIVE) ;
+  pthread_mutex_init (addr(q330->msgmutex), addr(attr)) ;
+  pthread_mutexattr_destroy (addr(attr)) ;
+  pthread_mutex_init (addr(q330->poolmutex), NULL) ;
 end
 
 static void destroy_mutex (pq330 q330)
@@ -145,6 +176,7 @@ begin
 
   pthread_mutex_destroy (addr(q330->mutex)) ;
   pthread_mutex_destroy (addr(q330->msgmutex)) ;
+  pthread_mutex_destroy (addr(q330->poolmutex)) ;
 end
 
 void lock (pq330 q330)
@@ -171,6 +203,18 @@ begin
   pthread_mutex_unlock (addr(q330->msgmutex)) ;
 end
 
+void poollock (pq330 q330)
+begin
+
+  pthread_mutex_lock (addr(q330->poolmutex)) ;
+end
+
+void poolunlock (pq330 q330)
+begin
+
+  pthread_mutex_unlock (addr(q330->poolmutex)) ;
+end
+
 void sleepms (integer ms)
 begin
   struct timespec dly ;
@@ -182,30 +226,110 @@ end
 #endif
 #endif
 
-void getbuf (pq330 q330, pointer *p, integer size)
+/* With opt_hugepages blocks are mapped in whole huge pages, aligned so the
+   kernel can back them with huge pages. Otherwise they come from malloc */
+static pointer arena_map (pq330 q330, pmem_manager pm)
 begin
-  pbyte newblock ;
+#if !defined(X86_WIN32) && !defined(CMEX32)
+  pbyte base ;
+  integer slack ;
+#endif
 
-  size = (size + 3) and 0xFFFFFFFC ; /* make multiple of longword */
-  if ((q330->cur_memory->sofar + size) > q330->cur_memory->alloc_size)
+  pm->map_size = 0 ;
+#if !defined(X86_WIN32) && !defined(CMEX32)
+  if (q330->par_create.opt_hugepages != OHP_NONE)
     then
-      begin /* need a new block of memory */
-        q330->cur_memory->next = malloc (sizeof(tmem_manager)) ;
-        q330->cur_memory = q330->cur_memory->next ;
-        q330->cur_memory->next = NIL ;
-        if (size > DEFAULT_MEM_INC)
+      begin
+        pm->alloc_size = (pm->alloc_size + ARENA_HUGE - 1) and not (ARENA_HUGE - 1) ;
+#ifdef MAP_HUGETLB
+        if (q330->par_create.opt_hugepages == OHP_EXPLICIT)
           then
-            q330->cur_memory->alloc_size = size ;
-          else
-            q330->cur_memory->alloc_size = DEFAULT_MEM_INC ;
-        q330->cur_memory->sofar = 0 ;
-        q330->cur_memory->base = malloc (q330->cur_memory->alloc_size) ;
+            begin
+              base = mmap (NIL, pm->alloc_size, PROT_READ or PROT_WRITE,
+                           MAP_PRIVATE or MAP_ANONYMOUS or MAP_HUGETLB, -1, 0) ;
+              if (base != MAP_FAILED)
+                then
+                  begin
+                    pm->map_size = pm->alloc_size ;
+                    return base ;
+                  end
+            end /* none reserved, fall back to transparent huge pages */
+#endif
+        base = mmap (NIL, pm->alloc_size + ARENA_HUGE, PROT_READ or PROT_WRITE,
+                     MAP_PRIVATE or MAP_ANONYMOUS, -1, 0) ;
+        if (base != MAP_FAILED)
+          then
+            begin /* trim the extra huge page from either side of the aligned block */
+              slack = (ARENA_HUGE - ((uninteger)base and (ARENA_HUGE - 1))) and (ARENA_HUGE - 1) ;
+              if (slack)
+                then
+                  munmap (base, slack) ;
+              incn(base, slack) ;
+              munmap (base + pm->alloc_size, ARENA_HUGE - slack) ;
+#ifdef MADV_HUGEPAGE
+              madvise (base, pm->alloc_size, MADV_HUGEPAGE) ;
+#endif
+              pm->map_size = pm->alloc_size ;
+              return base ;
+            end
+      end
+#endif
+  return malloc (pm->alloc_size) ;
+end
+
+static void arena_unmap (pmem_manager pm)
+begin
+
+#if !defined(X86_WIN32) && !defined(CMEX32)
+  if (pm->map_size)
+    then
+      begin
+        munmap (pm->base, pm->map_size) ;
+        return ;
       end
-  newblock = q330->cur_memory->base ;
-  incn(newblock, q330->cur_memory->sofar) ;
-  q330->cur_memory->sofar = q330->cur_memory->sofar + size ;
+#endif
+  free (pm->base) ;
+end
+
+/* The first block of an arena is sized from continuity so is usually all that is
+   needed, any added are at least twice the size of the last to keep the list short */
+static pointer arena_get (pq330 q330, pmem_manager *cur, integer size)
+begin
+  pmem_manager pm ;
+  pbyte newblock ;
+  integer grow ;
+
+  size = (size + 3) and 0xFFFFFFFC ; /* make multiple of longword */
+  pm = *cur ;
+  while ((pm->sofar + size) > pm->alloc_size)
+    if (pm->next)
+      then
+        pm = pm->next ; /* added before the last mem_release */
+      else
+        begin /* need a new block of memory */
+          grow = pm->alloc_size * 2 ;
+          if (grow < size)
+            then
+              grow = size ;
+          pm->next = malloc (sizeof(tmem_manager)) ;
+          pm = pm->next ;
+          pm->next = NIL ;
+          pm->alloc_size = grow ;
+          pm->sofar = 0 ;
+          pm->base = arena_map (q330, pm) ;
+        end
+  *cur = pm ;
+  newblock = pm->base ;
+  incn(newblock, pm->sofar) ;
+  pm->sofar = pm->sofar + size ;
   memset (newblock, 0, size) ; /* make sure is zeroed out */
-  *p = newblock ;
+  return newblock ;
+end
+
+void getbuf (pq330 q330, pointer *p, integer size)
+begin
+
+  *p = arena_get (q330, addr(q330->cur_memory), size) ;
 end
 
 void mem_release (pq330 q330)
@@ -218,32 +342,13 @@ begin
       pm->sofar = 0 ;
       pm = pm->next ;
     end
+  q330->cur_memory = q330->memory_head ;
 end
 
 void getthrbuf (pq330 q330, pointer *p, integer size)
 begin
-  pbyte newblock ;
 
-  size = (size + 3) and 0xFFFFFFFC ; /* make multiple of longword */
-  if ((q330->cur_thrmem->sofar + size) > q330->cur_thrmem->alloc_size)
-    then
-      begin /* need a new block of memory */
-        q330->cur_thrmem->next = malloc (sizeof(tmem_manager)) ;
-        q330->cur_thrmem = q330->cur_thrmem->next ;
-        q330->cur_thrmem->next = NIL ;
-        if (size > DEFAULT_THR_INC)
-          then
-            q330->cur_thrmem->alloc_size = size ;
-          else
-            q330->cur_thrmem->alloc_size = DEFAULT_THR_INC ;
-        q330->cur_thrmem->sofar = 0 ;
-        q330->cur_thrmem->base = malloc (q330->cur_thrmem->alloc_size) ;
-      end
-  newblock = q330->cur_thrmem->base ;
-  incn(newblock, q330->cur_thrmem->sofar) ;
-  q330->cur_thrmem->sofar = q330->cur_thrmem->sofar + size ;
-  memset (newblock, 0, size) ; /* make sure is zeroed out */
-  *p = newblock ;
+  *p = arena_get (q330, addr(q330->cur_thrmem), size) ;
 end
 
 void gcrcinit (crc_table_type *crctable)
@@ -327,6 +432,12 @@ begin
       case LIBSTATE_RUN :
       case LIBSTATE_DEALLOC :
       case LIBSTATE_DEREG :
+        if (q330->replay)
+          then
+            begin
+              replay_packets (q330) ;
+              break ;
+            end
 #ifndef OMIT_NETWORK
         if (q330->usesock)
           then
@@ -414,7 +525,10 @@ begin
       case LIBSTATE_TERM :
         break ; /* nothing to */
       case LIBSTATE_IDLE :
-        if (q330->needtosayhello)
+        if (q330->replay)
+          then
+            replay_packets (q330) ;
+        else if (q330->needtosayhello)
           then
             begin
               q330->needtosayhello = FALSE ;
@@ -497,6 +611,12 @@ begin
       case LIBSTATE_RUN :
       case LIBSTATE_DEALLOC :
       case LIBSTATE_DEREG :
+        if (q330->replay)
+          then
+            begin
+              replay_packets (q330) ;
+              break ;
+            end
 #ifndef OMIT_NETWORK
         if (q330->usesock)
           then
@@ -592,7 +712,10 @@ begin
       case LIBSTATE_TERM :
         break ; /* nothing to */
       case LIBSTATE_IDLE :
-        if (q330->needtosayhello)
+        if (q330->replay)
+          then
+            replay_packets (q330) ;
+        else if (q330->needtosayhello)
           then
             begin
               q330->needtosayhello = FALSE ;
@@ -648,6 +771,36 @@ end
 #endif
 #endif
 
+#ifndef OMIT_SEED
+/* Records for lib_record_hold, outside the memory managers as they are not
+   part of continuity */
+static void create_recpool (pq330 q330)
+begin
+  integer i, size ;
+  precord_ref ref ;
+
+  size = q330->par_create.opt_recpool ;
+  if (size > RECPOOL_MAX)
+    then
+      size = RECPOOL_MAX ;
+  if (size <= 0)
+    then
+      return ;
+  q330->recpool.refs = malloc (size * sizeof(trecord_ref)) ;
+  if (q330->recpool.refs == NIL)
+    then
+      return ;
+  q330->recpool.size = size ;
+  for (i = size - 1 ; i >= 0 ; i--)
+    begin
+      ref = addr(q330->recpool.refs[i]) ;
+      ref->refs = 0 ;
+      ref->link = q330->recpool.free ;
+      q330->recpool.free = ref ;
+    end
+end
+#endif
+
 void lib_create_330 (tcontext *ct, tpar_create *cfg)
 begin
   pq330 q330 ;
@@ -662,6 +815,9 @@ begin
   q330->libstate = LIBSTATE_IDLE ;
   q330->share.target_state = LIBSTATE_IDLE ;
   memcpy (addr(q330->par_create), cfg, sizeof(tpar_create)) ;
+#ifndef OMIT_SEED
+  create_recpool (q330) ;
+#endif
   gcrcinit (addr(q330->crc_table)) ;
   memcpy (addr(q330->qclock), addr(default_clock), sizeof(tclock)) ;
   q330->share.opstat.status_latency = INVALID_LATENCY ;
@@ -682,14 +838,14 @@ begin
       q330->cur_memory_required = DEFAULT_MEM_INC ;
   q330->memory_head->alloc_size = q330->cur_memory_required ;
   q330->memory_head->sofar = 0 ;
-  q330->memory_head->base = malloc(q330->memory_head->alloc_size) ;
+  q330->memory_head->base = arena_map (q330, q330->memory_head) ;
   q330->cur_memory = q330->memory_head ;
   if (q330->cur_thrmem_required < DEFAULT_THR_INC)
     then
       q330->cur_thrmem_required = DEFAULT_THR_INC ;
   q330->thrmem_head->alloc_size = q330->cur_thrmem_required ;
   q330->thrmem_head->sofar = 0 ;
-  q330->thrmem_head->base = malloc(q330->thrmem_head->alloc_size) ;
+  q330->thrmem_head->base = arena_map (q330, q330->thrmem_head) ;
   q330->cur_thrmem = q330->thrmem_head ;
   q330->last_100ms = now () ;
   q330->last_ten_sec = (q330->last_100ms + 0.5) div 10 ; /* integer 10 second value */
@@ -704,6 +860,7 @@ begin
   init_md5_buffer (q330) ;
   q330->aqstruc = allocate_aqstruc (q330) ;
   allocate_packetbuffers (q330) ;
+  start_workers (q330) ;
   q330->cur_verbosity = q330->par_create.opt_verbose ; /* until register anyway */
 #ifndef OMIT_SEED
   load_firfilters (q330, q330->aqstruc) ; /* build standards */
@@ -730,6 +887,7 @@ begin
     then
       begin
         cfg->resp_err = LIBERR_THREADERR ;
+        stop_workers (q330) ;
         free (*ct) ; /* no context */
         *ct = NIL ;
       end
@@ -744,12 +902,13 @@ begin
 
   q330 = *ct ;
   *ct = NIL ;
+  stop_workers (q330) ;
   destroy_mutex (q330) ;
   pm = q330->memory_head ;
   while (pm)
     begin
       pmn = pm->next ;
-      free (pm->base) ;
+      arena_unmap (pm) ;
       free (pm) ;
       pm = pmn ;
     end
@@ -757,10 +916,15 @@ begin
   while (pm)
     begin
       pmn = pm->next ;
-      free (pm->base) ;
+      arena_unmap (pm) ;
       free (pm) ;
       pm = pmn ;
     end
+#ifndef OMIT_SEED
+  if (q330->recpool.refs)
+    then
+      free (q330->recpool.refs) ;
+#endif
   free (q330) ;
   return LIBERR_NOERR ;
 end
@@ -37,11 +37,24 @@ Edit History:
    10 2009-09-15 rdr Add DSS support when connected to 330 via serial.
    11 2010-03-27 rdr Add Q335 flag.
    12 2010-05-07 rdr Add comm structure.
+   13 2026-10-19 gns Add acc_built to note when opstat accumulator statistics were last built.
+   14 2026-10-19 gns Add packet capture and replay fields.
+   15 2026-10-19 gns Add the packet trace event ring.
+   16 2026-10-19 gns Add the record pool, poolmutex, poollock, and poolunlock.
+   17 2026-10-19 gns Add workers.
+   18 2026-10-19 gns SLIP receive state is now a tslip.
+   19 2026-10-19 gns Command phase, sequence, and retry timing are now kept for each queued
+                     command so several can be outstanding. Add CMDWINDOW, token segment
+                     tracking in place of cfgoffset, fgls_read, and reg_started.
+   20 2026-10-19 gns Add cfgcheck for verifying cached tokens.
+   21 2026-10-19 gns Add map_size to tmem_manager and ARENA_HUGE.
+   22 2026-10-19 gns Add memtype to tcmdq, so each memory request knows what it asked for,
+                     and cfgbad.
 }*/
 #ifndef libstrucs_h
 /* Flag this file as included */
 #define libstrucs_h
-#define VER_LIBSTRUCS 16
+#define VER_LIBSTRUCS 26
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -59,8 +72,12 @@ Edit History:
 #ifndef libseed_h
 #include "libseed.h"
 #endif
+#ifndef libslip_h
+#include "libslip.h"
+#endif
 
 #define CMDQSZ 32 /* Maximum size of command queue */
+#define CMDWINDOW 4 /* Maximum number of read requests outstanding at once */
 #define MAX_HISTORY 16
 #define MAXCFG 7884 /* actual number of characters allowed */
 #define WINWRAP (WINBUFS - 1)
@@ -70,6 +87,7 @@ Edit History:
 #define DEFAULT_MEM_INC 65536
 #define DEFAULT_THRMEM 65536
 #define DEFAULT_THR_INC 32768
+#define ARENA_HUGE 2097152 /* huge page size, opt_hugepages blocks are multiples of this */
 #define RAW_GLOBAL_SIZE 160
 #define RAW_FIXED_SIZE 188
 #define RAW_LOG_SIZE 52
@@ -80,26 +98,31 @@ Edit History:
 #define DEFAULT_STATUS_TIMEOUT 5 * 60 /* Status timeout */
 #define DEFAULT_STATUS_TIMEOUT_RETRY 5 * 60 ;
 #define MIN_MSG_QUEUE_SIZE 10 /* Minimum number of client message buffers */
+#define CAP_BUFSIZE 16384 /* packet capture write buffer */
 
+enum tcphase {CP_NEED, CP_WAIT, CP_DONE} ;
+enum tcfgcheck {CC_NONE, CC_VERIFY, CC_CHANGED} ; /* running from cached tokens */
 typedef struct { /* One command to be sent to Q330 */
   byte cmd ;
   byte subcmd ;
   boolean tunneled ;
+  enum tcphase cphase ; /* command handling phase */
+  word ctrlrecnt ; /* control port retry down counter */
+  word lastctrlseq ; /* the last one we sent */
+  word ctrl_retries ; /* number of retries so far */
   word sendsz ; /* sending size */
   word estsz ; /* estimated return packet size */
   word retsz ; /* return size accumulator */
+  longword memstart ; /* starting offset for C1_RQMEM */
+  word memtype ; /* and memory type */
   double sent ;
 } tcmdq ;
 typedef tcmdq tcmdqs[CMDQSZ] ;
 
-enum tcphase {CP_IDLE, CP_NEED, CP_WAIT} ;
 typedef struct { /* command queue fields */
-  enum tcphase cphase ; /* command handling phase */
-  word ctrlrecnt ; /* control port retry down counter */
-  word lastctrlseq ; /* the last one we sent */
   word ctrlseq ; /* incrementing control sequence counter */
-  word ctrl_retries ; /* number of retries so far */
   integer cmdin, cmdout ; /* command queue pointers */
+  integer cmdcur ; /* command the response being processed is for */
   tcmdqs cmdq ; /* command dispatch queue */
   tany cmsgin ; /* command message from Q330 */
   tany cmsgout ; /* command messout to Q330 */
@@ -125,11 +148,34 @@ typedef struct {
   tany buf ;
 } tpkt_buf ;
 typedef word tcbuf[10000] ; /* continuity buffer */
+enum tcapkind {CK_HEADER, CK_CONFIG, CK_DATA} ;
+typedef struct { /* precedes each record in a packet capture file */
+  double timestamp ; /* host time when captured */
+  word kind ; /* tcapkind */
+  word spare ;
+  longint size ; /* bytes of payload following */
+} tcaphdr ;
+typedef struct { /* packet trace events, only the lib330 thread writes */
+  longword head ; /* number of the newest event, zero if none */
+  tmsgevent events[MSGRING_SIZE] ;
+} tmsgring ;
+#ifndef OMIT_SEED
+typedef struct { /* records handed out by lib_record_hold, protected by poolmutex */
+  precord_ref refs ; /* the records, from malloc */
+  precord_ref free ; /* records not in use */
+  integer size ;
+  integer in_use ;
+  integer high_water ;
+  longword holds ;
+  longword refused ;
+} trecpool ;
+#endif
 typedef struct tmem_manager { /* Linked list of memory segments for token expansion and buffers */
   struct tmem_manager *next ; /* next block */
   integer alloc_size ; /* allocated size of this block */
   integer sofar ; /* amount used in this block */
   pointer base ; /* start of the allocated memory in this block */
+  integer map_size ; /* size mapped at base, zero if it came from malloc */
 } tmem_manager ;
 typedef tmem_manager *pmem_manager ;
 
@@ -157,6 +203,12 @@ typedef struct { /* shared variables with client. Require mutex protection */
   integer stat_minutes ;
   integer stat_hours ;
   longint total_minutes ;
+  longint acc_built ; /* total_minutes + 1 when opstat.accstats was last built */
+  boolean capture_requested ; /* client wants packet capture started or stopped */
+  boolean replay_requested ; /* client wants packets replayed from a file */
+  boolean replay_paced ; /* at the rate they were captured */
+  string capture_name ; /* capture file, empty to stop */
+  string replay_name ; /* capture file to replay */
   taccmstats accmstats ;
   topstat opstat ; /* operation status */
   word first_share_clear ; /* start of shared fields cleared after de-registration */
@@ -217,11 +269,13 @@ typedef struct { /* this is the actual context which is hidden from clients */
 #ifdef X86_WIN32
   HANDLE mutex ;
   HANDLE msgmutex ;
+  HANDLE poolmutex ;
   HANDLE threadhandle ;
   longword threadid ;
 #else
   pthread_mutex_t mutex ;
   pthread_mutex_t msgmutex ;
+  pthread_mutex_t poolmutex ;
   pthread_t threadid ;
 #endif
 #endif
@@ -245,6 +299,7 @@ typedef struct { /* this is the actual context which is hidden from clients */
   tshare share ; /* variables shared with client */
   pointer aqstruc ; /* opaque pointer to acquisition structures */
   pointer dssstruc ; /* opaque pointer to dss handler */
+  pointer workers ; /* opaque pointer to LCQ worker threads, NIL if not used */
   pointer md5buf ; /* opaque pointer to md5 working buffer */
   pointer lastuser ;
   longword msg_count ; /* message count */
@@ -293,10 +348,13 @@ typedef struct { /* this is the actual context which is hidden from clients */
   crc_table_type crc_table ;
   tstate_call state_call ; /* buffer for building state callbacks */
   tmsg_call msg_call ; /* buffer for building message callbacks */
+  tmsgring msgring ; /* packet trace events */
+  longword msgring_out ; /* next event for flush_msgring */
   tonesec_call onesec_call ; /* buffer for building one second callbacks */
   tbaler_call baler_call ; /* buffer for buiding baler callbacks */
 #ifndef OMIT_SEED
   tminiseed_call miniseed_call ; /* buffer for building miniseed callbacks */
+  trecpool recpool ; /* for lib_record_hold */
 #endif
   tclock qclock ; /* default clock or loaded from tokens */
   longint zone_adjust ; /* timezone adjust */
@@ -304,6 +362,18 @@ typedef struct { /* this is the actual context which is hidden from clients */
   string contmsg ; /* any errors from continuity checking */
   string9 station_ident ; /* network-station */
   ppkt_buf pkt_bufs[256] ;
+  boolean capturing ; /* writing validated packets to capfile */
+  tfile_handle capfile ;
+  pbyte capbuf ; /* records waiting to be written */
+  integer capcount ; /* bytes in capbuf */
+  boolean replay ; /* packets come from repfile instead of the Q330 */
+  boolean rep_paced ; /* at the rate they were captured */
+  boolean rep_have ; /* rephdr read but not yet processed */
+  tfile_handle repfile ;
+  tcaphdr rephdr ;
+  double rep_first ; /* capture time of first record */
+  double rep_base ; /* host time first record was replayed */
+  longword rep_count ; /* records replayed */
   /* following are cleared after de-registering */
   word first_clear ; /* first byte to clear */
   integer ack_delay ;
@@ -322,6 +392,7 @@ typedef struct { /* this is the actual context which is hidden from clients */
   boolean need_regmsg ; /* need a registration user message */
   boolean piggyok ; /* piggyback status OK */
   boolean reboot_done ; /* has reboot been completed? */
+  boolean fgls_read ; /* have fixed values, global, and logical port since reboot */
   boolean need_sats ; /* need satellite status for clock logging */
   boolean nested_log ; /* we are actually writing a log record */
   boolean flush_all ; /* flush DA and DP LCQ's */
@@ -333,13 +404,16 @@ typedef struct { /* this is the actual context which is hidden from clients */
   integer status_timer ; /* count up for seconds since status */
   longword last_sent_count, lastds_sent_count ; /* packets sent at start of this minute */
   longword last_resent_count, lastds_resent_count ; /* packets resent at start of this minute */
-  word cfgsize, cfgnow, cfgoffset ;
+  word cfgsize, cfgnow ;
+  word cfgtotal, cfgnext ; /* token segments in all and next to request */
+  longword cfgsegs ; /* bitmap of token segments received */
+  word cfgbad ; /* token segments that had to be asked for again */
+  enum tcfgcheck cfgcheck ; /* comparing the tokens read with the cached ones in use */
+  double reg_started ; /* when registration started, zero once data has arrived */
   word ipid ;
   word pingid ;
   word window_size ;
-  boolean escpend ;
-  boolean needframe ;
-  pbyte bufptr ;
+  tslip slip ; /* serial receive framing */
   double ping_send ; /* when ping was sent out */
   tcommands commands ;
   tsrvch srvch ; /* Server challenge packet */
@@ -380,6 +454,8 @@ extern void lock (pq330 q330) ;
 extern void unlock (pq330 q330) ;
 extern void msglock (pq330 q330) ;
 extern void msgunlock (pq330 q330) ;
+extern void poollock (pq330 q330) ;
+extern void poolunlock (pq330 q330) ;
 extern void sleepms (integer ms) ;
 extern void getbuf (pq330 q330, pointer *p, integer size) ;
 extern void mem_release (pq330 q330) ;
@@ -30,10 +30,15 @@ Edit History:
     5 2008-01-10 rdr If file owner is specified then use baler callback to translate file
                      names and handle media access for file open, close, and delete.
     6 2009-07-30 rdr uppercase routine moved here from libtokens, renamed to lib330_upper
+    7 2026-10-19 gns lib330_gregorian, jul_string and packet_time use the cached calendar
+                     in libtime.
 */
 #ifndef libsupport_h
 #include "libsupport.h"
 #endif
+#ifndef libtime_h
+#include "libtime.h"
+#endif
 #include <stdio.h>
 #ifndef X86_WIN32
 #include <sys/stat.h>
@@ -206,85 +211,39 @@ end
 
 void lib330_gregorian (longint jul, tsystemtime *greg)
 begin
-  longint quads, days, subday, yeartemp ;
-
-  days = jul div 86400 ;
-  subday = jul - (days * 86400) ;
-  greg->whour = subday div 3600 ;
-  subday = subday - ((longint) greg->whour * 3600) ;
-  greg->wminute = subday div 60 ;
-  greg->wsecond = subday - (greg->wminute * 60) ;
-  yeartemp = 2000 ;
-  quads = days div 1461 ; /* 0-3 groups */
-  incn(yeartemp, quads shl 2) ;
-  decn(days, quads * 1461) ;
-  if (days >= 366)
-    then
-      begin
-        inc(yeartemp) ;
-        days = days - 366 ; /* remove leap year part of group */
-        while (days >= 365)
-          begin
-            inc(yeartemp) ;
-            days = days - 365 ;
-          end
-      end
-  greg->wyear = yeartemp ;
-  day_gregorian (greg->wyear, days + 1, addr(greg->wmonth), addr(greg->wday)) ;
+  tcalendar cal ;
+
+  lib330_calendar (jul, addr(cal)) ;
+  greg->wyear = cal.year ;
+  greg->wmonth = cal.month ;
+  greg->wday = cal.mday ;
+  greg->whour = cal.hour ;
+  greg->wminute = cal.minute ;
+  greg->wsecond = cal.second ;
 end
 
 char *jul_string (longint jul, pchar result)
 begin
-  tsystemtime g ;
-  string7 s1 ;
+  tcalendar cal ;
 
   if (jul < 0)
     then
       strcpy(result, "Invalid Time       ") ;
     else
       begin
-        lib330_gregorian (jul, addr(g)) ;
-        result[0] = 0 ;
-        sprintf(result, "%d", g.wyear) ;
-        strcat(result, "-") ;
-        sprintf(s1, "%d", g.wmonth) ;
-        zpad(s1, 2) ;
-        strcat(result, s1) ;
-        strcat(result, "-") ;
-        sprintf(s1, "%d", g.wday) ;
-        zpad(s1, 2) ;
-        strcat(result, s1) ;
-        strcat(result, " ") ;
-        sprintf(s1, "%d", g.whour) ;
-        zpad(s1, 2) ;
-        strcat(result, s1) ;
-        strcat(result, ":") ;
-        sprintf(s1, "%d", g.wminute) ;
-        zpad(s1, 2) ;
-        strcat(result, s1) ;
-        strcat(result, ":") ;
-        sprintf(s1, "%d", g.wsecond) ;
-        zpad(s1, 2) ;
-        strcat(result, s1) ;
+        lib330_calendar (jul, addr(cal)) ;
+        sprintf(result, "%d-%02d-%02d %02d:%02d:%02d", cal.year, cal.month, cal.mday,
+                cal.hour, cal.minute, cal.second) ;
       end
   return result ;
 end
 
 char *packet_time (longint jul, pchar result)
 begin
-  tsystemtime g ;
-  string7 s1 ;
+  tcalendar cal ;
 
-  lib330_gregorian (jul, addr(g)) ;
-  strcpy(result, "[") ;
-  sprintf(s1, "%d", g.wminute) ;
-  zpad(s1, 2) ;
-  strcat(result, s1) ;
-  strcat(result, ":") ;
-  sprintf(s1, "%d", g.wsecond) ;
-  zpad(s1, 2) ;
-  strcat(result, s1) ;
-  strcat(result, "] ") ;
+  lib330_calendar (jul, addr(cal)) ;
+  sprintf(result, "[%02d:%02d] ", cal.minute, cal.second) ;
   return result ;
 end ;
 
@@ -0,0 +1,99 @@
+/*   Lib330 cached calendar conversion
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+    1 2026-10-19 gns Round days down for times before 2000 rather than towards zero.
+*/
+#ifndef libtime_h
+#include "libtime.h"
+#endif
+#ifndef pascal_h
+#include "pascal.h"
+#endif
+
+/* days before the start of each month, for common and leap years */
+static const word cal_cumulative[2][13] = {
+  {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365},
+  {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366}} ;
+
+/* The calendar day only changes once every 86400 seconds, so the last one
+   worked out is kept for each thread and the rest is a few divisions */
+static THREADVAR longint cal_day = 0x7FFFFFFF ; /* none yet */
+static THREADVAR word cal_year ;
+static THREADVAR word cal_jday ;
+static THREADVAR word cal_month ;
+static THREADVAR word cal_mday ;
+
+static void calendar_day (longint days)
+begin
+  longint quads, left ;
+  word leap ;
+
+  quads = days div 1461 ; /* four year groups, each starting with a leap year */
+  left = days - quads * 1461 ;
+  if (left < 0)
+    then
+      begin /* before 2000, the group starts earlier */
+        dec(quads) ;
+        left = left + 1461 ;
+      end
+  cal_year = (word)(2000 + quads * 4) ;
+  if (left >= 366)
+    then
+      begin
+        left = left - 366 ;
+        cal_year = cal_year + 1 + (word)(left div 365) ;
+        left = left mod 365 ;
+      end
+  leap = ((cal_year mod 4) == 0) ;
+  cal_jday = (word)left + 1 ;
+  cal_month = 1 ;
+  while (left >= cal_cumulative[leap][cal_month])
+    inc(cal_month) ;
+  cal_mday = (word)left - cal_cumulative[leap][cal_month - 1] + 1 ;
+  cal_day = days ;
+end
+
+void lib330_calendar (longint jul, tcalendar *cal)
+begin
+  longint days, subday ;
+
+  days = jul div 86400 ;
+  subday = jul - days * 86400 ;
+  if (subday < 0)
+    then
+      begin /* before 2000, still a time of day from midnight */
+        dec(days) ;
+        subday = subday + 86400 ;
+      end
+  if (days != cal_day)
+    then
+      calendar_day (days) ;
+  cal->year = cal_year ;
+  cal->jday = cal_jday ;
+  cal->month = cal_month ;
+  cal->mday = cal_mday ;
+  cal->hour = (word)(subday div 3600) ;
+  subday = subday - (longint)cal->hour * 3600 ;
+  cal->minute = (word)(subday div 60) ;
+  cal->second = (word)(subday - (longint)cal->minute * 60) ;
+end
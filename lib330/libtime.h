@@ -0,0 +1,51 @@
+/*   Lib330 cached calendar conversion definitions
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+    1 2026-10-19 gns Times before 2000 are converted too, add CAL_MINDAY.
+*/
+#ifndef libtime_h
+/* Flag this file as included */
+#define libtime_h
+#define VER_LIBTIME 1
+
+/* Only the platform types are needed, so this can also be used outside lib330 */
+#ifndef platform_h
+#include "platform.h"
+#endif
+
+#define CAL_MINDAY (-24855) /* first whole day a longint of seconds since 2000 can reach */
+#define CAL_MAXDAY 24855 /* last whole day a longint of seconds since 2000 can reach */
+
+typedef struct { /* seconds since 2000 broken down */
+  word year ;
+  word jday ; /* day of the year, 1 to 366 */
+  word month ;
+  word mday ;
+  word hour ;
+  word minute ;
+  word second ;
+} tcalendar ;
+
+extern void lib330_calendar (longint jul, tcalendar *cal) ;
+
+#endif
@@ -28,6 +28,23 @@ Edit History:
     4 2009-07-30 rdr Move uppercase to libsupport.
     5 2010-03-27 rdr Add Q335 support.
     6 2011-07-24 rdr Fix bug in loading opaque token data.
+    7 2026-10-19 gns Add new_lcq, taking main LCQs from slabs and allocating the cold part
+                     separately.
+    8 2026-10-19 gns Build the dispatch plans after init_lcq.
+    9 2026-10-19 gns Assign the LCQs to worker threads once the control detectors are expanded.
+   10 2026-10-19 gns Once the first token segment says how many there are, keep up to
+                     CMDWINDOW segment requests outstanding.
+   11 2026-10-19 gns Keep the tokens read in a cache file next to the continuity files. If
+                     the cache matches the serial number and data port, decode it straight
+                     away and verify it against the tokens as they are read.
+   12 2026-10-19 gns Check each token segment is the one asked for and fits with the others,
+                     log one that doesn't and ask for it again. After CFG_RETRIES the read
+                     starts over.
+   13 2026-10-19 gns Stay in LIBSTATE_READTOK while verifying the cache until the first
+                     segment matches, so no data is acquired with stale tokens. If it
+                     doesn't match drop the cache and read the tokens instead.
+   14 2026-10-19 gns The cached tokens are decoded once the first segment matches, but the
+                     data port waits until every segment has, see lib_timer.
 */
 #ifndef libclient_h
 #include "libclient.h"
@@ -64,6 +81,9 @@ Edit History:
 #ifndef libsampcfg_h
 #include "libsampcfg.h"
 #endif
+#ifndef libworker_h
+#include "libworker.h"
+#endif
 #ifndef libcont_h
 #include "libcont.h"
 #endif
@@ -221,6 +241,40 @@ begin
   strcpy(addr(q->sseedname), s) ;
 end
 
+/* Main LCQs are carved from slabs of LCQ_SLAB so the ones processing data sit
+  next to each other rather than between token structures and buffers. DP LCQs
+  live as long as the thread and come from thread memory */
+plcq new_lcq (paqstruc paqs, boolean thread_life)
+begin
+  plcq q ;
+  pq330 q330 ;
+
+  q330 = paqs->owner ;
+  if (thread_life)
+    then
+      getthrbuf (q330, addr(q), sizeof(tlcq)) ;
+    else
+      begin
+        if (paqs->lcq_slab_left <= 0)
+          then
+            begin
+              getbuf (q330, addr(paqs->lcq_slab), LCQ_SLAB * sizeof(tlcq)) ;
+              paqs->lcq_slab_left = LCQ_SLAB ;
+            end
+        q = paqs->lcq_slab ;
+        inc(paqs->lcq_slab) ;
+        dec(paqs->lcq_slab_left) ;
+      end
+#ifndef OMIT_SEED
+  if (thread_life)
+    then
+      getthrbuf (q330, addr(q->cold), sizeof(tlcq_cold)) ;
+    else
+      getbuf (q330, addr(q->cold), sizeof(tlcq_cold)) ;
+#endif
+  return q ;
+end
+
 static void read_lcq (paqstruc paqs, pbyte *p)
 begin
   plcq cur_lcq ;
@@ -238,7 +292,7 @@ begin
 #endif
 
   q330 = paqs->owner ;
-  getbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+  cur_lcq = new_lcq (paqs, FALSE) ;
   if (paqs->lcqs == NIL)
     then
       paqs->lcqs = cur_lcq ;
@@ -429,7 +483,7 @@ begin
     then
       begin /* add new one */
         newone = TRUE ;
-        getthrbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+        cur_lcq = new_lcq (paqs, TRUE) ;
         if (paqs->dplcqs == NIL)
           then
             paqs->dplcqs = cur_lcq ;
@@ -670,7 +724,7 @@ begin
     then
       begin /* add new one */
         newone = TRUE ;
-        getthrbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+        cur_lcq = new_lcq (paqs, TRUE) ;
         if (paqs->dplcqs == NIL)
           then
             paqs->dplcqs = cur_lcq ;
@@ -700,7 +754,7 @@ begin
     then
       preload_archive (q330, FALSE, cur_lcq) ;
 #endif
-  getbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+  cur_lcq = new_lcq (paqs, FALSE) ;
   getbuf (q330, addr(cur_lcq->com), sizeof(tcom_packet)) ;
   paqs->lcqs = extend_link (paqs->lcqs, cur_lcq) ;
   paqs->tim_lcq = cur_lcq ;
@@ -715,8 +769,8 @@ begin
       cur_lcq->mini_filter = q330->par_create.opt_minifilter and (OMF_ALL or OMF_TIM) ;
   if ((paqs->arc_size > 0) land (q330->par_create.call_aminidata))
     then
-      cur_lcq->arc.amini_filter = q330->par_create.opt_aminifilter and (OMF_ALL or OMF_TIM) ;
-  getbuf (q330, addr(cur_lcq), sizeof(tlcq)) ;
+      cur_lcq->cold->arc.amini_filter = q330->par_create.opt_aminifilter and (OMF_ALL or OMF_TIM) ;
+  cur_lcq = new_lcq (paqs, FALSE) ;
   getbuf (q330, addr(cur_lcq->com), sizeof(tcom_packet)) ;
   paqs->lcqs = extend_link (paqs->lcqs, cur_lcq) ;
   paqs->cfg_lcq = cur_lcq ;
@@ -731,7 +785,7 @@ begin
       cur_lcq->mini_filter = q330->par_create.opt_minifilter and (OMF_ALL or OMF_CFG) ;
   if ((paqs->arc_size > 0) land (q330->par_create.call_aminidata))
     then
-      cur_lcq->arc.amini_filter = q330->par_create.opt_aminifilter and (OMF_ALL or OMF_CFG) ;
+      cur_lcq->cold->arc.amini_filter = q330->par_create.opt_aminifilter and (OMF_ALL or OMF_CFG) ;
 end
 #endif
 
@@ -930,9 +984,11 @@ begin
   s1[2] = 0 ; /* build string representation of network (always 2 characters) */
   sprintf (addr(q330->station_ident), "%s-%s", s1, s) ; /* network-station */
   init_lcq (paqs) ;
+  build_plans (paqs) ;
 #ifndef OMIT_SEED
   expand_control_detectors (paqs) ;
 #endif
+  assign_workers (paqs) ;
   check_continuity (q330) ;
   if (paqs->data_timetag > 1.0) /* if non-zero continuity was restored, write cfg blks at start of session */
     then
@@ -961,52 +1017,264 @@ begin
   new_state (q330, LIBSTATE_RUNWAIT) ;
 end
 
-void read_q330_cfg (pq330 q330, pbyte pb)
+typedef struct { /* start of the token cache file, the tokens follow */
+  longint crc ; /* over the rest of the header and the tokens */
+  word version ;
+  word size ; /* bytes of tokens */
+  t64 serial ; /* Q330 serial number */
+  word dataport ; /* LP_TEL1 .. LP_TEL4 */
+  word spare ;
+} tcfgcache ;
+typedef struct {
+  tcfgcache hdr ;
+  tcfgbuf cfg ;
+} tcfgcachefile ;
+
+static void cache_name (pq330 q330, pchar fname)
 begin
-  word w ;
+
+  strcpy(fname, q330->par_create.opt_contfile) ;
+  strcat(fname, "k") ;
+end
+
+static void save_cfg_cache (pq330 q330)
+begin
+  tcfgcachefile cache ;
+  tfile_handle cf ;
+  string fname ;
+
+  if (q330->par_create.opt_contfile[0] == 0)
+    then
+      return ;
+  memset (addr(cache.hdr), 0, sizeof(tcfgcache)) ;
+  cache.hdr.version = CFGCACHE_VER ;
+  cache.hdr.size = q330->cfgsize ;
+  memcpy (addr(cache.hdr.serial), addr(q330->par_create.q330id_serial), sizeof(t64)) ;
+  cache.hdr.dataport = q330->par_create.q330id_dataport ;
+  memcpy (addr(cache.cfg), q330->cfgbuf, q330->cfgsize) ;
+  cache.hdr.crc = gcrccalc (addr(q330->crc_table), (pointer)((integer)addr(cache) + 4),
+                            sizeof(tcfgcache) - 4 + q330->cfgsize) ;
+  cache_name (q330, fname) ;
+  cf = lib_file_open (q330->par_create.file_owner, fname, LFO_CREATE or LFO_WRITE) ;
+  if (cf == INVALID_FILE_HANDLE)
+    then
+      return ;
+  lib_file_write (q330->par_create.file_owner, cf, addr(cache), sizeof(tcfgcache) + q330->cfgsize) ;
+  lib_file_close (q330->par_create.file_owner, cf) ;
+end
+
+/* returns TRUE with the cached tokens in cfgbuf if there are any for this Q330 and data port */
+static boolean load_cfg_cache (pq330 q330)
+begin
+  tcfgcachefile cache ;
+  tfile_handle cf ;
+  string fname ;
+  integer size ;
+  boolean good ;
+
+  if (q330->par_create.opt_contfile[0] == 0)
+    then
+      return FALSE ;
+  cache_name (q330, fname) ;
+  cf = lib_file_open (q330->par_create.file_owner, fname, LFO_OPEN or LFO_READ) ;
+  if (cf == INVALID_FILE_HANDLE)
+    then
+      return FALSE ;
+  size = lib_file_size (q330->par_create.file_owner, cf) - (integer)sizeof(tcfgcache) ;
+  good = ((size > 0) land (size <= MAXCFG) land
+          (lnot lib_file_read (q330->par_create.file_owner, cf, addr(cache), sizeof(tcfgcache) + size))) ;
+  lib_file_close (q330->par_create.file_owner, cf) ;
+  if ((lnot good) lor (cache.hdr.version != CFGCACHE_VER) lor (cache.hdr.size != size) lor
+      (memcmp(addr(cache.hdr.serial), addr(q330->par_create.q330id_serial), sizeof(t64)) != 0) lor
+      (cache.hdr.dataport != q330->par_create.q330id_dataport) lor
+      (cache.hdr.crc != gcrccalc (addr(q330->crc_table), (pointer)((integer)addr(cache) + 4),
+                                  sizeof(tcfgcache) - 4 + size)))
+    then
+      return FALSE ;
+  memcpy (q330->cfgbuf, addr(cache.cfg), size) ;
+  q330->cfgsize = size ;
+  return TRUE ;
+end
+
+#define CFG_RETRIES 8 /* token segments asked for again before starting over */
+
+/* every segment but the last is full, so where each one starts is known */
+static void request_segment (pq330 q330, word segnum)
+begin
+
+  new_mem_cmd (q330, MT_CFG1 + q330->par_create.q330id_dataport,
+               (longword)(segnum - 1) * (MAXSEG + OVERHEAD)) ;
+end
+
+/* Log a segment that can't be used and ask for it again. After too many start
+   over, registering again if reading, as for a token change if verifying
+   once the cached tokens have been decoded */
+static void bad_segment (pq330 q330, word segnum, pchar why)
+begin
+  string95 s ;
+
+  sprintf(s, "%d, %s", (int)segnum, why) ;
+  libmsgadd (q330, LIBMSG_TOKSEG, addr(s)) ;
+  inc(q330->cfgbad) ;
+  if (q330->cfgbad <= CFG_RETRIES)
+    then
+      request_segment (q330, segnum) ;
+  else if ((q330->cfgcheck == CC_VERIFY) land (q330->libstate != LIBSTATE_READTOK))
+    then
+      q330->cfgcheck = CC_CHANGED ;
+    else
+      begin
+        q330->cfgcheck = CC_NONE ;
+        lib_change_state (q330, LIBSTATE_WAIT, LIBERR_INVAL_TOKENS) ;
+        sprintf(s, ", will retry in %d seconds", NR_TIME) ;
+        libmsgadd (q330, LIBMSG_INVTOK, addr(s)) ;
+        q330->reg_wait_timer = NR_TIME ;
+      end
+end
+
+/* the Q330 refused the request for the segment at start */
+void cfg_segment_error (pq330 q330, longword start)
+begin
+
+  bad_segment (q330, start div (MAXSEG + OVERHEAD) + 1, "refused") ;
+end
+
+/* pb is past the memory header of the response to the request for start */
+void read_q330_cfg (pq330 q330, pbyte pb, longword start)
+begin
+  word w, segnum ;
   tseghdr seghdr ;
   pbyte p ;
   tmem *pmem ;
-  string31 s ;
+  string95 s ;
 
   p = pb ; /* p now has location in received buffer */
   pmem = addr(q330->mem_hdr) ;
+  segnum = start div (MAXSEG + OVERHEAD) + 1 ;
+  if ((pmem->memtype != MT_CFG1 + q330->par_create.q330id_dataport) lor (pmem->start != start) lor
+      (pmem->count < 4) lor ((integer)pmem->count + 8 > (integer)q330->recvhdr.datalength))
+    then
+      begin
+        bad_segment (q330, segnum, "not what was asked for") ;
+        return ;
+      end
   loadseghdr (addr(p), addr(seghdr)) ;
   w = pmem->count - 4 ; /* remove segment numbers */
-  q330->cfgnow = (seghdr.segnum - 1) * MAXSEG ;
-  memcpy (addr((*(q330->cfgbuf))[q330->cfgnow]), p, w) ;
-  q330->cfgsize = q330->cfgnow + w ;
-  if (seghdr.segnum == seghdr.segtotal)
+  if (seghdr.segnum != segnum)
     then
       begin
-        sprintf(s, "%d bytes", q330->cfgsize) ;
-        libmsgadd (q330, LIBMSG_TOKREAD, addr(s)) ;
-        new_state (q330, LIBSTATE_DECTOK) ;
+        bad_segment (q330, segnum, "another came back") ;
+        return ;
+      end
+  if ((seghdr.segtotal < segnum) lor (seghdr.segtotal > (MAXCFG + MAXSEG - 1) div MAXSEG) lor
+      ((q330->cfgtotal) land (seghdr.segtotal != q330->cfgtotal)) lor (w > MAXSEG) lor
+      ((segnum < seghdr.segtotal) land (w != MAXSEG)) lor (((segnum - 1) * MAXSEG + w) > MAXCFG))
+    then
+      begin
+        bad_segment (q330, segnum, "out of range") ;
+        return ;
+      end
+  if (q330->cfgsegs and make_bitmap(segnum - 1))
+    then
+      return ; /* already have it */
+  q330->cfgsegs = q330->cfgsegs or make_bitmap(segnum - 1) ;
+  q330->cfgnow = (segnum - 1) * MAXSEG ;
+  if ((q330->cfgcheck == CC_VERIFY) land
+      ((seghdr.segtotal != (q330->cfgsize + MAXSEG - 1) div MAXSEG) lor
+       ((q330->cfgnow + w) > q330->cfgsize) lor
+       ((segnum == seghdr.segtotal) land ((q330->cfgnow + w) != q330->cfgsize)) lor
+       (memcmp (addr((*(q330->cfgbuf))[q330->cfgnow]), p, w) != 0)))
+    then
+      begin
+        if (q330->libstate != LIBSTATE_READTOK)
+          then
+            begin
+              q330->cfgcheck = CC_CHANGED ;
+              return ;
+            end
+        q330->cfgcheck = CC_NONE ; /* nothing decoded yet, drop the cache and carry on reading */
+        q330->cfgsize = 0 ;
+        s[0] = 0 ;
+        libmsgadd (q330, LIBMSG_TOKCHG, addr(s)) ;
+      end
+  if (q330->cfgcheck == CC_VERIFY)
+    then
+      begin /* cfgbuf is in use, compare rather than replace */
+        if (q330->libstate == LIBSTATE_READTOK)
+          then
+            new_state (q330, LIBSTATE_DECTOK) ; /* first segment matches, can use the cache */
       end
     else
       begin
-        q330->cfgoffset = q330->cfgoffset + w + OVERHEAD ;
-        pmem = addr(q330->mem_req) ;
-        pmem->start = q330->cfgoffset ;
-        pmem->count = 0 ;
-        pmem->memtype = MT_CFG1 + q330->par_create.q330id_dataport ;
-        new_cmd (q330, C1_RQMEM, MAXSEG) ;
+        memcpy (addr((*(q330->cfgbuf))[q330->cfgnow]), p, w) ;
+        if (segnum == seghdr.segtotal)
+          then
+            q330->cfgsize = q330->cfgnow + w ;
+      end
+  if (q330->cfgsegs == (make_bitmap(seghdr.segtotal) - 1))
+    then
+      begin
+        if (q330->cfgcheck == CC_VERIFY)
+          then
+            begin
+              q330->cfgcheck = CC_NONE ;
+              s[0] = 0 ;
+              libmsgadd (q330, LIBMSG_TOKVER, addr(s)) ;
+            end
+          else
+            begin
+              sprintf(s, "%d bytes", q330->cfgsize) ;
+              libmsgadd (q330, LIBMSG_TOKREAD, addr(s)) ;
+              save_cfg_cache (q330) ;
+              new_state (q330, LIBSTATE_DECTOK) ;
+            end
+      end
+  else if (q330->cfgtotal == 0)
+    then
+      begin /* first one back, now know how many to ask for */
+        q330->cfgtotal = seghdr.segtotal ;
+        while ((q330->cfgnext <= q330->cfgtotal) land (q330->cfgnext <= CMDWINDOW + 1))
+          begin
+            request_segment (q330, q330->cfgnext) ;
+            inc(q330->cfgnext) ;
+          end
+      end
+  else if (q330->cfgnext <= q330->cfgtotal)
+    then
+      begin /* replace the one just answered */
+        request_segment (q330, q330->cfgnext) ;
+        inc(q330->cfgnext) ;
       end
 end
 
+/* With usable cached tokens they are decoded once the first segment read matches
+   them, the rest are read only to check the cache and acquisition waits until
+   they all have. After a token change always read them first */
 void cfg_start (pq330 q330)
 begin
-  tmem *pmem ;
+  string95 s ;
 
-  pmem = addr(q330->mem_req) ;
-  new_state (q330, LIBSTATE_READTOK) ;
-  libmsgadd (q330, LIBMSG_READTOK, "") ;
   q330->data_timer = 0 ;
-  pmem->start = 0 ;
-  pmem->count = 0 ;
-  pmem->memtype = MT_CFG1 + q330->par_create.q330id_dataport ;
-  new_cmd (q330, C1_RQMEM, MAXSEG) ;
+  q330->mem_req.count = 0 ;
   q330->cfgsize = 0 ;
   q330->cfgnow = 0 ;
-  q330->cfgoffset = 0 ;
+  q330->cfgsegs = 0 ;
+  q330->cfgtotal = 0 ;
+  q330->cfgnext = 2 ;
+  q330->cfgbad = 0 ;
+  if ((q330->share.liberr != LIBERR_TOKENS_CHANGE) land (load_cfg_cache (q330)))
+    then
+      begin
+        q330->cfgcheck = CC_VERIFY ;
+        sprintf(s, "%d bytes", q330->cfgsize) ;
+        libmsgadd (q330, LIBMSG_TOKCACHE, addr(s)) ;
+      end
+    else
+      begin
+        q330->cfgcheck = CC_NONE ;
+        s[0] = 0 ;
+        libmsgadd (q330, LIBMSG_READTOK, addr(s)) ;
+      end
+  new_state (q330, LIBSTATE_READTOK) ;
+  request_segment (q330, 1) ;
 end
@@ -21,11 +21,15 @@ Edit History:
    Ed Date       By  Changes
    -- ---------- --- ---------------------------------------------------
     0 2006-10-01 rdr Created
+    1 2026-10-19 gns Add new_lcq.
+    2 2026-10-19 gns Add CFGCACHE_VER.
+    3 2026-10-19 gns read_q330_cfg is given where the segment was asked for, add
+                     cfg_segment_error.
 */
 #ifndef libtokens_h
 /* Flag this file as included */
 #define libtokens_h
-#define VER_LIBTOKENS 6
+#define VER_LIBTOKENS 14
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -38,6 +42,7 @@ Edit History:
 #define MAXCFG 7884 /* actual number of characters allowed */
 #define T_VER 0 /* Token Version */
 #define DEFLTH 37 /* Number of valid bytes in deftok */
+#define CFGCACHE_VER 1 /* token cache file version */
 
 /* Fixed Length Tokens */
 #define TF_NOP 0 /* nothing */
@@ -99,8 +104,10 @@ typedef struct { /* murdock-hutt detector definition */
 #endif
 
 extern void cfg_start (pq330 q330) ;
-extern void read_q330_cfg (pq330 q330, pbyte pb) ;
+extern void read_q330_cfg (pq330 q330, pbyte pb, longword start) ;
+extern void cfg_segment_error (pq330 q330, longword start) ;
 extern void decode_cfg (pq330 q330) ;
 extern void set_loc_name (plcq q) ;
+extern plcq new_lcq (paqstruc paqs, boolean thread_life) ;
 
 #endif
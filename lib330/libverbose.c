@@ -27,6 +27,7 @@ Edit History:
     4 2010-05-09 rdr Some cosemetic Q335 changes.
     5 2010-07-25 rdr Change in Q335 PGA encoding.
     6 2012-07-08 rdr Fix clock type 2 display.
+    7 2026-10-19 gns Archival and session statistics are now in the LCQ cold part.
 */
 #ifndef libverbose_h
 #include "libverbose.h"
@@ -592,8 +593,8 @@ begin
       if ((q == paqs->msg_lcq) land (q->com->ring) land (q->com->frame >= 2))
         then
           futuremr = 1 ;
-      totrec = totrec + q->records_generated_session + futuremr ;
-      if ((q->records_generated_session + futuremr) > 0)
+      totrec = totrec + q->cold->records_generated_session + futuremr ;
+      if ((q->cold->records_generated_session + futuremr) > 0)
         then
           begin
             if (strlen(m) >= 68)
@@ -603,7 +604,7 @@ begin
                   strcpy(m, "written:") ;
                 end
             sprintf(s, " %s-%d", seed2string(q->location, q->seedname, addr(s1)),
-                    q->records_generated_session + futuremr) ;
+                    q->cold->records_generated_session + futuremr) ;
             strcat (m, s) ;
           end
       q = q->link ;
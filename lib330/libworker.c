@@ -0,0 +1,491 @@
+/*   Lib330 LCQ worker threads
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+*/
+#ifndef libworker_h
+#include "libworker.h"
+#endif
+#ifndef libsample_h
+#include "libsample.h"
+#endif
+#ifndef libstrucs_h
+#include "libstrucs.h"
+#endif
+
+/*
+  The lib330 thread still sequences every data packet, but a main digitizer
+  blockette for an LCQ owned by a worker is copied to that worker's queue along
+  with the packet state, and the worker does the decompression, filtering,
+  detection and compression. LCQs that look at each other, a derived LCQ and its
+  source or the LCQs named in a control detector, are owned by the same worker.
+  Anything on the lib330 thread that reaches into LCQ state outside of sequencing
+  calls drain_workers first.
+*/
+
+/* What the lib330 thread did for each LCQ in the plan of a main blockette */
+static void run_main (pq330 q330, plcq q, psampctx ctx, byte kind, pbyte pblk,
+                      longint val, byte subchan, boolean charging)
+begin
+  pbyte p ;
+
+#ifndef OMIT_SEED
+  if (charging)
+    then
+      q->com->charging = TRUE ;
+#endif
+  switch (kind) begin
+    case PJ_ONE :
+      process_one (q330, q, ctx, val) ;
+      break ;
+    case PJ_COMP :
+      p = pblk ;
+      incn(p, 4) ; /* already read by the sequencer */
+      process_comp (q330, q, ctx, p, val) ;
+      break ;
+    case PJ_MULT :
+      if ((q->dholdq) land (q->dholdq->ppkt))
+        then
+          begin
+            if (q->dholdq->ppkt->seg_freq == subchan)
+              then /* detect duplicate queued pkt */
+                q->dholdq->ppkt = NIL ;
+              else
+                process_mult (q330, q, ctx, (pointer)q->dholdq->ppkt, ctx->sequence) ;
+          end
+      process_mult (q330, q, ctx, pblk, ctx->sequence) ;
+      break ;
+  end
+end
+
+#if defined(X86_WIN32) || defined(CMEX32)
+/* Workers are only implemented with pthreads, elsewhere opt_workers is ignored */
+void start_workers (pq330 q330) begin end
+void stop_workers (pq330 q330) begin end
+void drain_workers (pq330 q330) begin end
+
+#else
+typedef struct {
+  plcq q ;
+  tsampctx ctx ; /* packet state when it was queued */
+  byte kind ; /* PJ_xxx */
+  byte subchan ;
+  boolean charging ; /* first packet since registration */
+  longint val ; /* sample for PJ_ONE, else the blockette size */
+  byte blk[MAXDATA] ; /* copy of the blockette, the packet buffer is reused */
+} tjob ;
+
+typedef struct {
+  pq330 owner ;
+  pthread_t threadid ;
+  pthread_mutex_t mutex ;
+  pthread_cond_t work ; /* jobs queued or terminating */
+  pthread_cond_t done ; /* jobs finished */
+  integer head ; /* oldest unfinished job */
+  integer count ; /* queued jobs, including those being processed */
+  boolean terminate ;
+  tonesec_call onesec ; /* for building this worker's one second callbacks */
+  tjob jobs[WORKER_JOBS] ;
+} tworker ;
+typedef tworker *pworker ;
+
+typedef struct {
+  integer count ;
+  pworker w[MAX_WORKERS] ;
+} tworkers ;
+typedef tworkers *pworkers ;
+
+/* Jobs are taken in batches, the queue lock is only held to see how many there are */
+static void *workerthread (pointer p)
+begin
+  pworker pw ;
+  tjob *pj ;
+  integer i, n ;
+
+  pw = p ;
+  pthread_mutex_lock (addr(pw->mutex)) ;
+  repeat
+    if (pw->count == 0)
+      then
+        pthread_cond_wait (addr(pw->work), addr(pw->mutex)) ;
+      else
+        begin
+          n = pw->count ;
+          pthread_mutex_unlock (addr(pw->mutex)) ;
+          for (i = 0 ; i < n ; i++)
+            begin
+              pj = addr(pw->jobs[(pw->head + i) mod WORKER_JOBS]) ;
+              run_main (pw->owner, pj->q, addr(pj->ctx), pj->kind, (pbyte)addr(pj->blk),
+                        pj->val, pj->subchan, pj->charging) ;
+            end
+          pthread_mutex_lock (addr(pw->mutex)) ;
+          pw->head = (pw->head + n) mod WORKER_JOBS ;
+          pw->count = pw->count - n ;
+          pthread_cond_broadcast (addr(pw->done)) ;
+        end
+  until ((pw->terminate) land (pw->count == 0))) ;
+  pthread_mutex_unlock (addr(pw->mutex)) ;
+  return NIL ;
+end
+
+void start_workers (pq330 q330)
+begin
+  pworkers pws ;
+  pworker pw ;
+  integer i, n ;
+
+  q330->workers = NIL ;
+  n = q330->par_create.opt_workers ;
+  if (n > MAX_WORKERS)
+    then
+      n = MAX_WORKERS ;
+  if (n <= 0)
+    then
+      return ;
+  pws = malloc (sizeof(tworkers)) ;
+  if (pws == NIL)
+    then
+      return ;
+  memset (pws, 0, sizeof(tworkers)) ;
+  for (i = 0 ; i < n ; i++)
+    begin
+      pw = malloc (sizeof(tworker)) ;
+      if (pw == NIL)
+        then
+          break ;
+      memset (pw, 0, sizeof(tworker)) ;
+      pw->owner = q330 ;
+      pthread_mutex_init (addr(pw->mutex), NULL) ;
+      pthread_cond_init (addr(pw->work), NULL) ;
+      pthread_cond_init (addr(pw->done), NULL) ;
+      if (pthread_create (addr(pw->threadid), NULL, workerthread, pw))
+        then
+          begin
+            pthread_mutex_destroy (addr(pw->mutex)) ;
+            pthread_cond_destroy (addr(pw->work)) ;
+            pthread_cond_destroy (addr(pw->done)) ;
+            free (pw) ;
+            break ;
+          end
+      pws->w[pws->count] = pw ;
+      inc(pws->count) ;
+    end
+  if (pws->count == 0)
+    then
+      free (pws) ;
+    else
+      q330->workers = pws ;
+end
+
+/* Finishes whatever is queued first */
+void stop_workers (pq330 q330)
+begin
+  pworkers pws ;
+  pworker pw ;
+  integer i ;
+
+  pws = q330->workers ;
+  if (pws == NIL)
+    then
+      return ;
+  q330->workers = NIL ;
+  for (i = 0 ; i < pws->count ; i++)
+    begin
+      pw = pws->w[i] ;
+      pthread_mutex_lock (addr(pw->mutex)) ;
+      pw->terminate = TRUE ;
+      pthread_cond_broadcast (addr(pw->work)) ;
+      pthread_mutex_unlock (addr(pw->mutex)) ;
+      pthread_join (pw->threadid, NULL) ;
+      pthread_mutex_destroy (addr(pw->mutex)) ;
+      pthread_cond_destroy (addr(pw->work)) ;
+      pthread_cond_destroy (addr(pw->done)) ;
+      free (pw) ;
+    end
+  free (pws) ;
+end
+
+/* Wait until every worker is idle, after this the lib330 thread may touch any LCQ */
+void drain_workers (pq330 q330)
+begin
+  pworkers pws ;
+  pworker pw ;
+  integer i ;
+
+  pws = q330->workers ;
+  if (pws == NIL)
+    then
+      return ;
+  for (i = 0 ; i < pws->count ; i++)
+    begin
+      pw = pws->w[i] ;
+      pthread_mutex_lock (addr(pw->mutex)) ;
+      while (pw->count > 0)
+        pthread_cond_wait (addr(pw->done), addr(pw->mutex)) ;
+      pthread_mutex_unlock (addr(pw->mutex)) ;
+    end
+end
+
+static void queue_job (pworker pw, plcq q, psampctx ctx, byte kind, pbyte pblk,
+                       longint val, byte subchan, boolean charging)
+begin
+  tjob *pj ;
+
+  pthread_mutex_lock (addr(pw->mutex)) ;
+  while (pw->count >= WORKER_JOBS)
+    pthread_cond_wait (addr(pw->done), addr(pw->mutex)) ;
+  pj = addr(pw->jobs[(pw->head + pw->count) mod WORKER_JOBS]) ;
+  pj->q = q ;
+  memcpy (addr(pj->ctx), ctx, sizeof(tsampctx)) ;
+  pj->ctx.onesec = addr(pw->onesec) ;
+  pj->kind = kind ;
+  pj->subchan = subchan ;
+  pj->charging = charging ;
+  pj->val = val ;
+  switch (kind) begin
+    case PJ_COMP :
+      memcpy (addr(pj->blk), pblk, val) ;
+      break ;
+    case PJ_MULT :
+      memcpy (addr(pj->blk), pblk, val and DMSZ) ;
+      break ;
+  end
+  inc(pw->count) ;
+  if (pw->count == 1)
+    then
+      pthread_cond_signal (addr(pw->work)) ; /* was idle */
+  pthread_mutex_unlock (addr(pw->mutex)) ;
+end
+#endif
+
+/* pblk is the start of the blockette, val the sample for PJ_ONE, else the blockette size */
+void process_main (pq330 q330, plcq q, psampctx ctx, byte kind, pbyte pblk,
+                   longint val, byte subchan)
+begin
+#if !defined(X86_WIN32) && !defined(CMEX32)
+  pworkers pws ;
+
+  pws = q330->workers ;
+  if ((q->worker) land (pws))
+    then
+      begin
+        queue_job (pws->w[q->worker - 1], q, ctx, kind, pblk, val, subchan, q330->lastseq == 0) ;
+        return ;
+      end
+#endif
+  run_main (q330, q, ctx, kind, pblk, val, subchan, q330->lastseq == 0) ;
+end
+
+/* Client callbacks are made one at a time, the message lock allows nesting */
+void outlock (pq330 q330)
+begin
+
+  if (q330->workers)
+    then
+      msglock (q330) ;
+end
+
+void outunlock (pq330 q330)
+begin
+
+  if (q330->workers)
+    then
+      msgunlock (q330) ;
+end
+
+static integer find_lcq (plcq *lcqs, integer count, plcq q)
+begin
+  integer i ;
+
+  for (i = 0 ; i < count ; i++)
+    if (lcqs[i] == q)
+      then
+        return i ;
+  return -1 ;
+end
+
+static integer group_of (integer *group, integer i)
+begin
+
+  while (group[i] != i)
+    i = group[i] ;
+  return i ;
+end
+
+static void join_groups (integer *group, integer i, integer j)
+begin
+
+  if ((i >= 0) land (j >= 0))
+    then
+      group[group_of(group, i)] = group_of(group, j) ;
+end
+
+static boolean in_mplan (paqstruc paqs, plcq q)
+begin
+  integer i, j ;
+  pplanstep ps ;
+
+  for (i = 0 ; i < CHANNELS ; i++)
+    for (j = 0 ; j < FREQUENCIES ; j++)
+      for (ps = paqs->mplan[i][j] ; ps->lcq ; inc(ps))
+        if (ps->lcq == q)
+          then
+            return TRUE ;
+  return FALSE ;
+end
+
+/*
+  Divide the LCQs between the workers. Groups of LCQs that depend on each other
+  stay together, a group with any LCQ fed other than by main digitizer data stays
+  on the lib330 thread, the rest go to the least loaded worker, largest first.
+*/
+void assign_workers (paqstruc paqs)
+begin
+  pq330 q330 ;
+  pworkers pws ;
+  plcq q ;
+  plcq *lcqs ;
+  integer *group ;
+  integer *load ;
+  integer wload[MAX_WORKERS] ;
+  integer count, i, j, k, best ;
+#ifndef OMIT_SEED
+  pdop pop ;
+  pdet_packet pdp ;
+#endif
+
+  q330 = paqs->owner ;
+  count = 0 ;
+  q = paqs->lcqs ;
+  while (q)
+    begin
+      q->worker = 0 ;
+      inc(count) ;
+      q = q->link ;
+    end
+  pws = q330->workers ;
+  if ((pws == NIL) lor (count == 0))
+    then
+      return ;
+  lcqs = malloc (count * sizeof(plcq)) ;
+  group = malloc (count * sizeof(integer)) ;
+  load = malloc (count * sizeof(integer)) ;
+  if ((lcqs == NIL) lor (group == NIL) lor (load == NIL))
+    then
+      begin
+        free (lcqs) ;
+        free (group) ;
+        free (load) ;
+        return ; /* everything stays on the lib330 thread */
+      end
+  i = 0 ;
+  q = paqs->lcqs ;
+  while (q)
+    begin
+      lcqs[i] = q ;
+      group[i] = i ;
+      load[i] = 0 ;
+      inc(i) ;
+      q = q->link ;
+    end
+#ifndef OMIT_SEED
+  for (i = 0 ; i < count ; i++)
+    begin
+      q = lcqs[i] ;
+      if (q->prev_link)
+        then
+          join_groups (group, i, find_lcq (lcqs, count, q->prev_link)) ;
+      if (q->ctrl)
+        then
+          begin
+            for (j = i + 1 ; j < count ; j++)
+              if (lcqs[j]->ctrl == q->ctrl)
+                then
+                  join_groups (group, i, j) ;
+            pop = q->ctrl->token_list ;
+            while (pop)
+              begin
+                switch (pop->tok and DES_OP) begin
+                  case DES_DET :
+                    pdp = pop->point ;
+                    join_groups (group, i, find_lcq (lcqs, count, pdp->parent)) ;
+                    break ;
+                  case DES_CAL :
+                    join_groups (group, i, find_lcq (lcqs, count, pop->point)) ;
+                    break ;
+                end
+                pop = pop->link ;
+              end
+          end
+    end
+#endif
+/* an LCQ fed by anything but main digitizer data keeps its whole group on the lib330 thread */
+  for (i = 0 ; i < count ; i++)
+    begin
+      q = lcqs[i] ;
+      k = group_of (group, i) ;
+      if (load[k] < 0)
+        then
+          continue ;
+#ifndef OMIT_SEED
+      if (q->prev_link == NIL)
+        then
+#endif
+          if (lnot in_mplan (paqs, q))
+            then
+              begin
+                load[k] = -1 ;
+                continue ;
+              end
+      if (q->rate > 0)
+        then
+          load[k] = load[k] + q->rate ;
+        else
+          inc(load[k]) ;
+    end
+  memset (addr(wload), 0, sizeof(wload)) ;
+  repeat
+    best = -1 ;
+    for (i = 0 ; i < count ; i++)
+      if ((group[i] == i) land (load[i] > 0) land ((best < 0) lor (load[i] > load[best])))
+        then
+          best = i ;
+    if (best >= 0)
+      then
+        begin
+          k = 0 ;
+          for (j = 1 ; j < pws->count ; j++)
+            if (wload[j] < wload[k])
+              then
+                k = j ;
+          wload[k] = wload[k] + load[best] ;
+          load[best] = 0 ;
+          for (i = 0 ; i < count ; i++)
+            if (group_of (group, i) == best)
+              then
+                lcqs[i]->worker = k + 1 ;
+        end
+  until (best < 0)) ;
+  free (lcqs) ;
+  free (group) ;
+  free (load) ;
+end
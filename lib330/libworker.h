@@ -0,0 +1,53 @@
+/*   Lib330 LCQ worker thread definitions
+     Copyright 2026 Institute of Geological & Nuclear Sciences Ltd.
+
+    This file is part of Lib330
+
+    Lib330 is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Lib330 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Lib330; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Edit History:
+   Ed Date       By  Changes
+   -- ---------- --- ---------------------------------------------------
+    0 2026-10-19 gns Created
+*/
+#ifndef libworker_h
+/* Flag this file as included */
+#define libworker_h
+#define VER_LIBWORKER 0
+
+/* Make sure libtypes.h is included */
+#ifndef libtypes_h
+#include "libtypes.h"
+#endif
+#ifndef libsampglob_h
+#include "libsampglob.h"
+#endif
+
+#define WORKER_JOBS 256 /* blockettes queued for each worker */
+
+#define PJ_ONE 0 /* one sample, DC_D32 */
+#define PJ_COMP 1 /* DC_COMP blockette */
+#define PJ_MULT 2 /* DC_MULT segment */
+
+extern void start_workers (pq330 q330) ;
+extern void stop_workers (pq330 q330) ;
+extern void assign_workers (paqstruc paqs) ;
+extern void drain_workers (pq330 q330) ;
+extern void process_main (pq330 q330, plcq q, psampctx ctx, byte kind, pbyte pblk,
+                          longint val, byte subchan) ;
+extern void outlock (pq330 q330) ;
+extern void outunlock (pq330 q330) ;
+
+#endif
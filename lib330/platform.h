@@ -30,6 +30,10 @@ Edit History:
                      for double types.
     7 2010-02-18 fcs Slate computer needs same platform settings as BALER44
     8 2012-02-08 dsn/rdr Added configuration for ARM-LINUX Big Endian (ARMEB).
+    9 2026-10-19 gns Add THREADVAR for per thread static variables.
+   10 2026-10-19 gns Add MEMBARRIER for structures shared without a lock.
+   11 2026-10-19 gns Include poll.h for the serial port.
+   12 2026-10-19 gns Include sys/mman.h for the memory arenas.
 */
 #ifndef platform_h
 #define platform_h
@@ -106,11 +110,13 @@ typedef struct _stat tfile_state ;
 #include <sys/ioctl.h>
 #include <netdb.h>
 #include <signal.h>
+#include <sys/mman.h>
 
 #include <fcntl.h>
 #ifndef OMIT_SERIAL
 #include <unistd.h>     // required for ARM Linux. maybe for others as well.
 #include <sys/termios.h>
+#include <poll.h>
 #endif
 
 #define boolean uint8_t /* 8 bit unsigned, 0 or non-zero */
@@ -148,10 +154,12 @@ typedef struct stat tfile_state ;
 /* #include <sys/time.h> */
 #include <netdb.h>
 #include <signal.h>
+#include <sys/mman.h>
 
 #ifndef OMIT_SERIAL
 #include <fcntl.h>
 #include <sys/termios.h>
+#include <poll.h>
 #endif
 
 #define boolean uint8_t /* 8 bit unsigned, 0 or non-zero */
@@ -214,6 +222,24 @@ typedef void *pvoid ;
 
 #endif
 
+/* per thread static variables */
+#ifndef THREADVAR
+#if defined(X86_WIN32)
+#define THREADVAR __declspec(thread)
+#else
+#define THREADVAR __thread
+#endif
+#endif
+
+/* full memory barrier, for structures one thread writes and another reads without a lock */
+#ifndef MEMBARRIER
+#if defined(X86_WIN32)
+#define MEMBARRIER() MemoryBarrier()
+#else
+#define MEMBARRIER() __sync_synchronize()
+#endif
+#endif
+
 /* at least on solaris, this is undefined */
 #ifndef INADDR_NONE
 #  define INADDR_NONE (longword) -1
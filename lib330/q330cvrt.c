@@ -32,6 +32,8 @@ Edit History:
     9 2010-04-14 rdr loadfestat updated.
    10 2010-12-26 rdr loadboomstat now handles sensor currents.
    11 2011-01-12 rdr Sensor currents now overlay cal_timeouts.
+   12 2026-10-19 gns QDP header, global and fixed configuration, global, GPS and power
+                     status generated from fixed layout descriptions.
 */
 #ifndef libtypes_h
 #include "libtypes.h"
@@ -42,19 +44,38 @@ Edit History:
 #ifndef libcvrt_h
 #include "libcvrt.h"
 #endif
+#ifndef libsupport_h
+#include "libsupport.h"
+#endif
 #ifndef q330cvrt_h
 #include "q330cvrt.h"
 #endif
 
+#define QDP_HDR_SIZE 12
+#define QDP_HDR_LAYOUT(F) \
+  F(LONGINT, 0, 0, crc) \
+  F(BYTE, 4, 0, command) \
+  F(BYTE, 5, 0, version) \
+  F(WORD, 6, 0, datalength) \
+  F(WORD, 8, 0, sequence) \
+  F(WORD, 10, 0, acknowledge)
+
 void storeqdphdr (pbyte *p, byte cmd, word lth, word seq, word ack)
 begin
-
-  storelongint (p, 0) ; /* for now */
-  storebyte (p, cmd) ;
-  storebyte (p, QDP_VERSION) ;
-  storeword (p, lth) ;
-  storeword (p, seq) ;
-  storeword (p, ack) ;
+  tqdp hdr ;
+  tqdp *rec ;
+  pbyte wire ;
+
+  hdr.crc = 0 ; /* for now */
+  hdr.command = cmd ;
+  hdr.version = QDP_VERSION ;
+  hdr.datalength = lth ;
+  hdr.sequence = seq ;
+  hdr.acknowledge = ack ;
+  wire = *p ;
+  rec = addr(hdr) ;
+  QDP_HDR_LAYOUT(CVRT_STORE)
+  incn(*p, QDP_HDR_SIZE) ;
 end
 
 /* Note - this must be called before any other loadxxxx routines since you
@@ -63,13 +84,13 @@ end
   this routine is called. */
 void loadqdphdr (pbyte *p, tqdp *hdr)
 begin
+  tqdp *rec ;
+  pbyte wire ;
 
-  hdr->crc = loadlongint (p) ;
-  hdr->command = loadbyte (p) ;
-  hdr->version = loadbyte (p) ;
-  hdr->datalength = loadword (p) ;
-  hdr->sequence = loadword (p) ;
-  hdr->acknowledge = loadword (p) ;
+  wire = *p ;
+  rec = hdr ;
+  QDP_HDR_LAYOUT(CVRT_LOAD)
+  incn(*p, QDP_HDR_SIZE) ;
 end
 
 void storerqsrv (pbyte *p, t64 *sn)
@@ -229,106 +250,90 @@ begin
   log->spare = loadlongword (p) ;
 end
 
+#define GLOB_SIZE 160
+#define GLOB_LAYOUT(F) \
+  F(WORD, 0, 0, clock_to) \
+  F(WORD, 2, 0, initial_vco) \
+  F(WORD, 4, 0, gps_backup) \
+  F(WORD, 6, 0, samp_rates) \
+  F(WORD, 8, 0, gain_map) \
+  F(WORD, 10, 0, filter_map) \
+  F(WORD, 12, 0, input_map) \
+  F(WORD, 14, 0, web_port) \
+  F(WORD, 16, 0, server_to) \
+  F(WORD, 18, 0, drift_tol) \
+  F(WORD, 20, 0, jump_filt) \
+  F(WORD, 22, 0, jump_thresh) \
+  F(INT16, 24, 0, cal_offset) \
+  F(WORD, 26, 0, sensor_map) \
+  F(WORD, 28, 0, sampling_phase) \
+  F(WORD, 30, 0, gps_cold) \
+  F(LONGWORD, 32, 0, user_tag) \
+  F(INT16S, 36, CHANNELS * FREQUENCIES, scaling) \
+  F(INT16S, 132, CHANNELS, offsets) \
+  F(INT16S, 144, CHANNELS, gains) \
+  F(LONGWORD, 156, 0, msg_map)
+
 void loadglob (pbyte *p, tglobal *glob)
 begin
-  integer i, j ;
+  tglobal *rec ;
+  pbyte wire ;
 
-  glob->clock_to = loadword (p) ;
-  glob->initial_vco = loadword (p) ;
-  glob->gps_backup = loadword (p) ;
-  glob->samp_rates = loadword (p) ;
-  glob->gain_map = loadword (p) ;
-  glob->filter_map = loadword (p) ;
-  glob->input_map = loadword (p) ;
-  glob->web_port = loadword (p) ;
-  glob->server_to = loadword (p) ;
-  glob->drift_tol = loadword (p) ;
-  glob->jump_filt = loadword (p) ;
-  glob->jump_thresh = loadword (p) ;
-  glob->cal_offset = loadint16 (p) ;
-  glob->sensor_map = loadword (p) ;
-  glob->sampling_phase = loadword (p) ;
-  glob->gps_cold = loadword (p) ;
-  glob->user_tag = loadlongword (p) ;
-  for (i = 0 ; i <= CHANNELS - 1 ; i++)
-    for (j = 0 ; j <= FREQUENCIES - 1 ; j++)
-      glob->scaling[i][j] = loadint16 (p) ;
-  for (i = 0 ; i <= CHANNELS - 1 ; i++)
-    glob->offsets[i] = loadint16 (p) ;
-  for (i = 0 ; i <= CHANNELS - 1 ; i++)
-    glob->gains[i] = loadint16 (p) ;
-  glob->msg_map = loadlongword (p) ;
+  wire = *p ;
+  rec = glob ;
+  GLOB_LAYOUT(CVRT_LOAD)
+  incn(*p, GLOB_SIZE) ;
 end
 
+#define FIX_SIZE 188
+#define FIX_LAYOUT(F) \
+  F(LONGWORD, 0, 0, last_reboot) \
+  F(LONGWORD, 4, 0, reboots) \
+  F(LONGWORD, 8, 0, backup_map) \
+  F(LONGWORD, 12, 0, default_map) \
+  F(WORD, 16, 0, cal_type) \
+  F(WORD, 18, 0, cal_ver) \
+  F(WORD, 20, 0, aux_type) \
+  F(WORD, 22, 0, aux_ver) \
+  F(WORD, 24, 0, clk_type) \
+  F(WORD, 26, 0, flags) \
+  F(WORD, 28, 0, sys_ver) \
+  F(WORD, 30, 0, sp_ver) \
+  F(WORD, 32, 0, pld_ver) \
+  F(WORD, 34, 0, mem_block) \
+  F(LONGWORD, 36, 0, property_tag) \
+  F(T64, 40, 0, sys_num) \
+  F(T64, 48, 0, amb_num) \
+  F(T64, 56, 0, seis1_num) \
+  F(T64, 64, 0, seis2_num) \
+  F(LONGWORD, 72, 0, qapchp1_num) \
+  F(LONGWORD, 76, 0, int_sz) \
+  F(LONGWORD, 80, 0, int_used) \
+  F(LONGWORD, 84, 0, ext_sz) \
+  F(LONGWORD, 88, 0, flash_sz) \
+  F(LONGWORD, 92, 0, ext_used) \
+  F(LONGWORD, 96, 0, qapchp2_num) \
+  F(LONGWORDS, 100, LP_TEL4 - LP_TEL1 + 1, log_sz) \
+  F(BYTE, 116, 0, freq7) \
+  F(BYTE, 117, 0, freq6) \
+  F(BYTE, 118, 0, freq5) \
+  F(BYTE, 119, 0, freq4) \
+  F(BYTE, 120, 0, freq3) \
+  F(BYTE, 121, 0, freq2) \
+  F(BYTE, 122, 0, freq1) \
+  F(BYTE, 123, 0, freq0) \
+  F(LONGINTS, 124, FREQUENCIES, ch13_delay) \
+  F(LONGINTS, 156, FREQUENCIES, ch46_delay)
+
 void loadfix (pbyte *p, tfixed *fix)
 begin
-  word w ;
-  integer i ;
+  tfixed *rec ;
+  pbyte wire ;
 
-  fix->last_reboot = loadlongword (p) ;
-  fix->reboots = loadlongword (p) ;
-  fix->backup_map = loadlongword (p) ;
-  fix->default_map = loadlongword (p) ;
-  fix->cal_type = loadword (p) ;
-  fix->cal_ver = loadword (p) ;
-  fix->aux_type = loadword (p) ;
-  fix->aux_ver = loadword (p) ;
-  fix->clk_type = loadword (p) ;
-  fix->flags = loadword (p) ;
-  fix->sys_ver = loadword (p) ;
-  fix->sp_ver = loadword (p) ;
-  fix->pld_ver = loadword (p) ;
-  fix->mem_block = loadword (p) ;
-  fix->property_tag = loadlongword (p) ;
-#ifdef ENDIAN_LITTLE
-  fix->sys_num[1] = loadlongword (p) ;
-  fix->sys_num[0] = loadlongword (p) ;
-#else
-  fix->sys_num[0] = loadlongword (p) ;
-  fix->sys_num[1] = loadlongword (p) ;
-#endif
-#ifdef ENDIAN_LITTLE
-  fix->amb_num[1] = loadlongword (p) ;
-  fix->amb_num[0] = loadlongword (p) ;
-#else
-  fix->amb_num[0] = loadlongword (p) ;
-  fix->amb_num[1] = loadlongword (p) ;
-#endif
-#ifdef ENDIAN_LITTLE
-  fix->seis1_num[1] = loadlongword (p) ;
-  fix->seis1_num[0] = loadlongword (p) ;
-#else
-  fix->seis1_num[0] = loadlongword (p) ;
-  fix->seis1_num[1] = loadlongword (p) ;
-#endif
-#ifdef ENDIAN_LITTLE
-  fix->seis2_num[1] = loadlongword (p) ;
-  fix->seis2_num[0] = loadlongword (p) ;
-#else
-  fix->seis2_num[0] = loadlongword (p) ;
-  fix->seis2_num[1] = loadlongword (p) ;
-#endif
-  fix->qapchp1_num = loadlongword (p) ;
-  fix->int_sz = loadlongword (p) ;
-  fix->int_used = loadlongword (p) ;
-  fix->ext_sz = loadlongword (p) ;
-  fix->flash_sz = loadlongword (p) ;
-  fix->ext_used = loadlongword (p) ;
-  fix->qapchp2_num = loadlongword (p) ;
-  for (w = LP_TEL1 ; w <= LP_TEL4 ; w++)
-    fix->log_sz[w] = loadlongword (p) ;
-  fix->freq7 = loadbyte (p) ;
-  fix->freq6 = loadbyte (p) ;
-  fix->freq5 = loadbyte (p) ;
-  fix->freq4 = loadbyte (p) ;
-  fix->freq3 = loadbyte (p) ;
-  fix->freq2 = loadbyte (p) ;
-  fix->freq1 = loadbyte (p) ;
-  fix->freq0 = loadbyte (p) ;
-  for (i = 0 ; i <= FREQUENCIES - 1 ; i++)
-    fix->ch13_delay[i] = loadlongint (p) ;
-  for (i = 0 ; i <= FREQUENCIES - 1 ; i++)
-    fix->ch46_delay[i] = loadlongint (p) ;
+  wire = *p ;
+  rec = fix ;
+  FIX_LAYOUT(CVRT_LOAD)
+  incn(*p, FIX_SIZE) ;
 end
 
 void loadsensctrl (pbyte *p, tsensctrl *sensctrl)
@@ -351,61 +356,88 @@ begin
   return loadlongword (p) ;
 end ;
 
+#define GLOBALSTAT_SIZE 52
+#define GLOBALSTAT_LAYOUT(F) \
+  F(WORD, 0, 0, aqctrl) \
+  F(WORD, 2, 0, clock_qual) \
+  F(WORD, 4, 0, clock_loss) \
+  F(WORD, 6, 0, current_voltage) \
+  F(LONGWORD, 8, 0, sec_offset) \
+  F(LONGWORD, 12, 0, usec_offset) \
+  F(LONGWORD, 16, 0, total_time) \
+  F(LONGWORD, 20, 0, power_time) \
+  F(LONGWORD, 24, 0, last_resync) \
+  F(LONGWORD, 28, 0, resyncs) \
+  F(WORD, 32, 0, gps_stat) \
+  F(WORD, 34, 0, cal_stat) \
+  F(WORD, 36, 0, sensor_map) \
+  F(WORD, 38, 0, cur_vco) \
+  F(WORD, 40, 0, data_seq) \
+  F(WORD, 42, 0, pll_flag) \
+  F(WORD, 44, 0, stat_inp) \
+  F(WORD, 46, 0, misc_inp) \
+  F(LONGWORD, 48, 0, cur_sequence)
+
 void loadglobalstat (pbyte *p, tstat_global *globstat)
 begin
+  tstat_global *rec ;
+  pbyte wire ;
 
-  globstat->aqctrl = loadword (p) ;
-  globstat->clock_qual = loadword (p) ;
-  globstat->clock_loss = loadword (p) ;
-  globstat->current_voltage = loadword (p) ;
-  globstat->sec_offset = loadlongword (p) ;
-  globstat->usec_offset = loadlongword (p) ;
-  globstat->total_time = loadlongword (p) ;
-  globstat->power_time = loadlongword (p) ;
-  globstat->last_resync = loadlongword (p) ;
-  globstat->resyncs = loadlongword (p) ;
-  globstat->gps_stat = loadword (p) ;
-  globstat->cal_stat = loadword (p) ;
-  globstat->sensor_map = loadword (p) ;
-  globstat->cur_vco = loadword (p) ;
-  globstat->data_seq = loadword (p) ;
-  globstat->pll_flag = loadword (p) ;
-  globstat->stat_inp = loadword (p) ;
-  globstat->misc_inp = loadword (p) ;
-  globstat->cur_sequence = loadlongword (p) ;
+  wire = *p ;
+  rec = globstat ;
+  GLOBALSTAT_LAYOUT(CVRT_LOAD)
+  incn(*p, GLOBALSTAT_SIZE) ;
 end
 
+#define GPSSTAT_SIZE 84
+#define GPSSTAT_LAYOUT(F) \
+  F(WORD, 0, 0, gpstime) \
+  F(WORD, 2, 0, gpson) \
+  F(WORD, 4, 0, sat_used) \
+  F(WORD, 6, 0, sat_view) \
+  F(STRING, 8, 10, time) \
+  F(STRING, 18, 12, date) \
+  F(STRING, 30, 6, fix) \
+  F(STRING, 36, 12, height) \
+  F(STRING, 48, 14, lat) \
+  F(STRING, 62, 14, longt) \
+  F(LONGWORD, 76, 0, last_good) \
+  F(LONGWORD, 80, 0, check_err)
+
 void loadgpsstat (pbyte *p, tstat_gps *gpsstat)
 begin
+  tstat_gps *rec ;
+  pbyte wire ;
 
-  gpsstat->gpstime = loadword (p) ;
-  gpsstat->gpson = loadword (p) ;
-  gpsstat->sat_used = loadword (p) ;
-  gpsstat->sat_view = loadword (p) ;
-  loadstring (p, 10, gpsstat->time) ;
-  loadstring (p, 12, gpsstat->date) ;
-  loadstring (p, 6, gpsstat->fix) ;
-  loadstring (p, 12, gpsstat->height) ;
-  loadstring (p, 14, gpsstat->lat) ;
-  loadstring (p, 14, gpsstat->longt) ;
-  gpsstat->last_good = loadlongword (p) ;
-  gpsstat->check_err = loadlongword (p) ;
+  wire = *p ;
+  rec = gpsstat ;
+  GPSSTAT_LAYOUT(CVRT_LOAD)
+  incn(*p, GPSSTAT_SIZE) ;
 end
 
+#define PWRSTAT_SIZE 20
+#define PWRSTAT_LAYOUT(F) \
+  F(WORD, 0, 0, phase) \
+  F(INT16, 2, 0, battemp) \
+  F(WORD, 4, 0, capacity) \
+  F(WORD, 6, 0, depth) \
+  F(WORD, 8, 0, batvolt) \
+  F(WORD, 10, 0, inpvolt) \
+  F(INT16, 12, 0, batcur) \
+  F(WORD, 14, 0, absorption) \
+  F(WORD, 16, 0, float_) \
+  F(BYTE, 18, 0, alerts) \
+  F(BYTE, 19, 0, loads_off)
+
 void loadpwrstat (pbyte *p, tstat_pwr *pwrstat)
 begin
+  tstat_pwr *rec ;
+  pbyte wire ;
 
-  pwrstat->phase = loadword (p) ;
-  pwrstat->battemp = loadint16 (p) ;
-  pwrstat->capacity = loadword (p) ;
-  pwrstat->depth = loadword (p) ;
-  pwrstat->batvolt = loadword (p) ;
-  pwrstat->inpvolt = loadword (p) ;
-  pwrstat->batcur = loadint16 (p) ;
-  pwrstat->absorption = loadword (p) ;
-  pwrstat->float_ = loadword (p) ;
-  pwrstat->alerts = loadbyte (p) ;
-  pwrstat->loads_off = loadbyte (p) ;
+  wire = *p ;
+  rec = pwrstat ;
+  PWRSTAT_LAYOUT(CVRT_LOAD)
+  incn(*p, PWRSTAT_SIZE) ;
 end
 
 void loadboomstat (pbyte *p, tstat_boom *boomstat, boolean q335)
@@ -25,7 +25,7 @@ Edit History:
 #ifndef q330cvrt_h
 /* Flag this file as included */
 #define q330cvrt_h
-#define VER_Q330CVRT 11
+#define VER_Q330CVRT 12
 #ifndef q330types_h
 #include "q330types.h"
 #endif
@@ -41,6 +41,10 @@ Edit History:
    12 2010-01-04 rdr Use fcntl instead of ioctl to set socket non-blocking.
    13 2010-03-27 rdr Add Q335 support.
    14 2010-05-13 rdr Add detection of 127.0.0.1 as additional baler port.
+   15 2026-10-19 gns Add capture of validated packets to a file and replay from it.
+   16 2026-10-19 gns SLIP unframing and Base-96 decoding moved to libslip, which work on
+                     blocks rather than a byte at a time. Wait for serial data with poll and
+                     read up to 4096 bytes at once.
 */
 #ifdef CMEX32
 #include "cmexserial.h"
@@ -78,6 +82,18 @@ Edit History:
 #ifndef libstats_h
 #include "libstats.h"
 #endif
+#ifndef libtokens_h
+#include "libtokens.h"
+#endif
+#ifndef libsampcfg_h
+#include "libsampcfg.h"
+#endif
+#ifndef libcont_h
+#include "libcont.h"
+#endif
+#ifndef libslip_h
+#include "libslip.h"
+#endif
 
 #ifndef OMIT_SERIAL
 #define INQSIZE 20000
@@ -90,14 +106,29 @@ Edit History:
 #define IP_MF 0x2000 /* more fragments bit */
 #define IP_DF 0x4000 /* don't fragment bit */
 #define IP_FRAGMASK 0x1fff /* fragment offset mask */
-  /* SLIP */
-#define SLIP_FRM 0xC0 /* Framing character */
-#define SLIP_ESC 0xDB /* Escape character, special follows */
-#define ESC_FRM 0xDC /* SLIP_ESC|ESC_FRM = 0xC0 */
-#define ESC_ESC 0xDD /* SLIP_ESC|ESC_ESC = 0xDB */
 #endif
 
 #define LOOPBACK_PORT 2066 /* For getting C2_BACK */
+#define CAP_MAGIC 0x51434150 /* "QCAP" */
+#define CAP_VERSION 1
+#define REPLAY_BATCH 64 /* records per thread pass when not paced */
+
+typedef struct { /* payload of the CK_HEADER record */
+  longword magic ;
+  longword version ;
+  longword cfgsize ; /* sizeof(tcapcfg) in the writer */
+} tcapident ;
+typedef struct { /* payload of a CK_CONFIG record, followed by the tokens */
+  string9 station_ident ;
+  tsensctrl sensctrl ;
+  tfixed fixed ;
+  tglobal global ;
+  tlog log ;
+  tepdelay epdelay ;
+  longint zone_adjust ;
+  boolean q335 ;
+  word cfgsize ; /* bytes of tokens following */
+} tcapcfg ;
 
 void close_sockets (pq330 q330)
 begin
@@ -436,11 +467,8 @@ end
   4 bytes (1 group) plus 2. Returns -1 if not valid */
 static integer decode (pq330 q330, integer lth)
 begin
-typedef byte tenc[4] ;
-  integer groups, actual, diff ;
-  pbyte p, psave, pdest ;
-  tenc enc ;
-  tenc *psrc ;
+  integer actual, diff ;
+  pbyte p, psave ;
   byte m ;
   integer mask ;
   char *pmask ;
@@ -469,20 +497,7 @@ typedef byte tenc[4] ;
       mask = (mask shl 4) + (m - 0x37) ;
     else
       return -1 ; /* not valid */
-  psrc = (pointer) pmask ; /* skipped over encoding */
-  pdest = psave ;
-  groups = (lth - 2) shr 2 ;
-  actual = groups * 3 ; /* decoded byte count */
-  while (groups > 0)
-    begin
-      memcpy(addr(enc), psrc, 4) ;
-      psrc++ ;
-      m = enc[3] - 0x20 ;
-      *pdest++ = (enc[0] - 0x20 + ((m and 0x30) shl 2)) xor mask ;
-      *pdest++ = (enc[1] - 0x20 + ((m and 0xc) shl 4)) xor mask ;
-      *pdest++ = (enc[2] - 0x20 + ((m and 3) shl 6)) xor mask ;
-      dec(groups) ;
-    end
+  actual = base96_decode (psave, (pointer) pmask, (lth - 2) shr 2, mask) ; /* skipped over encoding */
   p = psave ;
   loadqdphdr (addr(p), addr(q330->recvhdr)) ;
   diff = actual - (q330->recvhdr.datalength + QDP_HDR_LTH) ;
@@ -514,6 +529,342 @@ begin
       return -1 ; /* bad crc */
 end
 
+/* Packet capture and replay. A capture file is a sequence of records, each a tcaphdr
+   followed by its payload. The first record identifies the file, configuration
+   records hold the state needed to decode the data packets that follow them. */
+static void capture_stop (pq330 q330)
+begin
+
+  lib_file_close (q330->par_create.file_owner, q330->capfile) ;
+  q330->capturing = FALSE ;
+  q330->capcount = 0 ;
+end
+
+void capture_flush (pq330 q330)
+begin
+  string95 s ;
+
+  if ((q330->capturing) land (q330->capcount > 0))
+    then
+      begin
+        if (lib_file_write (q330->par_create.file_owner, q330->capfile, q330->capbuf, q330->capcount))
+          then
+            begin
+              strcpy (s, "Write failed, capture stopped") ;
+              libmsgadd (q330, LIBMSG_CAPERR, addr(s)) ;
+              capture_stop (q330) ;
+            end
+          else
+            q330->capcount = 0 ;
+      end
+end
+
+static void capture_write (pq330 q330, enum tcapkind kind, pointer buf, integer size,
+                           pointer extra, integer extrasize)
+begin
+  tcaphdr hdr ;
+  integer lth ;
+  pbyte p ;
+
+  lth = sizeof(tcaphdr) + size + extrasize ;
+  if ((q330->capcount + lth) > CAP_BUFSIZE)
+    then
+      capture_flush (q330) ;
+  if ((lnot q330->capturing) lor (lth > CAP_BUFSIZE))
+    then
+      return ;
+  hdr.timestamp = now () ;
+  hdr.kind = kind ;
+  hdr.spare = 0 ;
+  hdr.size = size + extrasize ;
+  p = (pbyte)((integer)q330->capbuf + q330->capcount) ;
+  memcpy (p, addr(hdr), sizeof(tcaphdr)) ;
+  incn(p, sizeof(tcaphdr)) ;
+  memcpy (p, buf, size) ;
+  if (extrasize > 0)
+    then
+      begin
+        incn(p, size) ;
+        memcpy (p, extra, extrasize) ;
+      end
+  q330->capcount = q330->capcount + lth ;
+end
+
+void capture_config (pq330 q330)
+begin
+  tcapcfg cfg ;
+
+  if (lnot q330->capturing)
+    then
+      return ;
+  memset (addr(cfg), 0, sizeof(tcapcfg)) ;
+  memcpy (addr(cfg.station_ident), addr(q330->station_ident), sizeof(string9)) ;
+  lock (q330) ;
+  memcpy (addr(cfg.sensctrl), addr(q330->share.sensctrl), sizeof(tsensctrl)) ;
+  memcpy (addr(cfg.fixed), addr(q330->share.fixed), sizeof(tfixed)) ;
+  memcpy (addr(cfg.global), addr(q330->share.global), sizeof(tglobal)) ;
+  memcpy (addr(cfg.log), addr(q330->share.log), sizeof(tlog)) ;
+  memcpy (addr(cfg.epdelay), addr(q330->share.epdelay), sizeof(tepdelay)) ;
+  unlock (q330) ;
+  if (q330->libstate == LIBSTATE_RUN)
+    then
+      cfg.log.dataseq = q330->last_packet ; /* started mid-session, window resumes here */
+  cfg.zone_adjust = q330->zone_adjust ;
+  cfg.q335 = q330->q335 ;
+  cfg.cfgsize = q330->cfgsize ;
+  capture_write (q330, CK_CONFIG, addr(cfg), sizeof(tcapcfg), q330->cfgbuf, q330->cfgsize) ;
+  capture_flush (q330) ;
+end
+
+void capture_close (pq330 q330)
+begin
+
+  capture_flush (q330) ;
+  if (q330->capturing)
+    then
+      capture_stop (q330) ;
+end
+
+void capture_request (pq330 q330)
+begin
+  string name ;
+  string95 s ;
+  tcapident ident ;
+
+  lock (q330) ;
+  q330->share.capture_requested = FALSE ;
+  strcpy (name, q330->share.capture_name) ;
+  unlock (q330) ;
+  capture_close (q330) ;
+  if (name[0] == 0)
+    then
+      return ;
+  q330->capfile = lib_file_open (q330->par_create.file_owner, name, LFO_CREATE or LFO_WRITE) ;
+  if (q330->capfile == INVALID_FILE_HANDLE)
+    then
+      begin
+        sprintf(s, "Cannot create %.80s", name) ;
+        libmsgadd (q330, LIBMSG_CAPERR, addr(s)) ;
+        return ;
+      end
+  if (q330->capbuf == NIL)
+    then
+      getthrbuf (q330, (pointer *)addr(q330->capbuf), CAP_BUFSIZE) ;
+  q330->capturing = TRUE ;
+  q330->capcount = 0 ;
+  ident.magic = CAP_MAGIC ;
+  ident.version = CAP_VERSION ;
+  ident.cfgsize = sizeof(tcapcfg) ;
+  capture_write (q330, CK_HEADER, addr(ident), sizeof(tcapident), NIL, 0) ;
+  sprintf(s, "%.80s", name) ;
+  libmsgadd (q330, LIBMSG_CAPTURE, addr(s)) ;
+  if (q330->libstate == LIBSTATE_RUN)
+    then
+      capture_config (q330) ;
+    else
+      capture_flush (q330) ;
+end
+
+static void replay_finish (pq330 q330, enum tliberr err)
+begin
+  string95 s ;
+
+  if (q330->libstate == LIBSTATE_RUN)
+    then
+      begin
+        new_state (q330, LIBSTATE_DEALLOC) ;
+        deallocate_sg (q330->aqstruc) ; /* flushes partial records */
+      end
+  lib_file_close (q330->par_create.file_owner, q330->repfile) ;
+  q330->replay = FALSE ;
+  q330->link_recv = FALSE ;
+  sprintf(s, "%d", (longint)q330->rep_count) ;
+  libmsgadd (q330, LIBMSG_REPLAYEND, addr(s)) ;
+  new_state (q330, LIBSTATE_IDLE) ;
+  if (err != LIBERR_NOERR)
+    then
+      lib_change_state (q330, LIBSTATE_IDLE, err) ; /* else the client has already asked for something */
+end
+
+void replay_request (pq330 q330)
+begin
+  string name ;
+  string95 s ;
+  tcapident ident ;
+
+  lock (q330) ;
+  q330->share.replay_requested = FALSE ;
+  strcpy (name, q330->share.replay_name) ;
+  q330->rep_paced = q330->share.replay_paced ;
+  unlock (q330) ;
+  if ((q330->replay) lor (q330->libstate != LIBSTATE_IDLE))
+    then
+      return ;
+  q330->repfile = lib_file_open (q330->par_create.file_owner, name, LFO_OPEN or LFO_READ) ;
+  if (q330->repfile == INVALID_FILE_HANDLE)
+    then
+      begin
+        sprintf(s, "Cannot open %.80s", name) ;
+        libmsgadd (q330, LIBMSG_CAPERR, addr(s)) ;
+        lib_change_state (q330, LIBSTATE_IDLE, LIBERR_PAR) ;
+        return ;
+      end
+  if ((lib_file_read (q330->par_create.file_owner, q330->repfile, addr(q330->rephdr), sizeof(tcaphdr))) lor
+      (q330->rephdr.kind != CK_HEADER) lor (q330->rephdr.size != sizeof(tcapident)) lor
+      (lib_file_read (q330->par_create.file_owner, q330->repfile, addr(ident), sizeof(tcapident))) lor
+      (ident.magic != CAP_MAGIC) lor (ident.version != CAP_VERSION) lor (ident.cfgsize != sizeof(tcapcfg)))
+    then
+      begin
+        sprintf(s, "%.56s is not a capture file from this build", name) ;
+        libmsgadd (q330, LIBMSG_CAPERR, addr(s)) ;
+        lib_file_close (q330->par_create.file_owner, q330->repfile) ;
+        lib_change_state (q330, LIBSTATE_IDLE, LIBERR_PAR) ;
+        return ;
+      end
+  restore_thread_continuity (q330, FALSE, NIL) ; /* as for registration */
+  purge_thread_continuity (q330) ;
+  q330->replay = TRUE ;
+  q330->rep_have = FALSE ;
+  q330->rep_count = 0 ;
+  sprintf(s, "%.80s", name) ;
+  libmsgadd (q330, LIBMSG_REPLAY, addr(s)) ;
+end
+
+/* Stands in for registration and the configuration and token reads */
+static boolean replay_config (pq330 q330)
+begin
+  tcapcfg cfg ;
+  string95 s ;
+
+  if ((q330->rephdr.size < (longint)sizeof(tcapcfg)) lor
+      (lib_file_read (q330->par_create.file_owner, q330->repfile, addr(cfg), sizeof(tcapcfg))))
+    then
+      return FALSE ;
+  if ((cfg.cfgsize > MAXCFG) lor (q330->rephdr.size != (longint)(sizeof(tcapcfg) + cfg.cfgsize)) lor
+      (lib_file_read (q330->par_create.file_owner, q330->repfile, q330->cfgbuf, cfg.cfgsize)))
+    then
+      return FALSE ;
+  if (q330->libstate == LIBSTATE_RUN)
+    then
+      begin /* tokens changed during the capture */
+        new_state (q330, LIBSTATE_DEALLOC) ;
+        deallocate_sg (q330->aqstruc) ;
+      end
+  q330->cfgsize = cfg.cfgsize ;
+  memcpy (addr(q330->station_ident), addr(cfg.station_ident), sizeof(string9)) ;
+  q330->zone_adjust = cfg.zone_adjust ;
+  q330->q335 = cfg.q335 ;
+  lock (q330) ;
+  memcpy (addr(q330->share.sensctrl), addr(cfg.sensctrl), sizeof(tsensctrl)) ;
+  memcpy (addr(q330->share.fixed), addr(cfg.fixed), sizeof(tfixed)) ;
+  memcpy (addr(q330->share.global), addr(cfg.global), sizeof(tglobal)) ;
+  memcpy (addr(q330->share.log), addr(cfg.log), sizeof(tlog)) ;
+  memcpy (addr(q330->share.epdelay), addr(cfg.epdelay), sizeof(tepdelay)) ;
+  q330->share.have_config = make_bitmap(CRB_GLOB) or make_bitmap(CRB_FIX) or make_bitmap(CRB_LOG) ;
+  if (q330->share.target_state == LIBSTATE_IDLE)
+    then
+      q330->share.target_state = LIBSTATE_RUN ;
+  unlock (q330) ;
+  new_state (q330, LIBSTATE_DECTOK) ;
+  decode_cfg (q330) ;
+  strcpy(s, q330->station_ident) ;
+  strcat(s, ", ") ;
+  strcat(s, q330->par_create.host_software) ;
+  libmsgadd(q330, LIBMSG_NETSTN, addr(s)) ;
+  reset_link (q330) ;
+  new_state (q330, LIBSTATE_RUN) ;
+  return TRUE ;
+end
+
+/* Called from the thread loop in place of reading sockets or serial */
+void replay_packets (pq330 q330)
+begin
+  integer i ;
+  double wait ;
+  pbyte p ;
+
+  for (i = 0 ; i < REPLAY_BATCH ; i++)
+    begin
+      if (lnot q330->rep_have)
+        then
+          begin
+            if (lib_file_read (q330->par_create.file_owner, q330->repfile, addr(q330->rephdr), sizeof(tcaphdr)))
+              then
+                begin /* end of file */
+                  replay_finish (q330, LIBERR_CLOSED) ;
+                  return ;
+                end
+            q330->rep_have = TRUE ;
+            if (q330->rep_count == 0)
+              then
+                begin
+                  q330->rep_first = q330->rephdr.timestamp ;
+                  q330->rep_base = now () ;
+                end
+          end
+      if (q330->rep_paced)
+        then
+          begin
+            wait = q330->rep_base + (q330->rephdr.timestamp - q330->rep_first) - now () ;
+            if (wait > 0.0)
+              then
+                begin /* not due yet */
+                  if (wait > 0.025)
+                    then
+                      wait = 0.025 ;
+                  sleepms (lib_round(wait * 1000.0)) ;
+                  return ;
+                end
+          end
+      q330->rep_have = FALSE ;
+      inc(q330->rep_count) ;
+      switch (q330->rephdr.kind) begin
+        case CK_CONFIG :
+          if (lnot replay_config (q330))
+            then
+              begin
+                replay_finish (q330, LIBERR_PAR) ;
+                return ;
+              end
+          break ;
+        case CK_DATA :
+          if ((q330->rephdr.size < QDP_HDR_LTH) lor (q330->rephdr.size > (longint)sizeof(tany)) lor
+              (lib_file_read (q330->par_create.file_owner, q330->repfile, addr(q330->datain.qdp), q330->rephdr.size)))
+            then
+              begin
+                replay_finish (q330, LIBERR_PAR) ;
+                return ;
+              end
+          p = (pbyte)addr(q330->datain.qdp) ;
+          loadqdphdr (addr(p), addr(q330->recvhdr)) ;
+          process_data (q330) ;
+          break ;
+        default :
+          replay_finish (q330, LIBERR_PAR) ;
+          return ;
+      end
+    end
+end
+
+/* Called from lib_timer in place of the registration and status machinery */
+void replay_timer (pq330 q330)
+begin
+  enum tlibstate target ;
+
+  lock (q330) ;
+  target = q330->share.target_state ;
+  unlock (q330) ;
+  if ((target != q330->libstate) land ((q330->libstate == LIBSTATE_RUN) lor (target != LIBSTATE_RUN)))
+    then
+      begin /* client wants to stop */
+        replay_finish (q330, LIBERR_NOERR) ;
+        return ;
+      end
+#ifndef OMIT_SEED
+  dump_msgqueue (q330) ;
+#endif
+end
+
 static void check_for_encoded (pq330 q330, integer plth)
 begin
   integer actual ;
@@ -545,7 +896,12 @@ begin
     then
       add_status (q330, AC_CHECK, 1) ;
     else
-      process_data (q330) ;
+      begin
+        if (q330->capturing)
+          then
+            capture_write (q330, CK_DATA, addr(q330->datain.qdp), actual, NIL, 0) ;
+        process_data (q330) ;
+      end
 end
 
 #ifndef OMIT_NETWORK
@@ -953,22 +1309,40 @@ begin
   return TRUE ;
 end
 
+/* Called by slip_unframe with each frame in cmsgin */
+static boolean slip_frame (pointer ctx, integer lth)
+begin
+  pq330 q330 ;
+
+  q330 = ctx ;
+  if (proc_ip (q330, lth))
+    then
+      begin /* is actually a packet */
+        add_status (q330, AC_READ, lth) ;
+        return TRUE ;
+      end
+  return FALSE ;
+end
+
 void read_from_serial (pq330 q330)
 begin
+#ifdef CMEX32
 #define IBSIZE 700
-  pbyte pin, pout ;
-  pbyte maxp ;
-  byte c ;
-  longword i ;
+#else
+#define IBSIZE 4096 /* whatever has arrived since the last read */
+#endif
+  integer overruns ;
 #ifdef X86_WIN32
   COMSTAT comstat ;
   longword numread ;
   longword errs ;
 #else
   ssize_t numread ;
+#ifndef CMEX32
+  struct pollfd pfd ;
+#endif
 #endif
   byte inbuf[IBSIZE] ;
-  integer bufidx ;
 
 #ifdef X86_WIN32
   ClearCommError(q330->comid, addr(errs), addr(comstat)) ;
@@ -982,6 +1356,14 @@ begin
     then
       return ;
 #else
+#ifndef CMEX32
+  pfd.fd = q330->comid ;
+  pfd.events = POLLIN ;
+  pfd.revents = 0 ;
+  if (poll (addr(pfd), 1, 25) <= 0)
+    then
+      return ; /* nothing for 25ms */
+#endif
   numread = read(q330->comid, addr(inbuf), IBSIZE) ;
   if (numread <= 0)
     then
@@ -990,66 +1372,10 @@ begin
         return ;
       end
 #endif
-  pin = addr(inbuf) ;
-  pout = q330->bufptr ;
-  maxp = addr((q330->commands.cmsgin.qdp_data)[MAXDATA96 - 1]) ;
-  for (i = 1 ; i <= numread ; i++)
-    begin
-      c = *pin++ ;
-      if ((c == SLIP_FRM) lor (lnot q330->needframe))
-        then
-          switch (c) begin
-            case SLIP_FRM :
-              q330->escpend = FALSE ;
-              q330->needframe = FALSE ;
-              bufidx = (integer)pout - (integer)addr(q330->commands.cmsgin.headers) ;
-              if (bufidx)
-                then
-                  begin
-                    if (proc_ip (q330, bufidx))
-                      then
-                        begin /* is actually a packet */
-                          q330->needframe = TRUE ;
-                          add_status (q330, AC_READ, bufidx) ;
-                        end
-                  end
-              pout = addr(q330->commands.cmsgin.headers) ;
-              break ;
-            case SLIP_ESC :
-              q330->escpend = TRUE ;
-              break ;
-            case ESC_FRM :
-              if (q330->escpend)
-                then
-                  begin
-                    q330->escpend = FALSE ;
-                    *pout++ = SLIP_FRM ;
-                  end
-                else
-                  *pout++ = c ;
-              break ;
-            case ESC_ESC :
-              if (q330->escpend)
-                then
-                  begin
-                    q330->escpend = FALSE ;
-                    *pout++ = SLIP_ESC ;
-                  end
-                else
-                  *pout++ = c ;
-              break ;
-            default :
-              *pout++ = c ;
-              break ;
-          end
-      if ((longint)pout > ((longint)maxp + 1))
-        then
-          begin
-            pout = addr(q330->commands.cmsgin.headers) ;
-            add_status (q330, AC_CHECK, 1) ;
-          end
-    end
-  q330->bufptr = pout ;
+  overruns = slip_unframe (addr(q330->slip), addr(inbuf), numread, slip_frame, q330) ;
+  if (overruns)
+    then
+      add_status (q330, AC_CHECK, overruns) ;
 end
 
 static void build_ip (pq330 q330, pbyte p, longword src, longword dest, byte protocol, integer datalength)
@@ -1350,8 +1676,8 @@ begin
 /* Configure port using new settings */
         err = tcsetattr(q330->comid, TCSANOW, addr(sttynew)) ;
 #endif
-        q330->escpend = FALSE ;
-        q330->bufptr = addr(q330->commands.cmsgin.headers) ;
+        slip_init (addr(q330->slip), (pointer)addr(q330->commands.cmsgin.headers),
+                   (integer)addr((q330->commands.cmsgin.qdp_data)[MAXDATA96]) - (integer)addr(q330->commands.cmsgin.headers)) ;
         if (q330->par_register.host_ctrlport == 0)
           then
             begin
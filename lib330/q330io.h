@@ -25,7 +25,7 @@ Edit History:
 #ifndef q330io_h
 /* Flag this file as included */
 #define q330io_h
-#define VER_Q330IO 13
+#define VER_Q330IO 15
 
 /* Make sure libtypes.h is included */
 #ifndef libtypes_h
@@ -36,6 +36,13 @@ Edit History:
 #endif
 
 extern void close_sockets (pq330 q330) ;
+extern void capture_request (pq330 q330) ;
+extern void capture_config (pq330 q330) ;
+extern void capture_flush (pq330 q330) ;
+extern void capture_close (pq330 q330) ;
+extern void replay_request (pq330 q330) ;
+extern void replay_packets (pq330 q330) ;
+extern void replay_timer (pq330 q330) ;
 #ifndef OMIT_NETWORK
 extern boolean open_sockets (pq330 q330, boolean both, boolean fromback) ;
 extern void read_cmd_socket (pq330 q330) ;
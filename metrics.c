@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "metrics.h"
+
+/* accumulated statistic names, in tacctype order */
+static char *acc_names[AC_LAST + 1] = {
+  "gaps", "boots", "read", "write", "comm_attempts", "comm_successes", "packets", "comm_efficiency",
+  "pocs", "new_ip", "duty", "throughput", "missing", "fill", "command_timeouts", "sequence_errors",
+  "checksum_errors", "io_errors"
+};
+static char *dur_names[AD_DAY + 1] = {"minute", "hour", "day"};
+
+/* everything a scrape can see */
+typedef struct metrics_snapshot {
+  time_t updated; /* when the lib330 status was last copied */
+  enum tlibstate state;
+  topstat opstat;
+  tlcqstat lcqstat;
+
+  unsigned long long records; /* miniseed records received */
+  unsigned long long record_bytes;
+  unsigned long long dali_records; /* datalink writes */
+  unsigned long long dali_bytes;
+  unsigned long long dali_errors;
+  unsigned long long dali_reconnects;
+  unsigned long long archive_records; /* local archive writes */
+  unsigned long long archive_errors;
+  double archive_seconds; /* total time spent archiving */
+  double archive_max; /* slowest single write */
+  unsigned long long lowlat_seconds; /* low latency seconds of data sent */
+  unsigned long long lowlat_errors;
+  double lowlat_latency; /* total delay from the first sample to delivery */
+  double lowlat_last;
+  double lowlat_max;
+  unsigned long long onesec_frames; /* one second data frames sent */
+  unsigned long long onesec_bytes;
+  unsigned long long onesec_errors;
+  long long spool_bytes; /* records waiting in the datalink spool */
+  long spool_records;
+  double spool_age; /* how long the oldest has been waiting */
+  unsigned long long spool_spooled;
+  unsigned long long spool_drained;
+  unsigned long long spool_dropped;
+  trecpoolstat recpool; /* records lib330 holds for the sender thread */
+  long recpool_queued;
+  unsigned long long dedup_duplicates; /* resent records dropped */
+  unsigned long long dedup_overlaps;
+  unsigned long long dedup_bytes;
+} metrics_snapshot;
+
+static metrics_snapshot snapshot;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *metrics_station = NULL;
+static int metrics_sockfd = -1;
+static int metrics_going = 0;
+static pthread_t metrics_thread;
+
+/* growing output buffer */
+typedef struct metrics_buf {
+  char *data;
+  size_t len;
+  size_t size;
+} metrics_buf;
+
+static void out(metrics_buf *b, const char *fmt, ...) {
+  va_list ap;
+  int n;
+  char *p;
+
+  for (;;) {
+    va_start(ap, fmt);
+    n = vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+    va_end(ap);
+    if ((n >= 0) && ((size_t) n < (b->size - b->len))) {
+      b->len += n; return;
+    }
+    if ((p = realloc(b->data, b->size * 2)) == NULL)
+      return;
+    b->data = p; b->size *= 2;
+  }
+}
+
+static void help(metrics_buf *b, char *name, char *type, char *text) {
+  out(b, "# HELP quant2dali_%s %s\n# TYPE quant2dali_%s %s\n", name, text, name, type);
+}
+
+static void render(metrics_buf *b, metrics_snapshot *s) {
+  int i, j, n;
+  unsigned int bits;
+  char *st = metrics_station;
+  topstat *op = &s->opstat;
+  tonelcqstat *lcq;
+
+  help(b, "up", "gauge", "Whether the collector has a running q330 connection.");
+  out(b, "quant2dali_up{station=\"%s\"} %d\n", st, (s->state == LIBSTATE_RUN) ? 1 : 0);
+  help(b, "state", "gauge", "Current lib330 state.");
+  out(b, "quant2dali_state{station=\"%s\"} %d\n", st, (int) s->state);
+  help(b, "snapshot_age_seconds", "gauge", "Seconds since the lib330 status was last copied.");
+  out(b, "quant2dali_snapshot_age_seconds{station=\"%s\"} %ld\n", st, (s->updated) ? (long) (time(NULL) - s->updated) : -1L);
+
+  if (s->updated == 0)
+    goto counters;
+
+  if (op->data_latency != INVALID_LATENCY) {
+    help(b, "data_latency_seconds", "gauge", "Data latency based on the host clock.");
+    out(b, "quant2dali_data_latency_seconds{station=\"%s\"} %d\n", st, (int) op->data_latency);
+  }
+  if (op->status_latency != INVALID_LATENCY) {
+    help(b, "status_latency_seconds", "gauge", "Seconds since status was received from the q330.");
+    out(b, "quant2dali_status_latency_seconds{station=\"%s\"} %d\n", st, (int) op->status_latency);
+  }
+  help(b, "runtime_seconds", "gauge", "Time connected (positive) or disconnected (negative).");
+  out(b, "quant2dali_runtime_seconds{station=\"%s\"} %d\n", st, (int) op->runtime);
+  help(b, "gaps_total", "counter", "Data gaps since the context was created.");
+  out(b, "quant2dali_gaps_total{station=\"%s\"} %u\n", st, (unsigned int) op->totalgaps);
+  help(b, "packet_buffer_percent", "gauge", "Q330 packet buffer percent full.");
+  out(b, "quant2dali_packet_buffer_percent{station=\"%s\"} %.1f\n", st, op->pkt_full);
+  help(b, "clock_quality_percent", "gauge", "Q330 clock quality.");
+  out(b, "quant2dali_clock_quality_percent{station=\"%s\"} %u\n", st, (unsigned int) op->clock_qual);
+  help(b, "clock_drift_microseconds", "gauge", "Clock drift from GPS.");
+  out(b, "quant2dali_clock_drift_microseconds{station=\"%s\"} %d\n", st, (int) op->clock_drift);
+  help(b, "gps_age_seconds", "gauge", "Age of the last GPS clock update, -1 if never updated.");
+  out(b, "quant2dali_gps_age_seconds{station=\"%s\"} %d\n", st, (int) op->gps_age);
+  help(b, "temperature_celsius", "gauge", "Q330 system temperature.");
+  out(b, "quant2dali_temperature_celsius{station=\"%s\"} %d\n", st, (int) op->sys_temp);
+  help(b, "supply_volts", "gauge", "Q330 power supply voltage.");
+  out(b, "quant2dali_supply_volts{station=\"%s\"} %.2f\n", st, op->pwr_volt);
+  help(b, "supply_amps", "gauge", "Q330 power supply current.");
+  out(b, "quant2dali_supply_amps{station=\"%s\"} %.3f\n", st, op->pwr_cur);
+
+  help(b, "accstat", "gauge", "Q330 accumulated statistics over the last minute, hour and day.");
+  for (i = AC_FIRST; i <= AC_LAST; i++) {
+    for (j = AD_MINUTE; j <= AD_DAY; j++) {
+      if (op->accstats[i][j] == INVALID_ENTRY)
+        continue;
+      out(b, "quant2dali_accstat{station=\"%s\",type=\"%s\",period=\"%s\"} %d\n",
+        st, acc_names[i], dur_names[j], (int) op->accstats[i][j]);
+    }
+  }
+
+  for (i = 0, n = 0; i < 8; i++) {
+    for (bits = op->slidecopy.validmap[i]; bits; bits &= bits - 1)
+      n++;
+  }
+  help(b, "window_packets", "gauge", "Packets held in the sliding window.");
+  out(b, "quant2dali_window_packets{station=\"%s\"} %d\n", st, n);
+  help(b, "window_low_sequence", "gauge", "Last packet number acknowledged.");
+  out(b, "quant2dali_window_low_sequence{station=\"%s\"} %u\n", st, (unsigned int) op->slidecopy.low_seq);
+  help(b, "window_latest_sequence", "gauge", "Latest packet number received.");
+  out(b, "quant2dali_window_latest_sequence{station=\"%s\"} %u\n", st, (unsigned int) op->slidecopy.latest);
+
+  if (s->lcqstat.count > 0) {
+    help(b, "lcq_records_total", "counter", "Miniseed records built per channel.");
+    for (i = 0; i < s->lcqstat.count; i++) {
+      lcq = &s->lcqstat.entries[i];
+      out(b, "quant2dali_lcq_records_total{station=\"%s\",location=\"%s\",channel=\"%s\"} %d\n",
+        st, lcq->location, lcq->channel, (int) lcq->rec_cnt);
+    }
+    help(b, "lcq_record_age_seconds", "gauge", "Seconds since a record was last built per channel.");
+    for (i = 0; i < s->lcqstat.count; i++) {
+      lcq = &s->lcqstat.entries[i];
+      out(b, "quant2dali_lcq_record_age_seconds{station=\"%s\",location=\"%s\",channel=\"%s\"} %d\n",
+        st, lcq->location, lcq->channel, (int) lcq->rec_age);
+    }
+  }
+
+counters:
+  help(b, "records_total", "counter", "Miniseed records received from lib330.");
+  out(b, "quant2dali_records_total{station=\"%s\"} %llu\n", st, s->records);
+  help(b, "record_bytes_total", "counter", "Miniseed bytes received from lib330.");
+  out(b, "quant2dali_record_bytes_total{station=\"%s\"} %llu\n", st, s->record_bytes);
+  help(b, "datalink_records_total", "counter", "Records written to the datalink server.");
+  out(b, "quant2dali_datalink_records_total{station=\"%s\"} %llu\n", st, s->dali_records);
+  help(b, "datalink_bytes_total", "counter", "Bytes written to the datalink server.");
+  out(b, "quant2dali_datalink_bytes_total{station=\"%s\"} %llu\n", st, s->dali_bytes);
+  help(b, "datalink_errors_total", "counter", "Failed datalink writes.");
+  out(b, "quant2dali_datalink_errors_total{station=\"%s\"} %llu\n", st, s->dali_errors);
+  help(b, "datalink_reconnects_total", "counter", "Datalink reconnection attempts.");
+  out(b, "quant2dali_datalink_reconnects_total{station=\"%s\"} %llu\n", st, s->dali_reconnects);
+  help(b, "archive_records_total", "counter", "Records written to the local archive.");
+  out(b, "quant2dali_archive_records_total{station=\"%s\"} %llu\n", st, s->archive_records);
+  help(b, "archive_errors_total", "counter", "Failed local archive writes.");
+  out(b, "quant2dali_archive_errors_total{station=\"%s\"} %llu\n", st, s->archive_errors);
+  help(b, "archive_seconds_total", "counter", "Time spent writing the local archive.");
+  out(b, "quant2dali_archive_seconds_total{station=\"%s\"} %.6f\n", st, s->archive_seconds);
+  help(b, "archive_max_seconds", "gauge", "Slowest single local archive write.");
+  out(b, "quant2dali_archive_max_seconds{station=\"%s\"} %.6f\n", st, s->archive_max);
+  help(b, "lowlatency_total", "counter", "Seconds of data sent on the low latency stream.");
+  out(b, "quant2dali_lowlatency_total{station=\"%s\"} %llu\n", st, s->lowlat_seconds);
+  help(b, "lowlatency_errors_total", "counter", "Seconds of data the low latency stream failed to send.");
+  out(b, "quant2dali_lowlatency_errors_total{station=\"%s\"} %llu\n", st, s->lowlat_errors);
+  help(b, "lowlatency_seconds_total", "counter", "Total delay from the first sample of each second to its delivery.");
+  out(b, "quant2dali_lowlatency_seconds_total{station=\"%s\"} %.6f\n", st, s->lowlat_latency);
+  help(b, "lowlatency_last_seconds", "gauge", "Delay to delivery of the latest second on the low latency stream.");
+  out(b, "quant2dali_lowlatency_last_seconds{station=\"%s\"} %.6f\n", st, s->lowlat_last);
+  help(b, "lowlatency_max_seconds", "gauge", "Longest delay to delivery on the low latency stream.");
+  out(b, "quant2dali_lowlatency_max_seconds{station=\"%s\"} %.6f\n", st, s->lowlat_max);
+  help(b, "onesec_frames_total", "counter", "One second data frames sent.");
+  out(b, "quant2dali_onesec_frames_total{station=\"%s\"} %llu\n", st, s->onesec_frames);
+  help(b, "onesec_bytes_total", "counter", "Bytes of one second data frames sent.");
+  out(b, "quant2dali_onesec_bytes_total{station=\"%s\"} %llu\n", st, s->onesec_bytes);
+  help(b, "onesec_errors_total", "counter", "One second data frames that could not be sent.");
+  out(b, "quant2dali_onesec_errors_total{station=\"%s\"} %llu\n", st, s->onesec_errors);
+  help(b, "spool_bytes", "gauge", "Bytes of records waiting in the datalink spool.");
+  out(b, "quant2dali_spool_bytes{station=\"%s\"} %lld\n", st, s->spool_bytes);
+  help(b, "spool_records", "gauge", "Records waiting in the datalink spool.");
+  out(b, "quant2dali_spool_records{station=\"%s\"} %ld\n", st, s->spool_records);
+  help(b, "spool_age_seconds", "gauge", "How long the oldest spooled record has been waiting.");
+  out(b, "quant2dali_spool_age_seconds{station=\"%s\"} %.0f\n", st, s->spool_age);
+  help(b, "spool_spooled_total", "counter", "Records written to the datalink spool.");
+  out(b, "quant2dali_spool_spooled_total{station=\"%s\"} %llu\n", st, s->spool_spooled);
+  help(b, "spool_drained_total", "counter", "Spooled records acknowledged by the datalink server.");
+  out(b, "quant2dali_spool_drained_total{station=\"%s\"} %llu\n", st, s->spool_drained);
+  help(b, "spool_dropped_total", "counter", "Spooled records dropped to keep the spool within its limit.");
+  out(b, "quant2dali_spool_dropped_total{station=\"%s\"} %llu\n", st, s->spool_dropped);
+  help(b, "recpool_size", "gauge", "Records lib330 can hold for the datalink sender.");
+  out(b, "quant2dali_recpool_size{station=\"%s\"} %d\n", st, (int) s->recpool.size);
+  help(b, "recpool_in_use", "gauge", "Records held in the lib330 record pool.");
+  out(b, "quant2dali_recpool_in_use{station=\"%s\"} %d\n", st, (int) s->recpool.in_use);
+  help(b, "recpool_high_water", "gauge", "Most records held in the lib330 record pool at once.");
+  out(b, "quant2dali_recpool_high_water{station=\"%s\"} %d\n", st, (int) s->recpool.high_water);
+  help(b, "recpool_queued", "gauge", "Records waiting for the datalink sender thread.");
+  out(b, "quant2dali_recpool_queued{station=\"%s\"} %ld\n", st, s->recpool_queued);
+  help(b, "recpool_holds_total", "counter", "Records taken from the lib330 record pool.");
+  out(b, "quant2dali_recpool_holds_total{station=\"%s\"} %llu\n", st, (unsigned long long) s->recpool.holds);
+  help(b, "recpool_refused_total", "counter", "Holds refused because the lib330 record pool was full.");
+  out(b, "quant2dali_recpool_refused_total{station=\"%s\"} %llu\n", st, (unsigned long long) s->recpool.refused);
+  help(b, "dedup_duplicates_total", "counter", "Resent records dropped as exact duplicates.");
+  out(b, "quant2dali_dedup_duplicates_total{station=\"%s\"} %llu\n", st, s->dedup_duplicates);
+  help(b, "dedup_overlaps_total", "counter", "Resent records dropped as already covered by earlier data.");
+  out(b, "quant2dali_dedup_overlaps_total{station=\"%s\"} %llu\n", st, s->dedup_overlaps);
+  help(b, "dedup_bytes_total", "counter", "Bytes of resent records dropped.");
+  out(b, "quant2dali_dedup_bytes_total{station=\"%s\"} %llu\n", st, s->dedup_bytes);
+}
+
+static void write_all(int fd, char *p, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    if ((n = write(fd, p, len)) < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    p += n; len -= n;
+  }
+}
+
+/* answer one request, anything but a GET gets turned away */
+static void serve(int fd) {
+  char req[1024], hdr[256];
+  size_t len = 0;
+  ssize_t n;
+  metrics_snapshot *s;
+  metrics_buf b;
+  struct timeval tv = {2, 0};
+
+  (void) setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  (void) setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  while (len < sizeof(req) - 1) {
+    if ((n = read(fd, req + len, sizeof(req) - 1 - len)) <= 0)
+      break;
+    len += n; req[len] = '\0';
+    if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+      break;
+  }
+  req[len] = '\0';
+
+  if ((strncmp(req, "GET /metrics", 12) != 0) && (strncmp(req, "GET / ", 6) != 0)) {
+    n = snprintf(hdr, sizeof(hdr), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    write_all(fd, hdr, n);
+    return;
+  }
+
+  if ((s = (metrics_snapshot *) malloc(sizeof(metrics_snapshot))) == NULL)
+    return;
+  pthread_mutex_lock(&snapshot_lock);
+  memcpy(s, &snapshot, sizeof(metrics_snapshot));
+  pthread_mutex_unlock(&snapshot_lock);
+
+  b.len = 0; b.size = 16384;
+  if ((b.data = malloc(b.size)) != NULL) {
+    render(&b, s);
+    n = snprintf(hdr, sizeof(hdr), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long) b.len);
+    write_all(fd, hdr, n);
+    write_all(fd, b.data, b.len);
+    free(b.data);
+  }
+  free(s);
+}
+
+static void *metrics_main(void *arg) {
+  int fd;
+  struct pollfd pfd;
+
+  while (metrics_going) {
+    pfd.fd = metrics_sockfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 500) <= 0)
+      continue;
+    if ((fd = accept(metrics_sockfd, NULL, NULL)) < 0)
+      continue;
+    serve(fd);
+    close(fd);
+  }
+
+  return NULL;
+}
+
+int metrics_start (char *station, int port) {
+  int on = 1;
+  struct sockaddr_in sin;
+
+  metrics_station = station;
+
+  memset((char *) &sin, 0, sizeof(struct sockaddr_in));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  sin.sin_port = htons(port);
+
+  if ((metrics_sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    ms_log(2, "can't create metrics socket [%s]\n", strerror(errno)); return -1;
+  }
+  (void) setsockopt(metrics_sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(metrics_sockfd, (struct sockaddr *) &sin, sizeof(struct sockaddr_in)) < 0) {
+    ms_log(2, "can't bind metrics port %d [%s]\n", port, strerror(errno)); close(metrics_sockfd); return -1;
+  }
+  if (listen(metrics_sockfd, 8) < 0) {
+    ms_log(2, "can't listen on metrics port %d [%s]\n", port, strerror(errno)); close(metrics_sockfd); return -1;
+  }
+
+  metrics_going = 1;
+  if (pthread_create(&metrics_thread, NULL, metrics_main, NULL) != 0) {
+    ms_log(2, "can't start metrics thread\n"); metrics_going = 0; close(metrics_sockfd); return -1;
+  }
+
+  return 0;
+}
+
+void metrics_stop (void) {
+  if (!metrics_going)
+    return;
+
+  metrics_going = 0;
+  (void) pthread_join(metrics_thread, NULL);
+  close(metrics_sockfd);
+  metrics_sockfd = -1;
+}
+
+void metrics_state (enum tlibstate state, topstat *opstat) {
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot.state = state;
+  memcpy(&snapshot.opstat, opstat, sizeof(topstat));
+  snapshot.updated = time(NULL);
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_lcqs (tlcqstat *lcqstat) {
+  pthread_mutex_lock(&snapshot_lock);
+  memcpy(&snapshot.lcqstat, lcqstat, sizeof(tlcqstat));
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_record (int bytes) {
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot.records++;
+  snapshot.record_bytes += bytes;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_datalink (int bytes, int error) {
+  pthread_mutex_lock(&snapshot_lock);
+  if (error) {
+    snapshot.dali_errors++;
+  }
+  else {
+    snapshot.dali_records++;
+    snapshot.dali_bytes += bytes;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_reconnect (void) {
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot.dali_reconnects++;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_archive (double seconds, int error) {
+  pthread_mutex_lock(&snapshot_lock);
+  if (error) {
+    snapshot.archive_errors++;
+  }
+  else {
+    snapshot.archive_records++;
+  }
+  snapshot.archive_seconds += seconds;
+  if (seconds > snapshot.archive_max)
+    snapshot.archive_max = seconds;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_lowlatency (double latency, int error) {
+  pthread_mutex_lock(&snapshot_lock);
+  if (error) {
+    snapshot.lowlat_errors++;
+  }
+  else {
+    snapshot.lowlat_seconds++;
+    snapshot.lowlat_latency += latency;
+    snapshot.lowlat_last = latency;
+    if (latency > snapshot.lowlat_max)
+      snapshot.lowlat_max = latency;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_onesec (int bytes, int error) {
+  pthread_mutex_lock(&snapshot_lock);
+  if (error) {
+    snapshot.onesec_errors++;
+  }
+  else {
+    snapshot.onesec_frames++;
+    snapshot.onesec_bytes += bytes;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_spool (long long bytes, long records, double age, int spooled, int drained, int dropped) {
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot.spool_bytes = bytes;
+  snapshot.spool_records = records;
+  if (age >= 0.0)
+    snapshot.spool_age = age;
+  snapshot.spool_spooled += spooled;
+  snapshot.spool_drained += drained;
+  snapshot.spool_dropped += dropped;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_recpool (trecpoolstat *poolstat, long queued) {
+  pthread_mutex_lock(&snapshot_lock);
+  memcpy(&snapshot.recpool, poolstat, sizeof(trecpoolstat));
+  snapshot.recpool_queued = queued;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void metrics_dedup (int bytes, int overlap) {
+  pthread_mutex_lock(&snapshot_lock);
+  if (overlap)
+    snapshot.dedup_overlaps++;
+  else
+    snapshot.dedup_duplicates++;
+  snapshot.dedup_bytes += bytes;
+  pthread_mutex_unlock(&snapshot_lock);
+}
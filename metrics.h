@@ -0,0 +1,31 @@
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * metrics: a minimal http endpoint exporting collector statistics in the
+ * prometheus text format.
+ *
+ * The main loop pushes copies of the lib330 status blocks into a private
+ * snapshot, and the record callbacks add to counters, all under a mutex
+ * local to this module. A scrape only ever copies the snapshot, it never
+ * calls into lib330 or takes the station lock.
+ */
+
+extern int metrics_start (char *station, int port);
+extern void metrics_stop (void);
+
+extern void metrics_state (enum tlibstate state, topstat *opstat);
+extern void metrics_lcqs (tlcqstat *lcqstat);
+
+extern void metrics_record (int bytes);
+extern void metrics_datalink (int bytes, int error);
+extern void metrics_reconnect (void);
+extern void metrics_archive (double seconds, int error);
+extern void metrics_lowlatency (double latency, int error);
+extern void metrics_onesec (int bytes, int error);
+extern void metrics_dedup (int bytes, int overlap);
+extern void metrics_spool (long long bytes, long records, double age, int spooled, int drained, int dropped);
+extern void metrics_recpool (trecpoolstat *poolstat, long queued);
+
+#endif /* METRICS_H */
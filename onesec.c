@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "onesec.h"
+#include "metrics.h"
+
+#ifndef EPOCH_2000
+#define EPOCH_2000 946684800 /* lib330 times are seconds since 2000 */
+#endif
+
+#define ONESEC_CHANNELS 255 /* the frame channel count is a single byte */
+
+/* one channel's second, waiting for the batch to close */
+typedef struct onesec_entry {
+  unsigned char descriptor[ONESEC_DESCRIPTOR];
+  int count;
+  int first; /* index of its first sample in the pool */
+} onesec_entry;
+
+static onesec_entry entries[ONESEC_CHANNELS];
+static int nentries = 0;
+
+static int32_t *pool = NULL; /* samples of the open batch */
+static int npool = 0;
+static int pool_size = 0;
+
+static time_t batch_second = 0;
+static char batch_network[3];
+static char batch_station[6];
+
+static unsigned char *frame = NULL;
+static uint32_t frame_sequence = 0;
+static int frame_limit = ONESEC_MAXFRAME;
+
+static onesec_sink frame_sink = NULL;
+static int onesec_sockfd = -1;
+static struct sockaddr_un onesec_addr;
+
+static void put16(unsigned char *p, unsigned int v) {
+  p[0] = (v >> 8) & 0xff; p[1] = v & 0xff;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+  p[0] = (v >> 24) & 0xff; p[1] = (v >> 16) & 0xff; p[2] = (v >> 8) & 0xff; p[3] = v & 0xff;
+}
+
+/* copy a code into a fixed width field, space padded */
+static void putcode(unsigned char *p, char *code, int width) {
+  int i, n = (code != NULL) ? (int) strlen(code) : 0;
+
+  for (i = 0; i < width; i++)
+    p[i] = (i < n) ? code[i] : ' ';
+}
+
+/* lib330 station names are "NN-SSSSS" */
+static void onesec_codes(char *station_name, char *network, char *station) {
+  char *c;
+
+  if ((c = strchr(station_name, '-')) != NULL) {
+    (void) snprintf(network, 3, "%.*s", (int)(c - station_name), station_name);
+    (void) snprintf(station, 6, "%.5s", c + 1);
+  }
+  else {
+    (void) snprintf(network, 3, "%s", "");
+    (void) snprintf(station, 6, "%.5s", station_name);
+  }
+}
+
+static void send_frame(int nchan, int length) {
+  int error = 0;
+
+  frame[5] = (unsigned char) nchan;
+  put16(frame + 6, length);
+  put32(frame + 12, frame_sequence++);
+
+  if ((frame_sink != NULL) && (frame_sink((char *) frame, length, batch_network, batch_station, batch_second) < 0))
+    error++;
+
+  /* a local reader may come and go, frames are simply dropped while it is away */
+  if ((onesec_sockfd != -1) && (sendto(onesec_sockfd, frame, length, 0, (struct sockaddr *) &onesec_addr, sizeof(onesec_addr)) < 0))
+    error++;
+
+  metrics_onesec(length, error);
+}
+
+/* write the open batch, split into as many frames as the limit needs */
+void onesec_flush (void) {
+  int i, j, n, nchan, length, samples;
+  unsigned char *p;
+
+  for (i = 0; i < nentries; i = j) {
+    /* how many channels fit, at least one is always sent */
+    length = ONESEC_HEADER;
+    for (j = i; (j < nentries) && ((j - i) < ONESEC_CHANNELS); j++) {
+      n = ONESEC_DESCRIPTOR + entries[j].count * 4;
+      if ((j > i) && ((length + n) > frame_limit))
+        break;
+      length += n;
+    }
+    nchan = j - i;
+
+    memcpy(frame, ONESEC_MAGIC, 4);
+    frame[4] = ONESEC_VERSION;
+    put32(frame + 8, (uint32_t) batch_second);
+    putcode(frame + 16, batch_network, 2);
+    putcode(frame + 18, batch_station, 5);
+    frame[23] = 0;
+
+    p = frame + ONESEC_HEADER;
+    for (n = i; n < j; n++, p += ONESEC_DESCRIPTOR)
+      memcpy(p, entries[n].descriptor, ONESEC_DESCRIPTOR);
+    for (n = i; n < j; n++) {
+      for (samples = 0; samples < entries[n].count; samples++, p += 4)
+        put32(p, (uint32_t) pool[entries[n].first + samples]);
+    }
+
+    send_frame(nchan, length);
+  }
+
+  nentries = 0;
+  npool = 0;
+}
+
+void onesec_push (tonesec_call *data) {
+  onesec_entry *e;
+  unsigned char *d;
+  int32_t *p;
+  int count, size;
+  double timestamp;
+  time_t second;
+
+  if (frame == NULL)
+    return;
+
+  /* total_size trims the unused samples off the whole structure */
+  count = MAX_RATE - (int) ((sizeof(tonesec_call) - data->total_size) / sizeof(longint));
+  if ((count <= 0) || (count > MAX_RATE))
+    return;
+
+  timestamp = data->timestamp + EPOCH_2000;
+  second = (time_t) floor(timestamp);
+
+  /* a new second closes the batch */
+  if ((nentries > 0) && ((second != batch_second) || (nentries >= ONESEC_CHANNELS)))
+    onesec_flush();
+
+  if (nentries == 0) {
+    batch_second = second;
+    onesec_codes(data->station_name, batch_network, batch_station);
+  }
+
+  if ((npool + count) > pool_size) {
+    size = (pool_size > 0) ? pool_size * 2 : 4 * MAX_RATE;
+    while (size < (npool + count))
+      size *= 2;
+    if ((p = (int32_t *) realloc(pool, size * sizeof(int32_t))) == NULL) {
+      metrics_onesec(0, 1); return;
+    }
+    pool = p; pool_size = size;
+  }
+
+  e = &entries[nentries++];
+  e->count = count;
+  e->first = npool;
+  memcpy(pool + npool, data->samples, count * sizeof(int32_t));
+  npool += count;
+
+  d = e->descriptor;
+  putcode(d, data->location, 2);
+  putcode(d + 2, data->channel, 3);
+  d[5] = (unsigned char) data->qual_perc;
+  d[6] = (unsigned char) data->activity_flags;
+  d[7] = (unsigned char) data->io_flags;
+  d[8] = (unsigned char) data->data_quality_flags;
+  d[9] = (unsigned char) data->filter_bits;
+  put16(d + 10, count);
+  put32(d + 12, (uint32_t) (int32_t) data->rate);
+  put32(d + 16, (uint32_t) (int32_t) lround((timestamp - (double) second) * 1000000.0));
+}
+
+int onesec_start (char *path, int limit, onesec_sink sink) {
+
+  frame_sink = sink;
+  frame_limit = ((limit > 0) && (limit < ONESEC_MAXFRAME)) ? limit : ONESEC_MAXFRAME;
+  if (frame_limit < (ONESEC_HEADER + ONESEC_DESCRIPTOR + 4)) {
+    ms_log(2, "one second frame limit %d is too small\n", limit); return -1;
+  }
+
+  if (path != NULL) {
+    if (strlen(path) >= sizeof(onesec_addr.sun_path)) {
+      ms_log(2, "one second socket path is too long: %s\n", path); return -1;
+    }
+    memset((char *) &onesec_addr, 0, sizeof(struct sockaddr_un));
+    onesec_addr.sun_family = AF_UNIX;
+    strcpy(onesec_addr.sun_path, path);
+
+    if ((onesec_sockfd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+      ms_log(2, "can't create one second socket [%s]\n", strerror(errno)); return -1;
+    }
+    /* never hold up the station thread for a slow reader */
+    (void) fcntl(onesec_sockfd, F_SETFL, fcntl(onesec_sockfd, F_GETFL) | O_NONBLOCK);
+  }
+
+  if ((frame = (unsigned char *) malloc(ONESEC_MAXFRAME + ONESEC_DESCRIPTOR + 4 * MAX_RATE)) == NULL) {
+    ms_log(2, "can't allocate one second frame buffer\n");
+    if (onesec_sockfd != -1)
+      close(onesec_sockfd);
+    onesec_sockfd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+void onesec_stop (void) {
+  if (frame == NULL)
+    return;
+
+  onesec_flush();
+
+  if (onesec_sockfd != -1)
+    close(onesec_sockfd);
+  onesec_sockfd = -1;
+
+  free(frame); frame = NULL;
+  free(pool); pool = NULL;
+  pool_size = 0;
+}
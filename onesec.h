@@ -0,0 +1,56 @@
+#ifndef ONESEC_H
+#define ONESEC_H
+
+/*
+ * onesec: pack the lib330 one second data callbacks into compact binary
+ * frames, one frame per station second, so 1 Hz and state of health
+ * consumers can use the samples without decoding any miniseed.
+ *
+ * Callbacks are gathered until one arrives for a different second, then
+ * the batch is written as one or more frames no larger than the given
+ * limit. Everything is called from the lib330 station thread, only
+ * onesec_stop is called once that thread has gone.
+ *
+ * Frame layout, all values big-endian:
+ *
+ *   header (24 bytes)
+ *     0  4  magic "Q1SD"
+ *     4  1  version (1)
+ *     5  1  channel count
+ *     6  2  frame length in bytes, header included
+ *     8  4  the second, unix time
+ *    12  4  frame sequence number, to spot dropped datagrams
+ *    16  2  network code, space padded
+ *    18  5  station code, space padded
+ *    23  1  reserved
+ *
+ *   then a descriptor (20 bytes) per channel
+ *     0  2  location code, space padded
+ *     2  3  channel code, space padded
+ *     5  1  clock quality percentage
+ *     6  1  seed activity flags
+ *     7  1  seed io flags
+ *     8  1  seed data quality flags
+ *     9  1  OSF_xxx filter bits that selected the channel
+ *    10  2  sample count
+ *    12  4  sample rate, negative for seconds per sample
+ *    16  4  first sample offset from the second, microseconds
+ *
+ *   then each channel's samples as 32 bit integers, in descriptor order.
+ */
+
+#define ONESEC_MAGIC "Q1SD"
+#define ONESEC_VERSION 1
+#define ONESEC_HEADER 24
+#define ONESEC_DESCRIPTOR 20
+#define ONESEC_MAXFRAME 65000
+
+/* where complete frames are sent, besides any local socket */
+typedef int (*onesec_sink) (char *frame, int length, char *network, char *station, time_t second);
+
+extern int onesec_start (char *path, int limit, onesec_sink sink);
+extern void onesec_push (tonesec_call *data);
+extern void onesec_flush (void);
+extern void onesec_stop (void);
+
+#endif /* ONESEC_H */
@@ -17,6 +17,8 @@
 #include <errno.h>
 #include <time.h>
 #include <math.h>
+#include <poll.h>
+#include <sys/time.h>
 
 #include "libmseed.h"
 #include "ping.h"
@@ -66,70 +68,66 @@ static u_int32_t qdp_calc_crc (char *b, int len) {
   return crc.l ;
 }
 
-int send_qdp_ping(int sockfd, char *ipaddr, int ipport, int serial) {
-  static int seqno = 1;
-  struct sockaddr_in sin;
-
-  int status;
-  struct addrinfo hints, *res;
-
-  qdp ping;
+/* fill in a ping request, returns the packet length */
+static int make_qdp_ping(qdp *ping, int serial, u_int16_t seqno) {
   int len = 0;
 
-  memset(&ping, 0, sizeof(qdp));
+  memset(ping, 0, sizeof(qdp));
 
-  ping.crc = 0;
-  ping.command = C1_PING;
-  ping.version = QDP_VERSION;
-  ping.datalength = (serial) ? 4 : 8;
-  ping.sequence = seqno++;
-  ping.acknowledge = 0;
-  ping.ping_type = (serial) ? 4 : 2;
-  ping.ping_id = 0;
-  ping.data.bitmap = (serial) ? 0x0000 : 0x8f0b;
+  ping->crc = 0;
+  ping->command = C1_PING;
+  ping->version = QDP_VERSION;
+  ping->datalength = (serial) ? 4 : 8;
+  ping->sequence = seqno;
+  ping->acknowledge = 0;
+  ping->ping_type = (serial) ? 4 : 2;
+  ping->ping_id = 0;
+  ping->data.bitmap = (serial) ? 0x0000 : 0x8f0b;
 
-  len = QDP_HEDSIZE + ping.datalength;
+  len = QDP_HEDSIZE + ping->datalength;
 
 #ifdef DEBUG
-fprintf(stderr, "crc %u (%u)\n", ping.crc, qdp_calc_crc((char *) &ping.crc + 4, 12));
-fprintf(stderr, "cmd %u\n", ping.command);
-fprintf(stderr, "ver %u\n", ping.version);
-fprintf(stderr, "dat %u\n", ping.datalength);
-fprintf(stderr, "seq %u\n", ping.sequence);
-fprintf(stderr, "ack %u\n", ping.acknowledge);
-fprintf(stderr, "typ %u\n", ping.ping_type);
-fprintf(stderr, "id  %u\n", ping.ping_id);
-fprintf(stderr, "bit %x\n", ping.data.bitmap);
+fprintf(stderr, "crc %u (%u)\n", ping->crc, qdp_calc_crc((char *) &ping->crc + 4, 12));
+fprintf(stderr, "cmd %u\n", ping->command);
+fprintf(stderr, "ver %u\n", ping->version);
+fprintf(stderr, "dat %u\n", ping->datalength);
+fprintf(stderr, "seq %u\n", ping->sequence);
+fprintf(stderr, "ack %u\n", ping->acknowledge);
+fprintf(stderr, "typ %u\n", ping->ping_type);
+fprintf(stderr, "id  %u\n", ping->ping_id);
+fprintf(stderr, "bit %x\n", ping->data.bitmap);
 fprintf(stderr, "len %d\n", len);
 #endif // DEBUG
 
 #ifndef WORDS_BIGENDIAN
-  ping.datalength = swap16(ping.datalength);
-  ping.sequence = swap16(ping.sequence);
-  ping.acknowledge = swap16(ping.acknowledge);
-  ping.ping_type = swap16(ping.ping_type);
-  ping.ping_id = swap16(ping.ping_id);
-  ping.data.bitmap = swap32(ping.data.bitmap);
+  ping->datalength = swap16(ping->datalength);
+  ping->sequence = swap16(ping->sequence);
+  ping->acknowledge = swap16(ping->acknowledge);
+  ping->ping_type = swap16(ping->ping_type);
+  ping->ping_id = swap16(ping->ping_id);
+  ping->data.bitmap = swap32(ping->data.bitmap);
 #endif /* WORDS_BIGENDIAN */
 
-  ping.crc = qdp_calc_crc(&ping.command, len - QDP_CRCSIZE);
+  ping->crc = qdp_calc_crc(&ping->command, len - QDP_CRCSIZE);
 
 #ifndef WORDS_BIGENDIAN
-  ping.crc = swap32(ping.crc);
+  ping->crc = swap32(ping->crc);
 #endif /* WORDS_BIGENDIAN */
 
-#ifdef DEBUG
-fprintf(stderr, "crc %u\n", ping.crc);
-fprintf(stderr, "cmd %u\n", ping.command);
-fprintf(stderr, "ver %u\n", ping.version);
-fprintf(stderr, "dat %u\n", ping.datalength);
-fprintf(stderr, "seq %u\n", ping.sequence);
-fprintf(stderr, "ack %u\n", ping.acknowledge);
-fprintf(stderr, "typ %u\n", ping.ping_type);
-fprintf(stderr, "id  %u\n", ping.ping_id);
-fprintf(stderr, "bit %x\n", ping.data.bitmap);
-fprintf(stderr, "len %d\n", len);
-#endif // DEBUG
+  return len;
+}
+
+int send_qdp_ping(int sockfd, char *ipaddr, int ipport, int serial) {
+  static int seqno = 1;
+  struct sockaddr_in sin;
+
+  int status;
+  struct addrinfo hints, *res;
+
+  qdp ping;
+  int len = 0;
+
+  len = make_qdp_ping(&ping, serial, seqno++);
 
   memset(&hints, 0, sizeof hints);
   hints.ai_family = AF_UNSPEC; // AF_INET or AF_INET6 to force version
@@ -148,6 +146,8 @@ fprintf(stderr, "len %d\n", len);
 fprintf(stderr, "ip address : %s\n", inet_ntoa(sin.sin_addr));
 #endif // DEBUG
 
+  freeaddrinfo(res);
+
   if (sendto(sockfd, (char *) &ping, len, 0, (struct sockaddr *) &sin, sizeof(struct sockaddr_in)) != len)
     return -1;
 
@@ -174,7 +174,7 @@ static int decode_qdp_status(qdp *ping) {
   memset(&ping->gps, 0, sizeof(qdp_stat_gps));
   memset(&ping->ether, 0, sizeof(qdp_stat_ether));
   memset(&ping->boom, 0, sizeof(qdp_stat_boom));
-  for (j = 0; j < 6; j++) {
+  for (j = 0; j < 4; j++) {
     memset(&ping->lport[j], 0, sizeof(qdp_stat_log));
   }
 
@@ -289,7 +289,7 @@ static int decode_qdp_status(qdp *ping) {
         offset += sizeof(qdp_stat_boom);
         break;
       default:
-        ms_log(2, "error: unknown status messaage [%d]\n", i); exit(-1);
+        ms_log(2, "error: unknown status messaage [%d]\n", i); return -1;
       }
     }
   }
@@ -297,18 +297,19 @@ static int decode_qdp_status(qdp *ping) {
   return 0;
 }
 
-int recv_qdp_ping(int sockfd, qdp *ping) { // char **ipaddr, int *ipport) {
+/* read the next valid ping reply, noting who it came from, returns 0 if none are waiting */
+int recv_qdp_ping_from(int sockfd, qdp *ping, struct sockaddr_in *from) {
   int i;
   int len;
 
-  int slen;
+  socklen_t slen;
   int norecv;
   struct sockaddr_in sin;
-  slen = sizeof(sin);
 
-  memset(ping, sizeof(qdp), 0);
+  memset(ping, 0, sizeof(qdp));
 
-  do {
+  for (;;) {
+    slen = sizeof(sin);
 
     /* now pull in a block ... */
     if ((norecv = recvfrom(sockfd, (char *) ping, sizeof(qdp), 0, (struct sockaddr *) &sin, &slen)) < 0) {
@@ -335,52 +336,60 @@ int recv_qdp_ping(int sockfd, qdp *ping) { // char **ipaddr, int *ipport) {
     if (ping->crc != qdp_calc_crc(&ping->command, QDP_HEDSIZE + len - QDP_CRCSIZE))
       continue;
 
+    break;
+  }
+
 #ifdef DEBUG
 fprintf(stderr, "bit %x\n", ping->data.status.bitmap);
 #endif // DEBUG
 
 #ifndef WORDS_BIGENDIAN
-    ping->datalength = swap16(ping->datalength);
-    ping->sequence = swap16(ping->sequence);
-    ping->acknowledge = swap16(ping->acknowledge);
-    ping->ping_type = swap16(ping->ping_type);
-    ping->ping_id = swap16(ping->ping_id);
-
-    if (ping->ping_type == 3) {
-      ping->data.status.drifttol = swap16(ping->data.status.drifttol);
-      ping->data.status.usermsgcnt = swap16(ping->data.status.usermsgcnt);
-      ping->data.status.lastreboot = swap32(ping->data.status.lastreboot);
-      ping->data.status.bitmap = swap32(ping->data.status.bitmap);
+  ping->datalength = swap16(ping->datalength);
+  ping->sequence = swap16(ping->sequence);
+  ping->acknowledge = swap16(ping->acknowledge);
+  ping->ping_type = swap16(ping->ping_type);
+  ping->ping_id = swap16(ping->ping_id);
+
+  if (ping->ping_type == 3) {
+    ping->data.status.drifttol = swap16(ping->data.status.drifttol);
+    ping->data.status.usermsgcnt = swap16(ping->data.status.usermsgcnt);
+    ping->data.status.lastreboot = swap32(ping->data.status.lastreboot);
+    ping->data.status.bitmap = swap32(ping->data.status.bitmap);
+  }
+  else if (ping->ping_type == 5) {
+    ping->data.info.version = swap16(ping->data.info.version);
+    ping->data.info.flags = swap16(ping->data.info.flags);
+    ping->data.info.kmi = swap32(ping->data.info.kmi);
+    ping->data.info.serial_low = swap32(ping->data.info.serial_low);
+    ping->data.info.serial_high = swap32(ping->data.info.serial_high);
+    for (i = 0; i < 8; i++) {
+      ping->data.info.memory[i] = swap32(ping->data.info.memory[i]);
     }
-    else if (ping->ping_type == 5) {
-      ping->data.info.version = swap16(ping->data.info.version);
-      ping->data.info.flags = swap16(ping->data.info.flags);
-      ping->data.info.kmi = swap32(ping->data.info.kmi);
-      ping->data.info.serial_low = swap32(ping->data.info.serial_low);
-      ping->data.info.serial_high = swap32(ping->data.info.serial_high);
-      for (i = 0; i < 8; i++) {
-        ping->data.info.memory[i] = swap32(ping->data.info.memory[i]);
-      }
-      for (i = 0; i < 8; i++) {
-        ping->data.info.interface[i] = swap16(ping->data.info.interface[i]);
-      }
-      ping->data.info.calerr = swap16(ping->data.info.calerr);
-      ping->data.info.sysver = swap16(ping->data.info.sysver);
+    for (i = 0; i < 8; i++) {
+      ping->data.info.interface[i] = swap16(ping->data.info.interface[i]);
     }
+    ping->data.info.calerr = swap16(ping->data.info.calerr);
+    ping->data.info.sysver = swap16(ping->data.info.sysver);
+  }
 #endif /* WORDS_BIGENDIAN */
 
 #ifdef DEBUG
 fprintf(stderr, "bit %x\n", ping->data.status.bitmap);
 #endif // DEBUG
 
-    if (ping->ping_type == 3)
-      decode_qdp_status(ping);
+  if (ping->ping_type == 3)
+    decode_qdp_status(ping);
 
-  } while (norecv < 0);
+  if (from != NULL)
+    memcpy(from, &sin, sizeof(struct sockaddr_in));
 
   return norecv;
 }
 
+int recv_qdp_ping(int sockfd, qdp *ping) { // char **ipaddr, int *ipport) {
+  return recv_qdp_ping_from(sockfd, ping, NULL);
+}
+
 unsigned long long ping_for_serial(char *ipaddr, int port, int count, int timeout) {
 
   int n;
@@ -440,3 +449,291 @@ unsigned long long ping_for_serial(char *ipaddr, int port, int count, int timeou
 
   return serial;
 }
+
+static double qdp_now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+/* send the next request a discovery target is waiting on */
+static void qdp_request(int sockfd, qdp_target *target, int index, u_int16_t *seqno, int *pending) {
+  qdp ping;
+  int len, n;
+
+  target->sent = qdp_now();
+  target->tries++;
+
+  /* don't reuse a sequence number that is still outstanding */
+  for (n = 0; (n < 65536) && ((*seqno == 0) || (pending[*seqno] >= 0)); n++)
+    (*seqno)++;
+  if (n == 65536) {
+    /* every number is in use, treat it as lost and try again after the timeout */
+    target->sequence = 0;
+    return;
+  }
+
+  len = make_qdp_ping(&ping, (target->state == QDP_INFO), *seqno);
+
+  target->sequence = *seqno;
+  pending[*seqno] = index;
+  (*seqno)++;
+
+  /* a failed send is treated as a lost packet and retried after the timeout */
+  (void) sendto(sockfd, (char *) &ping, len, 0, (struct sockaddr *) &target->sin, sizeof(struct sockaddr_in));
+}
+
+/*
+ * discover_qdp: query many q330s concurrently over one non-blocking socket
+ *
+ * Each target is first asked for its serial number and then for its status,
+ * with at most "inflight" targets, up to QDP_MAXINFLIGHT, outstanding at any
+ * one time. Replies are matched to targets by the acknowledged sequence
+ * number. Requests are resent up to "retries" times if no reply arrives within
+ * "timeout" milliseconds.
+ *
+ * Returns the number of targets found, or -1 on a socket error.
+ */
+int discover_qdp(qdp_target *targets, int count, int inflight, int retries, int timeout) {
+  int i, n;
+  int state;
+  int sockfd;
+  int bufsize;
+  int *pending;
+  int active = 0, next = 0, left = count, found = 0;
+  u_int16_t seqno = 1;
+
+  qdp ping;
+  qdp_target *q;
+  double t;
+
+  struct pollfd pfd;
+  struct sockaddr_in sin;
+  struct addrinfo hints, *res;
+
+  if (count <= 0)
+    return 0;
+  if (inflight < 1)
+    inflight = 1;
+  if (inflight > QDP_MAXINFLIGHT)
+    inflight = QDP_MAXINFLIGHT;
+
+  /* target index by outstanding sequence number */
+  if ((pending = (int *) malloc(65536 * sizeof(int))) == NULL) {
+    ms_log(2, "can't allocate discovery table\n"); return -1;
+  }
+  for (i = 0; i < 65536; i++)
+    pending[i] = -1;
+
+  /* bind local socket ... */
+  memset((char *) &sin, 0, sizeof(struct sockaddr_in));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  sin.sin_port = htons(0);
+
+  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    ms_log(2, "can't create local socket [%s]\n", strerror(errno)); free(pending); return -1;
+  }
+  if (((state = fcntl(sockfd, F_GETFL, 0)) < 0) || (fcntl(sockfd, F_SETFL, state | O_NONBLOCK) < 0)) {
+    ms_log(2, "could not set socket non-blocking [%s]\n", strerror(errno)); close(sockfd); free(pending); return -1;
+  }
+  if (bind(sockfd, (struct sockaddr *) &sin, sizeof(struct sockaddr_in)) < 0) {
+    ms_log(2, "can't bind local socket address [%s]\n", strerror(errno)); close(sockfd); free(pending); return -1;
+  }
+
+  /* replies can arrive in bursts */
+  bufsize = 1024 * 1024;
+  (void) setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+  /* resolve everything up front */
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  for (i = 0; i < count; i++) {
+    q = &targets[i];
+    q->state = QDP_IDLE;
+    q->tries = 0;
+    q->serial = 0LL;
+    if (getaddrinfo(q->ipaddr, NULL, &hints, &res) != 0) {
+      ms_log(1, "unable to resolve %s\n", q->ipaddr);
+      q->state = QDP_NOREPLY; left--;
+      continue;
+    }
+    memset((char *) &q->sin, 0, sizeof(struct sockaddr_in));
+    q->sin.sin_family = AF_INET;
+    q->sin.sin_addr.s_addr = ((struct sockaddr_in *)(res->ai_addr))->sin_addr.s_addr;
+    q->sin.sin_port = htons(q->port);
+    freeaddrinfo(res);
+  }
+
+  while (left > 0) {
+
+    /* keep the window full */
+    while ((active < inflight) && (next < count)) {
+      q = &targets[next];
+      if (q->state == QDP_IDLE) {
+        q->state = QDP_INFO;
+        qdp_request(sockfd, q, next, &seqno, pending);
+        active++;
+      }
+      next++;
+    }
+
+    /* wait for something to arrive */
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    if ((poll(&pfd, 1, 50) < 0) && (errno != EINTR)) {
+      ms_log(2, "discovery poll failed [%s]\n", strerror(errno)); found = -1; break;
+    }
+
+    while ((n = recv_qdp_ping_from(sockfd, &ping, &sin)) > 0) {
+      if ((ping.command != C1_PING) || ((i = pending[ping.acknowledge]) < 0))
+        continue;
+
+      q = &targets[i];
+      if (q->sin.sin_addr.s_addr != sin.sin_addr.s_addr)
+        continue;
+
+      if ((q->state == QDP_INFO) && (ping.ping_type == 5)) {
+        pending[ping.acknowledge] = -1;
+        q->serial = ((unsigned long long) ping.data.info.serial_high << 32) | ping.data.info.serial_low;
+        q->state = QDP_STATUS;
+        q->tries = 0;
+        qdp_request(sockfd, q, i, &seqno, pending);
+      }
+      else if ((q->state == QDP_STATUS) && (ping.ping_type == 3)) {
+        pending[ping.acknowledge] = -1;
+        memcpy(&q->status, &ping, sizeof(qdp));
+        q->state = QDP_FOUND;
+        active--; left--; found++;
+      }
+    }
+    if (n < 0) {
+      ms_log(2, "discovery receive failed [%s]\n", strerror(errno)); found = -1; break;
+    }
+
+    /* retry, or give up on, anything that has timed out */
+    t = qdp_now();
+    for (i = 0; i < next; i++) {
+      q = &targets[i];
+      if ((q->state != QDP_INFO) && (q->state != QDP_STATUS))
+        continue;
+      if (((t - q->sent) * 1000.0) < (double) timeout)
+        continue;
+      pending[q->sequence] = -1;
+      if (q->tries <= retries) {
+        qdp_request(sockfd, q, i, &seqno, pending);
+      }
+      else {
+        q->state = QDP_NOREPLY;
+        active--; left--;
+      }
+    }
+  }
+
+  close(sockfd);
+  free(pending);
+
+  return found;
+}
+
+/*
+ * expand_qdp_targets: build a target list from a comma separated list of
+ * addresses or subnets, each with an optional port, e.g.
+ *
+ *   10.0.0.0/24,192.168.1.20:6330
+ *
+ * Network and broadcast addresses are skipped for subnets larger than
+ * a /31, subnets smaller than a /16 are refused.
+ *
+ * Returns the number of targets, which must be freed by the caller, or -1 on error.
+ */
+int expand_qdp_targets(char *spec, int port, qdp_target **targets) {
+  int n = 0, max = 0;
+  int bits, tport, subnet;
+  u_int32_t base, first, last, a;
+  char *list, *item, *save, *p;
+  struct in_addr in;
+  qdp_target *t = NULL, *tmp;
+
+  *targets = NULL;
+  if ((list = strdup(spec)) == NULL)
+    return -1;
+
+  for (item = strtok_r(list, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+    tport = port;
+    if ((p = strrchr(item, ':')) != NULL) {
+      *p++ = '\0'; tport = atoi(p);
+    }
+    bits = 32; subnet = 0;
+    if ((p = strchr(item, '/')) != NULL) {
+      *p++ = '\0'; bits = atoi(p); subnet = 1;
+      if ((bits < 16) || (bits > 32) || (inet_aton(item, &in) == 0)) {
+        ms_log(2, "invalid subnet: %s/%s\n", item, p); free(list); free(t); return -1;
+      }
+      base = ntohl(in.s_addr) & ((bits == 32) ? 0xffffffff : ~(0xffffffff >> bits));
+      first = base; last = base | ((bits == 32) ? 0 : (0xffffffff >> bits));
+      if (bits < 31) {
+        first++; last--;
+      }
+    }
+    else {
+      first = last = 0;
+    }
+
+    for (a = first; ; a++) {
+      if (n >= max) {
+        max = (max) ? max * 2 : 256;
+        if ((tmp = (qdp_target *) realloc(t, max * sizeof(qdp_target))) == NULL) {
+          free(list); free(t); return -1;
+        }
+        t = tmp;
+      }
+      memset(&t[n], 0, sizeof(qdp_target));
+      if (subnet) {
+        in.s_addr = htonl(a);
+        strncpy(t[n].ipaddr, inet_ntoa(in), sizeof(t[n].ipaddr) - 1);
+      }
+      else {
+        strncpy(t[n].ipaddr, item, sizeof(t[n].ipaddr) - 1);
+      }
+      t[n].port = tport;
+      n++;
+      if (a == last)
+        break;
+    }
+  }
+
+  free(list);
+  *targets = t;
+
+  return n;
+}
+
+/* run a discovery and log what was found, used by the --discover mode */
+int discover_report(char *spec, int port, int inflight, int retries, int timeout) {
+  int i, n, found;
+  qdp_target *targets;
+
+  if ((n = expand_qdp_targets(spec, port, &targets)) <= 0)
+    return -1;
+
+  if ((found = discover_qdp(targets, n, inflight, retries, timeout)) >= 0) {
+    for (i = 0; i < n; i++) {
+      if (targets[i].state != QDP_FOUND)
+        continue;
+      ms_log(0, "%s:%d serial 0x%016llx clock_qual %u clock_loss %u sats %u/%u supply %.2fV temp %dC\n",
+        targets[i].ipaddr, targets[i].port, targets[i].serial,
+        targets[i].status.global.clock_qual, targets[i].status.global.clock_loss,
+        targets[i].status.gps.sat_used, targets[i].status.gps.sat_view,
+        (double) targets[i].status.boom.supply * 0.150, targets[i].status.boom.sys_temp);
+    }
+  }
+
+  free(targets);
+
+  return found;
+}
@@ -234,5 +234,31 @@ typedef struct _ping {
 
 int send_qdp_ping(int sockfd, char *ipaddr, int ipport, int serial);
 int recv_qdp_ping(int sockfd, qdp *ping); // char **ipaddr, int *ipport);
+int recv_qdp_ping_from(int sockfd, qdp *ping, struct sockaddr_in *from);
+
+/* discovery target states */
+#define QDP_IDLE 0 /* not yet queried */
+#define QDP_INFO 1 /* waiting for the serial number */
+#define QDP_STATUS 2 /* waiting for the status */
+#define QDP_FOUND 3 /* serial number and status known */
+#define QDP_NOREPLY -1 /* unresolved or no reply after all retries */
+
+#define QDP_MAXINFLIGHT 4096 /* well short of the sequence numbers available */
+
+typedef struct qdp_target {
+	char ipaddr[64]; /* address to query */
+	int port; /* base udp port */
+	int state; /* one of the QDP_XXX states */
+	int tries; /* requests sent in the current state */
+	u_int16_t sequence; /* outstanding request sequence */
+	double sent; /* when it was sent */
+	struct sockaddr_in sin; /* resolved address */
+	unsigned long long serial; /* from the info reply */
+	qdp status; /* decoded status reply */
+} qdp_target;
+
+int discover_qdp(qdp_target *targets, int count, int inflight, int retries, int timeout);
+int expand_qdp_targets(char *spec, int port, qdp_target **targets);
+int discover_report(char *spec, int port, int inflight, int retries, int timeout);
 
 #endif // _PING_H_
@@ -0,0 +1,1418 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * q330sim: a local Q330 simulator for end-to-end throughput and soak testing.
+ *
+ * Each simulated digitiser answers QDP over UDP on its own block of ports,
+ * baseport + 10 * n, with the configuration port at the base and the control
+ * and data ports of the one logical port it serves at the usual offsets. It
+ * answers registration with the same MD5 challenge lib330 calculates, serves
+ * fixed values, global programming, the logical port and DP tokens, and then
+ * streams synthetic DC_COMP (and for 100 and 200 sps, DC_MULT) blockettes
+ * through a sliding window that honours DT_DACK and resends on timeout.
+ *
+ * Packet loss and reordering can be injected on the data port, token segments
+ * can come back as the wrong one, every packet sent can be held back to stand in for a long link, a backlog of older
+ * seconds is queued at startup, and SIGUSR1 drops every registration at once
+ * to provoke a reconnect storm. Point quant2dali at 127.0.0.2 (or any
+ * loopback address other than 127.0.0.1, which lib330 treats as a baler).
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* lib330 library includes */
+#include <libtypes.h>
+#include <libstrucs.h>
+#include <libsupport.h>
+#include <libcvrt.h>
+#include <libmd5.h>
+#include <libslider.h>
+#include <libtokens.h>
+#include <q330cvrt.h>
+
+#define SIM_PORTS 10 /* udp ports reserved for each simulated q330 */
+#define SIM_PAYLOAD 512 /* largest data packet payload generated */
+#define SIM_SEGMENT 256 /* largest blockette before a second is split into DC_MULT segments */
+#define SIM_RING 256 /* outstanding packets, indexed by the low byte of the sequence */
+#define LCQS 5 /* lcqs per channel, each with its own location code */
+#define SIM_HOLD 0.1 /* seconds a reordered packet is held back */
+#define SIM_SIGNAL 0.5 /* frequency of the synthetic signal */
+#define SIM_CLOCK 0xC5 /* pll locked, 3d fix */
+#define SIM_SYSVER 0x0168 /* reported system software version */
+
+/* which of the three sockets a packet arrived on */
+#define SIM_CONFIG 0
+#define SIM_CONTROL 1
+#define SIM_DATA 2
+
+#define PROGRAM_NAME "q330sim"
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION "unknown"
+#endif
+
+typedef struct sim_packet {
+  struct sim_packet *next;
+  int size; /* payload bytes */
+  double sent; /* last transmission, zero if never */
+  int acked;
+  byte qdp[QDP_HDR_LTH + MAXDATA];
+} sim_packet;
+
+typedef struct sim_station {
+  int index;
+  t64 serial;
+  char name[8];
+  word ports[3]; /* config, control, and data */
+  int socks[3];
+
+  int registered;
+  int dataopen;
+  struct sockaddr_in data_addr;
+  t64 challenge;
+  word cmdseq;
+  tlog log;
+
+  byte tokens[MAXCFG];
+  int token_size;
+
+  longword sec_offset; /* dsn + sec_offset = seconds since 2000 */
+  longword dsn;
+  longint last[CHANNELS]; /* last sample of the previous second */
+
+  sim_packet *head, *tail; /* generated but not yet sent */
+  int queued;
+  sim_packet *ring[SIM_RING]; /* sent but not yet acknowledged */
+  word base; /* oldest unacknowledged sequence */
+  word next; /* next sequence to assign */
+  sim_packet *held; /* reordered, sent after the next packet */
+  double held_at;
+
+  unsigned long long sent, resent, dropped, reordered, acked, overflow, registrations;
+} sim_station;
+
+/* a packet held back by the link delay */
+typedef struct sim_delayed {
+  struct sim_delayed *next;
+  double due;
+  int sock;
+  struct sockaddr_in to;
+  int size;
+  byte buf[QDP_HDR_LTH + MAXDATA];
+} sim_delayed;
+
+static int baseport = 5330;
+static int count = 1;
+static unsigned long long serial = 0x0100000000001000LL;
+static unsigned long long authcode = 0LL;
+static int lport = 1;
+static char *network = "XX";
+static char *prefix = "SIM";
+static int channels = 3;
+static int lcqs = 1;
+static int rate = 100;
+static int amplitude = 2000;
+static int window = 8;
+static double loss = 0.0;
+static double reorder = 0.0;
+static int backlog = 0;
+static int capacity = 4096;
+static int resend = 1000;
+static int delay = 0;
+static int token_pad = 0;
+static double garble = 0.0;
+static int verbose = 0;
+
+static int freqbit;
+static volatile sig_atomic_t going = 1;
+static volatile sig_atomic_t storm = 0;
+
+static crc_table_type crc_table;
+static pq330 md5ctx; /* only the md5 working buffer is used */
+static tmem_manager md5mem;
+static double started;
+
+static sim_delayed *delay_head = NULL, *delay_tail = NULL; /* in the order they are due */
+
+static int stat_size[SRB_FES + 1]; /* fixed length status blocks */
+static int fixed_size, global_size, gps2_size, man_size, dcp_size;
+
+static void term_handler(int sig) {
+  going = 0;
+}
+
+static void storm_handler(int sig) {
+  storm = 1;
+}
+
+static int sim_freqbit(int sps) {
+  switch (sps) {
+  case 1: return 0;
+  case 10: return 1;
+  case 20: return 2;
+  case 40: return 3;
+  case 50: return 4;
+  case 100: return 5;
+  case 200: return 6;
+  }
+  return -1;
+}
+
+/* the size of each fixed length structure, straight from the lib330 decoders */
+static void sim_measure(void) {
+  static byte zero[MAXDATA];
+  static union {
+    tstat_global glob; tstat_gps gps; tstat_pwr pwr; tstat_boom boom; tstat_pll pll;
+    tstat_log log; tstat_serial ser; tstat_ether eth; tstat_baler bal; tdyn_ips dyn; tstat_ep ep;
+    tfixed fix; tglobal global; tgps2 gps2; tman man; tdcp dcp;
+  } u;
+  pbyte p;
+  int bit;
+
+#define MEASURE(size, call) do { p = zero; call; size = (int)(p - zero); } while (0)
+  MEASURE(stat_size[SRB_GLB], loadglobalstat(&p, &u.glob));
+  MEASURE(stat_size[SRB_GST], loadgpsstat(&p, &u.gps));
+  MEASURE(stat_size[SRB_PWR], loadpwrstat(&p, &u.pwr));
+  MEASURE(stat_size[SRB_BOOM], loadboomstat(&p, &u.boom, FALSE));
+  MEASURE(stat_size[SRB_PLL], loadpllstat(&p, &u.pll));
+  for (bit = SRB_LOG1; bit <= SRB_LOG4; bit++)
+    MEASURE(stat_size[bit], loadlogstat(&p, &u.log));
+  for (bit = SRB_SER1; bit <= SRB_SER3; bit++)
+    MEASURE(stat_size[bit], loadserstat(&p, &u.ser));
+  MEASURE(stat_size[SRB_ETH], loadethstat(&p, &u.eth));
+  MEASURE(stat_size[SRB_BALER], loadbalestat(&p, &u.bal));
+  MEASURE(stat_size[SRB_DYN], loaddynstat(&p, &u.dyn));
+  MEASURE(stat_size[SRB_EP], loadepstat(&p, &u.ep));
+  stat_size[SRB_GSAT] = stat_size[SRB_ARP] = stat_size[SRB_SS] = 4; /* empty lists */
+  stat_size[SRB_AUX] = 8;
+  MEASURE(fixed_size, loadfix(&p, &u.fix));
+  MEASURE(global_size, loadglob(&p, &u.global));
+  MEASURE(gps2_size, loadgps2(&p, &u.gps2));
+  MEASURE(man_size, loadman(&p, &u.man));
+  MEASURE(dcp_size, loaddcp(&p, &u.dcp));
+#undef MEASURE
+}
+
+static void store64(pbyte *p, t64 *v) {
+#ifdef ENDIAN_LITTLE
+  storelongword(p, (*v)[1]);
+  storelongword(p, (*v)[0]);
+#else
+  storelongword(p, (*v)[0]);
+  storelongword(p, (*v)[1]);
+#endif
+}
+
+static void load64(pbyte *p, t64 *v) {
+#ifdef ENDIAN_LITTLE
+  (*v)[1] = loadlongword(p);
+  (*v)[0] = loadlongword(p);
+#else
+  (*v)[0] = loadlongword(p);
+  (*v)[1] = loadlongword(p);
+#endif
+}
+
+/* checks the length and crc of an incoming packet */
+static int sim_valid(byte *buf, int size, tqdp *hdr) {
+  pbyte p = buf;
+
+  if (size < QDP_HDR_LTH)
+    return 0;
+  loadqdphdr(&p, hdr);
+  if ((hdr->datalength > MAXDATA) || ((QDP_HDR_LTH + hdr->datalength) > size))
+    return 0;
+
+  return (gcrccalc(&crc_table, buf + 4, QDP_HDR_LTH + hdr->datalength - 4) == hdr->crc);
+}
+
+/* fills in the header and crc of a packet whose payload is already in place */
+static int sim_seal(byte *buf, byte cmd, int size, word seq, word ack) {
+  pbyte p = buf;
+
+  storeqdphdr(&p, cmd, size, seq, ack);
+  p = buf;
+  storelongint(&p, gcrccalc(&crc_table, buf + 4, QDP_HDR_LTH + size - 4));
+
+  return QDP_HDR_LTH + size;
+}
+
+/* every packet goes out through here, after the link delay if there is one */
+static void sim_send(int sock, byte *buf, int size, struct sockaddr_in *to) {
+  sim_delayed *d;
+
+  if (delay <= 0) {
+    (void) sendto(sock, buf, size, 0, (struct sockaddr *) to, sizeof(struct sockaddr_in));
+    return;
+  }
+  if ((d = (sim_delayed *) malloc(sizeof(sim_delayed))) == NULL)
+    return; /* as good as lost on the link */
+  d->next = NULL;
+  d->due = now() + delay / 1000.0;
+  d->sock = sock;
+  d->to = *to;
+  d->size = size;
+  memcpy(d->buf, buf, size);
+  if (delay_tail != NULL)
+    delay_tail->next = d;
+  else
+    delay_head = d;
+  delay_tail = d;
+}
+
+static void sim_flush(double t) {
+  sim_delayed *d;
+
+  while ((delay_head != NULL) && (delay_head->due <= t)) {
+    d = delay_head;
+    if ((delay_head = d->next) == NULL)
+      delay_tail = NULL;
+    (void) sendto(d->sock, d->buf, d->size, 0, (struct sockaddr *) &d->to, sizeof(struct sockaddr_in));
+    free(d);
+  }
+}
+
+static void sim_reply(sim_station *st, int which, struct sockaddr_in *to, byte cmd, word ack, byte *payload, int size) {
+  byte buf[QDP_HDR_LTH + MAXDATA];
+  int len;
+
+  memcpy(buf + QDP_HDR_LTH, payload, size);
+  len = sim_seal(buf, cmd, size, st->cmdseq++, ack);
+  sim_send(st->socks[which], buf, len, to);
+}
+
+static void sim_error(sim_station *st, int which, struct sockaddr_in *to, word ack, word code) {
+  byte buf[2];
+  pbyte p = buf;
+
+  storeword(&p, code);
+  sim_reply(st, which, to, C1_CERR, ack, buf, 2);
+}
+
+/* the dp tokens: version, network and station, lcqs per channel each under
+   its own location code, and optionally opaque configuration to bring them
+   up to token_pad bytes */
+static void sim_tokens(sim_station *st) {
+  char loc[3], seed[4], net[3], sta[6];
+  pbyte p = st->tokens, pref;
+  int c, l, size;
+
+  snprintf(net, sizeof(net), "%-2.2s", network);
+  snprintf(sta, sizeof(sta), "%-5.5s", st->name);
+
+  storebyte(&p, TF_VERSION);
+  storebyte(&p, T_VER);
+  storebyte(&p, TF_NET_STAT);
+  storeblock(&p, 2, net);
+  storeblock(&p, 5, sta);
+  for (l = 0; l < lcqs; l++)
+    for (c = 0; c < channels; c++) {
+      snprintf(loc, sizeof(loc), (l == 0) ? "  " : "%d0", l);
+      snprintf(seed, sizeof(seed), "%s%c", (rate >= 80) ? "HH" : ((rate >= 10) ? "BH" : "LH"), "ZNE123"[c]);
+      storebyte(&p, T1_LCQ);
+      pref = p;
+      storebyte(&p, 0); /* filled in below */
+      storeblock(&p, 2, loc);
+      storeblock(&p, 3, seed);
+      storebyte(&p, l * channels + c + 1);
+      storebyte(&p, DC_D32 | c);
+      storebyte(&p, freqbit);
+      storelongword(&p, 0);
+      storeint16(&p, rate);
+      *pref = (byte)(p - pref);
+    }
+  if ((token_pad - (int)(p - st->tokens)) > 3) {
+    storebyte(&p, T2_OPAQUE);
+    size = token_pad - (int)(p - st->tokens); /* counts the length word */
+    storeword(&p, size);
+    memset(p, 0, size - 2);
+    p += size - 2;
+  }
+  st->token_size = (int)(p - st->tokens);
+}
+
+/* mirrors loadfix */
+static void sim_fixed(sim_station *st, pbyte *p) {
+  longword lw;
+  int i;
+
+  storelongword(p, (longword) started); /* last reboot */
+  storelongword(p, 1); /* reboots */
+  storelongword(p, 0); /* backup map */
+  storelongword(p, 0); /* default map */
+  storeword(p, 0); /* cal type */
+  storeword(p, 0); /* cal version */
+  storeword(p, 0); /* aux type */
+  storeword(p, 0); /* aux version */
+  storeword(p, 0); /* clock type */
+  storeword(p, 0); /* flags */
+  storeword(p, SIM_SYSVER);
+  storeword(p, 0); /* slave processor version */
+  storeword(p, 0); /* pld version */
+  storeword(p, 0); /* memory block size */
+  storelongword(p, st->index); /* property tag */
+  store64(p, &st->serial);
+  for (i = 0; i < 6; i++)
+    storelongword(p, 0); /* amb, seismometer 1 and 2 serial numbers */
+  for (i = 0; i < 7; i++)
+    storelongword(p, 0); /* qapchp1, memory sizes, qapchp2 */
+  lw = (longword) capacity * SIM_PAYLOAD;
+  for (i = LP_TEL1; i <= LP_TEL4; i++)
+    storelongword(p, lw);
+  for (i = 0; i < 8; i++)
+    storebyte(p, 0); /* freq7 to freq0 */
+  for (i = 0; i < 2 * FREQUENCIES; i++)
+    storelongint(p, 0); /* channel 1-3 and 4-6 delays */
+}
+
+/* mirrors loadglob */
+static void sim_global(pbyte *p) {
+  int i, j;
+
+  storeword(p, 0); /* clock timeout */
+  storeword(p, 2048); /* initial vco */
+  storeword(p, 0); /* gps backup */
+  storeword(p, 0); /* sample rates */
+  storeword(p, 0); /* gain map */
+  storeword(p, 0); /* filter map */
+  storeword(p, 0); /* input map */
+  storeword(p, 80); /* web port */
+  storeword(p, 0); /* server timeout */
+  storeword(p, 10); /* drift tolerance */
+  storeword(p, 200); /* jump filter */
+  storeword(p, 1000); /* jump threshold */
+  storeint16(p, 0); /* cal offset */
+  storeword(p, 0); /* sensor map */
+  storeword(p, 0); /* sampling phase */
+  storeword(p, 0); /* gps cold */
+  storelongword(p, 0); /* user tag */
+  for (i = 0; i < CHANNELS; i++)
+    for (j = 0; j < FREQUENCIES; j++)
+      storeint16(p, 0);
+  for (i = 0; i < CHANNELS; i++)
+    storeint16(p, 0); /* offsets */
+  for (i = 0; i < CHANNELS; i++)
+    storeint16(p, 0); /* gains */
+  storelongword(p, 0); /* message map */
+}
+
+/* writes the requested status blocks in bit order, returns those written, the rest are asked for again */
+static longword sim_status(sim_station *st, longword bitmap, pbyte *p, pbyte limit) {
+  longword done = 0;
+  int bit;
+
+  for (bit = SRB_GLB; bit <= SRB_EP; bit++) {
+    if (((bitmap & (1 << bit)) == 0) || ((*p + stat_size[bit]) > limit))
+      continue;
+    switch (bit) {
+    case SRB_GLB:
+      storeword(p, 0); /* acquisition control */
+      storeword(p, SIM_CLOCK);
+      storeword(p, 0); /* clock loss */
+      storeword(p, 0); /* current voltage */
+      storelongword(p, st->sec_offset);
+      storelongword(p, 0); /* usec offset */
+      storelongword(p, (longword)(now() - started)); /* total time */
+      storelongword(p, (longword)(now() - started)); /* power on time */
+      storelongword(p, 0); /* last resync */
+      storelongword(p, 0); /* resyncs */
+      storeword(p, 0); /* gps status */
+      storeword(p, 0); /* calibrator status */
+      storeword(p, 0); /* sensor map */
+      storeword(p, 2048); /* current vco */
+      storeword(p, st->next); /* data sequence */
+      storeword(p, 0); /* pll flag */
+      storeword(p, 0); /* status inputs */
+      storeword(p, 0); /* misc inputs */
+      storelongword(p, st->dsn);
+      break;
+    case SRB_LOG1:
+    case SRB_LOG2:
+    case SRB_LOG3:
+    case SRB_LOG4:
+      storelongword(p, st->sent);
+      storelongword(p, st->resent);
+      storelongword(p, 0); /* fill */
+      storelongword(p, 0); /* sequence errors */
+      storelongword(p, st->queued * SIM_PAYLOAD); /* packet buffer used */
+      storelongword(p, 0); /* last ack */
+      storeword(p, PP_ETH);
+      storeword(p, bit - SRB_LOG1);
+      storeword(p, resend / 100);
+      storeword(p, 0); /* flags */
+      break;
+    case SRB_GSAT:
+    case SRB_ARP:
+      storeword(p, 0); /* none */
+      storeword(p, 4); /* block size */
+      break;
+    case SRB_AUX:
+      storeword(p, 8); /* header only */
+      storeword(p, 0);
+      storeword(p, 0);
+      storeword(p, 0);
+      break;
+    case SRB_SS:
+      storeword(p, 4);
+      storeword(p, 0);
+      break;
+    case SRB_THR:
+      break; /* nothing is sent for the thread status */
+    default:
+      if ((bit == SRB_FES) || (stat_size[bit] == 0))
+        continue;
+      memset(*p, 0, stat_size[bit]);
+      *p += stat_size[bit];
+      break;
+    }
+    done |= (1 << bit);
+  }
+
+  return done;
+}
+
+static void sim_ping(sim_station *st, int which, struct sockaddr_in *from, tqdp *hdr, pbyte p) {
+  byte buf[MAXDATA];
+  pbyte q = buf + 8;
+  tpinghdr ping;
+  longword bitmap;
+  int i;
+
+  loadpinghdr(&p, &ping);
+  switch (ping.ping_type) {
+  case 0: /* echo whatever came with it */
+    ping.ping_type = 1;
+    memcpy(buf, p - 4, hdr->datalength);
+    q = buf + hdr->datalength;
+    break;
+  case 2:
+    bitmap = loadlongword(&p);
+    ping.ping_type = 3;
+    q = buf + 4;
+    storeword(&q, 10); /* drift tolerance */
+    storeword(&q, 0); /* user messages */
+    storelongword(&q, (longword) started);
+    storelongint(&q, 0);
+    storelongint(&q, 0);
+    q += 4;
+    bitmap = sim_status(st, bitmap, &q, buf + MAXDATA);
+    p = buf + 20;
+    storelongword(&p, bitmap);
+    break;
+  case 4:
+    ping.ping_type = 5;
+    q = buf + 4;
+    storeword(&q, 0x0100); /* version */
+    storeword(&q, 0); /* flags */
+    storelongword(&q, st->index); /* tag */
+    store64(&q, &st->serial);
+    for (i = LP_TEL1; i <= LP_TEL4; i++)
+      storelongword(&q, (longword) capacity * SIM_PAYLOAD);
+    for (i = 0; i < 3 * (PP_ETH - PP_SER1 + 1); i++)
+      storelongword(&q, 0); /* triggers, advertising flags, data ports */
+    storeword(&q, 0); /* calibration errors */
+    storeword(&q, SIM_SYSVER);
+    break;
+  default:
+    return;
+  }
+  p = buf;
+  storepinghdr(&p, &ping);
+  sim_reply(st, which, from, C1_PING, hdr->sequence, buf, (int)(q - buf));
+}
+
+/* hands every unacknowledged packet back to the queue, the next session resends them */
+static void sim_requeue(sim_station *st) {
+  sim_packet *pkt, *first = NULL, *last = NULL;
+  word s;
+
+  for (s = st->base; s != st->next; s++) {
+    pkt = st->ring[s & (SIM_RING - 1)];
+    st->ring[s & (SIM_RING - 1)] = NULL;
+    if (pkt == NULL)
+      continue;
+    if (pkt->acked) {
+      free(pkt);
+      continue;
+    }
+    pkt->sent = 0.0;
+    pkt->next = NULL;
+    if (last)
+      last->next = pkt;
+    else
+      first = pkt;
+    last = pkt;
+    st->queued++;
+  }
+  if (last) {
+    last->next = st->head;
+    if (st->head == NULL)
+      st->tail = last;
+    st->head = first;
+  }
+  st->next = st->base;
+  st->held = NULL;
+}
+
+static void sim_drop(sim_station *st) {
+  st->registered = 0;
+  st->dataopen = 0;
+  sim_requeue(st);
+}
+
+static void sim_register(sim_station *st, struct sockaddr_in *from, tqdp *hdr, pbyte p) {
+  tsrvresp resp;
+  t64 md5equiv;
+  t128 md5;
+  string250 s;
+  string63 s1;
+  int i;
+
+  load64(&p, &resp.serial);
+  load64(&p, &resp.challenge);
+  resp.dpip = loadlongword(&p);
+  resp.dpport = loadword(&p);
+  resp.dpreg = loadword(&p);
+  load64(&p, &resp.counter_chal);
+  for (i = 0; i < 4; i++)
+    resp.md5result[i] = loadlongword(&p);
+
+  if (memcmp(resp.serial, st->serial, sizeof(t64)) != 0)
+    return;
+  if (memcmp(resp.challenge, st->challenge, sizeof(t64)) != 0) {
+    sim_error(st, SIM_CONTROL, from, hdr->sequence, CERR_INVREG);
+    return;
+  }
+
+#ifdef ENDIAN_LITTLE
+  md5equiv[1] = resp.dpip;
+  md5equiv[0] = ((longword) resp.dpport << 16) | resp.dpreg;
+#else
+  md5equiv[0] = resp.dpip;
+  md5equiv[1] = ((longword) resp.dpport << 16) | resp.dpreg;
+#endif
+  strcpy(s, dig2str(&resp.challenge, &s1));
+  strcat(s, dig2str(&md5equiv, &s1));
+  memcpy(md5equiv, &authcode, sizeof(t64));
+  strcat(s, dig2str(&md5equiv, &s1));
+  strcat(s, dig2str(&st->serial, &s1));
+  strcat(s, dig2str(&resp.counter_chal, &s1));
+  calcmd5(md5ctx, &s, &md5);
+  if (memcmp(md5, resp.md5result, sizeof(t128)) != 0) {
+    if (verbose)
+      fprintf(stderr, "%s: %s md5 mismatch, check the auth code\n", PROGRAM_NAME, st->name);
+    sim_error(st, SIM_CONTROL, from, hdr->sequence, CERR_INVREG);
+    return;
+  }
+
+  /* a new session replaces any previous one */
+  sim_drop(st);
+  st->registered = 1;
+  st->registrations++;
+  if (verbose)
+    fprintf(stderr, "%s: %s registered from %s:%d\n", PROGRAM_NAME, st->name,
+            inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+  sim_reply(st, SIM_CONTROL, from, C1_CACK, hdr->sequence, NULL, 0);
+}
+
+static void sim_memory(sim_station *st, struct sockaddr_in *from, tqdp *hdr, pbyte p) {
+  byte buf[MAXDATA];
+  pbyte q = buf;
+  tmem mem;
+  int segnum, segtotal, size;
+
+  loadmemhdr(&p, &mem);
+  if (mem.memtype != (MT_CFG1 + lport - 1)) {
+    sim_error(st, SIM_CONTROL, from, hdr->sequence, CERR_SNV);
+    return;
+  }
+  segnum = mem.start / (MAXSEG + OVERHEAD) + 1;
+  segtotal = (st->token_size + MAXSEG - 1) / MAXSEG;
+  if (segnum > segtotal) {
+    sim_error(st, SIM_CONTROL, from, hdr->sequence, CERR_PAR);
+    return;
+  }
+  /* answer with the one after, as a confused or replayed reply would */
+  if ((garble > 0.0) && ((drand48() * 100.0) < garble))
+    segnum = (segnum % segtotal) + 1;
+  size = st->token_size - (segnum - 1) * MAXSEG;
+  if (size > MAXSEG)
+    size = MAXSEG;
+
+  storelongword(&q, mem.start);
+  storeword(&q, size + 4);
+  storeword(&q, mem.memtype);
+  storeword(&q, segnum);
+  storeword(&q, segtotal);
+  storeblock(&q, size, st->tokens + (segnum - 1) * MAXSEG);
+  sim_reply(st, SIM_CONTROL, from, C1_MEM, hdr->sequence, buf, (int)(q - buf));
+}
+
+static void sim_control(sim_station *st, int which, byte *msg, int len, struct sockaddr_in *from) {
+  byte buf[MAXDATA];
+  pbyte p, q = buf;
+  tqdp hdr;
+  tlog log;
+  string s;
+  longword bitmap;
+  int i;
+
+  if (!sim_valid(msg, len, &hdr))
+    return;
+  p = msg + QDP_HDR_LTH;
+
+  if (hdr.command == C1_PING) {
+    sim_ping(st, which, from, &hdr, p);
+    return;
+  }
+  if (which != SIM_CONTROL)
+    return;
+
+  switch (hdr.command) {
+  case C1_RQSRV:
+    load64(&p, (t64 *) buf);
+    if (memcmp(buf, st->serial, sizeof(t64)) != 0)
+      return; /* not for us, a real q330 stays quiet */
+    st->challenge[0] = ((longword) random() << 16) ^ (longword) random();
+    st->challenge[1] = ((longword) random() << 16) ^ (longword) random();
+    store64(&q, &st->challenge);
+    storelongword(&q, ntohl(from->sin_addr.s_addr));
+    storeword(&q, ntohs(from->sin_port));
+    storeword(&q, 0);
+    sim_reply(st, which, from, C1_SRVCH, hdr.sequence, buf, (int)(q - buf));
+    return;
+  case C1_SRVRSP:
+    sim_register(st, from, &hdr, p);
+    return;
+  case C1_POLLSN:
+    store64(&q, &st->serial);
+    storelongword(&q, st->index);
+    storelongword(&q, 0);
+    sim_reply(st, which, from, C1_MYSN, hdr.sequence, buf, (int)(q - buf));
+    return;
+  }
+
+  if (!st->registered) {
+    sim_error(st, which, from, hdr.sequence, CERR_NOTR);
+    return;
+  }
+
+  switch (hdr.command) {
+  case C1_DSRV:
+    sim_drop(st);
+    if (verbose)
+      fprintf(stderr, "%s: %s deregistered\n", PROGRAM_NAME, st->name);
+    sim_reply(st, which, from, C1_CACK, hdr.sequence, NULL, 0);
+    break;
+  case C1_RQFGLS:
+    q = buf + 8;
+    sim_fixed(st, &q);
+    i = (int)(q - buf);
+    sim_global(&q);
+    p = buf;
+    storeword(&p, i);
+    storeword(&p, i + global_size);
+    storeword(&p, i + global_size + 32);
+    storeword(&p, 0);
+    for (i = 0; i < 8; i++)
+      storelongword(&q, 0); /* sensor control */
+    st->log.dataseq = st->base;
+    storeslog(&q, &st->log);
+    sim_reply(st, which, from, C1_FGLS, hdr.sequence, buf, (int)(q - buf));
+    break;
+  case C1_RQLOG:
+    st->log.dataseq = st->base;
+    storeslog(&q, &st->log);
+    sim_reply(st, which, from, C1_LOG, hdr.sequence, buf, (int)(q - buf));
+    break;
+  case C1_SLOG:
+    loadlog(&p, &log);
+    log.lport = st->log.lport;
+    log.dataseq = st->log.dataseq;
+    if ((log.window < 1) || (log.window >= WINBUFS))
+      log.window = st->log.window;
+    memcpy(&st->log, &log, sizeof(tlog));
+    sim_reply(st, which, from, C1_CACK, hdr.sequence, NULL, 0);
+    break;
+  case C1_RQGID:
+    for (i = 0; i < 9; i++) {
+      snprintf(s, sizeof(s), "%s %d", PROGRAM_NAME, i + 1);
+      storestring(&q, 32, &s);
+    }
+    sim_reply(st, which, from, C1_GID, hdr.sequence, buf, (int)(q - buf));
+    break;
+  case C1_RQSTAT:
+    bitmap = loadlongword(&p);
+    q = buf + 4;
+    bitmap = sim_status(st, bitmap, &q, buf + MAXDATA);
+    p = buf;
+    storelongword(&p, bitmap);
+    sim_reply(st, which, from, C1_STAT, hdr.sequence, buf, (int)(q - buf));
+    break;
+  case C1_RQMEM:
+    sim_memory(st, from, &hdr, p);
+    break;
+  case C1_UMSG:
+  case C1_WEB:
+    sim_reply(st, which, from, C1_CACK, hdr.sequence, NULL, 0);
+    break;
+  case C2_RQGPS:
+    memset(buf, 0, gps2_size);
+    sim_reply(st, which, from, C2_GPS, hdr.sequence, buf, gps2_size);
+    break;
+  case C1_RQMAN:
+    memset(buf, 0, man_size);
+    sim_reply(st, which, from, C1_MAN, hdr.sequence, buf, man_size);
+    break;
+  case C1_RQDCP:
+    memset(buf, 0, dcp_size);
+    sim_reply(st, which, from, C1_DCP, hdr.sequence, buf, dcp_size);
+    break;
+  default:
+    sim_error(st, which, from, hdr.sequence, CERR_PAR);
+    break;
+  }
+}
+
+static void sim_release(sim_station *st, sim_packet *pkt) {
+  if (st->held == pkt)
+    st->held = NULL;
+  free(pkt);
+}
+
+/* everything at or below low is acknowledged, the bitmap covers the packets above it */
+static void sim_ack(sim_station *st, word low, longword *acks) {
+  sim_packet *pkt;
+  word s, d;
+
+  for (s = st->base; s != st->next; s++) {
+    pkt = st->ring[s & (SIM_RING - 1)];
+    if ((pkt == NULL) || (pkt->acked))
+      continue;
+    d = s - low;
+    if ((word)(low - s) < 0x8000)
+      pkt->acked = 1;
+    else if ((d < WINBUFS) && (acks[d >> 5] & (1U << (d & 31))))
+      pkt->acked = 1;
+  }
+  while (st->base != st->next) {
+    pkt = st->ring[st->base & (SIM_RING - 1)];
+    if ((pkt != NULL) && (!pkt->acked))
+      break;
+    st->ring[st->base & (SIM_RING - 1)] = NULL;
+    if (pkt) {
+      sim_release(st, pkt);
+      st->acked++;
+    }
+    st->base++;
+  }
+}
+
+static void sim_data(sim_station *st, byte *msg, int len, struct sockaddr_in *from) {
+  longword acks[4];
+  tqdp hdr;
+  pbyte p;
+  word s;
+  int i;
+
+  if ((!sim_valid(msg, len, &hdr)) || (!st->registered))
+    return;
+  p = msg + QDP_HDR_LTH;
+
+  switch (hdr.command) {
+  case DT_OPEN:
+    memcpy(&st->data_addr, from, sizeof(struct sockaddr_in));
+    st->dataopen = 1;
+    for (s = st->base; s != st->next; s++)
+      if (st->ring[s & (SIM_RING - 1)])
+        st->ring[s & (SIM_RING - 1)]->sent = 0.0; /* resend now */
+    break;
+  case DT_DACK:
+    (void) loadword(&p); /* throttle */
+    (void) loadword(&p);
+    for (i = 0; i < 4; i++)
+      acks[i] = loadlongword(&p);
+    sim_ack(st, hdr.acknowledge, acks);
+    break;
+  }
+}
+
+static void sim_transmit(sim_station *st, sim_packet *pkt, double t) {
+  int size = QDP_HDR_LTH + pkt->size;
+
+  if (pkt->sent > 0.0)
+    st->resent++;
+  pkt->sent = t;
+  if ((loss > 0.0) && ((drand48() * 100.0) < loss)) {
+    st->dropped++;
+    return;
+  }
+  if ((reorder > 0.0) && (st->held == NULL) && ((drand48() * 100.0) < reorder)) {
+    st->held = pkt;
+    st->held_at = t;
+    st->reordered++;
+    return;
+  }
+  sim_send(st->socks[SIM_DATA], pkt->qdp, size, &st->data_addr);
+  if ((st->held) && (st->held != pkt)) {
+    pkt = st->held;
+    st->held = NULL;
+    sim_send(st->socks[SIM_DATA], pkt->qdp, QDP_HDR_LTH + pkt->size, &st->data_addr);
+  }
+}
+
+/* resend anything overdue, then fill the window from the queue */
+static void sim_pump(sim_station *st, double t) {
+  sim_packet *pkt;
+  word s, limit;
+
+  if ((!st->registered) || (!st->dataopen))
+    return;
+
+  for (s = st->base; s != st->next; s++) {
+    pkt = st->ring[s & (SIM_RING - 1)];
+    if ((pkt != NULL) && (!pkt->acked) && (pkt != st->held) && ((t - pkt->sent) * 1000.0 >= resend))
+      sim_transmit(st, pkt, t);
+  }
+
+  limit = st->log.window;
+  while ((st->head != NULL) && ((word)(st->next - st->base) < limit)) {
+    pkt = st->head;
+    st->head = pkt->next;
+    if (st->head == NULL)
+      st->tail = NULL;
+    st->queued--;
+    pkt->next = NULL;
+    (void) sim_seal(pkt->qdp, DT_DATA, pkt->size, st->next, 0);
+    st->ring[st->next & (SIM_RING - 1)] = pkt;
+    st->next++;
+    st->sent++;
+    sim_transmit(st, pkt, t);
+  }
+
+  if ((st->held) && ((t - st->held_at) >= SIM_HOLD)) {
+    pkt = st->held;
+    st->held = NULL;
+    sim_send(st->socks[SIM_DATA], pkt->qdp, QDP_HDR_LTH + pkt->size, &st->data_addr);
+  }
+}
+
+static sim_packet *sim_packet_new(longword dsn) {
+  sim_packet *pkt;
+  pbyte p;
+
+  if ((pkt = (sim_packet *) calloc(1, sizeof(sim_packet))) == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROGRAM_NAME); exit(-1);
+  }
+  p = pkt->qdp + QDP_HDR_LTH;
+  storelongword(&p, dsn);
+  pkt->size = 4;
+
+  return pkt;
+}
+
+/* a full buffer loses the oldest packet, as the q330 does unless told to keep old data */
+static void sim_enqueue(sim_station *st, sim_packet *pkt) {
+  sim_packet *old;
+
+  if (st->queued >= capacity) {
+    old = st->head;
+    st->head = old->next;
+    if (st->head == NULL)
+      st->tail = NULL;
+    st->queued--;
+    st->overflow++;
+    free(old);
+  }
+  if (st->tail)
+    st->tail->next = pkt;
+  else
+    st->head = pkt;
+  st->tail = pkt;
+  st->queued++;
+}
+
+static int sim_fits(longint *d, int n, int bits) {
+  longint lo = -(1 << (bits - 1)), hi = (1 << (bits - 1)) - 1;
+  int i;
+
+  for (i = 0; i < n; i++)
+    if ((d[i] < lo) || (d[i] > hi))
+      return 0;
+
+  return 1;
+}
+
+/* packs first differences into 32 bit compression blocks, returns the number used */
+static int sim_compress(longint prev, longint *samples, int n, longword *blocks, byte *codes) {
+  longint d[4];
+  int i = 0, k, left, used = 0;
+
+  while (i < n) {
+    left = n - i;
+    for (k = 0; (k < 4) && (k < left); k++)
+      d[k] = samples[i + k] - ((i + k) ? samples[i + k - 1] : prev);
+    if ((left >= 4) && sim_fits(d, 4, 8)) {
+      blocks[used] = ((longword)(d[0] & 0xFF) << 24) | ((longword)(d[1] & 0xFF) << 16) |
+                     ((longword)(d[2] & 0xFF) << 8) | (longword)(d[3] & 0xFF);
+      codes[used] = 1;
+      i += 4;
+    }
+    else if ((left >= 3) && sim_fits(d, 3, 10)) {
+      blocks[used] = (3U << 30) | ((longword)(d[0] & 0x3FF) << 20) | ((longword)(d[1] & 0x3FF) << 10) |
+                     (longword)(d[2] & 0x3FF);
+      codes[used] = 2;
+      i += 3;
+    }
+    else if ((left >= 2) && sim_fits(d, 2, 15)) {
+      blocks[used] = (2U << 30) | ((longword)(d[0] & 0x7FFF) << 15) | (longword)(d[1] & 0x7FFF);
+      codes[used] = 2;
+      i += 2;
+    }
+    else {
+      blocks[used] = (1U << 30) | (longword)(d[0] & 0x3FFFFFFF);
+      codes[used] = 2;
+      i += 1;
+    }
+    used++;
+  }
+
+  return used;
+}
+
+/* builds the DC_COMP blockette, or DC_MULT segments, for one channel, returns the number of blockettes */
+static int sim_channel(sim_station *st, int c, longword secs, pbyte *p, int *sizes) {
+  longint samples[200];
+  longword blocks[200];
+  byte codes[200];
+  longint prev = st->last[c], last = prev;
+  pbyte start = *p;
+  word map;
+  int i, n, offset, first, take, seg;
+  double phase;
+
+  for (i = 0; i < rate; i++) {
+    phase = 2.0 * M_PI * SIM_SIGNAL * (secs + (double) i / rate) + (2.0 * M_PI * c) / 3.0 + st->index;
+    last = samples[i] = lround(amplitude * sin(phase)) + (random() % (2 * (amplitude / 64) + 1)) - amplitude / 64;
+  }
+  n = sim_compress(prev, samples, rate, blocks, codes);
+  st->last[c] = last;
+
+  /* the map is padded so the data blocks stay longword aligned */
+  offset = (10 + 2 * ((n + 7) / 8) + 3) & ~3;
+  first = n;
+  if (((offset + 4 * n) > SIM_SEGMENT) && (rate >= 100))
+    first = (SIM_SEGMENT - offset) / 4;
+
+  storebyte(p, ((first < n) ? DC_MULT : DC_COMP) | c);
+  storebyte(p, freqbit);
+  storeword(p, offset + 4 * first);
+  storelongint(p, prev);
+  storeword(p, offset);
+  for (i = 0, map = 0; i < n; i++) {
+    map = map | (codes[i] << (14 - 2 * (i & 7)));
+    if (((i & 7) == 7) || (i == (n - 1))) {
+      storeword(p, map);
+      map = 0;
+    }
+  }
+  while ((*p - start) < offset)
+    storebyte(p, 0);
+  for (i = 0; i < first; i++)
+    storelongword(p, blocks[i]);
+  sizes[0] = offset + 4 * first;
+
+  for (seg = 1, i = first; i < n; seg++) {
+    take = n - i;
+    if ((4 + 4 * take) > SIM_SEGMENT)
+      take = (SIM_SEGMENT - 4) / 4;
+    storebyte(p, DC_MULT | c);
+    storebyte(p, (seg << 3) | freqbit);
+    storeword(p, (4 + 4 * take) | (((i + take) == n) ? DMLS : 0));
+    sizes[seg] = 4 + 4 * take;
+    for (; take > 0; take--, i++)
+      storelongword(p, blocks[i]);
+  }
+
+  return seg;
+}
+
+/* turns one second of synthetic samples into data packets */
+static void sim_second(sim_station *st, longword secs) {
+  byte area[CHANNELS * 1024 + 16];
+  int sizes[CHANNELS * 8], nblk = 0;
+  int c, i;
+  sim_packet *pkt;
+  pbyte p = area;
+
+  st->dsn = secs - st->sec_offset;
+
+  /* the timing blockette leads each second */
+  storebyte(&p, DC_MN232);
+  storebyte(&p, SIM_CLOCK);
+  storeword(&p, 0);
+  storelongint(&p, st->sec_offset);
+  storelongint(&p, 0);
+  sizes[nblk++] = 12;
+
+  for (c = 0; c < channels; c++)
+    nblk += sim_channel(st, c, secs, &p, sizes + nblk);
+
+  p = area;
+  pkt = sim_packet_new(st->dsn);
+  for (i = 0; i < nblk; i++) {
+    if ((pkt->size + sizes[i]) > SIM_PAYLOAD) {
+      sim_enqueue(st, pkt);
+      pkt = sim_packet_new(st->dsn);
+    }
+    memcpy(pkt->qdp + QDP_HDR_LTH + pkt->size, p, sizes[i]);
+    pkt->size += sizes[i];
+    p += sizes[i];
+  }
+  sim_enqueue(st, pkt);
+}
+
+static int sim_socket(word port) {
+  struct sockaddr_in sin;
+  int sock, flags;
+
+  if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    fprintf(stderr, "%s: can't create socket [%s]\n", PROGRAM_NAME, strerror(errno)); exit(-1);
+  }
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  sin.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+    fprintf(stderr, "%s: can't bind port %d [%s]\n", PROGRAM_NAME, port, strerror(errno)); exit(-1);
+  }
+  flags = fcntl(sock, F_GETFL, 0);
+  (void) fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+  return sock;
+}
+
+static void sim_open(sim_station *st, int index) {
+  unsigned long long sn = serial + index;
+  int c, w;
+
+  st->index = index;
+  memcpy(st->serial, &sn, sizeof(t64));
+  snprintf(st->name, sizeof(st->name), "%.3s%02d", prefix, index % 100);
+
+  st->ports[SIM_CONFIG] = baseport + SIM_PORTS * index;
+  st->ports[SIM_CONTROL] = st->ports[SIM_CONFIG] + 2 * lport;
+  st->ports[SIM_DATA] = st->ports[SIM_CONTROL] + 1;
+  for (w = SIM_CONFIG; w <= SIM_DATA; w++)
+    st->socks[w] = sim_socket(st->ports[w]);
+
+  st->log.lport = lport - 1;
+  st->log.mtu = 576;
+  st->log.grp_cnt = 1;
+  st->log.rsnd_max = 10 * resend / 100;
+  st->log.grp_to = 1;
+  st->log.rsnd_min = resend / 100;
+  st->log.window = window;
+  for (c = 0; c < channels; c++)
+    st->log.freqs[c] = 1 << freqbit;
+  st->log.ack_cnt = 1;
+  st->log.ack_to = 1;
+
+  sim_tokens(st);
+}
+
+static void sim_report(sim_station *stations, double elapsed) {
+  static unsigned long long last_sent = 0LL;
+  unsigned long long sent = 0, resent = 0, dropped = 0, reordered = 0, acked = 0, overflow = 0;
+  int i, registered = 0, open = 0, queued = 0;
+
+  for (i = 0; i < count; i++) {
+    registered += stations[i].registered;
+    open += stations[i].dataopen;
+    queued += stations[i].queued;
+    sent += stations[i].sent;
+    resent += stations[i].resent;
+    dropped += stations[i].dropped;
+    reordered += stations[i].reordered;
+    acked += stations[i].acked;
+    overflow += stations[i].overflow;
+  }
+  fprintf(stderr, "%s: %d/%d registered, %d open, %d queued, %llu sent (%.1f/s), %llu resent, %llu dropped, "
+          "%llu reordered, %llu acked, %llu overflowed\n", PROGRAM_NAME, registered, count, open, queued,
+          sent, (elapsed > 0.0) ? (sent - last_sent) / elapsed : 0.0, resent, dropped, reordered, acked, overflow);
+  last_sent = sent;
+}
+
+static void usage(int rc) {
+  fprintf(stderr, "usage: %s [options]\n", PROGRAM_NAME);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "\t-h --help\tshow this help\n");
+  fprintf(stderr, "\t-v --verbose\tbe more verbose, repeat to report every ten seconds\n");
+  fprintf(stderr, "\t-p --baseport\tbase port of the first simulated q330 [%d]\n", baseport);
+  fprintf(stderr, "\t-n --count\tnumber of simulated q330s, %d ports apart [%d]\n", SIM_PORTS, count);
+  fprintf(stderr, "\t-s --serial\tserial number of the first q330 [0x%016llx]\n", serial);
+  fprintf(stderr, "\t-A --authcode\tregistration auth code [0x%llx]\n", authcode);
+  fprintf(stderr, "\t-l --lport\tlogical data port served [%d]\n", lport);
+  fprintf(stderr, "\t-N --network\tnetwork code [%s]\n", network);
+  fprintf(stderr, "\t-S --station\tstation prefix, the q330 index is appended [%s]\n", prefix);
+  fprintf(stderr, "\t-c --channels\tnumber of channels, 1 to %d [%d]\n", CHANNELS, channels);
+  fprintf(stderr, "\t-m --lcqs\tlcqs per channel, each under its own location code, 1 to %d [%d]\n", LCQS, lcqs);
+  fprintf(stderr, "\t-r --rate\tsample rate, one of 1 10 20 40 50 100 200 [%d]\n", rate);
+  fprintf(stderr, "\t-a --amplitude\tsignal amplitude in counts, larger compresses worse [%d]\n", amplitude);
+  fprintf(stderr, "\t-w --window\tdata port sliding window [%d]\n", window);
+  fprintf(stderr, "\t-L --loss\tpercentage of data packets dropped [%g]\n", loss);
+  fprintf(stderr, "\t-O --reorder\tpercentage of data packets sent out of order [%g]\n", reorder);
+  fprintf(stderr, "\t-b --backlog\tseconds of older data queued at startup [%d]\n", backlog);
+  fprintf(stderr, "\t-q --capacity\tpackets buffered before the oldest are lost [%d]\n", capacity);
+  fprintf(stderr, "\t-t --resend\tresend timeout in milliseconds [%d]\n", resend);
+  fprintf(stderr, "\t-d --delay\tmilliseconds every packet sent is held back, keep below the resend timeout [%d]\n", delay);
+  fprintf(stderr, "\t-T --tokens\tpad the dp tokens with opaque configuration to this many bytes [%d]\n", token_pad);
+  fprintf(stderr, "\t-G --garble\tpercentage of token segment requests answered with the wrong segment [%g]\n", garble);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "\tSIGUSR1 drops every registration, to provoke a reconnect storm\n");
+  exit(rc);
+}
+
+int main(int argc, char **argv) {
+  struct option long_options[] = {
+    {"help", 0, 0, 'h'},
+    {"verbose", 0, 0, 'v'},
+    {"baseport", 1, 0, 'p'},
+    {"count", 1, 0, 'n'},
+    {"serial", 1, 0, 's'},
+    {"authcode", 1, 0, 'A'},
+    {"lport", 1, 0, 'l'},
+    {"network", 1, 0, 'N'},
+    {"station", 1, 0, 'S'},
+    {"channels", 1, 0, 'c'},
+    {"lcqs", 1, 0, 'm'},
+    {"rate", 1, 0, 'r'},
+    {"amplitude", 1, 0, 'a'},
+    {"window", 1, 0, 'w'},
+    {"loss", 1, 0, 'L'},
+    {"reorder", 1, 0, 'O'},
+    {"backlog", 1, 0, 'b'},
+    {"capacity", 1, 0, 'q'},
+    {"resend", 1, 0, 't'},
+    {"delay", 1, 0, 'd'},
+    {"tokens", 1, 0, 'T'},
+    {"garble", 1, 0, 'G'},
+    {0, 0, 0, 0}
+  };
+  sim_station *stations;
+  struct pollfd *fds;
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  byte msg[QDP_HDR_LTH + MAXDATA96];
+  longword generated;
+  double t, reported;
+  int i, n, rc, len;
+
+  while ((rc = getopt_long(argc, argv, "hvp:n:s:A:l:N:S:c:m:r:a:w:L:O:b:q:t:d:T:G:", long_options, NULL)) != EOF) {
+    switch(rc) {
+    case '?':
+    case 'h':
+      usage((rc == 'h') ? 0 : -1);
+      break;
+    case 'v':
+      verbose++;
+      break;
+    case 'p':
+      baseport = atoi(optarg);
+      break;
+    case 'n':
+      count = atoi(optarg);
+      break;
+    case 's':
+      serial = strtoull(optarg, (char **) NULL, 0);
+      break;
+    case 'A':
+      authcode = strtoull(optarg, (char **) NULL, 0);
+      break;
+    case 'l':
+      lport = atoi(optarg);
+      break;
+    case 'N':
+      network = optarg;
+      break;
+    case 'S':
+      prefix = optarg;
+      break;
+    case 'c':
+      channels = atoi(optarg);
+      break;
+    case 'm':
+      lcqs = atoi(optarg);
+      break;
+    case 'r':
+      rate = atoi(optarg);
+      break;
+    case 'a':
+      amplitude = atoi(optarg);
+      break;
+    case 'w':
+      window = atoi(optarg);
+      break;
+    case 'L':
+      loss = atof(optarg);
+      break;
+    case 'O':
+      reorder = atof(optarg);
+      break;
+    case 'b':
+      backlog = atoi(optarg);
+      break;
+    case 'q':
+      capacity = atoi(optarg);
+      break;
+    case 't':
+      resend = atoi(optarg);
+      break;
+    case 'd':
+      delay = atoi(optarg);
+      break;
+    case 'T':
+      token_pad = atoi(optarg);
+      break;
+    case 'G':
+      garble = atof(optarg);
+      break;
+    }
+  }
+
+  if ((freqbit = sim_freqbit(rate)) < 0) {
+    fprintf(stderr, "%s: unsupported sample rate %d\n", PROGRAM_NAME, rate); exit(-1);
+  }
+  if ((channels < 1) || (channels > CHANNELS) || (lcqs < 1) || (lcqs > LCQS) || (lport < 1) || (lport > 4) || (count < 1) ||
+      (window < 1) || (window >= WINBUFS) || (capacity < 1) || (backlog < 0) ||
+      (delay < 0) || (token_pad < 0) || (token_pad > MAXCFG) ||
+      ((baseport + SIM_PORTS * count) > 65535)) {
+    fprintf(stderr, "%s: invalid option value\n", PROGRAM_NAME); exit(-1);
+  }
+  /* keep every second within the lib330 segment buffers */
+  if (amplitude < 1)
+    amplitude = 1;
+  if (amplitude > 100000)
+    amplitude = 100000;
+  if (resend < 2 * (int)(SIM_HOLD * 1000))
+    resend = 2 * (int)(SIM_HOLD * 1000);
+
+  signal(SIGINT, term_handler);
+  signal(SIGTERM, term_handler);
+  signal(SIGUSR1, storm_handler);
+  signal(SIGPIPE, SIG_IGN);
+
+  gcrcinit(&crc_table);
+  if ((md5ctx = (pq330) calloc(1, sizeof(tq330))) == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROGRAM_NAME); exit(-1);
+  }
+  md5ctx->cur_thrmem = &md5mem;
+  init_md5_buffer(md5ctx);
+  sim_measure();
+
+  started = now();
+  srandom((unsigned int) started);
+  srand48((long) started);
+  generated = (longword) started - backlog - 1;
+
+  if (((stations = (sim_station *) calloc(count, sizeof(sim_station))) == NULL) ||
+      ((fds = (struct pollfd *) calloc(3 * count, sizeof(struct pollfd))) == NULL)) {
+    fprintf(stderr, "%s: out of memory\n", PROGRAM_NAME); exit(-1);
+  }
+  for (i = 0; i < count; i++) {
+    sim_open(&stations[i], i);
+    stations[i].sec_offset = generated;
+    for (n = 0; n < 3; n++) {
+      fds[3 * i + n].fd = stations[i].socks[n];
+      fds[3 * i + n].events = POLLIN;
+    }
+  }
+
+  if (verbose)
+    fprintf(stderr, "%s: %s, %d q330%s from port %d, serial 0x%016llx, %d x %d sps\n", PROGRAM_NAME, PACKAGE_VERSION,
+            count, (count > 1) ? "s" : "", baseport, serial, channels, rate);
+
+  reported = started;
+  while (going) {
+    if (poll(fds, 3 * count, 10) > 0) {
+      for (i = 0; i < 3 * count; i++) {
+        if ((fds[i].revents & POLLIN) == 0)
+          continue;
+        for (;;) {
+          fromlen = sizeof(from);
+          if ((len = recvfrom(fds[i].fd, msg, sizeof(msg), 0, (struct sockaddr *) &from, &fromlen)) <= 0)
+            break;
+          if ((i % 3) == SIM_DATA)
+            sim_data(&stations[i / 3], msg, len, &from);
+          else
+            sim_control(&stations[i / 3], i % 3, msg, len, &from);
+        }
+      }
+    }
+
+    if (storm) {
+      storm = 0;
+      for (i = 0; i < count; i++)
+        sim_drop(&stations[i]);
+      if (verbose)
+        fprintf(stderr, "%s: dropped all registrations\n", PROGRAM_NAME);
+    }
+
+    t = now();
+    sim_flush(t);
+    while ((generated + 1) < (longword) t) {
+      generated++;
+      for (i = 0; i < count; i++)
+        sim_second(&stations[i], generated);
+    }
+    for (i = 0; i < count; i++)
+      sim_pump(&stations[i], t);
+
+    if ((verbose > 1) && ((t - reported) >= 10.0)) {
+      sim_report(stations, t - reported);
+      reported = t;
+    }
+  }
+
+  if (verbose)
+    sim_report(stations, now() - reported);
+
+  return 0;
+}
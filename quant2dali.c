@@ -30,12 +30,15 @@
 #include <stdarg.h>
 #include <getopt.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <signal.h>
 #include <syslog.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/param.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/utsname.h>
@@ -46,6 +49,7 @@
 #include <time.h>
 #include <math.h>
 #include <pwd.h>
+#include <pthread.h>
 
 /* libmseed library includes */
 #include <libmseed.h>
@@ -57,6 +61,13 @@
 #include <libmsgs.h>
 
 #include "dsarchive.h"
+#include "metrics.h"
+#include "onesec.h"
+#include "spool.h"
+#include "dedup.h"
+#include "sender.h"
+#include "shmring.h"
+#include "seedlink.h"
 
 #ifndef PACKAGE_NAME
 #define PACKAGE_NAME "quant2dali" /* program name */
@@ -65,6 +76,11 @@
 #define PACKAGE_VERSION "xx.x"
 #endif // PACKAGE_VERSION
 
+#define EPOCH_2000 946684800 /* lib330 times are seconds since 2000 */
+#define LOWLAT_TYPE "/LLMSEED" /* datalink stream type for the low latency records */
+#define ONESEC_TYPE "/ONESEC" /* datalink stream type for the one second data frames */
+#define SPOOL_IOTIMEOUT 10 /* a datalink write taking longer than this goes to the spool instead */
+
 /*
  * q3link: collect and archive Q330 and optionally send it a ringserver via datalink
  *
@@ -83,8 +99,30 @@ static time_t last = 0; /* keep us going */
 static char *server = NULL; /* datalink server to use */
 static DLCP *dlconn = NULL; /* datalink handle */
 static int writeack = 0; /* request for write acks */
+static pthread_mutex_t dali_lock = PTHREAD_MUTEX_INITIALIZER; /* the spool drainer shares the connection */
+
+static char *spool_dir = NULL; /* spool records here while the datalink server is unavailable */
+static int spool_size = 1024; /* spool limit in megabytes */
+
+static char *dedup_path = NULL; /* index of the last record sent for each channel */
+
+static char *shm_name = NULL; /* also publish records in this shared memory ring */
+static int seedlink_port = 0; /* serve the ring to seedlink clients on this port */
+static int publish = 0; /* the ring is running */
+
+static int queue_depth = 0; /* records lib330 holds for the datalink sender thread */
+static int workers = 0; /* lib330 threads processing the main digitizer channels */
+static int hugepages = OHP_NONE; /* how lib330 backs its memory arenas */
 
 static DataStream datastream; /* archive it ... */
+static int archive_exponent = 9; /* archive record size as a power of two, 9 archives the 512 byte records */
+static int archive_update = 20; /* larger archive records up to this sample rate are rewritten as they grow */
+
+static int latency_target = 0; /* send each second of data as it arrives, if not older than this */
+static int lowlat_failed = 0; /* a low latency write failed */
+
+static char *onesec_filter = NULL; /* which one second data to send */
+static char *onesec_path = NULL; /* local datagram socket for the one second data */
 
 /* lib330 structures */
 static tpar_register ri; /* registration info */
@@ -114,10 +152,20 @@ static int cntl_wait = 120; /* how long to wait to register */
 static int serial_retry = 3;
 static int serial_wait = 5;
 
+static char *discover = NULL; /* subnets to search for q330s */
+static int discover_inflight = 32; /* concurrent discovery queries */
+
+static int metrics_port = 0; /* http metrics port, if any */
+
+static char *capture = NULL; /* record validated q330 packets here */
+static char *replay = NULL; /* play packets back from this capture */
+static int paced = 0; /* replay at the captured rate */
+
 /* current running status */
 static enum tlibstate lib_state = LIBSTATE_IDLE;
 
 extern unsigned long long ping_for_serial(char *ipaddr, int port, int count, int timeout);
+extern int discover_report(char *spec, int port, int inflight, int retries, int timeout);
 
 /* string to convert to upper case. */
 static char *uc(char *string) {
@@ -154,7 +202,7 @@ static void err_print(char *message) {
 	fprintf(stderr, "error: %s", message);
 }
 
-static int sendrecord (char *record, int reclen) {
+static int sendrecord (char *record, int reclen, int ack) {
   static MSRecord *msr = NULL;
   hptime_t endtime;
   char streamid[100];
@@ -177,7 +225,7 @@ static int sendrecord (char *record, int reclen) {
   endtime = msr_endtime (msr);
 
   /* Send record to server */
-  if (dl_write (dlconn, record, reclen, streamid, msr->starttime, endtime, writeack) < 0) {
+  if (dl_write (dlconn, record, reclen, streamid, msr->starttime, endtime, ack) < 0) {
 		return -1;
 	}
 
@@ -202,6 +250,9 @@ void q330_state_callback(pointer p) {
 			ms_log(0, "changing state to %s\n", new_state_name);
 		lib_state = (enum tlibstate)((tstate_call *) p)->info;
 	}
+	else if ((((tstate_call *) p)->state_type == ST_REGDATA) && (verbose)) {
+		ms_log(0, "first data %lu ms after registering\n", (unsigned long)((tstate_call *) p)->info);
+	}
 }
 
 void q330_message_callback(pointer p) {
@@ -217,16 +268,60 @@ void q330_message_callback(pointer p) {
 		ms_log(0, "%s {%03d} %s %s\n", data_time, msg->code, msg_text, msg->suffix);
 }
 
+/* lib330 keeps packet level debug as binary events, they are only formatted here */
+void q330_packet_trace(tcontext ct) {
+	static longword next = 0;
+	tmsgevent ev;
+	string95 msg_text;
+	string95 suffix;
+	char data_time[32];
+	integer part;
+
+	while (lib_msg_event(ct, &next, &ev)) {
+		jul_string((longint) ev.timestamp, &data_time);
+		/* the ring lapped this reader */
+		if (ev.lost) {
+			lib_get_msg(LIBMSG_PKTLOST, &msg_text);
+			ms_log(0, "%s {%03d} %s%u\n", data_time, LIBMSG_PKTLOST, msg_text, (unsigned int) ev.lost);
+		}
+		lib_get_msg(ev.code, &msg_text);
+		for (part = 0; part >= 0; ) {
+			if (lib_event_string(&ev, &part, suffix) != NULL)
+				ms_log(0, "%s {%03d} %s %s\n", data_time, ev.code, msg_text, suffix);
+		}
+	}
+}
+
 void q330_minidata_callback(pointer p) {
   int rc;
   char srcname[100];
   static MSRecord *msr = NULL;
+  struct timeval t0, t1;
 
 	tminiseed_call *data = (tminiseed_call *) p;
   pq330 q330 = (pq330) ((tminiseed_call *)p)->context;
 
-	/* archive it perhaps ... */
-	if (datastream.path != NULL) {
+	metrics_record(data->data_size);
+
+	/* lib330 may send again what it already has after a reconnection */
+	if ((dedup_path != NULL) && ((rc = dedup_record(data)) != 0)) {
+		if (verbose > 1)
+			ms_log (0, "dropping %s %s.%s.%s record\n", (rc == 1) ? "duplicate" : "overlapping", data->station_name, data->location, data->channel);
+		last = (time_t) time((time_t *) 0);
+		return;
+	}
+
+	/* local readers see it straight away, whatever happens to it next */
+	if (publish) {
+		char key[sizeof(((shmring_stream *) 0)->key)];
+		(void) snprintf(key, sizeof(key), "%s.%s.%s", data->station_name, data->location, data->channel);
+		if (shmring_push((char *) data->data_address, data->data_size, key, data->timestamp + EPOCH_2000, data->packet_class) < 0) {
+			ms_log (1, "error publishing record [%s]\n", strerror(errno)); going = 0; return;
+		}
+	}
+
+	/* archive it perhaps, unless larger records are being archived instead ... */
+	if ((datastream.path != NULL) && (ci.call_aminidata == NULL)) {
   	ms_recsrcname ((char *) data->data_address, srcname, 0);
 
   	/* Parse Mini-SEED header */
@@ -234,20 +329,49 @@ void q330_minidata_callback(pointer p) {
     	ms_log (1, "error unpacking %s: %s", srcname, ms_errorstr(rc)); going = 0; return;
   	}
 
-		if (ds_streamproc (&datastream, msr, 0, verbose - 1) < 0) {
+		gettimeofday(&t0, NULL);
+		rc = ds_streamproc (&datastream, msr, 0, verbose - 1);
+		gettimeofday(&t1, NULL);
+		metrics_archive((double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_usec - t0.tv_usec) / 1000000.0, (rc < 0));
+
+		if (rc < 0) {
    		ms_log (1, "error archiving packet\n"); going = 0; return;
 		}
 	}
 	
+	/* send it straight on while nothing is waiting in the spool, otherwise queue it behind */
+	if ((dlconn != NULL) && (spool_dir != NULL)) {
+		rc = -1;
+		if ((!spool_busy()) && (pthread_mutex_trylock(&dali_lock) == 0)) {
+			if ((rc = sendrecord ((char *) data->data_address, data->data_size, writeack)) < 0) {
+				/* leave the reconnecting to the drainer */
+				if (dlconn->link != -1)
+					dl_disconnect(dlconn);
+			}
+			pthread_mutex_unlock(&dali_lock);
+			metrics_datalink((rc < 0) ? 0 : data->data_size, (rc < 0));
+		}
+		if ((rc < 0) && (spool_write ((char *) data->data_address, data->data_size) < 0)) {
+			ms_log (1, "error spooling record\n"); going = 0; return;
+		}
+	}
+	/* or leave it to the sender thread, lib330 keeps it in its record pool until sent */
+	else if ((dlconn != NULL) && (queue_depth > 0)) {
+		if (sender_queue(data) < 0) {
+			ms_log (1, "error queueing record\n"); going = 0; return;
+		}
+	}
 	/* send it off to a datalink server */
-	if (dlconn != NULL) {
-		while (sendrecord ((char *) data->data_address, data->data_size)) {
+	else if (dlconn != NULL) {
+		while (sendrecord ((char *) data->data_address, data->data_size, writeack)) {
+			metrics_datalink(0, 1);
 			if (verbose > 0)
 				ms_log (1, "re-connecting to datalink server\n");
 
 			if (dlconn->link != -1)
 				dl_disconnect(dlconn);
 
+			metrics_reconnect();
 			if (dl_connect(dlconn) < 0) {
 				ms_log (1, "error re-connecting to datalink server, sleeping 10 seconds\n"); sleep (10);
 			}
@@ -255,12 +379,240 @@ void q330_minidata_callback(pointer p) {
 			if (q330->terminate)
 				break;
 		}
+		metrics_datalink(data->data_size, 0);
 	}
 
 	/* got it ... */
 	last = (time_t) time((time_t *) 0);
 }
 
+/* split the lib330 "NN-SSSSS" station name */
+static void q330_codes(char *station_name, char *network, char *station) {
+  char *c;
+
+  if ((c = strchr(station_name, '-')) != NULL) {
+    (void) snprintf(network, 3, "%.*s", (int)(c - station_name), station_name);
+    (void) snprintf(station, 6, "%s", c + 1);
+  }
+  else {
+    (void) snprintf(network, 3, "%s", "");
+    (void) snprintf(station, 6, "%s", station_name);
+  }
+}
+
+/* find the incomplete archive record lib330 may carry on with after a restart */
+static int q330_lastrecord(tminiseed_call *data) {
+  static MSRecord *msr = NULL;
+  static char record[16384];
+
+  if (data->data_size > sizeof(record))
+    return -1;
+
+  /* only the stream codes and today's date are needed to find the file */
+  if ((msr = msr_init(msr)) == NULL)
+    return -1;
+  if ((msr->fsdh = (struct fsdh_s *) calloc(1, sizeof(struct fsdh_s))) == NULL)
+    return -1;
+
+  q330_codes(data->station_name, msr->network, msr->station);
+  ms_strncpclean(msr->location, data->location, 2);
+  ms_strncpclean(msr->channel, data->channel, 3);
+  ms_strncpopen(msr->fsdh->network, msr->network, 2);
+  ms_strncpopen(msr->fsdh->station, msr->station, 5);
+  ms_strncpopen(msr->fsdh->location, msr->location, 2);
+  ms_strncpopen(msr->fsdh->channel, msr->channel, 3);
+  msr->starttime = MS_EPOCH2HPTIME(time((time_t *) 0));
+  msr->samprate = (data->rate > 0) ? (double) data->rate : -1.0 / (double) data->rate;
+  msr->reclen = data->data_size;
+  msr->dataquality = 'D';
+
+  if (ds_lastrecord(&datastream, msr, record, data->data_size, 0, verbose - 1) < 0)
+    return -1;
+  if (ms_detect(record, data->data_size) != data->data_size)
+    return -1;
+
+  memcpy(data->data_address, record, data->data_size);
+
+  return 0;
+}
+
+void q330_aminidata_callback(pointer p) {
+  int rc;
+  char srcname[100];
+  static MSRecord *msr = NULL;
+  struct timeval t0, t1;
+
+	tminiseed_call *data = (tminiseed_call *) p;
+
+	/* lib330 is asking for the last record written, the archive has it */
+	if (data->miniseed_action == MSA_GETARC) {
+		if (q330_lastrecord(data) == 0)
+			data->miniseed_action = MSA_RETARC;
+		return;
+	}
+
+	/* resent archival records, and updates to them, are dropped as the 512 byte ones are */
+	if ((dedup_path != NULL) && ((rc = dedup_record(data)) != 0)) {
+		if (verbose > 1)
+			ms_log (0, "dropping %s %s.%s.%s archival record\n", (rc == 1) ? "duplicate" : "overlapping", data->station_name, data->location, data->channel);
+		return;
+	}
+
+ 	ms_recsrcname ((char *) data->data_address, srcname, 0);
+
+ 	/* Parse Mini-SEED header */
+ 	if ((rc = msr_unpack ((char *) data->data_address, data->data_size, &msr, 0, 0)) != MS_NOERROR) {
+   	ms_log (1, "error unpacking %s: %s", srcname, ms_errorstr(rc)); going = 0; return;
+ 	}
+
+	/* increments rewrite the record already in the archive */
+	gettimeofday(&t0, NULL);
+	rc = ds_recordproc (&datastream, msr, ((data->miniseed_action == MSA_INC) || (data->miniseed_action == MSA_FINAL)), 0, verbose - 1);
+	gettimeofday(&t1, NULL);
+	metrics_archive((double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_usec - t0.tv_usec) / 1000000.0, (rc < 0));
+
+	if (rc < 0) {
+ 		ms_log (1, "error archiving %s\n", srcname); going = 0; return;
+	}
+}
+
+static void lowlat_record(char *record, int reclen, void *handlerdata) {
+  MSRecord *msr = (MSRecord *) handlerdata;
+  char streamid[100];
+  hptime_t endtime;
+
+  msr_srcname (msr, streamid, 0);
+  strcat (streamid, LOWLAT_TYPE);
+  endtime = msr->starttime + (hptime_t) ((msr->numsamples - 1) * HPTMODULUS / msr->samprate);
+
+  if (dl_write (dlconn, record, reclen, streamid, msr->starttime, endtime, 0) < 0)
+    lowlat_failed++;
+}
+
+/* each second of samples is sent on as soon as it has been decoded, without
+  waiting for a 512 byte record to fill, records are best effort and are dropped
+  rather than retried when the datalink server is unavailable or busy with a full
+  record, so check the lowlatency metrics for how many arrived and how late */
+void q330_lowlatency_callback(pointer p) {
+  static MSRecord *msr = NULL;
+  int64_t packed;
+  int rc;
+  struct timeval tv;
+
+	tonesec_call *data = (tonesec_call *) p;
+
+	if ((dlconn == NULL) || (dlconn->link == -1) || (data->rate <= 0))
+		return;
+
+  if ((msr = msr_init(msr)) == NULL)
+    return;
+
+  q330_codes(data->station_name, msr->network, msr->station);
+  ms_strncpclean(msr->location, data->location, 2);
+  ms_strncpclean(msr->channel, data->channel, 3);
+  msr->dataquality = 'D';
+  msr->starttime = (hptime_t) ((data->timestamp + EPOCH_2000) * HPTMODULUS);
+  msr->samprate = (double) data->rate;
+  msr->reclen = 512;
+  msr->encoding = DE_STEIM2;
+  msr->byteorder = 1;
+  msr->datasamples = data->samples;
+  msr->numsamples = data->rate;
+  msr->sampletype = 'i';
+
+  lowlat_failed = 0;
+  if (pthread_mutex_trylock(&dali_lock) == 0) {
+    rc = msr_pack (msr, lowlat_record, msr, &packed, 1, 0);
+    pthread_mutex_unlock(&dali_lock);
+  }
+  else {
+    rc = -1;
+  }
+  msr->datasamples = NULL; /* belongs to lib330 */
+
+  /* how long since the first sample of the second */
+  gettimeofday(&tv, NULL);
+  metrics_lowlatency((double) tv.tv_sec + (double) tv.tv_usec / 1000000.0 - (data->timestamp + EPOCH_2000), ((rc < 0) || (lowlat_failed)));
+}
+
+/* the spool drainer sends with acknowledgements of its own choosing */
+static int dali_sendrecord(char *record, int reclen, int ack) {
+  int rc;
+
+  pthread_mutex_lock(&dali_lock);
+  rc = sendrecord (record, reclen, (ack || writeack));
+  pthread_mutex_unlock(&dali_lock);
+  metrics_datalink((rc < 0) ? 0 : reclen, (rc < 0));
+
+  return rc;
+}
+
+static int dali_reconnect(void) {
+  int rc;
+
+  if (verbose > 0)
+    ms_log (1, "re-connecting to datalink server\n");
+
+  pthread_mutex_lock(&dali_lock);
+  if (dlconn->link != -1)
+    dl_disconnect(dlconn);
+  metrics_reconnect();
+  rc = dl_connect(dlconn);
+  pthread_mutex_unlock(&dali_lock);
+
+  return rc;
+}
+
+/* one second data frames go to the datalink server under the station name */
+static int onesec_datalink(char *frame, int length, char *network, char *station, time_t second) {
+  char streamid[100];
+  int64_t rc;
+
+	if ((dlconn == NULL) || (dlconn->link == -1))
+		return -1;
+
+  /* best effort, not worth waiting on the spool drainer for */
+  if (pthread_mutex_trylock(&dali_lock) != 0)
+    return -1;
+
+  (void) snprintf(streamid, sizeof(streamid), "%s_%s%s", network, station, ONESEC_TYPE);
+  rc = dl_write (dlconn, frame, length, streamid, MS_EPOCH2HPTIME(second), MS_EPOCH2HPTIME(second + 1), 0);
+  pthread_mutex_unlock(&dali_lock);
+
+  return (rc < 0) ? -1 : 0;
+}
+
+void q330_onesec_callback(pointer p) {
+	onesec_push((tonesec_call *) p);
+}
+
+/* decode a comma separated list of one second data names, or a bare OSF_xxx mask */
+static int onesec_bits(char *list) {
+  char buf[128], *c, *s;
+  int bits = 0;
+
+  if ((list == NULL) || (strlen(list) == 0))
+    return 0;
+  if (isdigit((int) list[0]))
+    return (int) strtol(list, (char **) NULL, 0);
+
+  (void) snprintf(buf, sizeof(buf), "%s", list);
+  for (c = strtok_r(buf, ",", &s); c != NULL; c = strtok_r(NULL, ",", &s)) {
+    if (strcasecmp(c, "all") == 0)
+      bits |= OSF_ALL;
+    else if (strcasecmp(c, "dataserv") == 0)
+      bits |= OSF_DATASERV;
+    else if (strcasecmp(c, "1hz") == 0)
+      bits |= OSF_1HZ;
+    else if (strcasecmp(c, "ep") == 0)
+      bits |= OSF_EP;
+    else
+      return -1;
+  }
+
+  return bits;
+}
+
 int main(int argc, char **argv) {
 
 	int i;
@@ -286,11 +638,33 @@ int main(int argc, char **argv) {
     {"attempts", 1, 0, 'n'},
     {"continuity", 1, 0, 'x'},
     {"format", 1, 0, 'f'},
+    {"discover", 1, 0, 'D'},
+    {"inflight", 1, 0, 'I'},
+    {"metrics", 1, 0, 'm'},
+    {"capture", 1, 0, 'c'},
+    {"replay", 1, 0, 'R'},
+    {"paced", 0, 0, 'P'},
+    {"exponent", 1, 0, 'e'},
+    {"update", 1, 0, 'u'},
+    {"latency", 1, 0, 'L'},
+    {"onesec", 1, 0, 'O'},
+    {"socket", 1, 0, 'U'},
+    {"spool", 1, 0, 'S'},
+    {"spoolsize", 1, 0, 'B'},
+    {"dedup", 1, 0, 'X'},
+    {"queue", 1, 0, 'Q'},
+    {"workers", 1, 0, 'W'},
+    {"hugepages", 1, 0, 'H'},
+    {"shm", 1, 0, 'M'},
+    {"seedlink", 1, 0, 'Z'},
 		{0, 0, 0, 0}
 	};
 
 	string63 errmsg;
 	topstat retopstat;
+	static tlcqstat lcqstat;
+	trecpoolstat poolstat;
+	time_t lcq_time = 0;
 	enum tliberr errcode;
 	tslidestat slidecopy;
 
@@ -319,7 +693,7 @@ int main(int argc, char **argv) {
   datastream.idletimeout = 60;
   datastream.grouproot = NULL;
 
-	while ((rc = getopt_long(argc, argv, "hvwr:p:d:a:i:s:l:k:n:x:f:", long_options, &option_index)) != EOF) {
+	while ((rc = getopt_long(argc, argv, "hvwr:p:d:a:i:s:l:k:n:x:f:D:I:m:c:R:Pe:u:L:O:U:S:B:X:Q:W:H:M:Z:", long_options, &option_index)) != EOF) {
 		switch(rc) {
 		case '?':
 			(void) fprintf(stderr, "usage: %s\n", program_usage);
@@ -343,6 +717,25 @@ int main(int argc, char **argv) {
       (void) fprintf(stderr, "\t-n --attempts\tnumber of registration attempts [%d]\n", cntl_attempts);
       (void) fprintf(stderr, "\t-x --continuity\tprovide a continuity file [%s]\n", (continuity) ? continuity : "<null>");
       (void) fprintf(stderr, "\t-f --format\toptional miniseed archive format [%s]\n", (datastream.path) ? datastream.path : "<null>");
+      (void) fprintf(stderr, "\t-D --discover\tlist the q330s found on a comma separated list of addresses or subnets [%s]\n", (discover) ? discover : "<null>");
+      (void) fprintf(stderr, "\t-I --inflight\tconcurrent discovery queries [%d]\n", discover_inflight);
+      (void) fprintf(stderr, "\t-m --metrics\tserve prometheus metrics over http on this port [%d]\n", metrics_port);
+      (void) fprintf(stderr, "\t-c --capture\trecord the q330 packets into this file [%s]\n", (capture) ? capture : "<null>");
+      (void) fprintf(stderr, "\t-R --replay\tprocess a capture file instead of a q330 [%s]\n", (replay) ? replay : "<null>");
+      (void) fprintf(stderr, "\t-P --paced\treplay at the captured rate rather than as fast as possible [%s]\n", (paced) ? "on" : "off");
+      (void) fprintf(stderr, "\t-e --exponent\tarchive record size as a power of two, from 9 to 14 [%d]\n", archive_exponent);
+      (void) fprintf(stderr, "\t-u --update\trewrite larger archive records as they grow up to this sample rate [%d]\n", archive_update);
+      (void) fprintf(stderr, "\t-L --latency\talso send each second of data as it arrives, unless older than this many seconds [%d]\n", latency_target);
+      (void) fprintf(stderr, "\t-O --onesec\tsend one second data frames, any of all,dataserv,1hz,ep [%s]\n", (onesec_filter) ? onesec_filter : "<null>");
+      (void) fprintf(stderr, "\t-U --socket\talso send the one second data frames to this local datagram socket [%s]\n", (onesec_path) ? onesec_path : "<null>");
+      (void) fprintf(stderr, "\t-S --spool\tspool records in this directory while the datalink server is unavailable [%s]\n", (spool_dir) ? spool_dir : "<null>");
+      (void) fprintf(stderr, "\t-B --spoolsize\tspool limit in megabytes, the oldest records are dropped beyond it [%d]\n", spool_size);
+      (void) fprintf(stderr, "\t-X --dedup\tdrop records already sent, using this index file [%s]\n", (dedup_path) ? dedup_path : "<null>");
+      (void) fprintf(stderr, "\t-Q --queue\tsend records from a separate thread, holding up to this many without a spool [%d]\n", queue_depth);
+      (void) fprintf(stderr, "\t-W --workers\tprocess the main digitizer channels on this many lib330 threads [%d]\n", workers);
+      (void) fprintf(stderr, "\t-H --hugepages\tback lib330 memory with huge pages, 1 transparent, 2 reserved [%d]\n", hugepages);
+      (void) fprintf(stderr, "\t-M --shm\talso publish records in a shared memory ring of this name for local readers [%s]\n", (shm_name) ? shm_name : "<null>");
+      (void) fprintf(stderr, "\t-Z --seedlink\tserve the records to seedlink clients on this port, %d is usual [%d]\n", SEEDLINK_PORT, seedlink_port);
 			exit(0); /*NOTREACHED*/
 		case 'v':
 			verbose++;
@@ -382,6 +775,63 @@ int main(int argc, char **argv) {
       break;
     case 'f':
       datastream.path = optarg;
+      break;
+    case 'D':
+      discover = optarg;
+      break;
+    case 'I':
+      discover_inflight = atoi(optarg);
+      break;
+    case 'm':
+      metrics_port = atoi(optarg);
+      break;
+    case 'c':
+      capture = optarg;
+      break;
+    case 'R':
+      replay = optarg;
+      break;
+    case 'P':
+      paced++;
+      break;
+    case 'e':
+      archive_exponent = atoi(optarg);
+      break;
+    case 'u':
+      archive_update = atoi(optarg);
+      break;
+    case 'L':
+      latency_target = atoi(optarg);
+      break;
+    case 'O':
+      onesec_filter = optarg;
+      break;
+    case 'U':
+      onesec_path = optarg;
+      break;
+    case 'S':
+      spool_dir = optarg;
+      break;
+    case 'B':
+      spool_size = atoi(optarg);
+      break;
+    case 'X':
+      dedup_path = optarg;
+      break;
+    case 'M':
+      shm_name = optarg;
+      break;
+    case 'Z':
+      seedlink_port = atoi(optarg);
+      break;
+    case 'Q':
+      queue_depth = atoi(optarg);
+      break;
+    case 'W':
+      workers = atoi(optarg);
+      break;
+    case 'H':
+      hugepages = atoi(optarg);
       break;
 		}
 	}
@@ -394,10 +844,41 @@ int main(int argc, char **argv) {
 	if (verbose)
 		ms_log (0, "%s\n", program_version);
 
+	/* just looking for q330s */
+	if (discover) {
+		if (discover_report(discover, baseport, discover_inflight, serial_retry, serial_wait * 1000) < 0) {
+			ms_log(2, "unable to run discovery: %s\n", discover); exit(-1);
+		}
+		exit(0);
+	}
+
 	if (!station) {
 		ms_log (2, "no station code given\n"); exit(-1);
 	}
 
+	if ((archive_exponent < 9) || (archive_exponent > 14)) {
+		ms_log (2, "archive record exponent must be from 9 to 14\n"); exit(-1);
+	}
+
+	if ((workers < 0) || (workers > MAX_WORKERS)) {
+		ms_log (2, "workers must be from 0 to %d\n", MAX_WORKERS); exit(-1);
+	}
+
+	if ((hugepages < OHP_NONE) || (hugepages > OHP_EXPLICIT)) {
+		ms_log (2, "hugepages must be from %d to %d\n", OHP_NONE, OHP_EXPLICIT); exit(-1);
+	}
+
+	if ((queue_depth < 0) || (queue_depth > RECPOOL_MAX)) {
+		ms_log (2, "record queue must be from 0 to %d\n", RECPOOL_MAX); exit(-1);
+	}
+	/* the spool already keeps the station thread from waiting on the server */
+	if ((server == NULL) || (spool_dir != NULL))
+		queue_depth = 0;
+
+	if (onesec_bits(onesec_filter) < 0) {
+		ms_log (2, "unknown one second data filter: %s\n", onesec_filter); exit(-1);
+	}
+
 	/* what to recover ... */
 	verbosity |= ((verbose > 0) ? VERB_RETRY : 0);
 	verbosity |= ((verbose > 1) ? VERB_PACKET : 0);
@@ -405,7 +886,11 @@ int main(int argc, char **argv) {
 	if (verbosity > 1)
      ms_log(0, "configuring q330 [%s] ... \n", station);
 
-  if ((serial == NULL) || (strtoll(serial, (char **) NULL, 0) == 0)) {
+  if (replay) {
+		/* nothing to ask */
+		s = 0LL;
+  }
+  else if ((serial == NULL) || (strtoll(serial, (char **) NULL, 0) == 0)) {
 	  if (verbosity > 1)
      ms_log(0, "discover q330 serial number [%s] ... \n", station);
     if ((s = ping_for_serial(ipaddr, baseport, serial_retry, serial_wait)) < 0) {
@@ -445,24 +930,30 @@ int main(int argc, char **argv) {
 	strncpy(ci.q330id_station, uc(station), 5);
 	ci.host_timezone = 0;
 	strncpy(ci.host_software, PACKAGE_NAME, 95);
-	strncpy(ci.opt_contfile, (continuity) ? continuity : "", 250);
+	/* a replay starts from nothing, and leaves the live continuity alone */
+	strncpy(ci.opt_contfile, (continuity && !replay) ? continuity : "", 250);
 	ci.opt_verbose = verbosity;
 	ci.opt_zoneadjust = 1;
-	ci.opt_secfilter = 0;
+	/* one second data is only worth decoding if there is somewhere to send it */
+	ci.opt_secfilter = ((server != NULL) || (onesec_path != NULL)) ? onesec_bits(onesec_filter) : 0;
 	ci.opt_minifilter = OMF_ALL;
-	ci.opt_aminifilter = 0;
-	ci.amini_exponent = 0;
-	ci.amini_512highest = 0;
+	/* larger archive records are built by lib330 alongside the 512 byte ones */
+	ci.opt_aminifilter = ((datastream.path != NULL) && (archive_exponent > 9)) ? OMF_ALL : 0;
+	ci.amini_exponent = (ci.opt_aminifilter) ? archive_exponent : 0;
+	ci.amini_512highest = archive_update;
 	ci.mini_embed = 1;
 	ci.mini_separate = 1;
+	ci.opt_recpool = queue_depth;
+	ci.opt_workers = workers;
+	ci.opt_hugepages = hugepages;
 	ci.mini_firchain = 0;
 	ci.call_minidata = q330_minidata_callback;
-	ci.call_aminidata = NULL;
+	ci.call_aminidata = (ci.opt_aminifilter) ? q330_aminidata_callback : NULL;
 	ci.resp_err = LIBERR_NOERR;
 	ci.call_state = q330_state_callback;
 	ci.call_messages = q330_message_callback;
-	ci.call_secdata = NULL;
-	ci.call_lowlatency = NULL;
+	ci.call_secdata = (ci.opt_secfilter) ? q330_onesec_callback : NULL;
+	ci.call_lowlatency = ((server != NULL) && (latency_target > 0)) ? q330_lowlatency_callback : NULL;
 
 	if (verbose > 1)
 		ms_log(0, "filling registration structure [%s]\n", station);
@@ -475,7 +966,7 @@ int main(int argc, char **argv) {
 	ri.host_maxcmdretry = max_retry;
 	ri.host_ctrlport = 0;
 	ri.host_dataport = 0;
-	ri.opt_latencytarget = 0;
+	ri.opt_latencytarget = latency_target;
 	ri.opt_closedloop = 0;
 	ri.opt_dynamic_ip = 0;
 	ri.opt_hibertime = hiber_time;
@@ -511,22 +1002,114 @@ int main(int argc, char **argv) {
 		if ((dlconn = dl_newdlcp (server, buf)) == NULL) {
      	ms_log(2, "cannot allocation datalink descriptor\n"); exit (-1);
   	}
-		/* connect to datalink server */
-		if (dl_connect(dlconn) < 0) {
-     	ms_log(2, "error connecting to datalink server: server\n"); exit(-1);
-  	}
-		if (dlconn->writeperm != 1) {
-     	ms_log(2, "datalink server is non-writable\n"); exit(-1);
+		/* connect to datalink server, with a spool it can wait */
+		if (spool_dir != NULL) {
+			dlconn->iotimeout = SPOOL_IOTIMEOUT;
+			if (dl_connect(dlconn) < 0)
+     		ms_log(1, "error connecting to datalink server %s, spooling until it is available\n", server);
+			else if (dlconn->writeperm != 1) {
+     		ms_log(2, "datalink server is non-writable\n"); exit(-1);
+			}
+			if (spool_start(spool_dir, (long long) spool_size * 1024 * 1024, dali_sendrecord, dali_reconnect) < 0)
+				exit(-1);
+		}
+		else {
+			if (dl_connect(dlconn) < 0) {
+     		ms_log(2, "error connecting to datalink server: server\n"); exit(-1);
+  		}
+			if (dlconn->writeperm != 1) {
+     		ms_log(2, "datalink server is non-writable\n"); exit(-1);
+			}
+			if ((queue_depth > 0) && (sender_start(queue_depth, dali_sendrecord, dali_reconnect) < 0))
+				exit(-1);
 		}
 	}
 
-	if (verbose > 1)
+	if (dedup_path != NULL) {
+		if (verbose)
+     	ms_log(0, "dropping resent records using %s\n", dedup_path);
+		if (dedup_open(dedup_path) < 0)
+			exit(-1);
+	}
+
+	/* the seedlink server reads from the ring, a private one if it is not shared */
+	if ((shm_name != NULL) || (seedlink_port > 0)) {
+		if ((verbose) && (shm_name != NULL))
+     	ms_log(0, "publishing records in shared memory %s\n", shm_name);
+		if (shmring_start(shm_name, SHMRING_SLOTS) < 0) {
+     	ms_log(2, "can't create shared memory ring %s [%s]\n", (shm_name) ? shm_name : "<private>", strerror(errno)); exit(-1);
+		}
+		publish = 1;
+	}
+	if (seedlink_port > 0) {
+		if (verbose)
+     	ms_log(0, "serving seedlink clients on port %d\n", seedlink_port);
+		if (seedlink_start(seedlink_port, (verbose > 1)) < 0)
+			exit(-1);
+	}
+
+	if (ci.opt_secfilter) {
+		if (verbose)
+     	ms_log(0, "sending one second data frames [%s]\n", onesec_filter);
+		if (onesec_start(onesec_path, (dlconn != NULL) ? dlconn->maxpktsize : 0, (dlconn != NULL) ? onesec_datalink : NULL) < 0)
+			exit(-1);
+	}
+
+	if (metrics_port > 0) {
+		if (verbose)
+     	ms_log(0, "serving metrics on port %d\n", metrics_port);
+		if (metrics_start(station, metrics_port) < 0)
+			exit(-1);
+	}
+
+	if (capture) {
+		if (verbose)
+     	ms_log(0, "capturing q330 packets to %s\n", capture);
+		lib_capture(sc, capture);
+	}
+
+	if (replay) {
+		if (verbose)
+     	ms_log(0, "replaying q330 packets from %s\n", replay);
+		errcode = lib_replay(sc, replay, (paced) ? TRUE : FALSE);
+		if (errcode != LIBERR_NOERR)
+			q330_error(1, errcode);
+	}
+	else if (verbose > 1)
 		ms_log (0, "connecting to q330 %s::%s@%s::%s/%d\n", station, authcode, serial, ipaddr, lport);
 
 	while (going) {
 
 		lib_state = lib_get_state(sc, &errcode, &retopstat);
 
+		if (verbosity & VERB_PACKET)
+			q330_packet_trace(sc);
+
+		/* refresh what the metrics endpoint will report */
+		if (metrics_port > 0) {
+			metrics_state(lib_state, &retopstat);
+			if ((lib_state == LIBSTATE_RUN) && (time((time_t *) 0) != lcq_time)) {
+				lcq_time = time((time_t *) 0);
+				if (lib_get_lcqstat(sc, &lcqstat) == LIBERR_NOERR)
+					metrics_lcqs(&lcqstat);
+				if ((queue_depth > 0) && (lib_get_recpoolstat(sc, &poolstat) == LIBERR_NOERR))
+					metrics_recpool(&poolstat, sender_waiting());
+			}
+		}
+
+		/* the library drives a replay itself, it returns to idle with a reason once done */
+		if (replay) {
+			if ((lib_state == LIBSTATE_IDLE) && (errcode != LIBERR_NOERR)) {
+				if (errcode != LIBERR_CLOSED)
+					q330_error(1, errcode);
+				going = 0;
+			}
+			if (lib_state == LIBSTATE_TERM)
+				going = 0;
+			(void) usleep((going) ? 100000: 0);
+			continue;
+		}
+
 		/* ready to go ... */
 		switch(lib_state) {
 		case LIBSTATE_IDLE:
@@ -607,6 +1190,9 @@ int main(int argc, char **argv) {
     }
   }
 
+	/* the sender still holds records from the station context */
+	sender_stop();
+
 	/* closing down */
 	if (verbose)
 		ms_log (0, "destroying station thread\n");
@@ -614,6 +1200,13 @@ int main(int argc, char **argv) {
 	if (errcode != LIBERR_NOERR)
 		q330_error(1, errcode);
 
+	onesec_stop();
+	spool_stop();
+	dedup_close();
+	seedlink_stop();
+	shmring_stop();
+	metrics_stop();
+
  	if ((dlconn) && (dlconn->link != -1))
  	 dl_disconnect (dlconn);
 
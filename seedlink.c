@@ -0,0 +1,853 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define _GNU_SOURCE /* accept4 */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "shmring.h"
+#include "seedlink.h"
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION "unknown"
+#endif
+
+#define SEEDLINK_BUFFER (SEEDLINK_BATCH * SEEDLINK_PACKET)
+#define SEEDLINK_BACKLOG (64 * SEEDLINK_BUFFER) /* most replies held for a client, past that it is dropped */
+#define SEEDLINK_XML (SHMRING_STREAMS * 512 + 512) /* INFO STREAMS with a station line and a stream line per stream */
+#define SEEDLINK_INFODATA 456 /* xml carried by each info record, after its header and blockette 1000 */
+#define SEEDLINK_NEW UINT64_MAX /* start with the next record to arrive */
+
+/* a STATION command, or the whole station in uni-station mode */
+typedef struct seedlink_station {
+  char network[3];
+  char station[6];
+  char select[SEEDLINK_SELECTORS][10]; /* [LL]CCC[.T], ? for any, - for a blank location */
+  int selects;
+  uint64_t start; /* first record wanted */
+  time_t from, to; /* TIME window, zero if open */
+} seedlink_station;
+
+typedef struct seedlink_client {
+  int fd;
+  char host[64];
+  uint32_t events; /* as last given to epoll */
+  int multi; /* multi-station mode */
+  int batch; /* no OK or ERROR replies */
+  int streaming;
+  int fetch; /* close once caught up */
+  int closing; /* close once the output has gone */
+  char in[SEEDLINK_COMMAND];
+  int inlen;
+  char *out;
+  int outsize, outlen, outpos;
+  seedlink_station station[SEEDLINK_STATIONS];
+  int stations;
+  shmring_reader *reader;
+  long packets;
+} seedlink_client;
+
+static seedlink_client *clients[SEEDLINK_CLIENTS];
+static int nclients = 0;
+
+static int listen_fd = -1;
+static int notify_fd = -1;
+static int epoll_fd = -1;
+static int seedlink_verbose = 0;
+static int seedlink_going = 0;
+static pthread_t seedlink_thread;
+static time_t seedlink_started = 0;
+
+/* record types by lib330 packet class */
+static char seedlink_types[] = {
+  [PKC_DATA] = 'D', [PKC_EVENT] = 'E', [PKC_CALIBRATE] = 'C',
+  [PKC_TIMING] = 'T', [PKC_MESSAGE] = 'L', [PKC_OPAQUE] = 'O'
+};
+
+/* ? matches any one character, * any run of them */
+static int seedlink_glob(char *pattern, char *s) {
+  for (; *pattern; pattern++, s++) {
+    if (*pattern == '*') {
+      for (pattern++; ; s++) {
+        if (seedlink_glob(pattern, s))
+          return 1;
+        if (*s == '\0')
+          return 0;
+      }
+    }
+    if ((*s == '\0') || ((*pattern != '?') && (toupper((unsigned char) *pattern) != toupper((unsigned char) *s))))
+      return 0;
+  }
+  return (*s == '\0');
+}
+
+/* split a NN-SSSSS.LL.CCC ring key, the location padded to two characters */
+static void seedlink_codes(char *key, char *network, char *station, char *location, char *channel) {
+  char *s, *l, *c;
+
+  network[0] = station[0] = channel[0] = '\0';
+  (void) strcpy(location, "  ");
+
+  if (((s = strchr(key, '-')) == NULL) || ((l = strchr(s + 1, '.')) == NULL) || ((c = strchr(l + 1, '.')) == NULL))
+    return;
+
+  (void) snprintf(network, 3, "%.*s", (int) (s - key), key);
+  (void) snprintf(station, 6, "%.*s", (int) (l - s - 1), s + 1);
+  if (c - l - 1 > 0)
+    memcpy(location, l + 1, (c - l - 1 > 2) ? 2 : c - l - 1);
+  (void) snprintf(channel, 4, "%s", c + 1);
+}
+
+static int seedlink_selected(char *selector, char *location, char *channel, char type) {
+  char *dot = strchr(selector, '.');
+  int i, n = (dot != NULL) ? (int) (dot - selector) : (int) strlen(selector);
+
+  if ((dot != NULL) && (dot[1] != '\0') && (toupper((unsigned char) dot[1]) != type))
+    return 0;
+  if (n == 5) {
+    for (i = 0; i < 2; i++)
+      if ((selector[i] != '?') && (((selector[i] == '-') ? ' ' : toupper((unsigned char) selector[i])) != location[i]))
+        return 0;
+    selector += 2; n -= 2;
+  }
+  for (i = 0; i < n; i++)
+    if ((channel[i] == '\0') || ((selector[i] != '?') && (toupper((unsigned char) selector[i]) != channel[i])))
+      return 0;
+
+  return 1;
+}
+
+/* whether any of the client's stations asks for this record */
+static int seedlink_wanted(seedlink_client *c, shmring_record *rec) {
+  char network[3], station[6], location[3], channel[4];
+  char type = ((rec->class >= 0) && (rec->class < (int) sizeof(seedlink_types))) ? seedlink_types[rec->class] : 'D';
+  seedlink_station *st;
+  int i, j, yes, positive;
+
+  seedlink_codes(rec->key, network, station, location, channel);
+
+  for (i = 0; i < c->stations; i++) {
+    st = &c->station[i];
+    if ((rec->seq < st->start) || (!seedlink_glob(st->network, network)) || (!seedlink_glob(st->station, station)))
+      continue;
+    if (((st->from > 0) && (rec->start < (double) st->from)) || ((st->to > 0) && (rec->start >= (double) st->to)))
+      continue;
+
+    /* any positive selector must match, no negative one may */
+    for (yes = 0, positive = 0, j = 0; j < st->selects; j++) {
+      if (st->select[j][0] == '!') {
+        if (seedlink_selected(st->select[j] + 1, location, channel, type))
+          break;
+      }
+      else {
+        positive++;
+        yes |= seedlink_selected(st->select[j], location, channel, type);
+      }
+    }
+    if ((j == st->selects) && ((positive == 0) || (yes)))
+      return 1;
+  }
+
+  return 0;
+}
+
+/* the oldest record still in the ring */
+static uint64_t seedlink_oldest(shmring_reader *r) {
+  uint64_t head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+
+  return (head > (uint64_t) r->header->slots) ? head - r->header->slots : 0;
+}
+
+/* the record a client's 24 bit sequence number refers to, or SEEDLINK_NEW if it has gone */
+static uint64_t seedlink_resolve(shmring_reader *r, unsigned long seq) {
+  uint64_t head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+  uint64_t back = (head - seq) & 0xFFFFFF;
+
+  if ((back > head) || (head - back < seedlink_oldest(r)))
+    return SEEDLINK_NEW;
+
+  return head - back;
+}
+
+/* YYYY,MM,DD,hh,mm,ss */
+static time_t seedlink_time(char *s) {
+  struct tm tm;
+  int n;
+
+  memset(&tm, 0, sizeof(tm));
+  n = sscanf(s, "%d,%d,%d,%d,%d,%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+  if ((n < 3) || (tm.tm_year < 1970) || (tm.tm_mon < 1) || (tm.tm_mon > 12) || (tm.tm_mday < 1) || (tm.tm_mday > 31))
+    return -1;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+
+  return timegm(&tm);
+}
+
+static void seedlink_want(seedlink_client *c, int out) {
+  struct epoll_event ev;
+  uint32_t events = EPOLLIN | ((out) ? EPOLLOUT : 0);
+
+  if (events == c->events)
+    return;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = c;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) == 0)
+    c->events = events;
+}
+
+static void seedlink_drop(seedlink_client *c) {
+  int i;
+
+  if (seedlink_verbose)
+    ms_log(0, "seedlink client %s gone, %ld packets sent, %llu records missed\n", c->host, c->packets, (unsigned long long) c->reader->missed);
+
+  (void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  shmring_close(c->reader);
+  free(c->out);
+
+  for (i = 0; i < nclients; i++) {
+    if (clients[i] == c) {
+      clients[i] = clients[--nclients]; break;
+    }
+  }
+  free(c);
+}
+
+/* room for length more bytes, packets only fill a batch but replies grow the buffer until it is sent */
+static int seedlink_room(seedlink_client *c, int length) {
+  char *out;
+  int size;
+
+  if (c->outlen + length <= c->outsize)
+    return 0;
+  if (c->outlen + length > SEEDLINK_BACKLOG) {
+    ms_log(1, "seedlink client %s not reading its replies, dropping it\n", c->host); return -1;
+  }
+
+  for (size = c->outsize; size < c->outlen + length; size *= 2);
+  if ((out = (char *) realloc(c->out, size)) == NULL)
+    return -1;
+  c->out = out;
+  c->outsize = size;
+
+  return 0;
+}
+
+/* -1 if the client has to be dropped rather than miss a reply */
+static int seedlink_append(seedlink_client *c, char *data, int length) {
+  if (seedlink_room(c, length) < 0)
+    return -1;
+
+  memcpy(c->out + c->outlen, data, length);
+  c->outlen += length;
+
+  return 0;
+}
+
+static int seedlink_reply(seedlink_client *c, int ok) {
+  if (c->batch)
+    return 0;
+  return seedlink_append(c, (ok) ? "OK\r\n" : "ERROR\r\n", (ok) ? 4 : 7);
+}
+
+/* send what is waiting, -1 if the client has gone, 1 if some is left over */
+static int seedlink_send(seedlink_client *c) {
+  ssize_t n;
+  char *out;
+
+  while (c->outpos < c->outlen) {
+    if ((n = send(c->fd, c->out + c->outpos, c->outlen - c->outpos, MSG_NOSIGNAL)) < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return 1;
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    c->outpos += n;
+  }
+  c->outpos = c->outlen = 0;
+
+  /* back to a batch once a long reply has gone */
+  if ((c->outsize > SEEDLINK_BUFFER) && ((out = (char *) realloc(c->out, SEEDLINK_BUFFER)) != NULL)) {
+    c->out = out;
+    c->outsize = SEEDLINK_BUFFER;
+  }
+
+  return 0;
+}
+
+/* send what the client has not seen yet, a buffer at a time, -1 once it is finished with */
+static int seedlink_feed(seedlink_client *c) {
+  shmring_record rec;
+  time_t now;
+  int rc, closed, i;
+
+  if ((rc = seedlink_send(c)) != 0) {
+    seedlink_want(c, 1);
+    return rc;
+  }
+  if (c->closing)
+    return -1;
+  if (!c->streaming) {
+    seedlink_want(c, 0);
+    return 0;
+  }
+
+  while ((c->outlen + SEEDLINK_PACKET <= SEEDLINK_BUFFER) && ((rc = shmring_next(c->reader, &rec, 0)) > 0)) {
+    if ((rec.length != SHMRING_RECSIZE) || (!seedlink_wanted(c, &rec)))
+      continue;
+    (void) snprintf(c->out + c->outlen, 9, "SL%06X", (unsigned int) (rec.seq & 0xFFFFFF));
+    if (shmring_copy(c->reader, &rec, c->out + c->outlen + 8, SHMRING_RECSIZE) < 0) {
+      c->reader->missed++; continue;
+    }
+    c->outlen += SEEDLINK_PACKET;
+    c->packets++;
+  }
+
+  /* caught up, a fetch is done with, as are time windows once every station's has closed */
+  if ((rc == 0) && (c->outlen + SEEDLINK_PACKET <= SEEDLINK_BUFFER)) {
+    now = time(NULL);
+    for (closed = (c->stations > 0), i = 0; (closed) && (i < c->stations); i++)
+      closed = ((c->station[i].to > 0) && (now >= c->station[i].to));
+    if ((c->fetch) || (closed)) {
+      if (seedlink_append(c, "END", 3) < 0)
+        return -1;
+      c->closing = 1;
+    }
+  }
+
+  if ((rc = seedlink_send(c)) < 0)
+    return -1;
+  if ((rc == 0) && (c->closing))
+    return -1;
+
+  /* more to come straight away, or wait for the socket */
+  seedlink_want(c, (rc > 0) || (c->outlen > 0) || (c->reader->next < __atomic_load_n(&c->reader->header->head, __ATOMIC_ACQUIRE)));
+  return 0;
+}
+
+static void seedlink_begin(seedlink_client *c) {
+  uint64_t start = SEEDLINK_NEW, head;
+  int i;
+
+  head = __atomic_load_n(&c->reader->header->head, __ATOMIC_ACQUIRE);
+  for (i = 0; i < c->stations; i++) {
+    if (c->station[i].start == SEEDLINK_NEW)
+      c->station[i].start = head;
+    if (c->station[i].start < start)
+      start = c->station[i].start;
+  }
+  c->reader->next = (start == SEEDLINK_NEW) ? head : start;
+  c->streaming = 1;
+
+  if (seedlink_verbose)
+    ms_log(0, "seedlink client %s streaming %d station(s) from %llu\n", c->host, c->stations, (unsigned long long) c->reader->next);
+}
+
+/* the station being set up, in uni-station mode the one matching everything */
+static seedlink_station *seedlink_current(seedlink_client *c) {
+  seedlink_station *st;
+
+  if (c->stations > 0)
+    return &c->station[c->stations - 1];
+  if (c->multi)
+    return NULL;
+
+  st = &c->station[c->stations++];
+  memset(st, 0, sizeof(seedlink_station));
+  (void) strcpy(st->network, "*");
+  (void) strcpy(st->station, "*");
+  st->start = SEEDLINK_NEW;
+
+  return st;
+}
+
+/* the xml for INFO, as a station list and perhaps each stream */
+static int seedlink_xml(seedlink_client *c, char *level, char *xml, int size) {
+  char network[3], station[6], location[3], channel[4], first[32], latest[32];
+  char seen[SHMRING_STREAMS][9], key[9], *type;
+  shmring_stream *streams = c->reader->stream;
+  shmring_record rec;
+  uint64_t head = __atomic_load_n(&c->reader->header->head, __ATOMIC_ACQUIRE);
+  int streams_too = (strcasecmp(level, "STREAMS") == 0);
+  int nseen = 0, n, i, j, k;
+  struct tm tm;
+  time_t t;
+
+  t = seedlink_started;
+  (void) gmtime_r(&t, &tm);
+  n = snprintf(xml, size, "<?xml version=\"1.0\"?>\n<seedlink software=\"SeedLink v3.1 (quant2dali %s)\" organization=\"quant2dali\" started=\"%04d/%02d/%02d %02d:%02d:%02d.0000\"",
+    PACKAGE_VERSION, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+  if ((strcasecmp(level, "STATIONS") != 0) && (!streams_too))
+    return n + snprintf(xml + n, size - n, "/>\n");
+  n += snprintf(xml + n, size - n, ">\n");
+
+  /* each station once, with its streams after it */
+  for (i = 0; (i < c->reader->header->streams) && (n < size); i++) {
+    if (!__atomic_load_n(&streams[i].used, __ATOMIC_ACQUIRE))
+      continue;
+    seedlink_codes(streams[i].key, network, station, location, channel);
+    (void) snprintf(key, sizeof(key), "%s-%s", network, station);
+    for (j = 0; (j < nseen) && (strcmp(seen[j], key) != 0); j++);
+    if (j < nseen)
+      continue;
+    (void) strcpy(seen[nseen++], key);
+
+    n += snprintf(xml + n, size - n, "<station name=\"%s\" network=\"%s\" description=\"\" begin_seq=\"%06X\" end_seq=\"%06X\" stream_check=\"%s\"%s\n",
+      station, network, (unsigned int) (seedlink_oldest(c->reader) & 0xFFFFFF), (unsigned int) (head & 0xFFFFFF),
+      (streams_too) ? "enabled" : "disabled", (streams_too) ? ">" : "/>");
+    if (!streams_too)
+      continue;
+
+    for (k = 0; (k < c->reader->header->streams) && (n < size); k++) {
+      if ((!__atomic_load_n(&streams[k].used, __ATOMIC_ACQUIRE)) || (strncmp(streams[k].key, key, strlen(key)) != 0) || (streams[k].key[strlen(key)] != '.'))
+        continue;
+      seedlink_codes(streams[k].key, network, station, location, channel);
+      if (!shmring_latest(c->reader, k, &rec))
+        continue;
+      type = (((rec.class >= 0) && (rec.class < (int) sizeof(seedlink_types))) ? &seedlink_types[rec.class] : "D");
+      t = (time_t) rec.start;
+      (void) gmtime_r(&t, &tm);
+      (void) strftime(latest, sizeof(latest), "%Y/%m/%d %H:%M:%S.0000", &tm);
+      while (shmring_previous(c->reader, &rec));
+      t = (time_t) rec.start;
+      (void) gmtime_r(&t, &tm);
+      (void) strftime(first, sizeof(first), "%Y/%m/%d %H:%M:%S.0000", &tm);
+      n += snprintf(xml + n, size - n, "<stream location=\"%.2s\" seedname=\"%s\" type=\"%c\" begin_time=\"%s\" end_time=\"%s\" begin_recno=\"0\" end_recno=\"0\" gap_check=\"disabled\" gap_treshold=\"0\"/>\n",
+        location, channel, *type, first, latest);
+    }
+    n += snprintf(xml + n, size - n, "</station>\n");
+  }
+
+  n += snprintf(xml + n, size - n, "</seedlink>\n");
+  return (n < size) ? n : -1;
+}
+
+/* INFO replies are xml carried in ascii log records, all but the last marked with an asterisk, -1 if the client has to be dropped */
+static int seedlink_info(seedlink_client *c, char *level) {
+  static char xml[SEEDLINK_XML];
+  unsigned char *p;
+  int length, chunk, off;
+  struct tm tm;
+  time_t now;
+
+  if ((length = seedlink_xml(c, level, xml, sizeof(xml))) < 0)
+    return seedlink_reply(c, 0);
+  if (seedlink_room(c, ((length + SEEDLINK_INFODATA - 1) / SEEDLINK_INFODATA) * SEEDLINK_PACKET) < 0)
+    return -1;
+
+  now = time(NULL);
+  (void) gmtime_r(&now, &tm);
+
+  for (off = 0; off < length; off += chunk) {
+    chunk = ((length - off) > SEEDLINK_INFODATA) ? SEEDLINK_INFODATA : length - off;
+    p = (unsigned char *) c->out + c->outlen;
+    memcpy(p, (off + chunk < length) ? "SLINFO *" : "SLINFO  ", 8);
+    p += 8;
+
+    /* fixed header and blockette 1000, big-endian */
+    memset(p, 0, SHMRING_RECSIZE);
+    memcpy(p, "000000D INFO   INFSL", 20);
+    p[20] = (tm.tm_year + 1900) >> 8; p[21] = (tm.tm_year + 1900) & 0xFF;
+    p[22] = (tm.tm_yday + 1) >> 8; p[23] = (tm.tm_yday + 1) & 0xFF;
+    p[24] = tm.tm_hour; p[25] = tm.tm_min; p[26] = tm.tm_sec;
+    p[30] = chunk >> 8; p[31] = chunk & 0xFF;
+    p[39] = 1;
+    p[45] = 56;
+    p[47] = 48;
+    p[48] = 1000 >> 8; p[49] = 1000 & 0xFF;
+    p[52] = 0; p[53] = 1; p[54] = 9;
+    memcpy(p + 56, xml + off, chunk);
+
+    c->outlen += SEEDLINK_PACKET;
+  }
+
+  return 0;
+}
+
+static int seedlink_cat(seedlink_client *c) {
+  char network[3], station[6], location[3], channel[4], line[32];
+  char seen[SHMRING_STREAMS][9], key[9];
+  int nseen = 0, i, j;
+
+  for (i = 0; i < c->reader->header->streams; i++) {
+    if (!__atomic_load_n(&c->reader->stream[i].used, __ATOMIC_ACQUIRE))
+      continue;
+    seedlink_codes(c->reader->stream[i].key, network, station, location, channel);
+    (void) snprintf(key, sizeof(key), "%s-%s", network, station);
+    for (j = 0; (j < nseen) && (strcmp(seen[j], key) != 0); j++);
+    if (j < nseen)
+      continue;
+    (void) strcpy(seen[nseen++], key);
+    (void) snprintf(line, sizeof(line), "%-2s %-5s\r\n", network, station);
+    if (seedlink_append(c, line, strlen(line)) < 0)
+      return -1;
+  }
+  return seedlink_append(c, "END", 3);
+}
+
+/* DATA, FETCH and TIME, returns 0 if the arguments made sense */
+static int seedlink_position(seedlink_client *c, seedlink_station *st, char *verb, int argc, char **argv) {
+  unsigned long seq;
+  char *e;
+
+  st->start = SEEDLINK_NEW;
+  st->from = st->to = 0;
+
+  if (strcasecmp(verb, "TIME") == 0) {
+    if ((argc < 1) || ((st->from = seedlink_time(argv[0])) < 0) || ((argc > 1) && ((st->to = seedlink_time(argv[1])) < 0)))
+      return -1;
+    st->start = seedlink_oldest(c->reader);
+    return 0;
+  }
+
+  /* the sequence number of the next packet wanted, then perhaps the time of it */
+  if (argc > 0) {
+    seq = strtoul(argv[0], &e, 16);
+    if ((*e != '\0') || (seq > 0xFFFFFF))
+      return -1;
+    if ((st->start = seedlink_resolve(c->reader, seq)) == SEEDLINK_NEW) {
+      if (argc > 1) {
+        if ((st->from = seedlink_time(argv[1])) < 0)
+          return -1;
+        st->start = seedlink_oldest(c->reader);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* -1 once the client has gone or has to be dropped */
+static int seedlink_command(seedlink_client *c, char *line) {
+  char *argv[8], *verb, *s;
+  seedlink_station *st;
+  int argc = 0, ok = 0;
+
+  for (s = strtok(line, " \t"); (s != NULL) && (argc < 8); s = strtok(NULL, " \t"))
+    argv[argc++] = s;
+  if (argc == 0)
+    return 0;
+  verb = argv[0];
+
+  if (strcasecmp(verb, "HELLO") == 0) {
+    char hello[128];
+    (void) snprintf(hello, sizeof(hello), "SeedLink v3.1 (quant2dali %s) :: SLPROTO:3.1 CAP BATCH NSWILDCARD\r\nquant2dali\r\n", PACKAGE_VERSION);
+    return seedlink_append(c, hello, strlen(hello));
+  }
+  if (strcasecmp(verb, "BYE") == 0)
+    return -1;
+  if (strcasecmp(verb, "CAT") == 0)
+    return seedlink_cat(c);
+  if (strcasecmp(verb, "INFO") == 0)
+    return (argc < 2) ? seedlink_reply(c, 0) : seedlink_info(c, argv[1]);
+
+  /* the rest only make sense before any data is sent */
+  if (c->streaming)
+    return seedlink_reply(c, 0);
+
+  if (strcasecmp(verb, "BATCH") == 0) {
+    if (seedlink_reply(c, 1) < 0)
+      return -1;
+    c->batch = 1;
+    return 0;
+  }
+  if (strcasecmp(verb, "CAP") == 0)
+    return seedlink_reply(c, 1);
+
+  if (strcasecmp(verb, "STATION") == 0) {
+    /* the first STATION turns a uni-station setup into a multi-station one */
+    if (!c->multi)
+      c->stations = 0;
+    c->multi = 1;
+    if ((argc >= 2) && (c->stations < SEEDLINK_STATIONS) && (strlen(argv[1]) < sizeof(st->station)) && ((argc < 3) || (strlen(argv[2]) < sizeof(st->network)))) {
+      st = &c->station[c->stations++];
+      memset(st, 0, sizeof(seedlink_station));
+      (void) snprintf(st->station, sizeof(st->station), "%s", argv[1]);
+      (void) snprintf(st->network, sizeof(st->network), "%s", (argc > 2) ? argv[2] : "*");
+      st->start = SEEDLINK_NEW;
+      ok = 1;
+    }
+    return seedlink_reply(c, ok);
+  }
+
+  if (strcasecmp(verb, "SELECT") == 0) {
+    if ((st = seedlink_current(c)) != NULL) {
+      if (argc < 2) {
+        st->selects = 0; ok = 1;
+      }
+      else if ((st->selects < SEEDLINK_SELECTORS) && (strlen(argv[1]) < sizeof(st->select[0]))) {
+        (void) strcpy(st->select[st->selects++], argv[1]); ok = 1;
+      }
+    }
+    return seedlink_reply(c, ok);
+  }
+
+  if ((strcasecmp(verb, "DATA") == 0) || (strcasecmp(verb, "FETCH") == 0) || (strcasecmp(verb, "TIME") == 0)) {
+    if (((st = seedlink_current(c)) == NULL) || (seedlink_position(c, st, verb, argc - 1, argv + 1) < 0))
+      return seedlink_reply(c, 0);
+    c->fetch = (strcasecmp(verb, "FETCH") == 0);
+    /* uni-station mode starts straight away, multi-station waits for END */
+    if (c->multi)
+      return seedlink_reply(c, 1);
+    seedlink_begin(c);
+    return 0;
+  }
+
+  if (strcasecmp(verb, "END") == 0) {
+    if ((!c->multi) || (c->stations == 0))
+      return seedlink_reply(c, 0);
+    seedlink_begin(c);
+    return 0;
+  }
+
+  return seedlink_reply(c, 0);
+}
+
+/* read commands, -1 once the client has gone */
+static int seedlink_read(seedlink_client *c) {
+  ssize_t n;
+  int i, j;
+
+  while (1) {
+    if ((n = recv(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen, 0)) < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return 0;
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      return -1;
+    c->inlen += n;
+
+    /* lines end with a carriage return, a newline or both */
+    for (i = j = 0; i < c->inlen; i++) {
+      if ((c->in[i] == '\r') || (c->in[i] == '\n')) {
+        c->in[i] = '\0';
+        if (seedlink_command(c, c->in + j) < 0)
+          return -1;
+        j = i + 1;
+      }
+    }
+    if (j > 0) {
+      memmove(c->in, c->in + j, c->inlen - j);
+      c->inlen -= j;
+    }
+    else if (c->inlen == (int) sizeof(c->in)) {
+      return -1;
+    }
+  }
+}
+
+static void seedlink_accept(void) {
+  struct sockaddr_in sa;
+  socklen_t len;
+  struct epoll_event ev;
+  seedlink_client *c;
+  int fd, one = 1;
+
+  while (1) {
+    len = sizeof(sa);
+    if ((fd = accept4(listen_fd, (struct sockaddr *) &sa, &len, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0)
+      return;
+
+    if (nclients >= SEEDLINK_CLIENTS) {
+      ms_log(1, "seedlink connection from %s refused, %d clients already\n", inet_ntoa(sa.sin_addr), nclients);
+      close(fd); continue;
+    }
+    if ((c = (seedlink_client *) calloc(1, sizeof(seedlink_client))) == NULL) {
+      close(fd); continue;
+    }
+    if (((c->out = (char *) malloc(SEEDLINK_BUFFER)) == NULL) || ((c->reader = shmring_attach()) == NULL)) {
+      free(c->out); free(c); close(fd); continue;
+    }
+    c->outsize = SEEDLINK_BUFFER;
+    c->fd = fd;
+    (void) snprintf(c->host, sizeof(c->host), "%s:%d", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+    (void) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = c->events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      shmring_close(c->reader); free(c->out); free(c); close(fd); continue;
+    }
+    clients[nclients++] = c;
+
+    if (seedlink_verbose)
+      ms_log(0, "seedlink client %s connected\n", c->host);
+  }
+}
+
+static void *seedlink_main(void *arg) {
+  struct epoll_event ev[64];
+  seedlink_client *c;
+  uint64_t count;
+  int n, i, fresh;
+
+  while (seedlink_going) {
+    if ((n = epoll_wait(epoll_fd, ev, 64, 1000)) < 0) {
+      if (errno == EINTR)
+        continue;
+      ms_log(2, "seedlink epoll failed [%s]\n", strerror(errno));
+      break;
+    }
+
+    for (fresh = 0, i = 0; i < n; i++) {
+      if (ev[i].data.ptr == &listen_fd) {
+        seedlink_accept();
+      }
+      else if (ev[i].data.ptr == &notify_fd) {
+        (void) read(notify_fd, &count, sizeof(count));
+        fresh = 1;
+      }
+      else {
+        c = (seedlink_client *) ev[i].data.ptr;
+        if ((ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (seedlink_read(c) < 0)) {
+          seedlink_drop(c);
+          continue;
+        }
+        if (seedlink_feed(c) < 0) {
+          seedlink_drop(c);
+        }
+      }
+    }
+
+    /* new records for everyone streaming whose socket is not already full */
+    if (fresh) {
+      for (i = 0; i < nclients; i++) {
+        c = clients[i];
+        if ((!c->streaming) || (c->events & EPOLLOUT))
+          continue;
+        if (seedlink_feed(c) < 0) {
+          seedlink_drop(c); i--;
+        }
+      }
+    }
+  }
+
+  while (nclients > 0)
+    seedlink_drop(clients[0]);
+
+  return NULL;
+}
+
+/* call once the shmring has been started */
+int seedlink_start (int port, int verbose) {
+  struct sockaddr_in sa;
+  struct epoll_event ev;
+  int one = 1;
+
+  seedlink_verbose = verbose;
+  seedlink_started = time(NULL);
+
+  if ((listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+    ms_log(2, "can't create seedlink socket [%s]\n", strerror(errno)); return -1;
+  }
+  (void) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(port);
+  if ((bind(listen_fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) || (listen(listen_fd, SOMAXCONN) < 0)) {
+    ms_log(2, "can't listen for seedlink clients on port %d [%s]\n", port, strerror(errno)); seedlink_stop(); return -1;
+  }
+
+  if (((notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) || ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)) {
+    ms_log(2, "can't set up seedlink polling [%s]\n", strerror(errno)); seedlink_stop(); return -1;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listen_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+    ms_log(2, "can't poll seedlink socket [%s]\n", strerror(errno)); seedlink_stop(); return -1;
+  }
+  ev.data.ptr = &notify_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, notify_fd, &ev) < 0) {
+    ms_log(2, "can't poll seedlink notifications [%s]\n", strerror(errno)); seedlink_stop(); return -1;
+  }
+
+  seedlink_going = 1;
+  if (pthread_create(&seedlink_thread, NULL, seedlink_main, NULL) != 0) {
+    ms_log(2, "can't start seedlink thread\n"); seedlink_going = 0; seedlink_stop(); return -1;
+  }
+  shmring_notify(notify_fd);
+
+  return 0;
+}
+
+/* call once lib330 has stopped, and before the shmring is */
+void seedlink_stop (void) {
+  uint64_t one = 1;
+
+  shmring_notify(-1);
+  if (seedlink_going) {
+    seedlink_going = 0;
+    (void) write(notify_fd, &one, sizeof(one));
+    (void) pthread_join(seedlink_thread, NULL);
+  }
+
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  if (notify_fd >= 0)
+    close(notify_fd);
+  if (listen_fd >= 0)
+    close(listen_fd);
+  epoll_fd = notify_fd = listen_fd = -1;
+}
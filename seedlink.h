@@ -0,0 +1,33 @@
+#ifndef SEEDLINK_H
+#define SEEDLINK_H
+
+/*
+ * seedlink: a small SeedLink v3 server inside quant2dali, so clients can
+ * follow the station without a separate ringserver.
+ *
+ * Records come from the shmring the minidata callback publishes into, one
+ * reader per client, so a client resuming by sequence number or time gets
+ * whatever is still in the ring and a slow client skips ahead rather than
+ * holding anything up. One thread runs everything from an epoll loop: the
+ * listening socket, the clients and an eventfd the ring writes to after
+ * each record. Packets for a client are gathered into a buffer and sent
+ * together, and a client that cannot keep up is only written to again once
+ * its socket has room.
+ *
+ * Uni-station (SELECT, DATA, FETCH, TIME) and multi-station (STATION ...
+ * END) modes are supported, with BATCH, CAT and INFO ID, STATIONS and
+ * STREAMS. Packet sequence numbers are the ring's, modulo 2^24.
+ */
+
+#define SEEDLINK_PORT 18000
+#define SEEDLINK_CLIENTS 1024 /* connections at once */
+#define SEEDLINK_STATIONS 16 /* STATION commands per connection */
+#define SEEDLINK_SELECTORS 16 /* SELECT patterns per station */
+#define SEEDLINK_PACKET 520 /* "SL", six hex digits, then the record */
+#define SEEDLINK_BATCH 64 /* packets gathered before sending */
+#define SEEDLINK_COMMAND 256 /* longest command line */
+
+extern int seedlink_start (int port, int verbose);
+extern void seedlink_stop (void);
+
+#endif /* SEEDLINK_H */
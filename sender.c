@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "sender.h"
+
+static sender_send sender_sender = NULL;
+static sender_connect sender_connector = NULL;
+
+static pthread_mutex_t sender_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sender_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t sender_thread;
+static int sender_going = 0;
+static time_t sender_deadline = 0; /* when stopping, give up on what is left after this */
+
+/* held records in the order they arrived */
+static precord_ref *queue = NULL;
+static int queue_size = 0;
+static int queue_head = 0;
+static int queue_count = 0;
+
+/* wait a while, or until something changes */
+static void sender_wait(int seconds) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += seconds;
+
+  (void) pthread_cond_timedwait(&sender_cond, &sender_lock, &ts);
+}
+
+/* keep trying, unless stopping and out of time, returns whether it was sent */
+static int sender_write(char *record, int reclen) {
+  int sent;
+
+  while (!(sent = (sender_sender(record, reclen, 0) >= 0))) {
+    if ((!sender_going) && (time((time_t *) 0) >= sender_deadline))
+      break;
+    if (sender_connector() < 0) {
+      ms_log (1, "error re-connecting to datalink server, retrying in %d seconds\n", SENDER_RETRY);
+      pthread_mutex_lock(&sender_lock);
+      if (sender_going)
+        sender_wait(SENDER_RETRY);
+      pthread_mutex_unlock(&sender_lock);
+    }
+  }
+
+  return sent;
+}
+
+static void *sender_main(void *arg) {
+  precord_ref ref;
+  long dropped = 0;
+
+  pthread_mutex_lock(&sender_lock);
+  while (1) {
+    if (queue_count == 0) {
+      if (!sender_going)
+        break;
+      (void) pthread_cond_wait(&sender_cond, &sender_lock);
+      continue;
+    }
+    ref = queue[queue_head];
+    pthread_mutex_unlock(&sender_lock);
+
+    if (!sender_write((char *) ref->call.data_address, ref->call.data_size))
+      dropped++;
+
+    lib_record_release(ref);
+
+    pthread_mutex_lock(&sender_lock);
+    queue_head = (queue_head + 1) % queue_size;
+    queue_count--;
+    pthread_cond_broadcast(&sender_cond);
+  }
+  pthread_mutex_unlock(&sender_lock);
+
+  if (dropped > 0)
+    ms_log(1, "%ld queued records could not be sent before stopping\n", dropped);
+
+  return NULL;
+}
+
+/* hold the record and pass it to the sender, waiting for the sender if lib330 has none to spare */
+int sender_queue (tminiseed_call *data) {
+  static int oversized = 0;
+  precord_ref ref;
+
+  if (queue == NULL)
+    return -1;
+
+  pthread_mutex_lock(&sender_lock);
+  while (((ref = lib_record_hold(data)) == NULL) && (sender_going) && (queue_count > 0))
+    sender_wait(1);
+  /* lib330 can't hold it even with nothing queued, it is larger than a pooled record, so it
+     goes straight out from here, the sender is idle and nothing queued can be overtaken */
+  if ((ref == NULL) && (sender_going)) {
+    pthread_mutex_unlock(&sender_lock);
+    if (!oversized++)
+      ms_log(1, "a %d byte record is too large for the record pool, sending such records directly\n", data->data_size);
+    if (!sender_write((char *) data->data_address, data->data_size)) {
+      ms_log(1, "a %d byte record could not be sent before stopping\n", data->data_size);
+      return -1;
+    }
+    return 0;
+  }
+  if ((ref == NULL) || (!sender_going)) {
+    pthread_mutex_unlock(&sender_lock);
+    if (ref != NULL)
+      lib_record_release(ref);
+    return -1;
+  }
+  /* the queue is as deep as the pool, so there is always room */
+  queue[(queue_head + queue_count) % queue_size] = ref;
+  queue_count++;
+  pthread_cond_broadcast(&sender_cond);
+  pthread_mutex_unlock(&sender_lock);
+
+  return 0;
+}
+
+long sender_waiting (void) {
+  long count;
+
+  pthread_mutex_lock(&sender_lock);
+  count = queue_count;
+  pthread_mutex_unlock(&sender_lock);
+
+  return count;
+}
+
+int sender_start (int depth, sender_send send, sender_connect connect) {
+
+  if ((depth <= 0) || (send == NULL) || (connect == NULL))
+    return -1;
+
+  if ((queue = (precord_ref *) calloc(depth, sizeof(precord_ref))) == NULL) {
+    ms_log(2, "can't allocate the sender queue\n"); return -1;
+  }
+  queue_size = depth;
+  queue_head = queue_count = 0;
+  sender_sender = send;
+  sender_connector = connect;
+
+  sender_going = 1;
+  if (pthread_create(&sender_thread, NULL, sender_main, NULL) != 0) {
+    ms_log(2, "can't start sender thread\n"); sender_going = 0; free(queue); queue = NULL; return -1;
+  }
+
+  return 0;
+}
+
+/* call once lib330 has stopped, and before its context is destroyed */
+void sender_stop (void) {
+  if (!sender_going)
+    return;
+
+  pthread_mutex_lock(&sender_lock);
+  sender_going = 0;
+  sender_deadline = time((time_t *) 0) + SENDER_DRAIN;
+  pthread_cond_broadcast(&sender_cond);
+  pthread_mutex_unlock(&sender_lock);
+
+  (void) pthread_join(sender_thread, NULL);
+
+  free(queue);
+  queue = NULL;
+  queue_size = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef SENDER_H
+#define SENDER_H
+
+/*
+ * sender: write records to the datalink server from a thread of its own, so
+ * the lib330 station thread is not held up by a slow or reconnecting server.
+ *
+ * The minidata callback holds each record with lib_record_hold and queues
+ * the handle, the sender thread writes it and gives it back with
+ * lib_record_release. Nothing is copied again after lib330 fills its pool.
+ * When every pooled record is in use the callback waits for the sender, so
+ * records are delayed rather than reordered or dropped. A record too large
+ * for the pool is sent from the callback itself once the queue is empty.
+ * Stopping allows SENDER_DRAIN seconds for whatever is still queued.
+ */
+
+#define SENDER_RETRY 10 /* seconds between reconnection attempts */
+#define SENDER_DRAIN 10 /* seconds allowed to empty the queue when stopping */
+
+/* the sender calls these, sending fails with a negative value */
+typedef int (*sender_send) (char *record, int reclen, int ack);
+typedef int (*sender_connect) (void);
+
+extern int sender_start (int depth, sender_send send, sender_connect connect);
+extern void sender_stop (void);
+
+extern int sender_queue (tminiseed_call *data);
+extern long sender_waiting (void);
+
+#endif /* SENDER_H */
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "shmring.h"
+
+/* the writer's side, readers never touch these */
+static shmring_header *ring = NULL;
+static shmring_stream *ring_stream = NULL;
+static shmring_slot *ring_slot = NULL;
+static char *ring_data = NULL;
+static size_t ring_size = 0;
+static char *ring_name = NULL;
+static int ring_notify = -1; /* eventfd for readers in this process */
+
+/* slot data starts on a cache line */
+static size_t shmring_offset(int slots, int streams) {
+  size_t off;
+
+  off = sizeof(shmring_header) + streams * sizeof(shmring_stream) + slots * sizeof(shmring_slot);
+  return (off + 63) & ~((size_t) 63);
+}
+
+static size_t shmring_length(int slots, int streams, int recsize) {
+  return shmring_offset(slots, streams) + (size_t) slots * recsize;
+}
+
+/* fnv-1a */
+static uint32_t shmring_hash(char *key) {
+  uint32_t h = 2166136261u;
+
+  for (; *key; key++)
+    h = (h ^ (unsigned char) *key) * 16777619u;
+  return h;
+}
+
+static void shmring_wake(uint32_t *word) {
+#ifdef __linux__
+  (void) syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/* sleep while wake still holds value, for up to ms milliseconds */
+static void shmring_sleep(shmring_reader *r, uint32_t value, int ms) {
+#ifdef __linux__
+  struct timespec ts;
+
+  /* the writer doesn't know about this reader, so won't wake it */
+  if (!r->counted && (ms > SHMRING_POLL))
+    ms = SHMRING_POLL;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+
+  /* counted in before futex checks the word, the writer bumps it before looking at the count */
+  if (r->counted)
+    __atomic_add_fetch(&r->header->waiters, 1, __ATOMIC_SEQ_CST);
+  (void) syscall(SYS_futex, &r->header->wake, FUTEX_WAIT, value, &ts, NULL, 0);
+  if (r->counted)
+    __atomic_sub_fetch(&r->header->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+  if (__atomic_load_n(&r->header->wake, __ATOMIC_ACQUIRE) == value)
+    (void) usleep(((ms < SHMRING_POLL) ? ms : SHMRING_POLL) * 1000);
+#endif
+}
+
+static long shmring_msecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long) ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* find, or claim, the table entry for a stream */
+static int shmring_claim(char *key) {
+  shmring_stream *st;
+  int i, n;
+
+  for (i = shmring_hash(key) & (SHMRING_STREAMS - 1), n = 0; n < SHMRING_STREAMS; i = (i + 1) & (SHMRING_STREAMS - 1), n++) {
+    st = &ring_stream[i];
+    if (!st->used) {
+      (void) snprintf(st->key, sizeof(st->key), "%s", key);
+      __atomic_store_n(&st->used, 1, __ATOMIC_RELEASE);
+      return i;
+    }
+    if (strcmp(st->key, key) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+/* returns 0 once published, 1 for a record too large for a slot */
+int shmring_push (char *record, int reclen, char *key, double start, int class) {
+  shmring_stream *st = NULL;
+  shmring_slot *s;
+  uint64_t n, one = 1;
+  int i;
+
+  if (ring == NULL) {
+    errno = EINVAL; return -1;
+  }
+  if ((reclen <= 0) || (reclen > ring->recsize)) {
+    ring->dropped++; return 1;
+  }
+
+  if ((i = shmring_claim(key)) >= 0)
+    st = &ring_stream[i];
+
+  n = ring->head;
+  s = &ring_slot[n & (ring->slots - 1)];
+
+  /* readers still on the old record see it go before it changes */
+  __atomic_store_n(&s->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(ring_data + (size_t) (n & (ring->slots - 1)) * ring->recsize, record, reclen);
+  s->prev = (st != NULL) ? st->last : 0;
+  s->start = start;
+  s->stream = i;
+  s->length = reclen;
+  s->class = class;
+  __atomic_store_n(&s->seq, n + 1, __ATOMIC_RELEASE);
+
+  if (st != NULL) {
+    __atomic_store_n(&st->last, n + 1, __ATOMIC_RELEASE);
+    st->count++;
+  }
+  __atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+
+  /* a system call per record is most of the cost of publishing it, only wake a reader that is asleep */
+  __atomic_add_fetch(&ring->wake, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST) != 0)
+    shmring_wake(&ring->wake);
+  if (ring_notify >= 0)
+    (void) write(ring_notify, &one, sizeof(one));
+
+  return 0;
+}
+
+int shmring_start (char *name, int slots) {
+  int fd;
+
+  if ((ring != NULL) || (slots <= 0) || (slots & (slots - 1))) {
+    errno = EINVAL; return -1;
+  }
+  ring_size = shmring_length(slots, SHMRING_STREAMS, SHMRING_RECSIZE);
+
+  /* only readers in this process */
+  if (name == NULL) {
+    if ((ring = (shmring_header *) mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+      ring = NULL; return -1;
+    }
+  }
+  else {
+    /* any readers of an old ring keep it until they see the writer has gone */
+    (void) shm_unlink(name);
+    if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)
+      return -1;
+
+    if (ftruncate(fd, ring_size) < 0) {
+      close(fd); (void) shm_unlink(name); return -1;
+    }
+    if ((ring = (shmring_header *) mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+      ring = NULL; close(fd); (void) shm_unlink(name); return -1;
+    }
+    close(fd);
+
+    if ((ring_name = strdup(name)) == NULL) {
+      (void) munmap(ring, ring_size); ring = NULL; (void) shm_unlink(name); return -1;
+    }
+  }
+
+  ring_stream = (shmring_stream *) (ring + 1);
+  ring_slot = (shmring_slot *) (ring_stream + SHMRING_STREAMS);
+  ring_data = (char *) ring + shmring_offset(slots, SHMRING_STREAMS);
+
+  /* a new segment is all zeroes, the magic goes in last */
+  ring->version = SHMRING_VERSION;
+  ring->slots = slots;
+  ring->streams = SHMRING_STREAMS;
+  ring->recsize = SHMRING_RECSIZE;
+  ring->pid = (int32_t) getpid();
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(ring->magic, SHMRING_MAGIC, sizeof(ring->magic));
+
+  return 0;
+}
+
+void shmring_stop (void) {
+  if (ring == NULL)
+    return;
+
+  __atomic_store_n(&ring->pid, 0, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&ring->wake, 1, __ATOMIC_RELEASE);
+  shmring_wake(&ring->wake);
+
+  (void) munmap(ring, ring_size);
+  if (ring_name != NULL) {
+    (void) shm_unlink(ring_name);
+    free(ring_name);
+  }
+
+  ring = NULL; ring_stream = NULL; ring_slot = NULL; ring_data = NULL;
+  ring_name = NULL; ring_size = 0; ring_notify = -1;
+}
+
+/* write to this eventfd after every record, -1 to stop */
+void shmring_notify (int fd) {
+  ring_notify = fd;
+}
+
+/* fill in record n, unless it has already been overwritten */
+static int shmring_fetch(shmring_reader *r, uint64_t n, shmring_record *rec) {
+  shmring_slot *s = &r->slot[n & (r->header->slots - 1)];
+
+  if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != n + 1)
+    return -1;
+
+  rec->seq = n;
+  rec->prev = s->prev;
+  rec->start = s->start;
+  rec->stream = s->stream;
+  rec->length = s->length;
+  rec->class = s->class;
+  rec->data = r->data + (size_t) (n & (r->header->slots - 1)) * r->header->recsize;
+  rec->key = ((rec->stream >= 0) && (rec->stream < r->header->streams)) ? r->stream[rec->stream].key : "";
+
+  if (!shmring_valid(r, rec))
+    return -1;
+  if ((rec->length <= 0) || (rec->length > r->header->recsize))
+    return -1;
+
+  return 0;
+}
+
+int shmring_valid (shmring_reader *r, shmring_record *rec) {
+  shmring_slot *s = &r->slot[rec->seq & (r->header->slots - 1)];
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == rec->seq + 1);
+}
+
+int shmring_copy (shmring_reader *r, shmring_record *rec, char *buf, int size) {
+  if (size < rec->length) {
+    errno = EINVAL; return -1;
+  }
+
+  memcpy(buf, rec->data, rec->length);
+  return (shmring_valid(r, rec)) ? rec->length : -1;
+}
+
+int shmring_next (shmring_reader *r, shmring_record *rec, int timeout) {
+  long now, until, quiet;
+  uint64_t head;
+  uint32_t wake;
+  pid_t pid;
+
+  now = shmring_msecs();
+  until = now + timeout;
+  quiet = now + 1000;
+
+  while (1) {
+    wake = __atomic_load_n(&r->header->wake, __ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+
+    if (r->next < head) {
+      /* a whole ring behind, the oldest of these are gone */
+      if ((head - r->next) > (uint64_t) r->header->slots) {
+        r->missed += head - r->header->slots - r->next;
+        r->next = head - r->header->slots;
+      }
+      if (shmring_fetch(r, r->next++, rec) == 0)
+        return 1;
+      r->missed++;
+      continue;
+    }
+
+    /* stopped, or not heard from in a while and no longer running */
+    if ((pid = __atomic_load_n(&r->header->pid, __ATOMIC_ACQUIRE)) == 0)
+      return -1;
+    now = shmring_msecs();
+    if (now >= quiet) {
+      if ((kill(pid, 0) < 0) && (errno == ESRCH))
+        return -1;
+      quiet = now + 1000;
+    }
+
+    if ((timeout >= 0) && (now >= until))
+      return 0;
+    shmring_sleep(r, wake, (int) (((timeout >= 0) && (until < quiet)) ? until - now : quiet - now));
+  }
+}
+
+int shmring_find (shmring_reader *r, char *key) {
+  shmring_stream *st;
+  int mask = r->header->streams - 1;
+  int i, n;
+
+  for (i = shmring_hash(key) & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+    st = &r->stream[i];
+    if (!__atomic_load_n(&st->used, __ATOMIC_ACQUIRE))
+      return -1;
+    if (strncmp(st->key, key, sizeof(st->key)) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+/* 1 with the stream's latest record, 0 if there is none still in the ring */
+int shmring_latest (shmring_reader *r, int stream, shmring_record *rec) {
+  uint64_t last;
+
+  if ((stream < 0) || (stream >= r->header->streams))
+    return 0;
+  if ((last = __atomic_load_n(&r->stream[stream].last, __ATOMIC_ACQUIRE)) == 0)
+    return 0;
+
+  return (shmring_fetch(r, last - 1, rec) == 0);
+}
+
+/* 1 with the record before this one of the same stream, 0 if there is none still in the ring */
+int shmring_previous (shmring_reader *r, shmring_record *rec) {
+  shmring_record prev;
+
+  if ((rec->prev == 0) || (shmring_fetch(r, rec->prev - 1, &prev) < 0))
+    return 0;
+
+  *rec = prev;
+  return 1;
+}
+
+shmring_reader *shmring_open (char *name) {
+  shmring_reader *r;
+  shmring_header *h;
+  struct stat st;
+  long page;
+  int fd, counted = 1;
+
+  /* without write access to count itself in as a waiter the reader polls */
+  if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+    if ((errno != EACCES) || ((fd = shm_open(name, O_RDONLY, 0)) < 0))
+      return NULL;
+    counted = 0;
+  }
+  if (fstat(fd, &st) < 0) {
+    close(fd); return NULL;
+  }
+  if ((size_t) st.st_size < sizeof(shmring_header)) {
+    close(fd); errno = EAGAIN; return NULL;
+  }
+  if ((h = (shmring_header *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd); return NULL;
+  }
+  /* only the header page is writable, the records stay read only */
+  if (counted && ((page = sysconf(_SC_PAGESIZE)) > 0) && ((size_t) page <= (size_t) st.st_size))
+    counted = (mprotect(h, page, PROT_READ | PROT_WRITE) == 0);
+  else
+    counted = 0;
+  close(fd);
+
+  /* still being set up, or not one of ours */
+  if (memcmp(h->magic, SHMRING_MAGIC, sizeof(h->magic)) != 0) {
+    (void) munmap(h, st.st_size); errno = EAGAIN; return NULL;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if ((h->version != SHMRING_VERSION) || (h->slots <= 0) || (h->slots & (h->slots - 1)) ||
+      (h->streams <= 0) || (h->streams & (h->streams - 1)) || (h->recsize <= 0) ||
+      ((size_t) st.st_size != shmring_length(h->slots, h->streams, h->recsize))) {
+    (void) munmap(h, st.st_size); errno = EINVAL; return NULL;
+  }
+
+  if ((r = (shmring_reader *) calloc(1, sizeof(shmring_reader))) == NULL) {
+    (void) munmap(h, st.st_size); return NULL;
+  }
+  r->header = h;
+  r->stream = (shmring_stream *) (h + 1);
+  r->slot = (shmring_slot *) (r->stream + h->streams);
+  r->data = (char *) h + shmring_offset(h->slots, h->streams);
+  r->size = st.st_size;
+  r->counted = counted;
+  r->next = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+
+  return r;
+}
+
+/* a reader of the writer's own ring, from another thread of the same process */
+shmring_reader *shmring_attach (void) {
+  shmring_reader *r;
+
+  if (ring == NULL) {
+    errno = EINVAL; return NULL;
+  }
+  if ((r = (shmring_reader *) calloc(1, sizeof(shmring_reader))) == NULL)
+    return NULL;
+
+  r->header = ring;
+  r->stream = ring_stream;
+  r->slot = ring_slot;
+  r->data = ring_data;
+  r->counted = 1;
+  r->next = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  return r;
+}
+
+void shmring_close (shmring_reader *r) {
+  if (r == NULL)
+    return;
+
+  /* attached readers share the writer's mapping */
+  if (r->size > 0)
+    (void) munmap(r->header, r->size);
+  free(r);
+}
@@ -0,0 +1,116 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+/*
+ * shmring: publish every 512 byte miniseed record in a POSIX shared memory
+ * ring, so programs on the same host can pick them up straight from memory
+ * rather than through the datalink server.
+ *
+ * The segment holds a header, a table of streams, a descriptor for each
+ * slot and then the fixed size slots themselves. Records are numbered as
+ * they are written, record n going in slot n modulo the ring size. There
+ * is one writer, quant2dali's minidata callback, and any number of readers
+ * which never write the records, only a count in the header.
+ *
+ * The writer clears a slot's sequence before overwriting it and sets it
+ * again once the record is complete, so a reader checks the sequence either
+ * side of using a record and knows whether it was overwritten underneath it.
+ * Each descriptor also points back to the previous record of its stream,
+ * and each stream remembers its latest, so a reader can look up one stream
+ * without scanning the ring. A reader falling a whole ring behind skips
+ * ahead and counts what it missed, it never holds the writer up.
+ *
+ * Readers sleep on a futex word the writer bumps after every record, or
+ * poll where there is no futex. A reader counts itself in the header while
+ * it sleeps and the writer only makes the wake call when someone is there;
+ * a reader that may not write the segment polls instead. Without a name the ring is private to the
+ * process, for readers attached from other threads, which can also be told
+ * of each record through an eventfd and so wait in epoll alongside sockets.
+ */
+
+#include <stdint.h>
+
+#define SHMRING_MAGIC "QSHR"
+#define SHMRING_VERSION 1
+#define SHMRING_RECSIZE 512 /* only records of this size are published */
+#define SHMRING_SLOTS 16384 /* a power of two, 8 MB of records */
+#define SHMRING_STREAMS 1024 /* a power of two, well above the channels of one station */
+#define SHMRING_POLL 1 /* milliseconds between looks without a futex */
+
+typedef struct shmring_header {
+  char magic[4];
+  int32_t version;
+  int32_t slots;
+  int32_t streams;
+  int32_t recsize;
+  int32_t pid; /* the writer, zero once it has stopped */
+  uint32_t wake; /* futex word, bumped after every record */
+  uint32_t waiters; /* readers asleep on wake, one killed asleep only costs needless wakes */
+  uint64_t head; /* sequence number the next record will have */
+  uint64_t dropped; /* records too large for a slot */
+} shmring_header;
+
+typedef struct shmring_stream {
+  char key[20]; /* NN-SSSSS.LL.CCC, set once */
+  int32_t used; /* the key is complete */
+  uint64_t last; /* sequence number of the latest record plus one, zero for none */
+  uint64_t count; /* records written */
+} shmring_stream;
+
+typedef struct shmring_slot {
+  uint64_t seq; /* sequence number plus one, zero while being written */
+  uint64_t prev; /* the stream's previous record, as for last */
+  double start; /* record start time, seconds since 1970 */
+  int32_t stream; /* index into the stream table */
+  int16_t length; /* bytes used in the slot */
+  int16_t class; /* lib330 packet class */
+} shmring_slot;
+
+/* a record as handed to a reader, data points into the ring */
+typedef struct shmring_record {
+  uint64_t seq;
+  uint64_t prev;
+  double start;
+  int stream;
+  int length;
+  int class;
+  char *key;
+  char *data;
+} shmring_record;
+
+typedef struct shmring_reader {
+  shmring_header *header;
+  shmring_stream *stream;
+  shmring_slot *slot;
+  char *data;
+  size_t size;
+  uint64_t next; /* the next record to read */
+  uint64_t missed; /* records overwritten before they were read */
+  int counted; /* may count itself in waiters, otherwise it polls */
+} shmring_reader;
+
+/* writer, the name is as for shm_open or NULL for a private ring, failures leave errno set */
+extern int shmring_start (char *name, int slots);
+extern void shmring_stop (void);
+extern void shmring_notify (int fd);
+
+extern int shmring_push (char *record, int reclen, char *key, double start, int class);
+
+/* readers start with the next record written */
+extern shmring_reader *shmring_open (char *name);
+extern shmring_reader *shmring_attach (void);
+extern void shmring_close (shmring_reader *r);
+
+/* 1 for a record, 0 if none arrived in time, -1 once the writer has gone; a negative timeout waits forever */
+extern int shmring_next (shmring_reader *r, shmring_record *rec, int timeout);
+/* whether a record handed out is still intact, check after using it in place */
+extern int shmring_valid (shmring_reader *r, shmring_record *rec);
+/* copy a record out of the ring, returns its length or -1 if it has been overwritten */
+extern int shmring_copy (shmring_reader *r, shmring_record *rec, char *buf, int size);
+
+/* stream lookups, for a reader following one stream */
+extern int shmring_find (shmring_reader *r, char *key);
+extern int shmring_latest (shmring_reader *r, int stream, shmring_record *rec);
+extern int shmring_previous (shmring_reader *r, shmring_record *rec);
+
+#endif /* SHMRING_H */
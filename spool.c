@@ -0,0 +1,597 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* libmseed library includes */
+#include <libmseed.h>
+
+/* lib330 library includes */
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "spool.h"
+#include "metrics.h"
+
+#define SPOOL_SUFFIX ".spool"
+#define SPOOL_POSITION "spool.pos"
+
+/* every record is prefixed with this, in host byte order */
+typedef struct spool_entry {
+  uint32_t length;
+  uint32_t crc;
+  uint32_t spooled; /* unix time it was written */
+} spool_entry;
+
+typedef struct spool_segment {
+  unsigned int seq;
+  off_t size; /* bytes written */
+  long records; /* records not yet drained */
+  long long bytes;
+} spool_segment;
+
+static char *spool_dir = NULL;
+static long long spool_max = 0;
+static spool_send spool_sender = NULL;
+static spool_connect spool_connector = NULL;
+
+static pthread_mutex_t spool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t spool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t spool_thread;
+static int spool_going = 0;
+
+static spool_segment *segments = NULL; /* oldest first, the last is being written */
+static int nsegments = 0;
+static int maxsegments = 0;
+
+static int write_fd = -1;
+
+static unsigned int commit_seq = 0; /* everything before here has been acknowledged */
+static off_t commit_off = 0;
+static int commit_reset = 0; /* the drainer must go back to the commit point */
+
+static uint32_t crc_table[256];
+
+static void crc_init(void) {
+  uint32_t c;
+  int n, k;
+
+  for (n = 0; n < 256; n++) {
+    for (c = (uint32_t) n, k = 0; k < 8; k++)
+      c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+static uint32_t crc32(char *buf, int len) {
+  uint32_t c = 0xffffffff;
+  int n;
+
+  for (n = 0; n < len; n++)
+    c = crc_table[(c ^ (unsigned char) buf[n]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffff;
+}
+
+static char *segment_name(unsigned int seq, char *name, int len) {
+  (void) snprintf(name, len, "%s/%010u%s", spool_dir, seq, SPOOL_SUFFIX);
+  return name;
+}
+
+static spool_segment *segment_find(unsigned int seq) {
+  int i;
+
+  for (i = 0; i < nsegments; i++) {
+    if (segments[i].seq == seq)
+      return &segments[i];
+  }
+  return NULL;
+}
+
+static spool_segment *segment_add(unsigned int seq) {
+  spool_segment *s;
+
+  if (nsegments == maxsegments) {
+    if ((s = (spool_segment *) realloc(segments, (maxsegments + 16) * sizeof(spool_segment))) == NULL)
+      return NULL;
+    segments = s; maxsegments += 16;
+  }
+  s = &segments[nsegments++];
+  memset(s, 0, sizeof(spool_segment));
+  s->seq = seq;
+  return s;
+}
+
+/* only called with the lock held */
+static void segment_remove(int index) {
+  char name[PATH_MAX];
+
+  (void) unlink(segment_name(segments[index].seq, name, sizeof(name)));
+  memmove(&segments[index], &segments[index + 1], (nsegments - index - 1) * sizeof(spool_segment));
+  nsegments--;
+}
+
+static void spool_report(int spooled, int drained, int dropped, time_t oldest) {
+  long long bytes = 0;
+  long records = 0;
+  int i;
+
+  for (i = 0; i < nsegments; i++) {
+    bytes += segments[i].bytes;
+    records += segments[i].records;
+  }
+  /* the age is only known once the drainer has looked at the oldest record */
+  metrics_spool(bytes, records, (records == 0) ? 0.0 : (oldest > 0) ? (double) (time(NULL) - oldest) : -1.0, spooled, drained, dropped);
+}
+
+/* a new or renamed file is only durable once its directory is */
+static int dir_sync(void) {
+  int fd, rc;
+
+  if ((fd = open(spool_dir, O_RDONLY | O_DIRECTORY)) < 0)
+    return -1;
+  rc = fsync(fd);
+  close(fd);
+
+  return rc;
+}
+
+static int position_write(unsigned int seq, off_t off) {
+  char name[PATH_MAX], tmp[PATH_MAX], buf[64];
+  int fd, n;
+
+  (void) snprintf(name, sizeof(name), "%s/%s", spool_dir, SPOOL_POSITION);
+  (void) snprintf(tmp, sizeof(tmp), "%s/%s.tmp", spool_dir, SPOOL_POSITION);
+  n = snprintf(buf, sizeof(buf), "%u %lld\n", seq, (long long) off);
+
+  if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    return -1;
+  if ((write(fd, buf, n) != n) || (fdatasync(fd) < 0)) {
+    close(fd); return -1;
+  }
+  close(fd);
+
+  if (rename(tmp, name) < 0)
+    return -1;
+  return dir_sync();
+}
+
+static void position_read(unsigned int *seq, off_t *off) {
+  char name[PATH_MAX];
+  long long o = 0;
+  unsigned int s = 0;
+  FILE *fp;
+
+  *seq = 0; *off = 0;
+
+  (void) snprintf(name, sizeof(name), "%s/%s", spool_dir, SPOOL_POSITION);
+  if ((fp = fopen(name, "r")) == NULL)
+    return;
+  if (fscanf(fp, "%u %lld", &s, &o) == 2) {
+    *seq = s; *off = (off_t) o;
+  }
+  fclose(fp);
+}
+
+/* read the record at an offset, zero at the end of the written data */
+static int entry_read(int fd, off_t off, off_t size, spool_entry *e, char *record) {
+
+  if ((off + (off_t) sizeof(spool_entry)) > size)
+    return 0;
+  if (pread(fd, e, sizeof(spool_entry), off) != sizeof(spool_entry))
+    return -1;
+  if ((e->length == 0) || (e->length > SPOOL_MAXRECORD) || ((off + (off_t) sizeof(spool_entry) + e->length) > size))
+    return -1;
+  if (pread(fd, record, e->length, off + sizeof(spool_entry)) != (ssize_t) e->length)
+    return -1;
+  if (crc32(record, e->length) != e->crc)
+    return -1;
+
+  return (int) e->length;
+}
+
+/* count what is left to send in a segment, cutting off anything torn */
+static int segment_scan(spool_segment *s, off_t from) {
+  char name[PATH_MAX], record[SPOOL_MAXRECORD];
+  spool_entry e;
+  struct stat st;
+  off_t off;
+  int fd, n;
+
+  if ((fd = open(segment_name(s->seq, name, sizeof(name)), O_RDWR)) < 0)
+    return -1;
+  if (fstat(fd, &st) < 0) {
+    close(fd); return -1;
+  }
+
+  for (off = 0; (n = entry_read(fd, off, st.st_size, &e, record)) > 0; off += sizeof(spool_entry) + n) {
+    if (off >= from) {
+      s->records++;
+      s->bytes += n;
+    }
+  }
+  if (off < st.st_size) {
+    ms_log(1, "spool segment %s damaged, dropping %lld bytes\n", name, (long long) (st.st_size - off));
+    if (ftruncate(fd, off) < 0) {
+      close(fd); return -1;
+    }
+  }
+  s->size = off;
+  close(fd);
+
+  return 0;
+}
+
+static int seq_compare(const void *a, const void *b) {
+  unsigned int x = *(unsigned int *) a, y = *(unsigned int *) b;
+  return (x < y) ? -1 : (x > y);
+}
+
+/* pick up whatever a previous run left behind */
+static int spool_recover(void) {
+  unsigned int *seqs = NULL, *p, seq;
+  int nseqs = 0, i;
+  char name[PATH_MAX];
+  struct dirent *d;
+  spool_segment *s;
+  size_t len;
+  DIR *dir;
+
+  if ((dir = opendir(spool_dir)) == NULL) {
+    ms_log(2, "can't open spool directory %s [%s]\n", spool_dir, strerror(errno)); return -1;
+  }
+  while ((d = readdir(dir)) != NULL) {
+    len = strlen(d->d_name);
+    if ((len <= strlen(SPOOL_SUFFIX)) || (strcmp(d->d_name + len - strlen(SPOOL_SUFFIX), SPOOL_SUFFIX) != 0))
+      continue;
+    if (sscanf(d->d_name, "%u", &seq) != 1)
+      continue;
+    if ((p = (unsigned int *) realloc(seqs, (nseqs + 1) * sizeof(unsigned int))) == NULL) {
+      closedir(dir); free(seqs); return -1;
+    }
+    seqs = p; seqs[nseqs++] = seq;
+  }
+  closedir(dir);
+
+  qsort(seqs, nseqs, sizeof(unsigned int), seq_compare);
+  position_read(&commit_seq, &commit_off);
+
+  for (i = 0; i < nseqs; i++) {
+    /* already drained */
+    if (seqs[i] < commit_seq) {
+      (void) unlink(segment_name(seqs[i], name, sizeof(name))); continue;
+    }
+    if ((s = segment_add(seqs[i])) == NULL) {
+      free(seqs); return -1;
+    }
+    if (segment_scan(s, (s->seq == commit_seq) ? commit_off : 0) < 0) {
+      ms_log(2, "can't read spool segment %s [%s]\n", segment_name(s->seq, name, sizeof(name)), strerror(errno));
+      free(seqs); return -1;
+    }
+  }
+  free(seqs);
+
+  /* start from the oldest segment still around */
+  if ((nsegments > 0) && (segments[0].seq != commit_seq)) {
+    commit_seq = segments[0].seq; commit_off = 0;
+  }
+
+  return 0;
+}
+
+/* start writing a new segment after the last one */
+static int segment_open(void) {
+  char name[PATH_MAX];
+  spool_segment *s;
+
+  if (write_fd != -1) {
+    (void) fdatasync(write_fd);
+    close(write_fd);
+  }
+
+  if ((nsegments > 0) && (segments[nsegments - 1].size < SPOOL_SEGMENT))
+    s = &segments[nsegments - 1];
+  else if ((s = segment_add((nsegments > 0) ? segments[nsegments - 1].seq + 1 : commit_seq)) == NULL)
+    return -1;
+
+  if ((write_fd = open(segment_name(s->seq, name, sizeof(name)), O_WRONLY | O_CREAT, 0644)) < 0) {
+    ms_log(2, "can't open spool segment %s [%s]\n", name, strerror(errno)); return -1;
+  }
+
+  /* the segment may be new */
+  if (dir_sync() < 0) {
+    ms_log(2, "can't sync spool directory %s [%s]\n", spool_dir, strerror(errno)); return -1;
+  }
+
+  return 0;
+}
+
+/* only called with the lock held */
+static void spool_trim(void) {
+  long long size = 0;
+  int i, dropped = 0;
+
+  for (i = 0; i < nsegments; i++)
+    size += segments[i].size;
+
+  /* never the segment being written */
+  while ((spool_max > 0) && (size > spool_max) && (nsegments > 1)) {
+    ms_log(1, "spool full, dropping %ld records\n", segments[0].records);
+    size -= segments[0].size;
+    dropped += segments[0].records;
+    segment_remove(0);
+
+    commit_seq = segments[0].seq;
+    commit_off = 0;
+    commit_reset = 1;
+    (void) position_write(commit_seq, commit_off);
+  }
+
+  if (dropped > 0)
+    spool_report(0, 0, dropped, 0);
+}
+
+int spool_write (char *record, int reclen) {
+  spool_entry e;
+  spool_segment *s;
+
+  if ((reclen <= 0) || (reclen > SPOOL_MAXRECORD))
+    return -1;
+
+  e.length = (uint32_t) reclen;
+  e.crc = crc32(record, reclen);
+  e.spooled = (uint32_t) time(NULL);
+
+  pthread_mutex_lock(&spool_lock);
+
+  if ((write_fd == -1) || (segments[nsegments - 1].size >= SPOOL_SEGMENT)) {
+    if (segment_open() < 0) {
+      pthread_mutex_unlock(&spool_lock); return -1;
+    }
+  }
+
+  s = &segments[nsegments - 1];
+  if (pwrite(write_fd, &e, sizeof(spool_entry), s->size) != sizeof(spool_entry)
+    || (pwrite(write_fd, record, reclen, s->size + sizeof(spool_entry)) != reclen)) {
+    ms_log(2, "can't write spool segment [%s]\n", strerror(errno));
+    /* leave the torn entry for the next write to cover */
+    pthread_mutex_unlock(&spool_lock); return -1;
+  }
+
+  /* the caller lets go of the record once this returns, so it has to be on disk */
+  if (fdatasync(write_fd) < 0) {
+    ms_log(2, "can't sync spool segment [%s]\n", strerror(errno));
+    pthread_mutex_unlock(&spool_lock); return -1;
+  }
+
+  s->size += sizeof(spool_entry) + reclen;
+  s->records++;
+  s->bytes += reclen;
+
+  spool_trim();
+  spool_report(1, 0, 0, 0);
+
+  pthread_cond_signal(&spool_cond);
+  pthread_mutex_unlock(&spool_lock);
+
+  return 0;
+}
+
+/* new records must follow the spool while anything is left in it */
+int spool_busy (void) {
+  int i, busy = 0;
+
+  pthread_mutex_lock(&spool_lock);
+  for (i = 0; i < nsegments; i++)
+    busy += (segments[i].records > 0);
+  pthread_mutex_unlock(&spool_lock);
+
+  return busy;
+}
+
+/* wait a while, unless told to stop */
+static void spool_wait(int seconds) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += seconds;
+
+  pthread_mutex_lock(&spool_lock);
+  if (spool_going)
+    (void) pthread_cond_timedwait(&spool_cond, &spool_lock, &ts);
+  pthread_mutex_unlock(&spool_lock);
+}
+
+static void *spool_main(void *arg) {
+  char name[PATH_MAX], record[SPOOL_MAXRECORD];
+  unsigned int seq = commit_seq, read_seq = 0;
+  unsigned int batch_seq[SPOOL_BATCH];
+  long batch_bytes[SPOOL_BATCH];
+  int nbatch = 0, connected = 1;
+  off_t off = commit_off, size;
+  spool_segment *s;
+  spool_entry e;
+  int fd = -1, n, i, last;
+  time_t oldest = 0;
+
+  while (spool_going) {
+
+    pthread_mutex_lock(&spool_lock);
+    if (commit_reset) {
+      seq = commit_seq; off = commit_off; nbatch = 0; commit_reset = 0;
+    }
+    /* step over finished segments */
+    while (((s = segment_find(seq)) != NULL) && (off >= s->size) && (s != &segments[nsegments - 1])) {
+      seq = (s + 1)->seq; off = 0;
+    }
+    if ((s == NULL) && (nsegments > 0) && (seq < segments[0].seq)) {
+      seq = segments[0].seq; off = 0; s = &segments[0];
+    }
+    size = (s != NULL) ? s->size : 0;
+    /* nothing more after this record, so it closes the batch */
+    last = (s == NULL) || (s == &segments[nsegments - 1]);
+    if ((s == NULL) || (off >= size)) {
+      spool_report(0, 0, 0, 0);
+      if (spool_going)
+        (void) pthread_cond_wait(&spool_cond, &spool_lock);
+      pthread_mutex_unlock(&spool_lock);
+      continue;
+    }
+    pthread_mutex_unlock(&spool_lock);
+
+    if ((fd == -1) || (read_seq != seq)) {
+      if (fd != -1)
+        close(fd);
+      if ((fd = open(segment_name(seq, name, sizeof(name)), O_RDONLY)) < 0) {
+        ms_log(2, "can't open spool segment %s [%s]\n", name, strerror(errno));
+        spool_wait(SPOOL_RETRY); continue;
+      }
+      read_seq = seq;
+    }
+
+    if ((n = entry_read(fd, off, size, &e, record)) <= 0) {
+      ms_log(2, "spool segment %s unreadable at %lld\n", name, (long long) off);
+      spool_wait(SPOOL_RETRY); continue;
+    }
+    oldest = (time_t) e.spooled;
+
+    if (!connected) {
+      if (spool_connector() < 0) {
+        ms_log(1, "error re-connecting to datalink server, spooling for %d seconds\n", SPOOL_RETRY);
+        pthread_mutex_lock(&spool_lock);
+        spool_report(0, 0, 0, oldest);
+        pthread_mutex_unlock(&spool_lock);
+        spool_wait(SPOOL_RETRY); continue;
+      }
+      connected = 1;
+    }
+
+    last = last && ((off + (off_t) sizeof(spool_entry) + n) >= size);
+    if (spool_sender(record, n, ((nbatch + 1) >= SPOOL_BATCH) || last) < 0) {
+      /* everything since the last acknowledgement goes again */
+      connected = 0;
+      pthread_mutex_lock(&spool_lock);
+      commit_reset = 1;
+      pthread_mutex_unlock(&spool_lock);
+      continue;
+    }
+
+    batch_seq[nbatch] = seq;
+    batch_bytes[nbatch++] = n;
+    off += sizeof(spool_entry) + n;
+
+    if ((nbatch < SPOOL_BATCH) && (!last))
+      continue;
+
+    /* the server has everything up to here */
+    pthread_mutex_lock(&spool_lock);
+    if (!commit_reset) {
+      for (i = 0; i < nbatch; i++) {
+        if ((s = segment_find(batch_seq[i])) != NULL) {
+          s->records--; s->bytes -= batch_bytes[i];
+        }
+      }
+      commit_seq = seq; commit_off = off;
+      (void) position_write(commit_seq, commit_off);
+      /* older segments are finished with */
+      while ((nsegments > 1) && (segments[0].seq < commit_seq))
+        segment_remove(0);
+      spool_report(0, nbatch, 0, oldest);
+    }
+    nbatch = 0;
+    pthread_mutex_unlock(&spool_lock);
+  }
+
+  if (fd != -1)
+    close(fd);
+
+  return NULL;
+}
+
+int spool_start (char *dir, long long maxbytes, spool_send send, spool_connect connect) {
+  long records = 0;
+  int i;
+
+  spool_dir = dir;
+  spool_max = maxbytes;
+  spool_sender = send;
+  spool_connector = connect;
+
+  crc_init();
+
+  if ((mkdir(spool_dir, 0755) < 0) && (errno != EEXIST)) {
+    ms_log(2, "can't create spool directory %s [%s]\n", spool_dir, strerror(errno)); return -1;
+  }
+  if (spool_recover() < 0)
+    return -1;
+
+  for (i = 0; i < nsegments; i++)
+    records += segments[i].records;
+  if (records > 0)
+    ms_log(0, "spool %s holds %ld records to send\n", spool_dir, records);
+
+  spool_going = 1;
+  if (pthread_create(&spool_thread, NULL, spool_main, NULL) != 0) {
+    ms_log(2, "can't start spool thread\n"); spool_going = 0; return -1;
+  }
+
+  return 0;
+}
+
+void spool_stop (void) {
+  if (!spool_going)
+    return;
+
+  pthread_mutex_lock(&spool_lock);
+  spool_going = 0;
+  pthread_cond_broadcast(&spool_cond);
+  pthread_mutex_unlock(&spool_lock);
+
+  (void) pthread_join(spool_thread, NULL);
+
+  if (write_fd != -1) {
+    (void) fdatasync(write_fd);
+    close(write_fd);
+  }
+  write_fd = -1;
+
+  free(segments);
+  segments = NULL;
+  nsegments = maxsegments = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+/*
+ * spool: a durable on-disk queue of miniseed records for datalink outages.
+ *
+ * Records are appended to numbered segment files in the spool directory,
+ * each one prefixed with its length, a crc and the time it was spooled.
+ * spool_write syncs each record to disk before it returns, and new segment
+ * files with their directory. A drainer thread sends them on in order once
+ * the server is back, with only every SPOOL_BATCH-th write acknowledged,
+ * and records how far it got in a position file after each acknowledgement,
+ * synced along with the directory it is renamed into. After a crash the
+ * spool resumes from that position, so records may be sent twice but none
+ * that spool_write accepted is lost, and a torn record at the end of a
+ * segment is cut off. Records still being built inside lib330 when the
+ * program stops are not covered.
+ *
+ * The oldest segments are removed once the spool grows past its limit.
+ */
+
+#define SPOOL_SEGMENT (8 * 1024 * 1024) /* segment file size before starting the next */
+#define SPOOL_BATCH 64 /* records sent between acknowledgements */
+#define SPOOL_MAXRECORD 16384 /* anything larger is not a miniseed record */
+#define SPOOL_RETRY 10 /* seconds between reconnection attempts */
+
+/* the drainer calls these, sending fails with a negative value */
+typedef int (*spool_send) (char *record, int reclen, int ack);
+typedef int (*spool_connect) (void);
+
+extern int spool_start (char *dir, long long maxbytes, spool_send send, spool_connect connect);
+extern void spool_stop (void);
+
+extern int spool_write (char *record, int reclen);
+extern int spool_busy (void);
+
+#endif /* SPOOL_H */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * caltest: check lib330_calendar against the C library for every day it
+ * covers, before 2000 as well as after, every second around each year end and leap day, and with times
+ * going backwards and forwards across day boundaries so the cached day is
+ * both reused and replaced. Several threads run at once, each has its own
+ * cached day.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libtime.h"
+
+#define EPOCH2000 946684800
+#define THREADS 4
+
+static int compare(longint jul) {
+  tcalendar cal;
+  struct tm tm;
+  time_t t = (time_t) EPOCH2000 + jul;
+
+  lib330_calendar(jul, &cal);
+  gmtime_r(&t, &tm);
+  if ((cal.year != tm.tm_year + 1900) || (cal.jday != tm.tm_yday + 1) || (cal.month != tm.tm_mon + 1) ||
+      (cal.mday != tm.tm_mday) || (cal.hour != tm.tm_hour) || (cal.minute != tm.tm_min) || (cal.second != tm.tm_sec)) {
+    fprintf(stderr, "caltest: %ld gave %04d.%03d %02d/%02d %02d:%02d:%02d, expected %04d.%03d %02d/%02d %02d:%02d:%02d\n",
+      (long) jul, cal.year, cal.jday, cal.month, cal.mday, cal.hour, cal.minute, cal.second,
+      tm.tm_year + 1900, tm.tm_yday + 1, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return 1;
+  }
+  return 0;
+}
+
+/* every second of the day either side of a day boundary, as far as the days covered go */
+static int boundary(longint day) {
+  long long jul, first, last;
+
+  first = ((long long) day - 1) * 86400;
+  last = ((long long) day + 1) * 86400;
+  if (first < (long long) CAL_MINDAY * 86400)
+    first = (long long) CAL_MINDAY * 86400;
+  if (last > (long long) CAL_MAXDAY * 86400)
+    last = (long long) CAL_MAXDAY * 86400;
+  for (jul = first; jul < last; jul++)
+    if (compare((longint) jul))
+      return 1;
+  return 0;
+}
+
+static void *run(void *arg) {
+  unsigned int seed = (unsigned int) (size_t) arg;
+  longint day, year, jul;
+  long i;
+  int fail = 0;
+
+  /* every day, at its first and last second and somewhere in between */
+  for (day = CAL_MINDAY; (day < CAL_MAXDAY) && (!fail); day++)
+    fail = compare(day * 86400) || compare(day * 86400 + 86399) || compare(day * 86400 + (rand_r(&seed) % 86400));
+
+  /* the turn of every year and every leap day, second by second, from the first whole year */
+  for (year = 1933, day = -24471 /* 1933-01-01 */; (day < CAL_MAXDAY) && (!fail); day += ((year % 4) == 0) ? 366 : 365, year++) {
+    fail = boundary(day);
+    if ((year % 4) == 0)
+      fail = fail || boundary(day + 59) || boundary(day + 60);
+  }
+
+  /* back and forth at random, a new day almost every time */
+  for (i = 0; (i < 1000000) && (!fail); i++) {
+    jul = (longint) ((long long) CAL_MINDAY * 86400 +
+      (long long) ((((unsigned long) rand_r(&seed) << 16) ^ rand_r(&seed)) % ((unsigned long) (CAL_MAXDAY - CAL_MINDAY) * 86400)));
+    fail = compare(jul);
+  }
+
+  return (void *) (size_t) fail;
+}
+
+int main(int argc, char **argv) {
+  pthread_t thread[THREADS];
+  void *fail;
+  int i, failed = 0;
+
+  for (i = 0; i < THREADS; i++)
+    pthread_create(&thread[i], NULL, run, (void *) (size_t) (i + 1));
+  for (i = 0; i < THREADS; i++) {
+    pthread_join(thread[i], &fail);
+    failed |= (fail != NULL);
+  }
+  if (!failed)
+    printf("caltest: %d days either side of 2000 in %d threads ok\n", CAL_MAXDAY - CAL_MINDAY, THREADS);
+
+  return failed;
+}
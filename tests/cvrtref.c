@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * cvrtref: the SEED header and QDP codecs as they were before they were
+ * generated from the fixed layout tables, included by cvrttest so that the
+ * layouts are held to exactly the bytes and fields the hand written
+ * routines produced. Copied unchanged apart from the ref_ prefix, do not
+ * bring them up to date with the library.
+ */
+
+static void ref_storeseedhdr (pbyte *pdest, seed_header *hdr, boolean hasdeb)
+begin
+  longint newusec ;
+  double time_save ;
+  longword seq_save ;
+
+  time_save = hdr->starting_time.seed_fpt ;
+  seq_save = hdr->sequence.seed_num ;
+  convert_seed_time (hdr->starting_time.seed_fpt, addr(hdr->starting_time), addr(newusec)) ;
+  fix_seed_sequence (hdr, newusec, hasdeb) ;
+  storeblock (pdest, 6, addr(hdr->sequence.seed_ch)) ;
+  storebyte (pdest, (byte)hdr->seed_record_type) ;
+  storebyte (pdest, (byte)hdr->continuation_record) ;
+  storeblock (pdest, 5, addr(hdr->station_id_call_letters)) ;
+  storeblock (pdest, 2, addr(hdr->location_id)) ;
+  storeblock (pdest, 3, addr(hdr->channel_id)) ;
+  storeblock (pdest, 2, addr(hdr->seednet)) ;
+  storetime (pdest, addr(hdr->starting_time)) ;
+  storeword (pdest, hdr->samples_in_record) ;
+  storeint16 (pdest, hdr->sample_rate_factor) ;
+  storeint16 (pdest, hdr->sample_rate_multiplier) ;
+  storebyte (pdest, hdr->activity_flags) ;
+  storebyte (pdest, hdr->io_flags) ;
+  storebyte (pdest, hdr->data_quality_flags) ;
+  storebyte (pdest, hdr->number_of_following_blockettes) ;
+  storelongint (pdest, hdr->tenth_msec_correction) ;
+  storeword (pdest, hdr->first_data_byte) ;
+  storeword (pdest, hdr->first_blockette_byte) ;
+  /* all seed records have this one */
+  storeword (pdest, hdr->dob.blockette_type) ;
+  storeword (pdest, hdr->dob.next_blockette) ;
+  storebyte (pdest, hdr->dob.encoding_format) ;
+  storebyte (pdest, hdr->dob.word_order) ;
+  storebyte (pdest, hdr->dob.rec_length) ;
+  storebyte (pdest, hdr->dob.dob_reserved) ;
+  /* only data records have this one */
+  if (hasdeb)
+    then
+      begin
+        storeword (pdest, hdr->deb.blockette_type) ;
+        storeword (pdest, hdr->deb.next_blockette) ;
+        storebyte (pdest, hdr->deb.qual) ;
+        storebyte (pdest, hdr->deb.usec99) ;
+        storebyte (pdest, hdr->deb.deb_flags) ;
+        storebyte (pdest, hdr->deb.frame_count) ;
+      end
+  hdr->starting_time.seed_fpt = time_save ;
+  hdr->sequence.seed_num = seq_save ;
+end
+
+static void ref_loadseedhdr (pbyte *psrc, seed_header *hdr, boolean hasdeb)
+begin
+
+  loadblock (psrc, 6, addr(hdr->sequence.seed_ch)) ;
+  hdr->seed_record_type = (char)loadbyte (psrc) ;
+  hdr->continuation_record = (char)loadbyte (psrc) ;
+  loadblock (psrc, 5, addr(hdr->station_id_call_letters)) ;
+  loadblock (psrc, 2, addr(hdr->location_id)) ;
+  loadblock (psrc, 3, addr(hdr->channel_id)) ;
+  loadblock (psrc, 2, addr(hdr->seednet)) ;
+  loadtime (psrc, addr(hdr->starting_time)) ;
+  hdr->samples_in_record = loadword (psrc) ;
+  hdr->sample_rate_factor = loadint16 (psrc) ;
+  hdr->sample_rate_multiplier = loadint16 (psrc) ;
+  hdr->activity_flags = loadbyte (psrc) ;
+  hdr->io_flags = loadbyte (psrc) ;
+  hdr->data_quality_flags = loadbyte (psrc) ;
+  hdr->number_of_following_blockettes = loadbyte (psrc) ;
+  hdr->tenth_msec_correction = loadlongint (psrc) ;
+  hdr->first_data_byte = loadword (psrc) ;
+  hdr->first_blockette_byte = loadword (psrc) ;
+  hdr->dob.blockette_type = loadword (psrc) ;
+  hdr->dob.next_blockette = loadword (psrc) ;
+  hdr->dob.encoding_format = loadbyte (psrc) ;
+  hdr->dob.word_order = loadbyte (psrc) ;
+  hdr->dob.rec_length = loadbyte (psrc) ;
+  hdr->dob.dob_reserved = loadbyte (psrc) ;
+  if (hasdeb)
+    then
+      begin
+        hdr->deb.blockette_type = loadword (psrc) ;
+        hdr->deb.next_blockette = loadword (psrc) ;
+        hdr->deb.qual = loadbyte (psrc) ;
+        hdr->deb.usec99 = loadbyte (psrc) ;
+        hdr->deb.deb_flags = loadbyte (psrc) ;
+        hdr->deb.frame_count = loadbyte (psrc) ;
+      end
+end
+
+static void ref_storeqdphdr (pbyte *p, byte cmd, word lth, word seq, word ack)
+begin
+
+  storelongint (p, 0) ; /* for now */
+  storebyte (p, cmd) ;
+  storebyte (p, QDP_VERSION) ;
+  storeword (p, lth) ;
+  storeword (p, seq) ;
+  storeword (p, ack) ;
+end
+
+static void ref_loadqdphdr (pbyte *p, tqdp *hdr)
+begin
+
+  hdr->crc = loadlongint (p) ;
+  hdr->command = loadbyte (p) ;
+  hdr->version = loadbyte (p) ;
+  hdr->datalength = loadword (p) ;
+  hdr->sequence = loadword (p) ;
+  hdr->acknowledge = loadword (p) ;
+end
+
+static void ref_loadglob (pbyte *p, tglobal *glob)
+begin
+  integer i, j ;
+
+  glob->clock_to = loadword (p) ;
+  glob->initial_vco = loadword (p) ;
+  glob->gps_backup = loadword (p) ;
+  glob->samp_rates = loadword (p) ;
+  glob->gain_map = loadword (p) ;
+  glob->filter_map = loadword (p) ;
+  glob->input_map = loadword (p) ;
+  glob->web_port = loadword (p) ;
+  glob->server_to = loadword (p) ;
+  glob->drift_tol = loadword (p) ;
+  glob->jump_filt = loadword (p) ;
+  glob->jump_thresh = loadword (p) ;
+  glob->cal_offset = loadint16 (p) ;
+  glob->sensor_map = loadword (p) ;
+  glob->sampling_phase = loadword (p) ;
+  glob->gps_cold = loadword (p) ;
+  glob->user_tag = loadlongword (p) ;
+  for (i = 0 ; i <= CHANNELS - 1 ; i++)
+    for (j = 0 ; j <= FREQUENCIES - 1 ; j++)
+      glob->scaling[i][j] = loadint16 (p) ;
+  for (i = 0 ; i <= CHANNELS - 1 ; i++)
+    glob->offsets[i] = loadint16 (p) ;
+  for (i = 0 ; i <= CHANNELS - 1 ; i++)
+    glob->gains[i] = loadint16 (p) ;
+  glob->msg_map = loadlongword (p) ;
+end
+
+static void ref_loadfix (pbyte *p, tfixed *fix)
+begin
+  word w ;
+  integer i ;
+
+  fix->last_reboot = loadlongword (p) ;
+  fix->reboots = loadlongword (p) ;
+  fix->backup_map = loadlongword (p) ;
+  fix->default_map = loadlongword (p) ;
+  fix->cal_type = loadword (p) ;
+  fix->cal_ver = loadword (p) ;
+  fix->aux_type = loadword (p) ;
+  fix->aux_ver = loadword (p) ;
+  fix->clk_type = loadword (p) ;
+  fix->flags = loadword (p) ;
+  fix->sys_ver = loadword (p) ;
+  fix->sp_ver = loadword (p) ;
+  fix->pld_ver = loadword (p) ;
+  fix->mem_block = loadword (p) ;
+  fix->property_tag = loadlongword (p) ;
+#ifdef ENDIAN_LITTLE
+  fix->sys_num[1] = loadlongword (p) ;
+  fix->sys_num[0] = loadlongword (p) ;
+#else
+  fix->sys_num[0] = loadlongword (p) ;
+  fix->sys_num[1] = loadlongword (p) ;
+#endif
+#ifdef ENDIAN_LITTLE
+  fix->amb_num[1] = loadlongword (p) ;
+  fix->amb_num[0] = loadlongword (p) ;
+#else
+  fix->amb_num[0] = loadlongword (p) ;
+  fix->amb_num[1] = loadlongword (p) ;
+#endif
+#ifdef ENDIAN_LITTLE
+  fix->seis1_num[1] = loadlongword (p) ;
+  fix->seis1_num[0] = loadlongword (p) ;
+#else
+  fix->seis1_num[0] = loadlongword (p) ;
+  fix->seis1_num[1] = loadlongword (p) ;
+#endif
+#ifdef ENDIAN_LITTLE
+  fix->seis2_num[1] = loadlongword (p) ;
+  fix->seis2_num[0] = loadlongword (p) ;
+#else
+  fix->seis2_num[0] = loadlongword (p) ;
+  fix->seis2_num[1] = loadlongword (p) ;
+#endif
+  fix->qapchp1_num = loadlongword (p) ;
+  fix->int_sz = loadlongword (p) ;
+  fix->int_used = loadlongword (p) ;
+  fix->ext_sz = loadlongword (p) ;
+  fix->flash_sz = loadlongword (p) ;
+  fix->ext_used = loadlongword (p) ;
+  fix->qapchp2_num = loadlongword (p) ;
+  for (w = LP_TEL1 ; w <= LP_TEL4 ; w++)
+    fix->log_sz[w] = loadlongword (p) ;
+  fix->freq7 = loadbyte (p) ;
+  fix->freq6 = loadbyte (p) ;
+  fix->freq5 = loadbyte (p) ;
+  fix->freq4 = loadbyte (p) ;
+  fix->freq3 = loadbyte (p) ;
+  fix->freq2 = loadbyte (p) ;
+  fix->freq1 = loadbyte (p) ;
+  fix->freq0 = loadbyte (p) ;
+  for (i = 0 ; i <= FREQUENCIES - 1 ; i++)
+    fix->ch13_delay[i] = loadlongint (p) ;
+  for (i = 0 ; i <= FREQUENCIES - 1 ; i++)
+    fix->ch46_delay[i] = loadlongint (p) ;
+end
+
+static void ref_loadglobalstat (pbyte *p, tstat_global *globstat)
+begin
+
+  globstat->aqctrl = loadword (p) ;
+  globstat->clock_qual = loadword (p) ;
+  globstat->clock_loss = loadword (p) ;
+  globstat->current_voltage = loadword (p) ;
+  globstat->sec_offset = loadlongword (p) ;
+  globstat->usec_offset = loadlongword (p) ;
+  globstat->total_time = loadlongword (p) ;
+  globstat->power_time = loadlongword (p) ;
+  globstat->last_resync = loadlongword (p) ;
+  globstat->resyncs = loadlongword (p) ;
+  globstat->gps_stat = loadword (p) ;
+  globstat->cal_stat = loadword (p) ;
+  globstat->sensor_map = loadword (p) ;
+  globstat->cur_vco = loadword (p) ;
+  globstat->data_seq = loadword (p) ;
+  globstat->pll_flag = loadword (p) ;
+  globstat->stat_inp = loadword (p) ;
+  globstat->misc_inp = loadword (p) ;
+  globstat->cur_sequence = loadlongword (p) ;
+end
+
+static void ref_loadgpsstat (pbyte *p, tstat_gps *gpsstat)
+begin
+
+  gpsstat->gpstime = loadword (p) ;
+  gpsstat->gpson = loadword (p) ;
+  gpsstat->sat_used = loadword (p) ;
+  gpsstat->sat_view = loadword (p) ;
+  loadstring (p, 10, gpsstat->time) ;
+  loadstring (p, 12, gpsstat->date) ;
+  loadstring (p, 6, gpsstat->fix) ;
+  loadstring (p, 12, gpsstat->height) ;
+  loadstring (p, 14, gpsstat->lat) ;
+  loadstring (p, 14, gpsstat->longt) ;
+  gpsstat->last_good = loadlongword (p) ;
+  gpsstat->check_err = loadlongword (p) ;
+end
+
+static void ref_loadpwrstat (pbyte *p, tstat_pwr *pwrstat)
+begin
+
+  pwrstat->phase = loadword (p) ;
+  pwrstat->battemp = loadint16 (p) ;
+  pwrstat->capacity = loadword (p) ;
+  pwrstat->depth = loadword (p) ;
+  pwrstat->batvolt = loadword (p) ;
+  pwrstat->inpvolt = loadword (p) ;
+  pwrstat->batcur = loadint16 (p) ;
+  pwrstat->absorption = loadword (p) ;
+  pwrstat->float_ = loadword (p) ;
+  pwrstat->alerts = loadbyte (p) ;
+  pwrstat->loads_off = loadbyte (p) ;
+end
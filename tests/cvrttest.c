@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * cvrttest: round trip every fixed layout through its codec. Random wire
+ * bytes are loaded with the lib330 routine, stored back with the same
+ * layout and must come out identical wherever the layout has a field;
+ * the layouts themselves must not overlap or run past their size. The
+ * SEED and QDP headers are also taken from a structure to the wire and
+ * back through the public store and load routines.
+ *
+ * A round trip cannot tell a field stored at the wrong offset from one
+ * loaded from the same wrong offset, so every codec is also run against
+ * the routine it replaced, kept in cvrtref.c: the same wire bytes have to
+ * load into the same structure, and the same structure has to store to the
+ * same bytes.
+ *
+ * The layouts are private to libseed.c and q330cvrt.c, so both are built
+ * in here directly.
+ */
+
+#include "../lib330/libseed.c"
+#include "../lib330/q330cvrt.c"
+#include "cvrtref.c"
+
+#define ROUNDS 100000
+#define MAXWIRE 256
+
+/* stores for the kinds lib330 only ever loads */
+#define cvrt_put_WORDS(b, o, n, v) cvrt_putn16 ((b) + (o), n, (pword)(v))
+#define cvrt_put_INT16S(b, o, n, v) cvrt_putn16 ((b) + (o), n, (pword)(v))
+#define cvrt_put_LONGWORDS(b, o, n, v) cvrt_putn32 ((b) + (o), n, (longword *)(v))
+#define cvrt_put_LONGINTS(b, o, n, v) cvrt_putn32 ((b) + (o), n, (longword *)(v))
+#ifdef ENDIAN_LITTLE
+#define cvrt_put_T64(b, o, n, v) cvrt_put32 ((b) + (o), (v)[1]), cvrt_put32 ((b) + (o) + 4, (v)[0])
+#else
+#define cvrt_put_T64(b, o, n, v) cvrt_put32 ((b) + (o), (v)[0]), cvrt_put32 ((b) + (o) + 4, (v)[1])
+#endif
+#define cvrt_put_STRING(b, o, n, v) lib330_strpas ((pchar)(b) + (o), (pchar)(v))
+
+static void cvrt_putn16 (pbyte b, integer count, pword src) {
+  integer i;
+
+  for (i = 0; i < count; i++)
+    cvrt_put16 (b + 2 * i, src[i]);
+}
+
+static void cvrt_putn32 (pbyte b, integer count, longword *src) {
+  integer i;
+
+  for (i = 0; i < count; i++)
+    cvrt_put32 (b + 4 * i, src[i]);
+}
+
+/* bytes each kind takes on the wire */
+#define WIDTH_BYTE(n) 1
+#define WIDTH_CHAR(n) 1
+#define WIDTH_WORD(n) 2
+#define WIDTH_INT16(n) 2
+#define WIDTH_LONGWORD(n) 4
+#define WIDTH_LONGINT(n) 4
+#define WIDTH_BLOCK(n) (n)
+#define WIDTH_STRING(n) (n)
+#define WIDTH_WORDS(n) (2 * (n))
+#define WIDTH_INT16S(n) (2 * (n))
+#define WIDTH_LONGWORDS(n) (4 * (n))
+#define WIDTH_LONGINTS(n) (4 * (n))
+#define WIDTH_T64(n) 8
+
+/* marks the bytes a field covers, counting any covered twice */
+#define COVER(kind, offset, width, field) overlaps += cover (mask, size, offset, WIDTH_##kind(width)) ;
+
+/* a pascal string of printable characters no longer than its field, with nothing after it */
+#define IS_STRING_BLOCK 0
+#define IS_STRING_STRING 1
+#define SANITIZE(kind, offset, width, field) if (IS_STRING_##kind) pascal_string (in + (offset), width) ;
+#define IS_STRING_BYTE 0
+#define IS_STRING_CHAR 0
+#define IS_STRING_WORD 0
+#define IS_STRING_INT16 0
+#define IS_STRING_LONGWORD 0
+#define IS_STRING_LONGINT 0
+#define IS_STRING_WORDS 0
+#define IS_STRING_INT16S 0
+#define IS_STRING_LONGWORDS 0
+#define IS_STRING_LONGINTS 0
+#define IS_STRING_T64 0
+
+static int cover (byte *mask, integer size, integer offset, integer width) {
+  integer i, twice = 0;
+
+  for (i = offset; i < offset + width; i++)
+    if (i >= size)
+      twice++;
+    else if (mask[i]++)
+      twice++;
+  return twice;
+}
+
+static void pascal_string (byte *b, integer width) {
+  integer i;
+
+  b[0] = (byte) (rand () % width);
+  for (i = 1; i <= b[0]; i++)
+    b[i] = (byte) (' ' + rand () % 95);
+  memset (b + 1 + b[0], 0, width - 1 - b[0]);
+}
+
+static void randomize (byte *b, integer size) {
+  integer i;
+
+  for (i = 0; i < size; i++)
+    b[i] = (byte) rand ();
+}
+
+/* load random wire bytes and store them back through the same layout */
+#define ROUND_TRIP(name, LAYOUT, SIZE, type, loader) \
+static int name (void) { \
+  byte in[MAXWIRE], out[MAXWIRE], mask[MAXWIRE] ; \
+  integer size = SIZE, overlaps = 0, covered = 0, i, r ; \
+  type s, *rec ; \
+  pbyte p, wire ; \
+ \
+  memset (mask, 0, sizeof(mask)) ; \
+  LAYOUT(COVER) \
+  for (i = 0 ; i < size ; i++) \
+    covered += (mask[i] != 0) ; \
+  if (overlaps) { \
+    fprintf (stderr, "cvrttest: %s layout has %d bytes overlapping or past its size\n", #LAYOUT, (int)overlaps) ; \
+    return 1 ; \
+  } \
+  for (r = 0 ; r < ROUNDS ; r++) { \
+    randomize (in, size) ; \
+    LAYOUT(SANITIZE) \
+    memset (&s, 0, sizeof(s)) ; \
+    p = in ; \
+    loader ; \
+    if (p != in + size) { \
+      fprintf (stderr, "cvrttest: %s moved on %d bytes, not %d\n", #LAYOUT, (int)(p - in), (int)size) ; \
+      return 1 ; \
+    } \
+    memset (out, 0, sizeof(out)) ; \
+    wire = out ; \
+    rec = &s ; \
+    LAYOUT(CVRT_STORE) \
+    for (i = 0 ; i < size ; i++) \
+      if ((mask[i]) && (in[i] != out[i])) { \
+        fprintf (stderr, "cvrttest: %s byte %d went in as %02x and came back %02x\n", #LAYOUT, (int)i, in[i], out[i]) ; \
+        return 1 ; \
+      } \
+  } \
+  printf ("cvrttest: %s %d of %d bytes round trip\n", #LAYOUT, (int)covered, (int)size) ; \
+  return 0 ; \
+}
+
+#define SEED_LAYOUT(F) SEED_FIXED_LAYOUT(F) SEED_DEB_LAYOUT(F)
+
+ROUND_TRIP(seed_layout, SEED_LAYOUT, SEED_FIXED_SIZE + SEED_DEB_SIZE, seed_header, loadseedhdr (&p, &s, TRUE))
+ROUND_TRIP(qdp_layout, QDP_HDR_LAYOUT, QDP_HDR_SIZE, tqdp, loadqdphdr (&p, &s))
+ROUND_TRIP(glob_layout, GLOB_LAYOUT, GLOB_SIZE, tglobal, loadglob (&p, &s))
+ROUND_TRIP(fix_layout, FIX_LAYOUT, FIX_SIZE, tfixed, loadfix (&p, &s))
+ROUND_TRIP(globalstat_layout, GLOBALSTAT_LAYOUT, GLOBALSTAT_SIZE, tstat_global, loadglobalstat (&p, &s))
+ROUND_TRIP(gpsstat_layout, GPSSTAT_LAYOUT, GPSSTAT_SIZE, tstat_gps, loadgpsstat (&p, &s))
+ROUND_TRIP(pwrstat_layout, PWRSTAT_LAYOUT, PWRSTAT_SIZE, tstat_pwr, loadpwrstat (&p, &s))
+
+/* load the same random wire bytes with the layout and with the routine it replaced */
+#define AGAINST_REF(name, LAYOUT, SIZE, type, loader, refloader) \
+static int name (void) { \
+  byte in[MAXWIRE] ; \
+  integer size = SIZE, r ; \
+  type a, b ; \
+  pbyte p, q ; \
+ \
+  for (r = 0 ; r < ROUNDS ; r++) { \
+    randomize (in, size) ; \
+    LAYOUT(SANITIZE) \
+    memset (&a, 0, sizeof(a)) ; \
+    memset (&b, 0, sizeof(b)) ; \
+    p = in ; \
+    loader ; \
+    q = in ; \
+    refloader ; \
+    if ((p != q) || (memcmp (&a, &b, sizeof(a)))) { \
+      fprintf (stderr, "cvrttest: %s loads differently from the routine it replaced\n", #LAYOUT) ; \
+      return 1 ; \
+    } \
+  } \
+  printf ("cvrttest: %s loads as it did before the layouts\n", #LAYOUT) ; \
+  return 0 ; \
+}
+
+AGAINST_REF(seed_ref, SEED_LAYOUT, SEED_FIXED_SIZE + SEED_DEB_SIZE, seed_header, loadseedhdr (&p, &a, TRUE), ref_loadseedhdr (&q, &b, TRUE))
+AGAINST_REF(qdp_ref, QDP_HDR_LAYOUT, QDP_HDR_SIZE, tqdp, loadqdphdr (&p, &a), ref_loadqdphdr (&q, &b))
+AGAINST_REF(glob_ref, GLOB_LAYOUT, GLOB_SIZE, tglobal, loadglob (&p, &a), ref_loadglob (&q, &b))
+AGAINST_REF(fix_ref, FIX_LAYOUT, FIX_SIZE, tfixed, loadfix (&p, &a), ref_loadfix (&q, &b))
+AGAINST_REF(globalstat_ref, GLOBALSTAT_LAYOUT, GLOBALSTAT_SIZE, tstat_global, loadglobalstat (&p, &a), ref_loadglobalstat (&q, &b))
+AGAINST_REF(gpsstat_ref, GPSSTAT_LAYOUT, GPSSTAT_SIZE, tstat_gps, loadgpsstat (&p, &a), ref_loadgpsstat (&q, &b))
+AGAINST_REF(pwrstat_ref, PWRSTAT_LAYOUT, PWRSTAT_SIZE, tstat_pwr, loadpwrstat (&p, &a), ref_loadpwrstat (&q, &b))
+
+/* store the same headers with the layouts and with the routines they replaced */
+static int store_ref (void) {
+  seed_header hdr, copy;
+  byte buf[MAXWIRE], ref[MAXWIRE];
+  pbyte p, q;
+  byte cmd;
+  word lth, seq, ack;
+  integer r, deb;
+
+  for (r = 0; r < ROUNDS; r++) {
+    randomize ((byte *) &hdr, sizeof(hdr));
+    hdr.starting_time.seed_fpt = (rand () % 800000000) + (rand () % 1000000) / 1000000.0;
+    hdr.sequence.seed_num = rand () % 1000000;
+    for (deb = 0; deb <= 1; deb++) {
+      memset (buf, 0, sizeof(buf));
+      memset (ref, 0, sizeof(ref));
+      memcpy (&copy, &hdr, sizeof(hdr));
+      p = buf;
+      storeseedhdr (&p, &copy, deb);
+      memcpy (&copy, &hdr, sizeof(hdr));
+      q = ref;
+      ref_storeseedhdr (&q, &copy, deb);
+      if (((p - buf) != (q - ref)) || (memcmp (buf, ref, sizeof(buf)))) {
+        fprintf (stderr, "cvrttest: storeseedhdr %s the data extension blockette stores differently from before\n",
+          deb ? "with" : "without");
+        return 1;
+      }
+    }
+
+    cmd = rand ();
+    lth = rand ();
+    seq = rand ();
+    ack = rand ();
+    p = buf;
+    storeqdphdr (&p, cmd, lth, seq, ack);
+    q = ref;
+    ref_storeqdphdr (&q, cmd, lth, seq, ack);
+    if (((p - buf) != (q - ref)) || (memcmp (buf, ref, QDP_HDR_SIZE))) {
+      fprintf (stderr, "cvrttest: storeqdphdr %d %d %d %d stores differently from before\n", cmd, lth, seq, ack);
+      return 1;
+    }
+  }
+  printf ("cvrttest: seed and qdp headers store as they did before the layouts\n");
+  return 0;
+}
+
+/* fields a structure came back with that differ from what went in */
+#define DIFFER(kind, offset, width, field) \
+  if (memcmp (&a->field, &b->field, sizeof(a->field))) { \
+    fprintf (stderr, "cvrttest: %s differs after a round trip\n", #field) ; \
+    return 1 ; \
+  }
+
+static int seed_differ (seed_header *a, seed_header *b) {
+  SEED_LAYOUT(DIFFER)
+  return 0;
+}
+
+/* a header stored from a structure and loaded again, as records are built */
+static int seed_store (void) {
+  seed_header hdr, expect, back;
+  byte buf[MAXWIRE];
+  pbyte p;
+  longint usec;
+  integer r;
+
+  for (r = 0; r < ROUNDS; r++) {
+    memset (&hdr, 0, sizeof(hdr));
+    randomize ((byte *) &hdr, sizeof(hdr));
+    hdr.starting_time.seed_fpt = (rand () % 800000000) + (rand () % 1000000) / 1000000.0;
+    hdr.sequence.seed_num = rand () % 1000000;
+    memcpy (&expect, &hdr, sizeof(hdr));
+    p = buf;
+    storeseedhdr (&p, &hdr, TRUE);
+    if (p != buf + SEED_FIXED_SIZE + SEED_DEB_SIZE) {
+      fprintf (stderr, "cvrttest: storeseedhdr moved on %d bytes\n", (int)(p - buf));
+      return 1;
+    }
+    convert_seed_time (expect.starting_time.seed_fpt, &expect.starting_time, &usec);
+    fix_seed_sequence (&expect, usec, TRUE);
+    memset (&back, 0, sizeof(back));
+    p = buf;
+    loadseedhdr (&p, &back, TRUE);
+    if (seed_differ (&expect, &back))
+      return 1;
+  }
+  printf ("cvrttest: seed header store and load agree\n");
+  return 0;
+}
+
+static int qdp_store (void) {
+  byte buf[QDP_HDR_SIZE];
+  pbyte p;
+  tqdp hdr;
+  byte cmd;
+  word lth, seq, ack;
+  integer r;
+
+  for (r = 0; r < ROUNDS; r++) {
+    cmd = rand ();
+    lth = rand ();
+    seq = rand ();
+    ack = rand ();
+    p = buf;
+    storeqdphdr (&p, cmd, lth, seq, ack);
+    p = buf;
+    loadqdphdr (&p, &hdr);
+    if ((p != buf + QDP_HDR_SIZE) || (hdr.crc != 0) || (hdr.command != cmd) || (hdr.version != QDP_VERSION) ||
+        (hdr.datalength != lth) || (hdr.sequence != seq) || (hdr.acknowledge != ack)) {
+      fprintf (stderr, "cvrttest: qdp header %d %d %d %d did not round trip\n", cmd, lth, seq, ack);
+      return 1;
+    }
+  }
+  printf ("cvrttest: qdp header store and load agree\n");
+  return 0;
+}
+
+int main (int argc, char **argv) {
+
+  srand ((argc > 1) ? atoi (argv[1]) : 1);
+
+  return seed_layout () || qdp_layout () || glob_layout () || fix_layout () || globalstat_layout () ||
+         gpsstat_layout () || pwrstat_layout () || seed_store () || qdp_store () ||
+         seed_ref () || qdp_ref () || glob_ref () || fix_ref () || globalstat_ref () ||
+         gpsstat_ref () || pwrstat_ref () || store_ref ();
+}
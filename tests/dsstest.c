@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * dsstest: run the DSS server's own registration, request and removal code
+ * for a few hundred clients against an allocation limit they cannot all fit
+ * in. Clients register, ask for reports on a 30 channel station, drop some
+ * of them and expire, over and over. Afterwards:
+ *
+ *  - every request the allocator could not satisfy was refused to its
+ *    client as out of memory, and no request was refused for any other
+ *    reason;
+ *  - the arena never grew past the limit, and the bytes in use match the
+ *    clients, reports and accumulators still registered;
+ *  - the free lists, the bytes in use and the unused tail add up to the
+ *    arena, so the fragmentation figure count_blocks reports is honest,
+ *    and with requests still being refused that figure stays low rather
+ *    than the arena sitting free in pieces too small to use;
+ *  - once everyone has expired nothing is in use, and the freed blocks take
+ *    at least three quarters of the first load again without the arena
+ *    growing.
+ *
+ * The allocator and the request handlers are static to libdss.c, so it is
+ * built in here directly.
+ */
+
+#include <unistd.h>
+
+#include "../lib330/libdss.c"
+
+#define CLIENTS 400
+#define LCQS 30
+#define CYCLES 200000
+#define MEM_ALLOWED (48 * 1024)
+
+static const byte reqcodes[] = {REQ_SIMP, REQ_REC, REQ_MMA, REQ_SQR, REQ_BOOT, REQ_GPS, REQ_DEAD};
+
+typedef struct {
+  boolean registered;
+  word data_id;
+} tslot;
+
+static tslot slots[CLIENTS];
+static integer refusals[REF_OOM + 1];
+static integer acks;
+
+/* every free block is at least a header long and in the right class */
+static int free_lists(pdssstr dssstr, integer *blocks, integer *bytes) {
+  pmemory pt;
+  integer c, n;
+
+  *blocks = 0;
+  *bytes = 0;
+  for (c = 0; c < DSS_CLASSES; c++) {
+    for (n = 0, pt = dssstr->classes[c]; pt; pt = pt->next, n++)
+      if ((pt->size != c * DSS_GRAIN) || (pt->size < (integer) DSS_MINBLOCK) || (n > dssstr->class_count[c]))
+        return 0;
+    if (n != dssstr->class_count[c])
+      return 0;
+    *blocks += n;
+    *bytes += n * c * DSS_GRAIN;
+  }
+  return 1;
+}
+
+/* bytes held by the registered clients, walking their lists both ways */
+static integer registered(pdssstr dssstr, integer *clients) {
+  pdss_client pcli, pclient;
+  pdss_report prep, prev;
+  integer cp, sum = 0, walked = 0;
+
+  *clients = 0;
+  for (cp = 0; cp <= 2; cp++)
+    for (pclient = NIL, pcli = dssstr->clients[cp]; pcli; pclient = pcli, pcli = (pdss_client) pcli->memory.next) {
+      /* the head client points back to itself */
+      if ((pdss_client) pcli->memory.prev != (pclient ? pclient : pcli))
+        return -1;
+      (*clients)++;
+      sum += pcli->memory.size;
+      for (prev = NIL, prep = pcli->head; prep; prev = prep, prep = (pdss_report) prep->memory.next) {
+        if (((pdss_report) prep->memory.prev != prev) || (++walked > dssstr->total / (integer) DSS_MINBLOCK))
+          return -1;
+        sum += prep->memory.size;
+        if (prep->access)
+          sum += prep->access->size;
+      }
+    }
+  return sum;
+}
+
+static void client_address(pdssstr dssstr, integer k) {
+  struct sockaddr_in *psock = (struct sockaddr_in *) addr(dssstr->sock);
+
+  memset(psock, 0, sizeof(struct sockaddr));
+  psock->sin_family = AF_INET;
+  psock->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  psock->sin_port = htons(20000 + k);
+}
+
+/* hand the message in msgin to the server as lib_dss_read would once the
+  datagram has arrived, and note how it was answered */
+static void deliver(pdssstr dssstr, byte command) {
+  pdss_client pcli;
+  pbyte p;
+
+  dssstr->refused = FALSE;
+  dssstr->msgin.qdp.command = dssstr->recvhdr.command = command;
+  dssstr->msgin.qdp.version = dssstr->recvhdr.version = QDP_VERSION;
+  if (command == DSS_REG)
+    register_client(dssstr);
+  else if ((pcli = find_client(dssstr)) == NIL)
+    refuse(dssstr, REF_URC);
+  else if (command == DSS_REQ)
+    add_request(dssstr, pcli);
+  else if (command == DSS_DEL)
+    del_requests(dssstr, pcli);
+  else
+    remove_client(dssstr, pcli);
+  if (dssstr->refused) {
+    p = dssstr->msgout.buffer;
+    refusals[loadword(addr(p)) % (REF_OOM + 1)]++;
+  }
+  else
+    acks++;
+}
+
+static boolean do_register(pdssstr dssstr, integer k) {
+  string95 s;
+  pbyte p = dssstr->msgin.buffer;
+
+  client_address(dssstr, k);
+  strcpy(s, "DSSPASS");
+  storestring(addr(p), 8, (string *) s);
+  sprintf(s, "client %d", (int) k);
+  storestring(addr(p), 250, (string *) s);
+  deliver(dssstr, DSS_REG);
+  return !dssstr->refused;
+}
+
+static boolean do_request(pdssstr dssstr, integer k) {
+  byte reqcode = reqcodes[rand() % sizeof(reqcodes)];
+  char seed[4];
+  pbyte p = dssstr->msgin.buffer;
+
+  client_address(dssstr, k);
+  storeword(addr(p), ++slots[k].data_id);
+  storeword(addr(p), rand() % 4);
+  storelongint(addr(p), 10);
+  storebyte(addr(p), reqcode);
+  storebyte(addr(p), 0);
+  storeblock(addr(p), 4, "TEST");
+  sprintf(seed, "H%02d", rand() % LCQS);
+  storeblock(addr(p), 2, "00");
+  storeblock(addr(p), 3, seed);
+  storebyte(addr(p), FMT_I32);
+  storelongint(addr(p), 5);
+  deliver(dssstr, DSS_REQ);
+  return !dssstr->refused;
+}
+
+/* drop one of the client's reports, by an id it may or may not still have */
+static void do_delete(pdssstr dssstr, integer k) {
+  pbyte p = dssstr->msgin.buffer;
+
+  client_address(dssstr, k);
+  storeint16(addr(p), 1);
+  storeword(addr(p), 1 + rand() % (slots[k].data_id + 1));
+  deliver(dssstr, DSS_DEL);
+}
+
+static void do_expire(pdssstr dssstr, integer k) {
+  client_address(dssstr, k);
+  deliver(dssstr, DSS_REM);
+  slots[k].registered = FALSE;
+}
+
+/* what the out of memory refusals, the arena and the free lists say */
+static int check(pdssstr dssstr, const char *when, integer *free_bytes) {
+  integer blocks, clients, held, lost;
+
+  if (!free_lists(dssstr, &blocks, free_bytes)) {
+    fprintf(stderr, "%s: free lists damaged\n", when);
+    return 0;
+  }
+  if ((held = registered(dssstr, &clients)) != dssstr->in_use) {
+    fprintf(stderr, "%s: %d clients hold %d bytes, allocator counts %d in use\n",
+      when, (int) clients, (int) held, (int) dssstr->in_use);
+    return 0;
+  }
+  if (dssstr->total > dssstr->mem_allowed) {
+    fprintf(stderr, "%s: arena of %d bytes over the %d allowed\n", when, (int) dssstr->total, (int) dssstr->mem_allowed);
+    return 0;
+  }
+  if (refusals[REF_OOM] != dssstr->failures) {
+    fprintf(stderr, "%s: %d allocations failed, %d refused as out of memory\n",
+      when, (int) dssstr->failures, (int) refusals[REF_OOM]);
+    return 0;
+  }
+  /* only the sub-header tail of each chunk can be abandoned */
+  lost = dssstr->total - dssstr->chunk_left - dssstr->in_use - *free_bytes;
+  if ((lost < 0) || (lost >= (dssstr->total / 1024 + 1) * (integer) DSS_MINBLOCK)) {
+    fprintf(stderr, "%s: %d in use, %d free and %d unused of %d\n", when, (int) dssstr->in_use,
+      (int) *free_bytes, (int) dssstr->chunk_left, (int) dssstr->total);
+    return 0;
+  }
+  return 1;
+}
+
+/* fill every slot with a client and as many reports as will fit */
+static integer fill(pdssstr dssstr) {
+  integer k, n = 0;
+
+  for (k = 0; k < CLIENTS; k++)
+    if (do_register(dssstr, k)) {
+      slots[k].registered = TRUE;
+      while (do_request(dssstr, k))
+        n++;
+    }
+  return n;
+}
+
+int main(int argc, char **argv) {
+  pq330 q330;
+  pmem_manager pm;
+  pdssstr dssstr;
+  paqstruc paqs;
+  plcq q;
+  integer i, k, free_bytes, frag, first, again, total;
+  long cycle;
+
+  srand((argc > 1) ? atoi(argv[1]) : 1);
+  alarm(60); /* a report list looped back on itself never ends */
+
+  q330 = (pq330) calloc(1, sizeof(tq330));
+  pm = (pmem_manager) calloc(1, sizeof(tmem_manager));
+  pm->alloc_size = MEM_ALLOWED;
+  pm->base = malloc(pm->alloc_size);
+  q330->memory_head = q330->cur_memory = pm;
+  memcpy(addr(q330->station), "TEST ", sizeof(tseed_stn));
+  q330->dsspath = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  paqs = (paqstruc) calloc(1, sizeof(taqstruc));
+  q330->aqstruc = paqs;
+  for (i = LCQS - 1; i >= 0; i--) {
+    q = (plcq) calloc(1, sizeof(tlcq));
+    q->com = (pcom_packet) calloc(1, sizeof(tcom_packet));
+    memcpy(addr(q->location), "00", 2);
+    sprintf((pchar) addr(q->seedname), "H%02d", (int) i);
+    q->link = paqs->lcqs;
+    paqs->lcqs = q;
+  }
+
+  dssstr = (pdssstr) calloc(1, sizeof(tdssstr));
+  dssstr->q330 = q330;
+  dssstr->mem_allowed = MEM_ALLOWED;
+  strcpy(dssstr->passwords[0], "DSSPASS");
+  strcpy(dssstr->passwords[1], "NOPE");
+  strcpy(dssstr->passwords[2], "NOPE");
+
+  /* everyone at once first, to find out how much fits */
+  first = fill(dssstr);
+  if (!check(dssstr, "fill", &free_bytes))
+    return 1;
+  total = dssstr->total;
+
+  for (cycle = 0; cycle < CYCLES; cycle++) {
+    k = rand() % CLIENTS;
+    if (!slots[k].registered)
+      slots[k].registered = do_register(dssstr, k);
+    else
+      switch (rand() % 8) {
+        case 0:
+          do_expire(dssstr, k);
+          break;
+        case 1:
+        case 2:
+          do_delete(dssstr, k);
+          break;
+        default:
+          (void) do_request(dssstr, k);
+          break;
+      }
+    if ((cycle % 1000) == 0) {
+      char when[40];
+
+      sprintf(when, "cycle %ld", cycle);
+      if (!check(dssstr, when, &free_bytes))
+        return 1;
+    }
+  }
+  if (!check(dssstr, "cycles", &free_bytes))
+    return 1;
+  /* with clients still asking for more, little of the arena can be sitting free */
+  frag = (free_bytes * 100) / (dssstr->total - dssstr->chunk_left);
+  if (frag > 25) {
+    fprintf(stderr, "%d%% of the arena free, yet requests refused\n", (int) frag);
+    return 1;
+  }
+
+  for (k = 0; k < CLIENTS; k++)
+    if (slots[k].registered)
+      do_expire(dssstr, k);
+  if (!check(dssstr, "expired", &free_bytes))
+    return 1;
+  if (dssstr->in_use) {
+    fprintf(stderr, "all clients expired, %d bytes still in use\n", (int) dssstr->in_use);
+    return 1;
+  }
+
+  /* the same load again has to come out of the blocks just freed */
+  again = fill(dssstr);
+  if (!check(dssstr, "refill", &free_bytes))
+    return 1;
+  if ((dssstr->total != total) || (again < first * 3 / 4)) {
+    fprintf(stderr, "refill: %d reports in %d bytes, first time %d in %d\n",
+      (int) again, (int) dssstr->total, (int) first, (int) total);
+    return 1;
+  }
+
+  for (i = 0; i <= REF_OOM; i++)
+    if ((i != REF_OOM) && (refusals[i])) {
+      fprintf(stderr, "%d requests refused with code %d\n", (int) refusals[i], (int) i);
+      return 1;
+    }
+  if (refusals[REF_OOM] == 0) {
+    fprintf(stderr, "%d bytes was enough for everyone, nothing refused\n", (int) dssstr->mem_allowed);
+    return 1;
+  }
+
+  printf("dsstest: %d clients, %ld cycles in %d bytes, %d acks, %d refused out of memory, %d%% fragmented, %d then %d reports fit\n",
+    CLIENTS, (long) CYCLES, (int) dssstr->total, (int) acks, (int) refusals[REF_OOM], (int) frag, (int) first, (int) again);
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# metrics.sh: scrape the metrics endpoint served by tests/metricsd and check
+# the reply is well formed prometheus text carrying the counts fed into it.
+#
+# usage: tests/metrics.sh [port]
+#
+
+port=${1:-18680}
+records=1000
+dir=$(dirname "$0")
+tmp=${TMPDIR:-/tmp}/metrics.$$
+fail=0
+
+"$dir/metricsd" "$port" "$records" > "$tmp.log" 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null; rm -f "$tmp".*' EXIT
+
+# wait for it to be listening
+for i in 1 2 3 4 5 6 7 8 9 10; do
+  grep -q serving "$tmp.log" && break
+  sleep 0.2
+done
+
+check() {
+  if [ "$2" != "$3" ]; then
+    echo "metrics: $1, expected \"$3\", got \"$2\""; fail=1
+  fi
+}
+
+curl -s -D "$tmp.hdr" -o "$tmp.body" "http://127.0.0.1:$port/metrics" || { echo "metrics: scrape failed"; exit 1; }
+
+check "status" "$(head -1 "$tmp.hdr" | tr -d '\r')" "HTTP/1.0 200 OK"
+check "content type" "$(grep -i '^content-type:' "$tmp.hdr" | tr -d '\r' | cut -d' ' -f2-)" "text/plain; version=0.0.4"
+check "content length" "$(grep -i '^content-length:' "$tmp.hdr" | tr -d '\r' | cut -d' ' -f2)" "$(wc -c < "$tmp.body" | tr -d ' ')"
+
+# every sample is name{labels} value, and follows its HELP and TYPE lines
+awk '
+  /^# HELP / { help[$3] = 1; next }
+  /^# TYPE / { if (!help[$3]) { print "metrics: TYPE before HELP for " $3; bad = 1 }
+               if ($4 !~ /^(counter|gauge)$/) { print "metrics: bad type " $4; bad = 1 }
+               type[$3] = 1; next }
+  /^quant2dali_[a-z_]+(\{[^}]*\})? -?[0-9.eE+-]+$/ {
+               name = $1; sub(/\{.*/, "", name)
+               if (!type[name]) { print "metrics: no TYPE for " name; bad = 1 }
+               next }
+  { print "metrics: bad line: " $0; bad = 1 }
+  END { exit bad }
+' "$tmp.body" || fail=1
+
+value() {
+  grep "^quant2dali_$1{" "$tmp.body" | head -1 | awk '{ print $2 }'
+}
+check "records" "$(value records_total)" "$records"
+check "record bytes" "$(value record_bytes_total)" "$((records * 512))"
+check "datalink errors" "$(value datalink_errors_total)" "$((records / 100))"
+check "datalink reconnects" "$(value datalink_reconnects_total)" "1"
+check "station label" "$(grep -c 'station="TEST"' "$tmp.body" | awk '{ print ($1 > 0) }')" "1"
+
+check "other paths" "$(curl -s -o /dev/null -w '%{http_code}' "http://127.0.0.1:$port/other")" "404"
+
+if [ $fail -eq 0 ]; then
+  echo "metrics: $(grep -c '^quant2dali_' "$tmp.body") samples ok"
+fi
+exit $fail
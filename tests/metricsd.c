@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * metricsd: serve the metrics endpoint with known counts fed into it, for
+ * tests/metrics.sh to scrape, until interrupted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <libclient.h>
+#include <libtypes.h>
+
+#include "metrics.h"
+
+static volatile int running = 1;
+
+static void stop(int sig) {
+  running = 0;
+}
+
+int main(int argc, char **argv) {
+  int port = (argc > 1) ? atoi(argv[1]) : 18680;
+  long records = (argc > 2) ? atol(argv[2]) : 1000;
+  topstat opstat;
+  tlcqstat lcqstat;
+  long i;
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  memset(&opstat, 0, sizeof(opstat));
+  memset(&lcqstat, 0, sizeof(lcqstat));
+  metrics_state(LIBSTATE_RUN, &opstat);
+  metrics_lcqs(&lcqstat);
+  for (i = 0; i < records; i++) {
+    metrics_record(512);
+    metrics_datalink(512, (i % 100) == 0);
+    metrics_archive(0.001, 0);
+  }
+  metrics_reconnect();
+
+  if (metrics_start("TEST", port) < 0)
+    return 1;
+  (void) printf("metricsd: serving on port %d\n", port);
+  (void) fflush(stdout);
+  while (running)
+    pause();
+  metrics_stop();
+
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * nsload: run a netserver with dozens of clients reading from it at once
+ * and report, for each, the records it received, how many it lost to being
+ * lapped, whether any arrived torn, and how long they took to arrive.
+ *
+ * Records carry their sequence number, the time they were handed to the
+ * netserver and a pattern derived from the sequence, so a reader can tell
+ * a lost record from a broken one. A reader lagging behind loses records,
+ * as a real one would, but must never see a torn or reordered one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "libtypes.h"
+#include "libseed.h"
+#include "libnetserv.h"
+
+#define READERS 48
+
+static int port = 18600;
+static int readers = READERS;
+static long records = 20000;
+static long rate = 2000; /* records per second */
+static volatile int finished = 0;
+
+typedef struct {
+  pthread_t thread;
+  int id;
+  int fd;
+  long got, lost, torn;
+  long long latency, worst;
+} treader;
+
+static treader reader[MAX_NS_CLIENTS];
+
+static long long load_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void load_fill(unsigned char *rec, long long seq) {
+  long long stamp = load_nsecs();
+  int i;
+
+  memcpy(rec, &seq, sizeof(seq));
+  memcpy(rec + 8, &stamp, sizeof(stamp));
+  for (i = 16; i < LIB_REC_SIZE; i++)
+    rec[i] = (unsigned char) (seq + i);
+}
+
+static void *load_reader(void *p) {
+  treader *r = (treader *) p;
+  unsigned char rec[LIB_REC_SIZE];
+  long long seq, stamp, last = -1, lat;
+  int have = 0, n, i;
+
+  while ((n = recv(r->fd, rec + have, LIB_REC_SIZE - have, 0)) > 0) {
+    if ((have += n) < LIB_REC_SIZE)
+      continue;
+    have = 0;
+    memcpy(&seq, rec, sizeof(seq));
+    memcpy(&stamp, rec + 8, sizeof(stamp));
+    for (i = 16; i < LIB_REC_SIZE; i++)
+      if (rec[i] != (unsigned char) (seq + i))
+        break;
+    if ((i < LIB_REC_SIZE) || (seq <= last)) {
+      r->torn++; continue;
+    }
+    if (seq > last + 1)
+      r->lost += seq - last - 1;
+    last = seq;
+    r->got++;
+    lat = load_nsecs() - stamp;
+    r->latency += lat;
+    if (lat > r->worst)
+      r->worst = lat;
+    if (seq == records - 1)
+      break;
+  }
+  close(r->fd);
+
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  tns_par par;
+  pointer ns;
+  completed_record rec;
+  struct sockaddr_in sin;
+  long long t0, t1;
+  long n, got = 0, lost = 0, torn = 0;
+  int rc, i;
+
+  while ((rc = getopt(argc, argv, "hp:r:n:R:")) != EOF) {
+    switch (rc) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'r':
+      readers = atoi(optarg);
+      break;
+    case 'n':
+      records = atol(optarg);
+      break;
+    case 'R':
+      rate = atol(optarg);
+      break;
+    case 'h':
+    default:
+      (void) fprintf(stderr, "usage: %s [-p port] [-r readers] [-n records] [-R rate]\n", argv[0]);
+      exit(rc != 'h');
+    }
+  }
+  if ((readers <= 0) || (readers > MAX_NS_CLIENTS) || (records <= 0) || (rate <= 0)) {
+    (void) fprintf(stderr, "%s: bad arguments, at most %d readers\n", argv[0], MAX_NS_CLIENTS); exit(1);
+  }
+
+  memset(&par, 0, sizeof(par));
+  par.ns_port = port;
+  par.server_number = 1;
+  par.record_count = MAX_NS_BUFFERS;
+  if ((par.nsbuf = (tnsbuf *) malloc(sizeof(tnsbuf))) == NULL) {
+    perror("malloc"); exit(1);
+  }
+  if ((ns = lib_ns_start(&par)) == NIL) {
+    (void) fprintf(stderr, "%s: can't start a netserver on port %d\n", argv[0], port); exit(1);
+  }
+
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (i = 0; i < readers; i++) {
+    reader[i].id = i;
+    if (((reader[i].fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (connect(reader[i].fd, (struct sockaddr *) &sin, sizeof(sin)) < 0)) {
+      perror("connect"); exit(1);
+    }
+    pthread_create(&reader[i].thread, NULL, load_reader, &reader[i]);
+  }
+  usleep(200000); /* let the netserver accept them all */
+
+  t0 = load_nsecs();
+  for (n = 0; n < records; n++) {
+    while (load_nsecs() < t0 + (n * 1000000000LL) / rate)
+      usleep(50);
+    load_fill(rec, n);
+    lib_ns_send(ns, &rec);
+  }
+  t1 = load_nsecs();
+
+  for (i = 0; i < readers; i++) {
+    pthread_join(reader[i].thread, NULL);
+    got += reader[i].got;
+    lost += reader[i].lost;
+    torn += reader[i].torn;
+    if (reader[i].got == 0)
+      continue;
+    (void) printf("reader %2d: %ld records, %ld lost, %ld torn, latency mean %.1f max %.1f ms\n", i, reader[i].got, reader[i].lost,
+      reader[i].torn, reader[i].latency / (reader[i].got * 1e6), reader[i].worst / 1e6);
+  }
+  (void) printf("nsload: %d readers, %ld records at %.0f/s, %ld received, %ld lost, %ld torn\n", readers, records,
+    records / ((t1 - t0) / 1e9), got, lost, torn);
+
+  lib_ns_stop(ns);
+
+  return (torn > 0) || (got == 0);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * replaytest: replay tests/replay.cap twice, each time in a fresh context,
+ * and check that both replays hand over the same miniseed records, byte for
+ * byte and in the same order. A replay takes nothing from the host, so any
+ * difference is state leaking from one context into the next or something
+ * uninitialised finding its way into a record.
+ *
+ * The capture is a minute of q330sim -O 10 (three 100 sps channels, a tenth
+ * of the data packets out of order) taken through lib_capture.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libtypes.h"
+#include "libclient.h"
+#include "libmsgs.h"
+
+typedef struct {
+  char *data; /* channel name then record, for every record */
+  long size;
+  long records;
+} treplay;
+
+static treplay replays[2];
+static treplay *current = NULL;
+static volatile int finished = 0;
+
+static void replay_state(pointer p) {
+}
+
+static void replay_messages(pointer p) {
+  tmsg_call *msg = (tmsg_call *) p;
+
+  if (msg->code == LIBMSG_REPLAYEND)
+    finished = 1;
+}
+
+static void replay_minidata(pointer p) {
+  tminiseed_call *mini = (tminiseed_call *) p;
+
+  /* the message log carries the times messages were logged */
+  if (strcmp(mini->channel, "LOG") == 0)
+    return;
+  current->data = realloc(current->data, current->size + sizeof(mini->channel) + mini->data_size);
+  if (current->data == NULL) {
+    (void) fprintf(stderr, "out of memory\n"); exit(1);
+  }
+  memcpy(current->data + current->size, mini->channel, sizeof(mini->channel));
+  memcpy(current->data + current->size + sizeof(mini->channel), mini->data_address, mini->data_size);
+  current->size += sizeof(mini->channel) + mini->data_size;
+  current->records++;
+}
+
+static int replay_run(char *capture, treplay *r) {
+  unsigned long long serial = 0x0100000000001000LL;
+  tpar_create ci;
+  tcontext ct;
+  enum tliberr err;
+
+  memset(&ci, 0, sizeof(ci));
+  memcpy(ci.q330id_serial, &serial, sizeof(ci.q330id_serial));
+  ci.q330id_dataport = LP_TEL1;
+  strcpy(ci.q330id_station, "SIM00");
+  strcpy(ci.host_software, "replaytest");
+  ci.opt_zoneadjust = 1;
+  ci.opt_minifilter = OMF_ALL;
+  ci.mini_embed = 1;
+  ci.mini_separate = 1;
+  ci.call_minidata = replay_minidata;
+  ci.call_state = replay_state;
+  ci.call_messages = replay_messages;
+
+  lib_create_context(&ct, &ci);
+  if (ct == NULL) {
+    (void) fprintf(stderr, "can't create a context [%d]\n", (int) ci.resp_err); return -1;
+  }
+  current = r;
+  finished = 0;
+
+  if ((err = lib_replay(ct, capture, FALSE)) != LIBERR_NOERR) {
+    (void) fprintf(stderr, "can't replay %s [%d]\n", capture, (int) err);
+    lib_destroy_context(&ct); return -1;
+  }
+  while (!finished)
+    usleep(1000);
+
+  /* the lib330 thread has to have gone before the context is */
+  while (lib_get_state(ct, &err, NULL) != LIBSTATE_TERM) {
+    lib_change_state(ct, LIBSTATE_TERM, LIBERR_CLOSED);
+    usleep(10000);
+  }
+  lib_destroy_context(&ct);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char *capture = (argc > 1) ? argv[1] : "tests/replay.cap";
+  long off, n;
+
+  if ((replay_run(capture, &replays[0]) < 0) || (replay_run(capture, &replays[1]) < 0))
+    return 1;
+
+  if (replays[0].records == 0) {
+    (void) fprintf(stderr, "replaytest: no records from %s\n", capture); return 1;
+  }
+  if ((replays[0].records != replays[1].records) || (replays[0].size != replays[1].size)) {
+    (void) fprintf(stderr, "replaytest: %ld records of %ld bytes, then %ld of %ld\n",
+      replays[0].records, replays[0].size, replays[1].records, replays[1].size);
+    return 1;
+  }
+  for (off = 0; off < replays[0].size; off++)
+    if (replays[0].data[off] != replays[1].data[off]) {
+      /* records are all the same length within a capture */
+      n = replays[0].size / replays[0].records;
+      (void) fprintf(stderr, "replaytest: record %ld (%.4s) differs at byte %ld\n",
+        off / n, replays[0].data + (off / n) * n, off % n);
+      return 1;
+    }
+
+  (void) printf("replaytest: %s replayed twice, %ld records of %ld bytes identical\n",
+    capture, replays[0].records, replays[0].size);
+
+  return 0;
+}
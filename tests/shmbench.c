@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * shmbench: publish records into a shared memory ring as quant2dali would,
+ * with a number of reader processes following it, and report how many each
+ * reader saw, missed or found torn, and how long records took to reach them.
+ *
+ * Each record carries the time it was written, readers copy it out of the
+ * ring as a real consumer would and compare against the time it arrived.
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "shmring.h"
+
+static char *name = "/shmbench";
+static int readers = 4;
+static long records = 1000000;
+static long rate = 0; /* records per second, none for as fast as possible */
+static int slots = SHMRING_SLOTS;
+static int streams = 3;
+
+static long long bench_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bench_compare(const void *a, const void *b) {
+  long long x = *(const long long *) a, y = *(const long long *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+static int bench_reader(int id, int ready) {
+  shmring_reader *r;
+  shmring_record rec;
+  char buf[SHMRING_RECSIZE];
+  long long *lat, stamp;
+  long got = 0, torn = 0, order = 0;
+  uint64_t last = 0;
+  int rc;
+
+  if ((lat = (long long *) malloc(records * sizeof(long long))) == NULL)
+    return -1;
+  if ((r = shmring_open(name)) == NULL) {
+    (void) fprintf(stderr, "reader %d: can't open %s [%s]\n", id, name, strerror(errno)); return -1;
+  }
+  (void) write(ready, "r", 1);
+  close(ready);
+
+  while ((rc = shmring_next(r, &rec, 1000)) >= 0) {
+    if (rc == 0)
+      continue;
+    if (shmring_copy(r, &rec, buf, sizeof(buf)) < 0) {
+      torn++; continue;
+    }
+    if ((got > 0) && (rec.seq <= last))
+      order++;
+    last = rec.seq;
+    memcpy(&stamp, buf, sizeof(stamp));
+    if (got < records)
+      lat[got] = bench_nsecs() - stamp;
+    got++;
+  }
+
+  if (got > records)
+    got = records;
+  qsort(lat, got, sizeof(long long), bench_compare);
+  (void) printf("reader %d: %ld records, %llu missed, %ld torn, %ld out of order", id, got, (unsigned long long) r->missed, torn, order);
+  if (got > 0)
+    (void) printf(", latency median %.1f p99 %.1f max %.1f us", lat[got / 2] / 1000.0, lat[(got * 99) / 100] / 1000.0, lat[got - 1] / 1000.0);
+  (void) printf("\n");
+
+  shmring_close(r);
+  free(lat);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char record[SHMRING_RECSIZE], key[20], c;
+  long long t0, t1, stamp, due;
+  int fds[2], rc, i;
+  pid_t pid;
+  long n;
+
+  while ((rc = getopt(argc, argv, "hn:r:R:s:k:m:")) != EOF) {
+    switch (rc) {
+    case 'n':
+      records = atol(optarg);
+      break;
+    case 'r':
+      readers = atoi(optarg);
+      break;
+    case 'R':
+      rate = atol(optarg);
+      break;
+    case 's':
+      slots = atoi(optarg);
+      break;
+    case 'k':
+      streams = atoi(optarg);
+      break;
+    case 'm':
+      name = optarg;
+      break;
+    case 'h':
+    default:
+      (void) fprintf(stderr, "usage: %s [-n records] [-r readers] [-R rate] [-s slots] [-k streams] [-m name]\n", argv[0]);
+      (void) fprintf(stderr, "\t-n\trecords to publish [%ld]\n", records);
+      (void) fprintf(stderr, "\t-r\treader processes [%d]\n", readers);
+      (void) fprintf(stderr, "\t-R\trecords per second, 0 for as fast as possible [%ld]\n", rate);
+      (void) fprintf(stderr, "\t-s\tslots in the ring, a power of two [%d]\n", slots);
+      (void) fprintf(stderr, "\t-k\tstreams the records are spread over [%d]\n", streams);
+      (void) fprintf(stderr, "\t-m\tshared memory name [%s]\n", name);
+      exit(rc != 'h');
+    }
+  }
+  if ((records <= 0) || (readers < 0) || (streams <= 0)) {
+    (void) fprintf(stderr, "%s: bad arguments\n", argv[0]); exit(1);
+  }
+
+  if (shmring_start(name, slots) < 0) {
+    (void) fprintf(stderr, "can't create %s [%s]\n", name, strerror(errno)); exit(1);
+  }
+
+  /* wait for every reader to be attached before writing anything */
+  if (pipe(fds) < 0) {
+    perror("pipe"); shmring_stop(); exit(1);
+  }
+  for (i = 0; i < readers; i++) {
+    if ((pid = fork()) < 0) {
+      perror("fork"); shmring_stop(); exit(1);
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      exit((bench_reader(i, fds[1]) < 0) ? 1 : 0);
+    }
+  }
+  close(fds[1]);
+  for (i = 0; (i < readers) && (read(fds[0], &c, 1) == 1); i++);
+  close(fds[0]);
+
+  memset(record, 0, sizeof(record));
+  t0 = bench_nsecs();
+  for (n = 0; n < records; n++) {
+    if (rate > 0) {
+      due = t0 + (n * 1000000000LL) / rate;
+      while (bench_nsecs() < due);
+    }
+    (void) snprintf(key, sizeof(key), "NZ-BENCH.10.HH%c", 'A' + (int) (n % streams));
+    stamp = bench_nsecs();
+    memcpy(record, &stamp, sizeof(stamp));
+    (void) shmring_push(record, sizeof(record), key, (double) n, 0);
+  }
+  t1 = bench_nsecs();
+  (void) printf("writer: %ld records in %.3f s, %.0f records/s\n", records, (t1 - t0) / 1e9, records / ((t1 - t0) / 1e9));
+  (void) fflush(stdout);
+
+  shmring_stop();
+  while (wait(NULL) > 0);
+
+  return 0;
+}
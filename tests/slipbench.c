@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * slipbench: time Base-96 decoding and SLIP unframing against the byte at
+ * a time loops they replaced, first in memory and then draining a pseudo
+ * terminal that a forked sender keeps full of framed packets.
+ *
+ * Packets are 540 bytes, about as large as the Q330 sends, and go as
+ * Base-96 as they do on a serial line. Rates are of the bytes decoded in
+ * memory, and of the bytes read for the pty. The old pty loop reads 700
+ * bytes at a time and sleeps 25 ms when nothing has arrived, the new one
+ * polls and then takes up to 4096 bytes, as read_from_serial does.
+ *
+ * Build it with the optimisation lib330 is shipped with, CFLAGS=-O2 make
+ * tests/slipbench, as without any the SSE2 intrinsics lose to the byte loop.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "libtypes.h"
+#include "libslip.h"
+
+#define PACKET 540
+#define FRAMESIZE 1400
+#define MASK 0x5A
+
+static int rounds = 20000;
+static int seconds = 3;
+static byte packet[PACKET];
+static byte framebuf[FRAMESIZE + 1];
+static pbyte oldptr;
+static boolean oldesc;
+static long frames, good;
+static volatile byte sink;
+
+static double bench_secs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Base-96 then SLIP, as the Q330 sends a packet */
+static integer encode_packet(pbyte out) {
+  byte enc[2 + (PACKET / 3) * 4], b0, b1, b2;
+  integer e = 2, i, o = 0;
+
+  sprintf((char *) enc, "%02X", MASK);
+  for (i = 0; i < PACKET; i += 3) {
+    b0 = packet[i] ^ MASK; b1 = packet[i + 1] ^ MASK; b2 = packet[i + 2] ^ MASK;
+    enc[e++] = (b0 & 0x3f) + 0x20;
+    enc[e++] = (b1 & 0x3f) + 0x20;
+    enc[e++] = (b2 & 0x3f) + 0x20;
+    enc[e++] = (((b0 >> 6) << 4) | ((b1 >> 6) << 2) | (b2 >> 6)) + 0x20;
+  }
+  out[o++] = SLIP_FRM;
+  for (i = 0; i < e; i++) {
+    if (enc[i] == SLIP_FRM) {
+      out[o++] = SLIP_ESC; out[o++] = ESC_FRM;
+    } else if (enc[i] == SLIP_ESC) {
+      out[o++] = SLIP_ESC; out[o++] = ESC_ESC;
+    } else
+      out[o++] = enc[i];
+  }
+  out[o++] = SLIP_FRM;
+  return o;
+}
+
+/* the group at a time decoder q330io used */
+static integer old_decode(pbyte pdest, pbyte psrc, integer groups, byte mask) {
+  integer count = groups * 3;
+  byte m;
+
+  while (groups-- > 0) {
+    m = psrc[3] - 0x20;
+    *pdest++ = (psrc[0] - 0x20 + ((m & 0x30) << 2)) ^ mask;
+    *pdest++ = (psrc[1] - 0x20 + ((m & 0xc) << 4)) ^ mask;
+    *pdest++ = (psrc[2] - 0x20 + ((m & 3) << 6)) ^ mask;
+    psrc += 4;
+  }
+  return count;
+}
+
+static void check_frame(integer lth, integer actual) {
+
+  frames++;
+  if ((actual == PACKET) && (memcmp(framebuf, packet, PACKET) == 0))
+    good++;
+  sink = framebuf[7];
+}
+
+/* the byte at a time unframer read_from_serial used, decoding in place as q330io does */
+static void old_unframe(pbyte pin, integer count) {
+  pbyte pout = oldptr;
+  integer i, lth;
+  byte c;
+
+  for (i = 0; i < count; i++) {
+    c = *pin++;
+    switch (c) {
+    case SLIP_FRM:
+      oldesc = FALSE;
+      lth = pout - framebuf;
+      if (lth)
+        check_frame(lth, old_decode(framebuf, framebuf + 2, (lth - 2) >> 2, MASK));
+      pout = framebuf;
+      break;
+    case SLIP_ESC:
+      oldesc = TRUE;
+      break;
+    case ESC_FRM:
+      if (oldesc) {
+        oldesc = FALSE; *pout++ = SLIP_FRM;
+      } else
+        *pout++ = c;
+      break;
+    case ESC_ESC:
+      if (oldesc) {
+        oldesc = FALSE; *pout++ = SLIP_ESC;
+      } else
+        *pout++ = c;
+      break;
+    default:
+      *pout++ = c;
+    }
+    if (pout > framebuf + FRAMESIZE)
+      pout = framebuf;
+  }
+  oldptr = pout;
+}
+
+static boolean new_frame(pointer ctx, integer lth) {
+
+  check_frame(lth, base96_decode(framebuf, framebuf + 2, (lth - 2) >> 2, MASK));
+  return FALSE;
+}
+
+static void report(char *what, double bytes, double secs) {
+
+  printf("%-36s %8.1f MB/s, %ld of %ld frames good\n", what, bytes / secs / 1e6, good, frames);
+  frames = good = 0;
+}
+
+static void bench_memory(void) {
+  static byte stream[1 << 20];
+  byte frame[2 * PACKET + 8], out[PACKET];
+  integer lth, n = 0, off, c, i;
+  tslip slip;
+  double t;
+
+  lth = encode_packet(frame);
+  while ((n + lth) < sizeof(stream)) {
+    memcpy(stream + n, frame, lth); n += lth;
+  }
+
+  t = bench_secs();
+  for (i = 0; i < rounds * 10; i++) {
+    old_decode(out, frame + 3, PACKET / 3, MASK); sink = out[i % PACKET];
+  }
+  t = bench_secs() - t;
+  frames = good = (memcmp(out, packet, PACKET) == 0) * (long) rounds * 10;
+  report("decode, byte loop", (double) rounds * 10 * PACKET, t);
+
+  t = bench_secs();
+  for (i = 0; i < rounds * 10; i++) {
+    base96_decode(out, frame + 3, PACKET / 3, MASK); sink = out[i % PACKET];
+  }
+  t = bench_secs() - t;
+  frames = good = (memcmp(out, packet, PACKET) == 0) * (long) rounds * 10;
+#if defined(__SSE2__) && defined(__GNUC__)
+  report("decode, base96_decode with SSE2", (double) rounds * 10 * PACKET, t);
+#else
+  report("decode, base96_decode without SSE2", (double) rounds * 10 * PACKET, t);
+#endif
+
+  oldptr = framebuf;
+  t = bench_secs();
+  for (i = 0; i < rounds / 1000; i++)
+    for (off = 0; off < n; off += 700) {
+      c = ((n - off) < 700) ? n - off : 700;
+      old_unframe(stream + off, c);
+    }
+  t = bench_secs() - t;
+  report("unframe and decode, byte loops", (double) (rounds / 1000) * n, t);
+
+  slip_init(&slip, framebuf, FRAMESIZE);
+  t = bench_secs();
+  for (i = 0; i < rounds / 1000; i++)
+    for (off = 0; off < n; off += 4096) {
+      c = ((n - off) < 4096) ? n - off : 4096;
+      slip_unframe(&slip, stream + off, c, new_frame, NULL);
+    }
+  t = bench_secs() - t;
+  report("unframe and decode, libslip", (double) (rounds / 1000) * n, t);
+}
+
+static void bench_pty(int old) {
+  static byte block[1 << 16];
+  struct termios tio;
+  struct pollfd pfd;
+  byte inbuf[4096];
+  ssize_t numread;
+  integer lth, n;
+  double t0, t, total = 0;
+  tslip slip;
+  char *name;
+  int master, slave;
+  pid_t pid;
+
+  if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0) {
+    perror("posix_openpt"); exit(1);
+  }
+  if ((grantpt(master) < 0) || (unlockpt(master) < 0) || ((name = ptsname(master)) == NULL) ||
+      ((slave = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0)) {
+    perror("pty"); exit(1);
+  }
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  tcsetattr(slave, TCSANOW, &tio);
+
+  if ((pid = fork()) < 0) {
+    perror("fork"); exit(1);
+  }
+  if (pid == 0) {
+    close(slave);
+    n = lth = encode_packet(block);
+    while ((n + lth) < sizeof(block)) {
+      memcpy(block + n, block, lth); n += lth;
+    }
+    while (write(master, block, n) > 0);
+    _exit(0);
+  }
+
+  oldptr = framebuf;
+  oldesc = FALSE;
+  slip_init(&slip, framebuf, FRAMESIZE);
+  t0 = bench_secs();
+  while ((t = bench_secs() - t0) < seconds) {
+    if (old) {
+      if ((numread = read(slave, inbuf, 700)) <= 0) {
+        usleep(25000); continue;
+      }
+      old_unframe(inbuf, numread);
+    } else {
+      pfd.fd = slave;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, 25) <= 0)
+        continue;
+      if ((numread = read(slave, inbuf, sizeof(inbuf))) <= 0) {
+        usleep(25000); continue;
+      }
+      slip_unframe(&slip, inbuf, numread, new_frame, NULL);
+    }
+    total += numread;
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  close(slave);
+  close(master);
+
+  report(old ? "pty, read and sleep with byte loops" : "pty, poll and read with libslip", total, t);
+}
+
+int main(int argc, char **argv) {
+  int rc, i;
+
+  while ((rc = getopt(argc, argv, "hn:s:")) != EOF) {
+    switch (rc) {
+    case 'n':
+      rounds = atoi(optarg);
+      break;
+    case 's':
+      seconds = atoi(optarg);
+      break;
+    case 'h':
+    default:
+      (void) fprintf(stderr, "usage: %s [-n rounds] [-s seconds]\n", argv[0]);
+      (void) fprintf(stderr, "\t-n\tpackets decoded in memory, over ten [%d]\n", rounds);
+      (void) fprintf(stderr, "\t-s\tseconds draining the pty each way [%d]\n", seconds);
+      exit(rc != 'h');
+    }
+  }
+  if ((rounds < 1000) || (seconds <= 0)) {
+    (void) fprintf(stderr, "%s: bad arguments\n", argv[0]); exit(1);
+  }
+
+  for (i = 0; i < PACKET; i++)
+    packet[i] = rand();
+  bench_memory();
+  bench_pty(1);
+  bench_pty(0);
+
+  return 0;
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * sliptest: check the block at a time SLIP unframing and Base-96 decoding
+ * against the byte at a time loops they replaced, then send framed packets
+ * across a pseudo terminal and check every one comes out the far side.
+ *
+ * The first part feeds random streams, heavy with special characters,
+ * malformed escapes and frames too long for the buffer, through both in
+ * random sized pieces and compares the frames, the overruns and the state
+ * left behind. Base-96 is decoded both into a separate buffer and in place,
+ * two bytes before the source, as q330io does.
+ *
+ * The second part forks a sender onto the master side of a pty, writing
+ * Base-96 packets and escaped binary packets in random sized writes, and
+ * reads the slave side the way read_from_serial does, polling and then
+ * taking whatever has arrived.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "libtypes.h"
+#include "libslip.h"
+
+#define STREAMS 20000
+#define FRAMESIZE 600 /* room for a frame in the random streams */
+#define PACKETS 20000 /* sent across the pty */
+#define MAXPACKET 576 /* largest packet, a multiple of three */
+#define PTYFRAME 1500
+
+static byte oldbuf[FRAMESIZE + 1];
+static pbyte oldptr;
+static boolean oldesc, oldneed;
+static long oldframes, oldhash;
+static byte newbuf[FRAMESIZE];
+static long newframes, newhash;
+
+static long frame_hash(pbyte p, integer lth) {
+  long h = 0;
+  integer i;
+
+  for (i = 0; i < lth; i++)
+    h = h * 31 + p[i];
+  return h;
+}
+
+/* whether a frame is a packet, which sends the unframer looking for the next one */
+static boolean verdict(pbyte p, integer lth) {
+
+  return (frame_hash(p, lth) & 3) != 0;
+}
+
+/* the byte at a time unframer read_from_serial used */
+static integer old_unframe(pbyte pin, integer count) {
+  pbyte pout = oldptr;
+  integer i, overruns = 0, lth;
+  byte c;
+
+  for (i = 0; i < count; i++) {
+    c = *pin++;
+    if ((c == SLIP_FRM) || !oldneed)
+      switch (c) {
+      case SLIP_FRM:
+        oldesc = FALSE;
+        oldneed = FALSE;
+        lth = pout - oldbuf;
+        if (lth) {
+          oldhash = oldhash * 7 + frame_hash(oldbuf, lth) + lth;
+          oldframes++;
+          oldneed = verdict(oldbuf, lth);
+        }
+        pout = oldbuf;
+        break;
+      case SLIP_ESC:
+        oldesc = TRUE;
+        break;
+      case ESC_FRM:
+        if (oldesc) {
+          oldesc = FALSE; *pout++ = SLIP_FRM;
+        } else
+          *pout++ = c;
+        break;
+      case ESC_ESC:
+        if (oldesc) {
+          oldesc = FALSE; *pout++ = SLIP_ESC;
+        } else
+          *pout++ = c;
+        break;
+      default:
+        *pout++ = c;
+      }
+    if (pout > oldbuf + FRAMESIZE) {
+      pout = oldbuf; overruns++;
+    }
+  }
+  oldptr = pout;
+  return overruns;
+}
+
+static boolean new_frame(pointer ctx, integer lth) {
+
+  newhash = newhash * 7 + frame_hash(newbuf, lth) + lth;
+  newframes++;
+  return verdict(newbuf, lth);
+}
+
+/* the group at a time decoder q330io used */
+static void old_decode(pbyte pdest, pbyte psrc, integer groups, byte mask) {
+  byte m;
+
+  while (groups-- > 0) {
+    m = psrc[3] - 0x20;
+    *pdest++ = (psrc[0] - 0x20 + ((m & 0x30) << 2)) ^ mask;
+    *pdest++ = (psrc[1] - 0x20 + ((m & 0xc) << 4)) ^ mask;
+    *pdest++ = (psrc[2] - 0x20 + ((m & 3) << 6)) ^ mask;
+    psrc += 4;
+  }
+}
+
+static int compare_streams(void) {
+  static byte in[3000], a[2000], b[2000];
+  integer n, i, r, mode, chunk, off, c, groups;
+  integer oldover = 0, newover = 0;
+  tslip slip;
+  byte mask;
+  long it;
+
+  slip_init(&slip, newbuf, FRAMESIZE);
+  oldptr = oldbuf;
+  for (it = 0; it < STREAMS; it++) {
+    /* plain noise, special characters, short frames, or frames too long to fit */
+    n = rand() % sizeof(in);
+    mode = rand() % 4;
+    for (i = 0; i < n; i++) {
+      r = rand() % 100;
+      in[i] = (mode == 0) ? rand() : (r < 3) ? SLIP_FRM : (r < 6) ? SLIP_ESC : (r < 8) ? ESC_FRM : (r < 10) ? ESC_ESC :
+        ((mode == 1) && (r < 11)) ? SLIP_FRM : rand();
+    }
+    if (mode == 3)
+      for (i = 0; i < n; i++)
+        if ((in[i] == SLIP_FRM) && (rand() % 10))
+          in[i] = 1;
+    chunk = 1 + rand() % 700;
+    for (off = 0; off < n; off += chunk) {
+      c = ((n - off) < chunk) ? n - off : chunk;
+      oldover += old_unframe(in + off, c);
+      newover += slip_unframe(&slip, in + off, c, new_frame, NULL);
+    }
+    if ((oldframes != newframes) || (oldhash != newhash) || (oldover != newover) || (oldesc != slip.escpend) ||
+        (oldneed != slip.needframe) || ((oldptr - oldbuf) != (slip.ptr - newbuf)) || memcmp(oldbuf, newbuf, oldptr - oldbuf)) {
+      fprintf(stderr, "stream %ld: unframed %ld frames with %d overruns, expected %ld with %d\n", it,
+        newframes, (int) newover, oldframes, (int) oldover);
+      return -1;
+    }
+
+    /* mostly valid characters, but anything may turn up on a serial line */
+    groups = rand() % 200;
+    mask = rand();
+    for (i = 0; i < (groups * 4 + 2); i++)
+      in[i] = (rand() % 4) ? 0x20 + rand() % 96 : rand();
+    old_decode(a, in + 2, groups, mask);
+    if ((base96_decode(b, in + 2, groups, mask) != (groups * 3)) || memcmp(a, b, groups * 3)) {
+      fprintf(stderr, "stream %ld: %d groups decoded wrongly\n", it, (int) groups); return -1;
+    }
+    memcpy(b, in, groups * 4 + 2);
+    base96_decode(b, b + 2, groups, mask);
+    if (memcmp(a, b, groups * 3)) {
+      fprintf(stderr, "stream %ld: %d groups decoded wrongly in place\n", it, (int) groups); return -1;
+    }
+  }
+  printf("sliptest: %d streams, %ld frames and %d overruns as before\n", STREAMS, newframes, (int) newover);
+
+  return 0;
+}
+
+/* packet n, the same on both sides */
+static integer make_packet(long n, pbyte p, byte *mask) {
+  unsigned int seed = n;
+  integer lth, i;
+
+  lth = 3 * (1 + rand_r(&seed) % (MAXPACKET / 3));
+  *mask = rand_r(&seed);
+  for (i = 0; i < lth; i++)
+    p[i] = rand_r(&seed);
+  return lth;
+}
+
+static integer slip_escape(pbyte out, pbyte in, integer lth) {
+  integer i, o = 0;
+
+  out[o++] = SLIP_FRM;
+  for (i = 0; i < lth; i++) {
+    if (in[i] == SLIP_FRM) {
+      out[o++] = SLIP_ESC; out[o++] = ESC_FRM;
+    } else if (in[i] == SLIP_ESC) {
+      out[o++] = SLIP_ESC; out[o++] = ESC_ESC;
+    } else
+      out[o++] = in[i];
+  }
+  out[o++] = SLIP_FRM;
+  return o;
+}
+
+/* even packets go as Base-96, the mask in hex then four characters for every three bytes */
+static integer encode_packet(long n, pbyte out) {
+  byte p[MAXPACKET], enc[2 + (MAXPACKET / 3) * 4], b0, b1, b2, mask;
+  integer lth, e, i;
+
+  lth = make_packet(n, p, &mask);
+  if (n & 1)
+    return slip_escape(out, p, lth);
+  sprintf((char *) enc, "%02X", mask);
+  e = 2;
+  for (i = 0; i < lth; i += 3) {
+    b0 = p[i] ^ mask; b1 = p[i + 1] ^ mask; b2 = p[i + 2] ^ mask;
+    enc[e++] = (b0 & 0x3f) + 0x20;
+    enc[e++] = (b1 & 0x3f) + 0x20;
+    enc[e++] = (b2 & 0x3f) + 0x20;
+    enc[e++] = (((b0 >> 6) << 4) | ((b1 >> 6) << 2) | (b2 >> 6)) + 0x20;
+  }
+  return slip_escape(out, enc, e);
+}
+
+static void pty_sender(int fd) {
+  static byte out[1 << 16];
+  integer lth = 0, off, chunk;
+  ssize_t k;
+  long n;
+
+  srand(getpid());
+  for (n = 0; n <= PACKETS; n++) {
+    if (n < PACKETS)
+      lth += encode_packet(n, out + lth);
+    if ((n == PACKETS) || (lth > (sizeof(out) - 2 * (2 * MAXPACKET + 4)))) {
+      for (off = 0; off < lth; off += k) {
+        chunk = 1 + rand() % 4096;
+        if (chunk > (lth - off))
+          chunk = lth - off;
+        if ((k = write(fd, out + off, chunk)) <= 0)
+          _exit(1);
+      }
+      lth = 0;
+    }
+  }
+  /* closing the master would lose whatever the reader has yet to take */
+  pause();
+  _exit(0);
+}
+
+static byte ptybuf[PTYFRAME];
+static long received, wrong;
+
+static boolean pty_frame(pointer ctx, integer lth) {
+  byte p[MAXPACKET], mask;
+  integer plth;
+  unsigned int m;
+  boolean ok;
+
+  plth = make_packet(received, p, &mask);
+  if (received & 1)
+    ok = (lth == plth) && (memcmp(ptybuf, p, plth) == 0);
+  else
+    ok = (lth == (2 + (plth / 3) * 4)) && (sscanf((char *) ptybuf, "%2X", &m) == 1) && (m == mask) &&
+      (base96_decode(ptybuf, ptybuf + 2, (lth - 2) >> 2, m) == plth) && (memcmp(ptybuf, p, plth) == 0);
+  if (!ok) {
+    if (wrong < 5)
+      fprintf(stderr, "packet %ld: %d bytes came out wrong\n", received, (int) plth);
+    wrong++;
+  }
+  received++;
+  return TRUE;
+}
+
+static int pty_round_trip(void) {
+  struct termios tio;
+  struct pollfd pfd;
+  byte inbuf[4096];
+  ssize_t numread;
+  integer overruns = 0, idle = 0;
+  tslip slip;
+  char *name;
+  int master, slave;
+  pid_t pid;
+
+  if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0) {
+    perror("posix_openpt"); return -1;
+  }
+  if ((grantpt(master) < 0) || (unlockpt(master) < 0) || ((name = ptsname(master)) == NULL) ||
+      ((slave = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0)) {
+    perror("pty"); close(master); return -1;
+  }
+  /* as lib330 sets up a serial port, no translation and reads return what there is */
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  tcsetattr(slave, TCSANOW, &tio);
+
+  if ((pid = fork()) < 0) {
+    perror("fork"); return -1;
+  }
+  if (pid == 0) {
+    close(slave);
+    pty_sender(master);
+  }
+
+  slip_init(&slip, ptybuf, PTYFRAME);
+  while ((received < PACKETS) && (idle < 200)) {
+    pfd.fd = slave;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 25) <= 0) {
+      idle++; continue;
+    }
+    if ((numread = read(slave, inbuf, sizeof(inbuf))) <= 0) {
+      idle++; usleep(25000); continue;
+    }
+    idle = 0;
+    overruns += slip_unframe(&slip, inbuf, numread, pty_frame, NULL);
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  close(slave);
+  close(master);
+
+  printf("sliptest: %ld of %d packets across a pty, %ld wrong, %d overruns\n", received, PACKETS, wrong, (int) overruns);
+  return ((received == PACKETS) && (wrong == 0) && (overruns == 0)) ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+
+  if (compare_streams() < 0)
+    return 1;
+  if (pty_round_trip() < 0)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * slload: publish records into a private ring at a steady rate, as the
+ * minidata callback would, and follow them with many SeedLink clients of
+ * the embedded server, reporting how many packets each client got, any
+ * gaps in their sequence numbers, and how long packets took to arrive.
+ * With SELECT the gaps include every record not selected.
+ *
+ * The clients run in a child process, all in one epoll loop, and send the
+ * same command lines once connected. Each record carries the time it was
+ * written, which the client compares against the time its packet arrived.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "shmring.h"
+#include "seedlink.h"
+
+#define LATENCIES 200000 /* arrival times kept for each client */
+
+typedef struct load_client {
+  int fd;
+  char buf[SEEDLINK_PACKET];
+  int len;
+  long packets;
+  long gaps;
+  unsigned int last;
+  long long *lat;
+  long nlat;
+} load_client;
+
+static int port = 18555;
+static int nclients = 100;
+static int seconds = 10;
+static long rate = 500; /* records per second */
+static int streams = 3;
+static char *command = "DATA";
+static char lines[SEEDLINK_COMMAND * 8];
+
+static long long load_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int load_compare(const void *a, const void *b) {
+  long long x = *(const long long *) a, y = *(const long long *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/* one packet in, the record starts with the time it was written */
+static void load_packet(load_client *c) {
+  char hex[7];
+  unsigned int seq;
+  long long stamp;
+
+  memcpy(hex, c->buf + 2, 6);
+  hex[6] = '\0';
+  seq = strtoul(hex, NULL, 16);
+  if ((c->packets > 0) && (seq != ((c->last + 1) & 0xFFFFFF)))
+    c->gaps++;
+  c->last = seq;
+  memcpy(&stamp, c->buf + 8 + 64, sizeof(stamp));
+  if (c->nlat < LATENCIES)
+    c->lat[c->nlat++] = load_nsecs() - stamp;
+  c->packets++;
+  c->len = 0;
+}
+
+static int load_clients(int ready) {
+  struct sockaddr_in sa;
+  struct epoll_event ev, evs[256];
+  load_client *clients, *c;
+  long long end, *all;
+  long total = 0, gaps = 0, nall = 0, least = -1, most = 0, j;
+  ssize_t r;
+  int ep, n, i, k;
+
+  if (((clients = (load_client *) calloc(nclients, sizeof(load_client))) == NULL) || ((ep = epoll_create1(0)) < 0))
+    return -1;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (i = 0; i < nclients; i++) {
+    c = &clients[i];
+    if (((c->lat = (long long *) malloc(LATENCIES * sizeof(long long))) == NULL) ||
+        ((c->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (connect(c->fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)) {
+      fprintf(stderr, "client %d: can't connect to port %d [%s]\n", i, port, strerror(errno)); return -1;
+    }
+    (void) write(c->fd, lines, strlen(lines));
+    (void) fcntl(c->fd, F_SETFL, O_NONBLOCK);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    (void) epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+  }
+  (void) write(ready, "r", 1);
+  close(ready);
+
+  end = load_nsecs() + (seconds + 2) * 1000000000LL;
+  while (load_nsecs() < end) {
+    n = epoll_wait(ep, evs, 256, 100);
+    for (k = 0; k < n; k++) {
+      c = (load_client *) evs[k].data.ptr;
+      while ((r = read(c->fd, c->buf + c->len, SEEDLINK_PACKET - c->len)) > 0) {
+        c->len += r;
+        /* replies to the command lines come before any packets */
+        while ((c->len >= 4) && (memcmp(c->buf, "OK\r\n", 4) == 0)) {
+          memmove(c->buf, c->buf + 4, c->len - 4);
+          c->len -= 4;
+        }
+        if ((c->len >= 2) && (memcmp(c->buf, "SL", 2) != 0)) {
+          fprintf(stderr, "client %d: unexpected %.*s\n", (int) (c - clients), c->len, c->buf); return -1;
+        }
+        if (c->len == SEEDLINK_PACKET)
+          load_packet(c);
+      }
+      if (r == 0) {
+        (void) epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+      }
+    }
+  }
+
+  for (i = 0; i < nclients; i++) {
+    total += clients[i].packets;
+    gaps += clients[i].gaps;
+    nall += clients[i].nlat;
+    least = ((least < 0) || (clients[i].packets < least)) ? clients[i].packets : least;
+    most = (clients[i].packets > most) ? clients[i].packets : most;
+  }
+  if ((all = (long long *) malloc((nall + 1) * sizeof(long long))) == NULL)
+    return -1;
+  for (nall = 0, i = 0; i < nclients; i++)
+    for (j = 0; j < clients[i].nlat; j++)
+      all[nall++] = clients[i].lat[j];
+  qsort(all, nall, sizeof(long long), load_compare);
+
+  printf("%d clients: %ld packets (each %ld to %ld), %ld sequence gaps", nclients, total, least, most, gaps);
+  if (nall > 0)
+    printf(", latency median %.1f p99 %.1f max %.1f us", all[nall / 2] / 1000.0, all[(nall * 99) / 100] / 1000.0, all[nall - 1] / 1000.0);
+  printf("\n");
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char record[SHMRING_RECSIZE], key[20], c;
+  long long t0, t1, stamp, due;
+  struct timespec pause = { 0, 20000 };
+  struct rlimit rl;
+  int fds[2], rc;
+  long n, total;
+  pid_t pid;
+
+  while ((rc = getopt(argc, argv, "hc:s:R:k:p:C:")) != EOF) {
+    switch (rc) {
+    case 'c':
+      nclients = atoi(optarg);
+      break;
+    case 's':
+      seconds = atoi(optarg);
+      break;
+    case 'R':
+      rate = atol(optarg);
+      break;
+    case 'k':
+      streams = atoi(optarg);
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'C':
+      command = optarg;
+      break;
+    case 'h':
+    default:
+      fprintf(stderr, "usage: %s [-c clients] [-s seconds] [-R rate] [-k streams] [-p port] [-C command]\n", argv[0]);
+      fprintf(stderr, "\t-c\tclients connected [%d]\n", nclients);
+      fprintf(stderr, "\t-s\tseconds records are published for [%d]\n", seconds);
+      fprintf(stderr, "\t-R\trecords per second [%ld]\n", rate);
+      fprintf(stderr, "\t-k\tstreams the records are spread over [%d]\n", streams);
+      fprintf(stderr, "\t-p\tSeedLink port [%d]\n", port);
+      fprintf(stderr, "\t-C\tcommand lines each client sends, separated by semicolons [%s]\n", command);
+      exit(rc != 'h');
+    }
+  }
+  if ((nclients <= 0) || (nclients > SEEDLINK_CLIENTS) || (seconds <= 0) || (rate <= 0) || (streams <= 0) || (streams > 26) ||
+      (strlen(command) >= sizeof(lines) / 2)) {
+    fprintf(stderr, "%s: bad arguments\n", argv[0]); exit(1);
+  }
+  for (n = 0; *command != '\0'; command++) {
+    if (*command == ';') {
+      lines[n++] = '\r'; lines[n++] = '\n';
+    }
+    else {
+      lines[n++] = *command;
+    }
+  }
+  (void) strcpy(lines + n, "\r\n");
+
+  /* a socket each side of every connection */
+  if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur < rl.rlim_max)) {
+    rl.rlim_cur = rl.rlim_max;
+    (void) setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  (void) signal(SIGPIPE, SIG_IGN);
+
+  if (shmring_start(NULL, SHMRING_SLOTS) < 0) {
+    fprintf(stderr, "can't create the ring [%s]\n", strerror(errno)); exit(1);
+  }
+  if (seedlink_start(port, 0) < 0) {
+    shmring_stop(); exit(1);
+  }
+
+  /* wait for every client to be connected before publishing anything */
+  if (pipe(fds) < 0) {
+    perror("pipe"); seedlink_stop(); shmring_stop(); exit(1);
+  }
+  if ((pid = fork()) < 0) {
+    perror("fork"); seedlink_stop(); shmring_stop(); exit(1);
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    exit((load_clients(fds[1]) < 0) ? 1 : 0);
+  }
+  close(fds[1]);
+  if (read(fds[0], &c, 1) != 1) {
+    seedlink_stop(); shmring_stop(); (void) waitpid(pid, NULL, 0); exit(1);
+  }
+  close(fds[0]);
+  sleep(1);
+
+  memset(record, 0, sizeof(record));
+  memcpy(record, "000001D TEST 10HHZNZ", 20);
+  total = rate * seconds;
+  t0 = load_nsecs();
+  for (n = 0; n < total; n++) {
+    due = t0 + (n * 1000000000LL) / rate;
+    while (load_nsecs() < due)
+      (void) nanosleep(&pause, NULL);
+    (void) snprintf(key, sizeof(key), "NZ-TEST.10.HH%c", 'A' + (int) (n % streams));
+    record[17] = 'A' + (int) (n % streams);
+    stamp = load_nsecs();
+    memcpy(record + 64, &stamp, sizeof(stamp));
+    (void) shmring_push(record, sizeof(record), key, (double) time(NULL), 0);
+  }
+  t1 = load_nsecs();
+  printf("writer: %ld records in %.3f s, %.0f records/s\n", total, (t1 - t0) / 1e9, total / ((t1 - t0) / 1e9));
+  fflush(stdout);
+
+  (void) waitpid(pid, &rc, 0);
+  seedlink_stop();
+  shmring_stop();
+
+  return (WIFEXITED(rc) && (WEXITSTATUS(rc) == 0)) ? 0 : 1;
+}
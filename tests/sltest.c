@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * sltest: run the embedded SeedLink server against a private record ring
+ * and check the replies that do not fit in one batch of packets, and when
+ * TIME windows end a multi-station connection.
+ *
+ * The ring is filled with records for enough stations and streams that
+ * INFO STREAMS runs to many times the packet buffer. A long list of INFO ID
+ * requests sent in one write has to be answered in full. Two stations, one
+ * with a TIME window already over and one following new data, must keep the
+ * connection open whichever is given first, and it must end once both
+ * windows are over.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "shmring.h"
+#include "seedlink.h"
+
+#define STATIONS 100
+#define CHANNELS 3
+#define RECORDS 3000
+#define REQUESTS 200 /* INFO ID requests in one write */
+#define REPLY (1 << 20) /* most read back for one check */
+
+static int port = 18555;
+static char reply[REPLY];
+
+static int sl_connect(void) {
+  struct sockaddr_in sa;
+  int fd;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)) {
+    fprintf(stderr, "sltest: can't connect to port %d [%s]\n", port, strerror(errno)); exit(1);
+  }
+
+  return fd;
+}
+
+/* read until the server closes the connection, nothing arrives for ms or want bytes are in, *closed says which */
+static int sl_read(int fd, int ms, int want, int *closed) {
+  struct pollfd pfd;
+  ssize_t n;
+  int got = 0;
+
+  *closed = 0;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while ((got < want) && (got < REPLY) && (poll(&pfd, 1, ms) > 0)) {
+    if ((n = read(fd, reply + got, REPLY - got)) <= 0) {
+      *closed = 1; break;
+    }
+    got += n;
+  }
+
+  return got;
+}
+
+static int sl_command(int fd, char *cmd) {
+  return (write(fd, cmd, strlen(cmd)) == (ssize_t) strlen(cmd)) ? 0 : -1;
+}
+
+/* INFO STREAMS, far longer than a batch of packets */
+static int sl_info(void) {
+  char xml[SHMRING_STREAMS * 512], *p;
+  int fd, got, closed, packets, length = 0, chunk, i, n;
+
+  fd = sl_connect();
+  (void) sl_command(fd, "INFO STREAMS\r\n");
+  got = sl_read(fd, 500, REPLY, &closed);
+  close(fd);
+
+  if ((got == 0) || ((got % SEEDLINK_PACKET) != 0)) {
+    fprintf(stderr, "sltest: INFO STREAMS gave %d bytes\n", got); return -1;
+  }
+  packets = got / SEEDLINK_PACKET;
+  for (i = 0; i < packets; i++) {
+    p = reply + i * SEEDLINK_PACKET;
+    if (memcmp(p, (i < packets - 1) ? "SLINFO *" : "SLINFO  ", 8) != 0) {
+      fprintf(stderr, "sltest: INFO packet %d of %d has header %.8s\n", i + 1, packets, p); return -1;
+    }
+    chunk = ((unsigned char) p[8 + 30] << 8) | (unsigned char) p[8 + 31];
+    if (length + chunk > (int) sizeof(xml)) {
+      fprintf(stderr, "sltest: INFO xml too long\n"); return -1;
+    }
+    memcpy(xml + length, p + 8 + 56, chunk);
+    length += chunk;
+  }
+  xml[length] = '\0';
+
+  for (n = 0, p = xml; (p = strstr(p, "<stream ")) != NULL; p++, n++);
+  if ((length < SEEDLINK_BATCH * SEEDLINK_PACKET) || (n != STATIONS * CHANNELS) || (strstr(xml, "</seedlink>\n") == NULL)) {
+    fprintf(stderr, "sltest: INFO STREAMS gave %d bytes of xml with %d streams\n", length, n); return -1;
+  }
+
+  printf("sltest: INFO STREAMS of %d bytes in %d packets, %d streams\n", length, packets, n);
+  return 0;
+}
+
+/* a pipeline of requests whose replies don't fit in one buffer */
+static int sl_replies(void) {
+  char cmd[REQUESTS * 9 + 1];
+  int fd, got, closed, n = 0, i;
+
+  for (i = 0; i < REQUESTS; i++)
+    (void) strcpy(cmd + i * 9, "INFO ID\r\n");
+  fd = sl_connect();
+  (void) sl_command(fd, cmd);
+  got = sl_read(fd, 1000, REQUESTS * SEEDLINK_PACKET, &closed);
+  close(fd);
+
+  for (i = 0; i + SEEDLINK_PACKET <= got; i += SEEDLINK_PACKET)
+    if (memcmp(reply + i, "SLINFO  ", 8) == 0)
+      n++;
+  if ((n != REQUESTS) || (got != REQUESTS * SEEDLINK_PACKET)) {
+    fprintf(stderr, "sltest: %d INFO ID requests gave %d replies in %d bytes\n", REQUESTS, n, got); return -1;
+  }
+
+  printf("sltest: %d INFO ID requests in one write all answered\n", REQUESTS);
+  return 0;
+}
+
+/* two stations given in turn, ends is whether the connection should end once caught up */
+static int sl_window(char *first, char *second, int ends) {
+  char cmd[256];
+  int fd, got, closed;
+
+  fd = sl_connect();
+  (void) snprintf(cmd, sizeof(cmd), "STATION S000 XX\r\n%s\r\nSTATION S001 XX\r\n%s\r\nEND\r\n", first, second);
+  (void) sl_command(fd, cmd);
+  got = sl_read(fd, 1500, REPLY, &closed);
+  close(fd);
+
+  if (ends != ((closed) && (got >= 3) && (memcmp(reply + got - 3, "END", 3) == 0))) {
+    fprintf(stderr, "sltest: \"%s\" then \"%s\" %s\n", first, second, (ends) ? "did not end" : "ended");
+    return -1;
+  }
+
+  return 0;
+}
+
+static int sl_windows(time_t base) {
+  char over[160], open[16];
+  struct tm tm;
+
+  (void) gmtime_r(&base, &tm);
+  (void) snprintf(over, sizeof(over), "TIME %04d,%02d,%02d,%02d,%02d,%02d %04d,%02d,%02d,%02d,%02d,%02d",
+    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec + 10);
+  (void) strcpy(open, "DATA");
+
+  if ((sl_window(over, open, 0) < 0) || (sl_window(open, over, 0) < 0) || (sl_window(over, over, 1) < 0))
+    return -1;
+
+  printf("sltest: TIME windows end the connection only once every station's is over\n");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char record[SHMRING_RECSIZE], key[20];
+  time_t base;
+  int rc, i;
+
+  while ((rc = getopt(argc, argv, "hp:")) != EOF) {
+    switch (rc) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'h':
+    default:
+      fprintf(stderr, "usage: %s [-p port]\n", argv[0]);
+      exit(rc != 'h');
+    }
+  }
+
+  (void) signal(SIGPIPE, SIG_IGN);
+  if (shmring_start(NULL, SHMRING_SLOTS) < 0) {
+    fprintf(stderr, "sltest: can't create the ring [%s]\n", strerror(errno)); return 1;
+  }
+  if (seedlink_start(port, 0) < 0) {
+    shmring_stop(); return 1;
+  }
+
+  /* a second a record, well in the past */
+  base = time(NULL) - 2 * RECORDS;
+  memset(record, 0, sizeof(record));
+  for (i = 0; i < RECORDS; i++) {
+    (void) snprintf(key, sizeof(key), "XX-S%03d.10.HH%c", (i / CHANNELS) % STATIONS, 'Z' - (i % CHANNELS));
+    (void) shmring_push(record, sizeof(record), key, (double) (base + i), 0);
+  }
+
+  rc = ((sl_info() < 0) || (sl_replies() < 0) || (sl_windows(base) < 0));
+
+  seedlink_stop();
+  shmring_stop();
+
+  return rc;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * statbench: time add_status from several threads at once, as the packet
+ * threads call it, against the same update made under the station lock,
+ * with a collector taking the totals away meanwhile as lib_stats_timer
+ * does. Every count added must turn up in what was collected.
+ *
+ * The accumulator macros are static to libstats.c, so it is built in here.
+ */
+
+#include "../lib330/libstats.c"
+
+#include <time.h>
+#include <unistd.h>
+
+#define ADDS 2000000 /* per thread */
+#define MAXTHREADS 64
+
+static tq330 q330;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int running;
+static long long collected;
+
+static long long bench_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *bench_atomic(void *p) {
+  long i;
+
+  for (i = 0; i < ADDS; i++)
+    add_status(&q330, AC_READ, 1);
+  return NULL;
+}
+
+static void *bench_locked(void *p) {
+  long i;
+
+  for (i = 0; i < ADDS; i++) {
+    pthread_mutex_lock(&mutex);
+    q330.share.accmstats[AC_READ].accum += 1;
+    q330.share.accmstats[AC_READ].accum_ds += 1;
+    pthread_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+static void *bench_collect(void *p) {
+  int locked = *(int *) p;
+
+  while (running) {
+    if (locked) {
+      pthread_mutex_lock(&mutex);
+      collected += q330.share.accmstats[AC_READ].accum;
+      q330.share.accmstats[AC_READ].accum = 0;
+      pthread_mutex_unlock(&mutex);
+    }
+    else
+      collected += acc_take(&q330.share.accmstats[AC_READ].accum);
+    usleep(100);
+  }
+  return NULL;
+}
+
+/* ns per add with the given number of threads, -1 if counts went missing */
+static double bench_run(int threads, int locked) {
+  pthread_t thread[MAXTHREADS], collector;
+  long long t0, t1;
+  int i;
+
+  memset(&q330.share.accmstats, 0, sizeof(q330.share.accmstats));
+  collected = 0;
+  running = 1;
+  pthread_create(&collector, NULL, bench_collect, &locked);
+  t0 = bench_nsecs();
+  for (i = 0; i < threads; i++)
+    pthread_create(&thread[i], NULL, locked ? bench_locked : bench_atomic, NULL);
+  for (i = 0; i < threads; i++)
+    pthread_join(thread[i], NULL);
+  t1 = bench_nsecs();
+  running = 0;
+  pthread_join(collector, NULL);
+  collected += q330.share.accmstats[AC_READ].accum;
+
+  if ((collected != (long long) threads * ADDS) || (q330.share.accmstats[AC_READ].accum_ds != threads * ADDS)) {
+    fprintf(stderr, "statbench: %d threads added %lld, collected %lld\n", threads, (long long) threads * ADDS, collected);
+    return -1.0;
+  }
+  return (double) (t1 - t0) / ((double) threads * ADDS);
+}
+
+int main(int argc, char **argv) {
+  int threads, max = (argc > 1) ? atoi(argv[1]) : 8;
+  double atomic, locked;
+
+  if ((max < 1) || (max > MAXTHREADS))
+    max = 8;
+  printf("threads  atomic ns/add  locked ns/add\n");
+  for (threads = 1; threads <= max; threads *= 2) {
+    if (((atomic = bench_run(threads, 0)) < 0) || ((locked = bench_run(threads, 1)) < 0))
+      return 1;
+    printf("%7d  %13.1f  %13.1f\n", threads, atomic, locked);
+  }
+
+  return 0;
+}
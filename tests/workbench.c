@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 Institute of Geological & Nuclear Sciences Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *		notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *		notice, this list of conditions and the following disclaimer in the
+ *		documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * workbench: replay a capture as fast as lib330 will take it, once for each
+ * number of worker threads asked for, and report how quickly the main
+ * digitizer LCQs were drained into miniseed records in each case.
+ *
+ * Records are summed into an order independent checksum, so a run with
+ * workers can be checked against the run without them as well as timed.
+ * The CPU time of the whole process is reported alongside, since with
+ * fewer cores than workers the threads only take turns.
+ *
+ * A capture comes from quant2dali -c, or from q330sim through any client.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "libtypes.h"
+#include "libclient.h"
+#include "libmsgs.h"
+
+#define RUNS 8
+
+static char *capture = NULL;
+static int workers[RUNS] = { 0, 1, 2, 4 };
+static int runs = 4;
+static int replays = 3;
+static volatile int finished = 0;
+static long long started = 0;
+static double startcpu = 0.0;
+static long packets = 0;
+static long records = 0;
+static long drained = 0; /* records by the end of the replay */
+static unsigned long long checksum = 0;
+
+static long long bench_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double bench_cpu(void) {
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static void bench_state(pointer p) {
+}
+
+static void bench_messages(pointer p) {
+  tmsg_call *msg = (tmsg_call *) p;
+
+  /* timed from the replay starting, not from asking for it */
+  if (msg->code == LIBMSG_REPLAY) {
+    started = bench_nsecs();
+    startcpu = bench_cpu();
+  }
+  if (msg->code == LIBMSG_REPLAYEND) {
+    packets = atol(msg->suffix);
+    drained = records;
+    finished = 1;
+  }
+}
+
+/* called from the workers as well as the lib330 thread */
+static void bench_minidata(pointer p) {
+  tminiseed_call *mini = (tminiseed_call *) p;
+  unsigned char *data = (unsigned char *) mini->data_address;
+  unsigned long long h = 14695981039346656037ULL;
+  int i;
+
+  /* the message log carries the times messages were logged */
+  if (strcmp(mini->channel, "LOG") != 0) {
+    for (i = 0; i < mini->data_size; i++)
+      h = (h ^ data[i]) * 1099511628211ULL;
+    __atomic_fetch_add(&checksum, h, __ATOMIC_RELAXED);
+  }
+  __atomic_fetch_add(&records, 1, __ATOMIC_RELAXED);
+}
+
+static int bench_run(int nworkers, double *elapsed, double *cpu) {
+  unsigned long long serial = 0x0100000000001000LL;
+  tpar_create ci;
+  tcontext ct;
+  enum tliberr err;
+
+  memset(&ci, 0, sizeof(ci));
+  memcpy(ci.q330id_serial, &serial, sizeof(ci.q330id_serial));
+  ci.q330id_dataport = LP_TEL1;
+  strcpy(ci.q330id_station, "BENCH");
+  strcpy(ci.host_software, "workbench");
+  ci.opt_zoneadjust = 1;
+  ci.opt_minifilter = OMF_ALL;
+  ci.opt_workers = nworkers;
+  ci.mini_embed = 1;
+  ci.mini_separate = 1;
+  ci.call_minidata = bench_minidata;
+  ci.call_state = bench_state;
+  ci.call_messages = bench_messages;
+
+  lib_create_context(&ct, &ci);
+  if (ct == NULL) {
+    (void) fprintf(stderr, "can't create a context [%d]\n", (int) ci.resp_err); return -1;
+  }
+  finished = 0; packets = 0; records = 0; drained = 0; checksum = 0;
+
+  if ((err = lib_replay(ct, capture, FALSE)) != LIBERR_NOERR) {
+    (void) fprintf(stderr, "can't replay %s [%d]\n", capture, (int) err);
+    lib_destroy_context(&ct); return -1;
+  }
+  /* the workers are drained before the end of the replay is reported */
+  while (!finished)
+    usleep(100);
+  *elapsed = (bench_nsecs() - started) / 1e9; *cpu = bench_cpu() - startcpu;
+
+  /* the lib330 thread has to have gone before the context is, asking again
+     as the end of the replay may still set the state it wants back to idle */
+  while (lib_get_state(ct, &err, NULL) != LIBSTATE_TERM) {
+    lib_change_state(ct, LIBSTATE_TERM, LIBERR_CLOSED);
+    usleep(10000);
+  }
+  lib_destroy_context(&ct);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long long reference = 0;
+  double elapsed, cpu, best, bestcpu;
+  char *s;
+  int differ = 0, rc, i, j;
+
+  while ((rc = getopt(argc, argv, "hw:n:")) != EOF) {
+    switch (rc) {
+    case 'w':
+      for (runs = 0, s = strtok(optarg, ","); (s != NULL) && (runs < RUNS); s = strtok(NULL, ","))
+        workers[runs++] = atoi(s);
+      break;
+    case 'n':
+      replays = atoi(optarg);
+      break;
+    case 'h':
+    default:
+      (void) fprintf(stderr, "usage: %s [-w workers,...] [-n replays] capture\n", argv[0]);
+      (void) fprintf(stderr, "\t-w\tworker counts to try, up to %d of them [0,1,2,4]\n", RUNS);
+      (void) fprintf(stderr, "\t-n\treplays of each, the fastest is reported [%d]\n", replays);
+      exit(rc != 'h');
+    }
+  }
+  if ((optind >= argc) || (runs == 0) || (replays <= 0)) {
+    (void) fprintf(stderr, "%s: a capture file is needed\n", argv[0]); exit(1);
+  }
+  capture = argv[optind];
+
+  (void) printf("%s, %ld cores online\n", capture, sysconf(_SC_NPROCESSORS_ONLN));
+  for (i = 0; i < runs; i++) {
+    best = bestcpu = 0.0;
+    for (j = 0; j < replays; j++) {
+      if (bench_run(workers[i], &elapsed, &cpu) < 0)
+        exit(1);
+      if ((j == 0) || (elapsed < best)) {
+        best = elapsed; bestcpu = cpu;
+      }
+    }
+    (void) printf("workers %2d: %ld packets, %ld records in %.3f s, %.0f packets/s, %.0f records/s, cpu %.3f s",
+      workers[i], packets, drained, best, packets / best, drained / best, bestcpu);
+    if (i == 0)
+      reference = checksum;
+    (void) printf("%s\n", (checksum == reference) ? "" : ", records differ from the first run");
+    if (checksum != reference)
+      differ = 1;
+  }
+
+  return differ;
+}